@@ -0,0 +1,102 @@
+#include <fix16.h>
+#include <fix16_fft.h>
+#include <fix16_rfft.h>
+#include "interface.h"
+#include <stdio.h>
+
+// Cycles per 128 point transform plus the magnitude of every bin, the way
+// the audio apps use them: fix16_fft() with fix16_sqrt() against
+// fix16_rfft_u8() with fix16_rfft_bin_mag().
+
+#define LENGTH FIX16_RFFT_LENGTH
+#define ROUNDS 16
+
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;
+    uint32_t count;
+} cyclecount_t;
+
+#define CYCLECOUNT_INIT {0xFFFFFFFF, 0, 0, 0}
+
+static void cyclecount_update(cyclecount_t *data, uint32_t cycles)
+{
+    if (cycles < data->min)
+        data->min = cycles;
+    if (cycles > data->max)
+        data->max = cycles;
+
+    data->sum += cycles;
+    data->count++;
+}
+
+#define MEASURE(variable, statement) { \
+    start_timing(); \
+    statement; \
+    cyclecount_update(&variable, end_timing()); \
+}
+
+#define PRINT(variable, label) { \
+    print_value(label " min", variable.min); \
+    print_value(label " max", variable.max); \
+    print_value(label " avg", variable.sum / variable.count); \
+}
+
+static cyclecount_t fft_cycles = CYCLECOUNT_INIT;
+static cyclecount_t fft_mag_cycles = CYCLECOUNT_INIT;
+static cyclecount_t rfft_cycles = CYCLECOUNT_INIT;
+static cyclecount_t rfft_mag_cycles = CYCLECOUNT_INIT;
+
+static uint8_t samples[LENGTH];
+static fix16_t real[LENGTH];
+static fix16_t imag[LENGTH];
+static int32_t buf[LENGTH];
+static volatile uint32_t sink;
+
+static void fft_mag(void)
+{
+    unsigned i;
+    for (i = 0; i < LENGTH; i++)
+        sink = fix16_to_int(fix16_sqrt(fix16_sadd(fix16_mul(real[i], real[i]),
+                                                  fix16_mul(imag[i], imag[i]))));
+}
+
+static void rfft_mag(void)
+{
+    unsigned i;
+    for (i = 0; i <= FIX16_RFFT_BINS; i++)
+        sink = fix16_rfft_to_int(fix16_rfft_bin_mag(buf, i));
+}
+
+int main()
+{
+    unsigned round, i;
+    uint32_t seed = 1;
+
+    interface_init();
+
+    start_timing();
+    print_value("Timestamp bias", end_timing());
+
+    for (round = 0; round < ROUNDS; round++)
+    {
+        for (i = 0; i < LENGTH; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            samples[i] = seed >> 24;
+        }
+
+        MEASURE(fft_cycles, fix16_fft(samples, real, imag, LENGTH));
+        MEASURE(fft_mag_cycles, fft_mag());
+        MEASURE(rfft_cycles, fix16_rfft_u8(samples, buf));
+        MEASURE(rfft_mag_cycles, rfft_mag());
+    }
+
+    PRINT(fft_cycles, "fix16_fft");
+    PRINT(fft_mag_cycles, "fix16_sqrt mag");
+    PRINT(rfft_cycles, "fix16_rfft_u8");
+    PRINT(rfft_mag_cycles, "fix16_rfft_bin_mag");
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <fix16.h>
+#include "interface.h"
+#include <stdio.h>
+
+// Cycles per fix16_sin(), fix16_cos() and fix16_atan2() call, built once
+// per trig mode: the polynomial the badge used to build with
+// (FIXMATH_FAST_SIN, FIXMATH_NO_CACHE) against the flash tables
+// (FIXMATH_TRIG_LUT).
+
+#define CALLS 256
+#define ROUNDS 16
+
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;
+    uint32_t count;
+} cyclecount_t;
+
+#define CYCLECOUNT_INIT {0xFFFFFFFF, 0, 0, 0}
+
+static void cyclecount_update(cyclecount_t *data, uint32_t cycles)
+{
+    if (cycles < data->min)
+        data->min = cycles;
+    if (cycles > data->max)
+        data->max = cycles;
+
+    data->sum += cycles;
+    data->count++;
+}
+
+#define MEASURE(variable, statement) { \
+    start_timing(); \
+    statement; \
+    cyclecount_update(&variable, end_timing()); \
+}
+
+// per call, a measurement being CALLS calls
+#define PRINT(variable, label) { \
+    print_value(label " min", variable.min / CALLS); \
+    print_value(label " max", variable.max / CALLS); \
+    print_value(label " avg", variable.sum / variable.count / CALLS); \
+}
+
+static cyclecount_t sin_cycles = CYCLECOUNT_INIT;
+static cyclecount_t cos_cycles = CYCLECOUNT_INIT;
+static cyclecount_t atan2_cycles = CYCLECOUNT_INIT;
+
+static fix16_t angles[CALLS];
+static fix16_t xs[CALLS];
+static fix16_t ys[CALLS];
+static volatile fix16_t sink;
+
+static void run_sin(void)
+{
+    unsigned i;
+    for (i = 0; i < CALLS; i++)
+        sink = fix16_sin(angles[i]);
+}
+
+static void run_cos(void)
+{
+    unsigned i;
+    for (i = 0; i < CALLS; i++)
+        sink = fix16_cos(angles[i]);
+}
+
+static void run_atan2(void)
+{
+    unsigned i;
+    for (i = 0; i < CALLS; i++)
+        sink = fix16_atan2(ys[i], xs[i]);
+}
+
+int main()
+{
+    unsigned round, i;
+    uint32_t seed = 1;
+
+    interface_init();
+
+#if defined(FIXMATH_TRIG_LUT)
+    print_value("FIXMATH_TRIG_LUT_BITS", FIXMATH_TRIG_LUT_BITS);
+#endif
+
+    start_timing();
+    print_value("Timestamp bias", end_timing());
+
+    for (round = 0; round < ROUNDS; round++)
+    {
+        // the angles the LED patterns and the FFT use, within a few turns
+        for (i = 0; i < CALLS; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            angles[i] = (fix16_t)(seed >> 12) - (1 << 19);
+            seed = seed * 1103515245 + 12345;
+            xs[i] = (fix16_t)seed >> 8;
+            seed = seed * 1103515245 + 12345;
+            ys[i] = (fix16_t)seed >> 8;
+        }
+
+        MEASURE(sin_cycles, run_sin());
+        MEASURE(cos_cycles, run_cos());
+        MEASURE(atan2_cycles, run_atan2());
+    }
+
+    PRINT(sin_cycles, "fix16_sin");
+    PRINT(cos_cycles, "fix16_cos");
+    PRINT(atan2_cycles, "fix16_atan2");
+
+    return 0;
+}
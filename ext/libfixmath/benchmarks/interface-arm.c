@@ -20,7 +20,7 @@ void start_timing()
      STCURRENT = 0;
 }
 
-uint16_t end_timing()
+uint32_t end_timing()
 {
      return 0x00FFFFFF - STCURRENT - 4;
 }
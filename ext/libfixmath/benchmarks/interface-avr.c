@@ -28,7 +28,7 @@ void start_timing()
     TCNT1 = 0;
 }
 
-uint16_t end_timing()
+uint32_t end_timing()
 {
     return TCNT1 - 9;
 }
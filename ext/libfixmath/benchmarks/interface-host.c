@@ -0,0 +1,51 @@
+#include "interface.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// This targets the build host, for a quick comparison before running the
+// simulators. On x86 the time stamp counter gives cycles, elsewhere the
+// monotonic clock gives nanoseconds.
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t start;
+
+void interface_init()
+{
+}
+
+void start_timing()
+{
+    start = __rdtsc();
+}
+
+uint32_t end_timing()
+{
+    return (uint32_t)(__rdtsc() - start);
+}
+#else
+static struct timespec start;
+
+void interface_init()
+{
+}
+
+void start_timing()
+{
+    clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+uint32_t end_timing()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - start.tv_sec) * 1000000000L +
+                      (now.tv_nsec - start.tv_nsec));
+}
+#endif
+
+void print_value(const char *label, int32_t value)
+{
+    printf("%-20s %ld\n", label, (long)value);
+}
@@ -10,7 +10,7 @@ void interface_init();
 void start_timing();
 
 // Return the number of clock cycles passed since start_timing();
-uint16_t end_timing();
+uint32_t end_timing();
 
 // Print a value to console, along with a descriptive label
 void print_value(const char *label, int32_t value);
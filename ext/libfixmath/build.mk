@@ -6,9 +6,11 @@ LIBFIXMATHSRC += \
                  $(LIBFIXMATH)/libfixmath/fix16_str.c \
                  $(LIBFIXMATH)/libfixmath/fract32.c \
                  $(LIBFIXMATH)/libfixmath/uint32.c \
-                 $(LIBFIXMATH)/contrib/fix16_fft.c \
+                 $(LIBFIXMATH)/contrib/fix16_fft.c \
+                 $(LIBFIXMATH)/contrib/fix16_rfft.c \
 
-LIBFIXMATHDEFS += -DFIXMATH_FAST_SIN -DFIXMATH_NO_CACHE
+# const quarter-wave tables in flash for sin, cos and atan2, nothing in RAM
+LIBFIXMATHDEFS += -DFIXMATH_TRIG_LUT -DFIXMATH_TRIG_LUT_BITS=8 -DFIXMATH_NO_CACHE
 
 LIBFIXMATHINC += $(LIBFIXMATH)/libfixmath $(LIBFIXMATH)/contrib
 
@@ -0,0 +1,168 @@
+/* 128 point real-input FFT with precomputed twiddles, see fix16_rfft.h.
+ *
+ * Refer to http://www.dspguide.com/ch12/5.htm for the real FFT by way of
+ * a half length complex FFT.
+ *
+ * This file is released to public domain.
+ */
+
+#include <stdint.h>
+#include <fix16.h>
+#include <fix16_rfft.h>
+#include "fix16_rfft_twiddle.h"
+
+#define M         (FIX16_RFFT_LENGTH / 2)   // complex points
+#define TW_SHIFT  14
+
+#define RE(i)     buf[2 * (i)]
+#define IM(i)     buf[2 * (i) + 1]
+
+// base-4 digit reversal of a 64 point index
+static inline unsigned rev4_64(unsigned n)
+{
+  return ((n & 3) << 4) | (n & 12) | (n >> 4);
+}
+
+static void digit_reverse(int32_t *buf)
+{
+  unsigned i, r;
+  int32_t t;
+
+  for (i = 0; i < M; i++) {
+    r = rev4_64(i);
+    if (r > i) {
+      t = RE(i); RE(i) = RE(r); RE(r) = t;
+      t = IM(i); IM(i) = IM(r); IM(r) = t;
+    }
+  }
+}
+
+// Decimation in time radix-4 stages over 64 points in digit reversed
+// order. Each butterfly divides by 4, so the values never grow.
+static void radix4_stages(int32_t *buf)
+{
+  unsigned span, quarter, step, g, j, m, k;
+  int32_t re[4], im[4], c, s, r;
+  int32_t t0r, t0i, t1r, t1i, t2r, t2i, t3r, t3i;
+
+  // first stage: every twiddle is 1
+  for (g = 0; g < M; g += 4) {
+    t0r = RE(g) + RE(g + 2);  t0i = IM(g) + IM(g + 2);
+    t1r = RE(g) - RE(g + 2);  t1i = IM(g) - IM(g + 2);
+    t2r = RE(g + 1) + RE(g + 3);  t2i = IM(g + 1) + IM(g + 3);
+    t3r = RE(g + 1) - RE(g + 3);  t3i = IM(g + 1) - IM(g + 3);
+
+    RE(g) = (t0r + t2r) >> 2;      IM(g) = (t0i + t2i) >> 2;
+    RE(g + 1) = (t1r + t3i) >> 2;  IM(g + 1) = (t1i - t3r) >> 2;
+    RE(g + 2) = (t0r - t2r) >> 2;  IM(g + 2) = (t0i - t2i) >> 2;
+    RE(g + 3) = (t1r - t3i) >> 2;  IM(g + 3) = (t1i + t3r) >> 2;
+  }
+
+  for (span = 16; span <= M; span *= 4) {
+    quarter = span / 4;
+    step = 2 * M / span;    // W_span^j is W_128^(j * step)
+    for (j = 0; j < quarter; j++) {
+      for (g = j; g < M; g += span) {
+        re[0] = RE(g);
+        im[0] = IM(g);
+        for (m = 1; m < 4; m++) {
+          k = g + m * quarter;
+          c = rfft_twiddle[m * j * step][0];
+          s = rfft_twiddle[m * j * step][1];
+          r = RE(k);
+          re[m] = (r * c + IM(k) * s) >> TW_SHIFT;
+          im[m] = (IM(k) * c - r * s) >> TW_SHIFT;
+        }
+
+        t0r = re[0] + re[2];  t0i = im[0] + im[2];
+        t1r = re[0] - re[2];  t1i = im[0] - im[2];
+        t2r = re[1] + re[3];  t2i = im[1] + im[3];
+        t3r = re[1] - re[3];  t3i = im[1] - im[3];
+
+        RE(g) = (t0r + t2r) >> 2;                IM(g) = (t0i + t2i) >> 2;
+        RE(g + quarter) = (t1r + t3i) >> 2;      IM(g + quarter) = (t1i - t3r) >> 2;
+        RE(g + 2 * quarter) = (t0r - t2r) >> 2;  IM(g + 2 * quarter) = (t0i - t2i) >> 2;
+        RE(g + 3 * quarter) = (t1r - t3i) >> 2;  IM(g + 3 * quarter) = (t1i + t3r) >> 2;
+      }
+    }
+  }
+}
+
+// Splits the 64 point transform of the packed samples z[n] = x[2n] + j x[2n+1]
+// into bins 0..64 of the 128 point transform of x:
+//   E = (Z[k] + conj Z[64-k]) / 2,  O = -j (Z[k] - conj Z[64-k]) / 2
+//   X[k] = E + W^k O,  X[64-k] = conj(E - W^k O)
+// Z is already divided by 64, the extra halving below makes X divided by 128.
+static void split(int32_t *buf)
+{
+  unsigned k;
+  int32_t er, ei, or_, oi, wr, wi, c, s, ar, ai, br, bi;
+
+  ar = RE(0);
+  ai = IM(0);
+  RE(0) = (ar + ai) >> 1;   // bin 0
+  IM(0) = (ar - ai) >> 1;   // bin 64, packed into the imaginary part of bin 0
+
+  for (k = 1; k <= M / 2; k++) {
+    ar = RE(k);      ai = IM(k);
+    br = RE(M - k);  bi = IM(M - k);
+
+    er = (ar + br) >> 2;
+    ei = (ai - bi) >> 2;
+    or_ = (ai + bi) >> 2;
+    oi = (br - ar) >> 2;
+
+    c = rfft_twiddle[k][0];
+    s = rfft_twiddle[k][1];
+    wr = (or_ * c + oi * s) >> TW_SHIFT;
+    wi = (oi * c - or_ * s) >> TW_SHIFT;
+
+    RE(k) = er + wr;
+    IM(k) = ei + wi;
+    RE(M - k) = er - wr;
+    IM(M - k) = wi - ei;
+  }
+}
+
+void fix16_rfft(int32_t *buf)
+{
+  digit_reverse(buf);
+  radix4_stages(buf);
+  split(buf);
+}
+
+void fix16_rfft_u8(const uint8_t *input, int32_t *buf)
+{
+  unsigned i, r;
+
+  for (i = 0; i < M; i++) {
+    r = rev4_64(i);
+    RE(r) = (int32_t) input[2 * i] << FIX16_RFFT_INPUT_SHIFT;
+    IM(r) = (int32_t) input[2 * i + 1] << FIX16_RFFT_INPUT_SHIFT;
+  }
+  radix4_stages(buf);
+  split(buf);
+}
+
+uint32_t fix16_rfft_mag(int32_t re, int32_t im)
+{
+  uint32_t a = (uint32_t) (re < 0 ? -re : re);
+  uint32_t b = (uint32_t) (im < 0 ? -im : im);
+  uint32_t hi, lo, m;
+
+  hi = a > b ? a : b;
+  lo = a > b ? b : a;
+
+  // max(hi, 7/8 hi + 1/2 lo)
+  m = hi - (hi >> 3) + (lo >> 1);
+  return m > hi ? m : hi;
+}
+
+uint32_t fix16_rfft_bin_mag(const int32_t *buf, unsigned k)
+{
+  if (k == 0)
+    return fix16_rfft_mag(buf[0], 0);
+  if (k == M)
+    return fix16_rfft_mag(buf[1], 0);
+  return fix16_rfft_mag(buf[2 * k], buf[2 * k + 1]);
+}
@@ -0,0 +1,49 @@
+/* 128 point real-input FFT with precomputed twiddles.
+ *
+ * The 128 real samples are packed into 64 complex points, transformed with
+ * three radix-4 stages and split back into the spectrum of the real signal,
+ * all in place in one buffer of FIX16_RFFT_LENGTH words. The twiddle
+ * factors come from a const table generated by gen_rfft_twiddle.py, so
+ * nothing trigonometric is computed at run time.
+ *
+ * Samples are loaded as sample << FIX16_RFFT_INPUT_SHIFT, and every stage
+ * scales its output down, so the bins come out divided by the transform
+ * length: bin k holds DFT(x)[k] / 128 in the same units as the input,
+ * shifted by FIX16_RFFT_INPUT_SHIFT. That is the normalization fix16_fft()
+ * uses by default.
+ */
+
+#ifndef __FIX16_RFFT_H__
+#define __FIX16_RFFT_H__
+#include <stdint.h>
+#include <fix16.h>
+
+#define FIX16_RFFT_LENGTH       128
+#define FIX16_RFFT_BINS         (FIX16_RFFT_LENGTH / 2)
+#define FIX16_RFFT_INPUT_SHIFT  7   // keeps 8 bit samples and every product in 32 bits
+
+// Converts a bin value to fix16_t, or to whole sample units.
+#define fix16_rfft_to_fix16(x)  ((fix16_t) (x) << (16 - FIX16_RFFT_INPUT_SHIFT))
+#define fix16_rfft_to_int(x)    ((int32_t) (x) >> FIX16_RFFT_INPUT_SHIFT)
+
+// Transforms FIX16_RFFT_LENGTH real values in place. On input buf[i] is
+// sample i, already scaled by FIX16_RFFT_INPUT_SHIFT (so |buf[i]| < 2^15).
+// On output buf[2k] and buf[2k+1] are the real and imaginary parts of
+// bin k, for k = 1..FIX16_RFFT_BINS-1. Bins 0 and FIX16_RFFT_BINS are
+// real, their values are in buf[0] and buf[1]. The upper half of the
+// spectrum is the complex conjugate of the lower half.
+void fix16_rfft(int32_t *buf);
+
+// Loads FIX16_RFFT_LENGTH 8 bit samples into buf and transforms them.
+// The samples are scattered straight to the order the radix-4 stages want
+// them in, which saves fix16_rfft() its reordering pass.
+void fix16_rfft_u8(const uint8_t *input, int32_t *buf);
+
+// |re + j im| within 4%, from a two segment alpha max plus beta min
+// approximation: no multiply, no square root.
+uint32_t fix16_rfft_mag(int32_t re, int32_t im);
+
+// Magnitude of bin k of a transformed buffer, k = 0..FIX16_RFFT_BINS.
+uint32_t fix16_rfft_bin_mag(const int32_t *buf, unsigned k);
+
+#endif /* __FIX16_RFFT_H__ */
@@ -0,0 +1,109 @@
+/* Generated by gen_rfft_twiddle.py, do not edit. */
+
+#ifndef __FIX16_RFFT_TWIDDLE_H__
+#define __FIX16_RFFT_TWIDDLE_H__
+#include <stdint.h>
+
+#define FIX16_RFFT_TWIDDLE_ONE 16384
+
+/* { cos, sin } of 2 pi k / 128, for k = 0..95 */
+static const int16_t rfft_twiddle[96][2] = {
+  {  16384,      0 },
+  {  16364,    804 },
+  {  16305,   1606 },
+  {  16207,   2404 },
+  {  16069,   3196 },
+  {  15893,   3981 },
+  {  15679,   4756 },
+  {  15426,   5520 },
+  {  15137,   6270 },
+  {  14811,   7005 },
+  {  14449,   7723 },
+  {  14053,   8423 },
+  {  13623,   9102 },
+  {  13160,   9760 },
+  {  12665,  10394 },
+  {  12140,  11003 },
+  {  11585,  11585 },
+  {  11003,  12140 },
+  {  10394,  12665 },
+  {   9760,  13160 },
+  {   9102,  13623 },
+  {   8423,  14053 },
+  {   7723,  14449 },
+  {   7005,  14811 },
+  {   6270,  15137 },
+  {   5520,  15426 },
+  {   4756,  15679 },
+  {   3981,  15893 },
+  {   3196,  16069 },
+  {   2404,  16207 },
+  {   1606,  16305 },
+  {    804,  16364 },
+  {      0,  16384 },
+  {   -804,  16364 },
+  {  -1606,  16305 },
+  {  -2404,  16207 },
+  {  -3196,  16069 },
+  {  -3981,  15893 },
+  {  -4756,  15679 },
+  {  -5520,  15426 },
+  {  -6270,  15137 },
+  {  -7005,  14811 },
+  {  -7723,  14449 },
+  {  -8423,  14053 },
+  {  -9102,  13623 },
+  {  -9760,  13160 },
+  { -10394,  12665 },
+  { -11003,  12140 },
+  { -11585,  11585 },
+  { -12140,  11003 },
+  { -12665,  10394 },
+  { -13160,   9760 },
+  { -13623,   9102 },
+  { -14053,   8423 },
+  { -14449,   7723 },
+  { -14811,   7005 },
+  { -15137,   6270 },
+  { -15426,   5520 },
+  { -15679,   4756 },
+  { -15893,   3981 },
+  { -16069,   3196 },
+  { -16207,   2404 },
+  { -16305,   1606 },
+  { -16364,    804 },
+  { -16384,      0 },
+  { -16364,   -804 },
+  { -16305,  -1606 },
+  { -16207,  -2404 },
+  { -16069,  -3196 },
+  { -15893,  -3981 },
+  { -15679,  -4756 },
+  { -15426,  -5520 },
+  { -15137,  -6270 },
+  { -14811,  -7005 },
+  { -14449,  -7723 },
+  { -14053,  -8423 },
+  { -13623,  -9102 },
+  { -13160,  -9760 },
+  { -12665, -10394 },
+  { -12140, -11003 },
+  { -11585, -11585 },
+  { -11003, -12140 },
+  { -10394, -12665 },
+  {  -9760, -13160 },
+  {  -9102, -13623 },
+  {  -8423, -14053 },
+  {  -7723, -14449 },
+  {  -7005, -14811 },
+  {  -6270, -15137 },
+  {  -5520, -15426 },
+  {  -4756, -15679 },
+  {  -3981, -15893 },
+  {  -3196, -16069 },
+  {  -2404, -16207 },
+  {  -1606, -16305 },
+  {   -804, -16364 },
+};
+
+#endif /* __FIX16_RFFT_TWIDDLE_H__ */
@@ -0,0 +1,31 @@
+'''This script generates fix16_rfft_twiddle.h, the twiddle factors of the
+128 point real FFT in fix16_rfft.c. The table is const so it stays in flash
+instead of being computed with fix16_sin()/fix16_cos() on every transform.
+
+W(k) = cos(2 pi k / 128) - j sin(2 pi k / 128), in Q14. The 64 point
+complex radix-4 stages use the even entries up to W(90), the real split
+uses W(0) to W(63).
+'''
+
+import math
+
+LENGTH = 128
+ENTRIES = 96
+ONE = 1 << 14
+
+f = open('fix16_rfft_twiddle.h', 'w')
+f.write('/* Generated by gen_rfft_twiddle.py, do not edit. */\n\n')
+f.write('#ifndef __FIX16_RFFT_TWIDDLE_H__\n')
+f.write('#define __FIX16_RFFT_TWIDDLE_H__\n')
+f.write('#include <stdint.h>\n\n')
+f.write('#define FIX16_RFFT_TWIDDLE_ONE %d\n\n' % ONE)
+f.write('/* { cos, sin } of 2 pi k / %d, for k = 0..%d */\n' % (LENGTH, ENTRIES - 1))
+f.write('static const int16_t rfft_twiddle[%d][2] = {\n' % ENTRIES)
+for k in range(ENTRIES):
+    a = 2 * math.pi * k / LENGTH
+    c = int(round(math.cos(a) * ONE))
+    s = int(round(math.sin(a) * ONE))
+    f.write('  { %6d, %6d },\n' % (c, s))
+f.write('};\n\n')
+f.write('#endif /* __FIX16_RFFT_TWIDDLE_H__ */\n')
+f.close()
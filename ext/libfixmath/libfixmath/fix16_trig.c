@@ -1,14 +1,16 @@
 #include <limits.h>
 #include "fix16.h"
 
-#if defined(FIXMATH_SIN_LUT)
+#if defined(FIXMATH_TRIG_LUT)
+#include "fix16_trig_lut.h"
+#elif defined(FIXMATH_SIN_LUT)
 #include "fix16_trig_sin_lut.h"
 #elif !defined(FIXMATH_NO_CACHE)
 static fix16_t _fix16_sin_cache_index[4096]  = { 0 };
 static fix16_t _fix16_sin_cache_value[4096]  = { 0 };
 #endif
 
-#ifndef FIXMATH_NO_CACHE
+#if !defined(FIXMATH_NO_CACHE) && !defined(FIXMATH_TRIG_LUT)
 static fix16_t _fix16_atan_cache_index[2][4096] = { { 0 }, { 0 } };
 static fix16_t _fix16_atan_cache_value[4096] = { 0 };
 #endif
@@ -47,6 +49,125 @@ fix16_t fix16_sin_parabola(fix16_t inAngle)
 	return retval;
 }
 
+#ifdef FIXMATH_TRIG_LUT
+/* FIXMATH_TRIG_LUT uses only the const tables of fix16_trig_lut.h, with
+ * linear interpolation, and keeps no cache: nothing but a few words of stack
+ * in RAM. FIXMATH_TRIG_LUT_BITS picks the table size, 2^bits entries a
+ * quarter wave; at 8 the sine is within 1/65536 and the tables take 1 kB.
+ */
+
+/* The angle as a fraction of a turn, 2^32 being a full turn, so that the
+ * reduction to one turn is the wrap around of the addition:
+ * inAngle * 2^16 / (2 pi). In 16 bit halves, not every target multiplies
+ * to 64 bits in hardware.
+ */
+static uint32_t _fix16_trig_phase(fix16_t inAngle)
+{
+	const uint32_t scale = 683565276; /* 2^32 / (2 pi) */
+	uint32_t ah = (uint32_t)inAngle >> 16, al = (uint32_t)inAngle & 0xFFFF;
+	uint32_t sh = scale >> 16, sl = scale & 0xFFFF;
+	uint32_t phase;
+
+	/* bits 16 to 47 of inAngle * scale */
+	phase = ((ah * sh) << 16) + ah * sl + al * sh + ((al * sl) >> 16);
+	/* the unsigned inAngle is 2^32 too much when negative */
+	if (inAngle < 0)
+		phase -= sl << 16;
+	return phase;
+}
+
+static fix16_t _fix16_sin_phase(uint32_t phase)
+{
+	uint32_t pos = phase & 0x3FFFFFFF;
+	uint32_t index, frac, lo, hi;
+	fix16_t out;
+
+	/* the second and fourth quarters run the table backwards */
+	if (phase & 0x40000000)
+		pos = 0x40000000 - pos;
+	index = pos >> (30 - FIXMATH_TRIG_LUT_BITS);
+	frac = (pos >> (14 - FIXMATH_TRIG_LUT_BITS)) & 0xFFFF;
+
+	if (index >= _FIX16_TRIG_LUT_SIZE)
+		return (phase & 0x80000000) ? -fix16_one : fix16_one;
+
+	lo = _fix16_trig_sin_lut[index];
+	hi = (index + 1 < _FIX16_TRIG_LUT_SIZE) ? _fix16_trig_sin_lut[index + 1] : fix16_one;
+	out = lo + (((hi - lo) * frac + 0x8000) >> 16);
+
+	return (phase & 0x80000000) ? -out : out;
+}
+
+/* atan(num / den) for num <= den */
+static fix16_t _fix16_atan_ratio(uint32_t num, uint32_t den)
+{
+	uint32_t ratio, rem, index, frac, lo, hi;
+	unsigned shift = 0;
+
+	/* num << 16 has to fit, the quotient keeps 15 bits or more */
+	while ((num >> shift) >= 0xFFFF)
+		shift++;
+	if (shift != 0)
+	{
+		num = (num >> shift) + ((num >> (shift - 1)) & 1);
+		den = (den >> shift) + ((den >> (shift - 1)) & 1);
+	}
+	num <<= 16;
+	ratio = num / den;
+	rem = num % den;
+	if (rem >= den - rem)
+		ratio++;
+
+	index = ratio >> (16 - FIXMATH_TRIG_LUT_BITS);
+	frac = (ratio << FIXMATH_TRIG_LUT_BITS) & 0xFFFF;
+	if (index >= _FIX16_TRIG_LUT_SIZE)
+		return _fix16_trig_atan_lut[_FIX16_TRIG_LUT_SIZE];
+
+	lo = _fix16_trig_atan_lut[index];
+	hi = _fix16_trig_atan_lut[index + 1];
+	return lo + (((hi - lo) * frac + 0x8000) >> 16);
+}
+
+fix16_t fix16_sin(fix16_t inAngle)
+{
+	return _fix16_sin_phase(_fix16_trig_phase(inAngle));
+}
+
+fix16_t fix16_cos(fix16_t inAngle)
+{
+	/* a quarter turn on the phase is exact, pi/2 on the angle is not */
+	return _fix16_sin_phase(_fix16_trig_phase(inAngle) + 0x40000000);
+}
+
+fix16_t fix16_atan2(fix16_t inY , fix16_t inX)
+{
+	uint32_t abs_inX, abs_inY;
+	fix16_t angle;
+
+	abs_inX = (inX < 0) ? -(uint32_t)inX : (uint32_t)inX;
+	abs_inY = (inY < 0) ? -(uint32_t)inY : (uint32_t)inY;
+	if ((abs_inX | abs_inY) == 0)
+		return 0;
+
+	/* the first octant from the table, the others by symmetry; 102944 is
+	 * pi/2 rounded, fix16_pi >> 1 would be most of an LSB short */
+	if (abs_inY <= abs_inX)
+	{
+		angle = _fix16_atan_ratio(abs_inY, abs_inX);
+		if (inX < 0)
+			angle = fix16_pi - angle;
+	}
+	else
+	{
+		angle = _fix16_atan_ratio(abs_inX, abs_inY);
+		angle = (inX < 0) ? 102944 + angle : 102944 - angle;
+	}
+	if (inY < 0)
+		angle = -angle;
+
+	return angle;
+}
+#else
 fix16_t fix16_sin(fix16_t inAngle)
 {
 	fix16_t tempAngle = inAngle % (fix16_pi << 1);
@@ -113,6 +234,7 @@ fix16_t fix16_cos(fix16_t inAngle)
 {
 	return fix16_sin(inAngle + (fix16_pi >> 1));
 }
+#endif
 
 fix16_t fix16_tan(fix16_t inAngle)
 {
@@ -137,6 +259,7 @@ fix16_t fix16_acos(fix16_t x)
 	return ((fix16_pi >> 1) - fix16_asin(x));
 }
 
+#ifndef FIXMATH_TRIG_LUT
 fix16_t fix16_atan2(fix16_t inY , fix16_t inX)
 {
 	fix16_t abs_inY, mask, angle, r, r_3;
@@ -178,6 +301,7 @@ fix16_t fix16_atan2(fix16_t inY , fix16_t inX)
 
 	return angle;
 }
+#endif
 
 fix16_t fix16_atan(fix16_t x)
 {
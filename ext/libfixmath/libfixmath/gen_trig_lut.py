@@ -0,0 +1,49 @@
+'''This script generates fix16_trig_lut.h, the tables fix16_trig.c uses
+when built with FIXMATH_TRIG_LUT. They are const so they stay in flash,
+unlike the FIXMATH_SIN_LUT table and the sin and atan caches, which need
+RAM the small targets don't have.
+
+For each table size N = 2^FIXMATH_TRIG_LUT_BITS:
+  sin(pi/2 * i / N) for i = 0..N-1, a quarter wave; sin(pi/2) is one and
+  is not stored, so the entries fit in uint16_t.
+  atan(i / N) for i = 0..N, atan2() reduces to a ratio in [0, 1].
+Both are interpolated linearly between entries.
+'''
+
+import math
+
+BITS = range(6, 11)
+ONE = 1 << 16
+
+def write_table(f, ctype, name, values):
+    f.write('static const %s %s[%d] = {\n' % (ctype, name, len(values)))
+    for i in range(0, len(values), 8):
+        f.write('  ' + ' '.join('%5d,' % v for v in values[i:i + 8]) + '\n')
+    f.write('};\n')
+
+f = open('fix16_trig_lut.h', 'w')
+f.write('/* Generated by gen_trig_lut.py, do not edit. */\n\n')
+f.write('#ifndef __libfixmath_fix16_trig_lut_h__\n')
+f.write('#define __libfixmath_fix16_trig_lut_h__\n')
+f.write('#include <stdint.h>\n\n')
+f.write('#ifndef FIXMATH_TRIG_LUT_BITS\n')
+f.write('#define FIXMATH_TRIG_LUT_BITS 8\n')
+f.write('#endif\n\n')
+f.write('#define _FIX16_TRIG_LUT_SIZE (1 << FIXMATH_TRIG_LUT_BITS)\n\n')
+
+for bits in BITS:
+    n = 1 << bits
+    sin_lut = [min(int(round(math.sin(math.pi / 2 * i / n) * ONE)), ONE - 1)
+               for i in range(n)]
+    atan_lut = [int(round(math.atan(float(i) / n) * ONE)) for i in range(n + 1)]
+    f.write('#%s FIXMATH_TRIG_LUT_BITS == %d\n' % ('if' if bits == BITS[0] else 'elif', bits))
+    f.write('/* sin(pi/2 * i / %d), i = 0..%d */\n' % (n, n - 1))
+    write_table(f, 'uint16_t', '_fix16_trig_sin_lut', sin_lut)
+    f.write('/* atan(i / %d), i = 0..%d */\n' % (n, n))
+    write_table(f, 'uint16_t', '_fix16_trig_atan_lut', atan_lut)
+
+f.write('#else\n')
+f.write('#error "FIXMATH_TRIG_LUT_BITS must be %d to %d"\n' % (BITS[0], BITS[-1]))
+f.write('#endif\n\n')
+f.write('#endif /* __libfixmath_fix16_trig_lut_h__ */\n')
+f.close()
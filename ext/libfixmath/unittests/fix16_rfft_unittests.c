@@ -0,0 +1,162 @@
+#include <fix16.h>
+#include <fix16_rfft.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "unittests.h"
+
+#define N FIX16_RFFT_LENGTH
+
+// Reference DFT of x, divided by the transform length like fix16_rfft().
+static void dft(const uint8_t *x, unsigned k, double *re, double *im)
+{
+    unsigned n;
+    *re = 0;
+    *im = 0;
+    for (n = 0; n < N; n++)
+    {
+        *re += x[n] * cos(2 * M_PI * k * n / N);
+        *im -= x[n] * sin(2 * M_PI * k * n / N);
+    }
+    *re /= N;
+    *im /= N;
+}
+
+// Worst bin error of fix16_rfft_u8(x), in sample units.
+static double rfft_error(const uint8_t *x)
+{
+    int32_t buf[N];
+    double re, im, fr, fi, err, worst = 0;
+    unsigned k;
+
+    fix16_rfft_u8(x, buf);
+    for (k = 0; k <= FIX16_RFFT_BINS; k++)
+    {
+        dft(x, k, &re, &im);
+        if (k == 0 || k == FIX16_RFFT_BINS)
+        {
+            fr = fix16_to_dbl(fix16_rfft_to_fix16(buf[k == 0 ? 0 : 1]));
+            fi = 0;
+        }
+        else
+        {
+            fr = fix16_to_dbl(fix16_rfft_to_fix16(buf[2 * k]));
+            fi = fix16_to_dbl(fix16_rfft_to_fix16(buf[2 * k + 1]));
+        }
+        err = hypot(fr - re, fi - im);
+        if (err > worst)
+            worst = err;
+    }
+    return worst;
+}
+
+int main()
+{
+    int status = 0;
+    uint8_t x[N];
+    unsigned i, t;
+
+    {
+        COMMENT("Testing fix16_rfft_u8() on constant input");
+        int32_t buf[N];
+        bool ok = true;
+
+        memset(x, 200, sizeof(x));
+        fix16_rfft_u8(x, buf);
+        TEST(fix16_rfft_to_int(buf[0]) == 200);
+        for (i = 1; i < N; i++)
+            ok = ok && (buf[i] == 0);
+        TEST(ok);
+    }
+
+    {
+        COMMENT("Testing fix16_rfft_u8() on a tone");
+        int32_t buf[N];
+        uint32_t peak = 0;
+        unsigned peak_bin = 0;
+
+        for (i = 0; i < N; i++)
+            x[i] = 128 + 100 * sin(2 * M_PI * 5 * i / N);
+        fix16_rfft_u8(x, buf);
+        for (i = 1; i <= FIX16_RFFT_BINS; i++)
+        {
+            if (fix16_rfft_bin_mag(buf, i) > peak)
+            {
+                peak = fix16_rfft_bin_mag(buf, i);
+                peak_bin = i;
+            }
+        }
+        TEST(peak_bin == 5);
+        TEST(fix16_rfft_to_int(peak) == 50);
+        TEST(rfft_error(x) < 0.1);
+    }
+
+    {
+        COMMENT("Testing fix16_rfft_u8() against a reference DFT");
+        double err, worst = 0;
+
+        srand(1);
+        for (t = 0; t < 100; t++)
+        {
+            for (i = 0; i < N; i++)
+                x[i] = rand() & 0xFF;
+            err = rfft_error(x);
+            if (err > worst)
+                worst = err;
+        }
+
+        // full scale square wave, the largest values the stages can see
+        for (i = 0; i < N; i++)
+            x[i] = (i & 1) ? 255 : 0;
+        err = rfft_error(x);
+        if (err > worst)
+            worst = err;
+
+        printf("Worst bin error %0.4f sample units\n", worst);
+        TEST(worst < 0.1);
+    }
+
+    {
+        COMMENT("Testing fix16_rfft() matches fix16_rfft_u8()");
+        int32_t a[N], b[N];
+
+        for (i = 0; i < N; i++)
+            x[i] = (i * 37) & 0xFF;
+        fix16_rfft_u8(x, a);
+        for (i = 0; i < N; i++)
+            b[i] = (int32_t) x[i] << FIX16_RFFT_INPUT_SHIFT;
+        fix16_rfft(b);
+        TEST(memcmp(a, b, sizeof(a)) == 0);
+    }
+
+    {
+        COMMENT("Testing fix16_rfft_mag() accuracy over half a sample unit");
+        double worst = 0, err;
+        int32_t re, im;
+
+        for (re = -2000; re <= 2000; re += 7)
+        {
+            for (im = -2000; im <= 2000; im += 13)
+            {
+                // below that the truncated shifts dominate
+                if (hypot(re, im) < 64)
+                    continue;
+                err = fabs(fix16_rfft_mag(re, im) - hypot(re, im)) / hypot(re, im);
+                if (err > worst)
+                    worst = err;
+            }
+        }
+
+        printf("Worst relative error %0.4f\n", worst);
+        TEST(worst < 0.04);
+        TEST(fix16_rfft_mag(0, 0) == 0);
+        TEST(fix16_rfft_mag(-1000, 0) == 1000);
+    }
+
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+
+    return status;
+}
@@ -0,0 +1,134 @@
+#include <fix16.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdbool.h>
+#include "unittests.h"
+
+// Worst errors allowed for the FIXMATH_TRIG_LUT builds, in fix16 LSBs: what
+// linear interpolation between the table entries gives, plus the rounding
+// of the angle and of pi.
+#ifndef FIXMATH_TRIG_LUT
+#  error "These are the bounds of the FIXMATH_TRIG_LUT builds"
+#endif
+#if FIXMATH_TRIG_LUT_BITS == 6
+#  define SIN_MAX_ERROR  6
+#  define ATAN_MAX_ERROR 3
+#elif FIXMATH_TRIG_LUT_BITS == 7
+#  define SIN_MAX_ERROR  3
+#  define ATAN_MAX_ERROR 2.5
+#else
+#  define SIN_MAX_ERROR  2
+#  define ATAN_MAX_ERROR 2.5
+#endif
+
+// The angles: a dense sweep over a few turns, then large ones, where the
+// reduction to one turn matters.
+#define SWEEP_STEP 7
+#define SWEEP_END (4 * 205887)
+
+static double lsb_error(fix16_t got, double want)
+{
+    return fabs(fix16_to_dbl(got) - want) * fix16_one;
+}
+
+static double sin_error(fix16_t a, double *worst_cos)
+{
+    double x = fix16_to_dbl(a);
+    double e = lsb_error(fix16_cos(a), cos(x));
+    if (e > *worst_cos)
+        *worst_cos = e;
+    return lsb_error(fix16_sin(a), sin(x));
+}
+
+int main()
+{
+    int status = 0;
+
+    {
+        COMMENT("Testing fix16_sin() and fix16_cos() accuracy");
+        double e, worst_sin = 0, worst_cos = 0;
+        fix16_t a;
+        uint32_t seed = 1;
+        int i;
+
+        for (a = -SWEEP_END; a <= SWEEP_END; a += SWEEP_STEP)
+        {
+            e = sin_error(a, &worst_cos);
+            if (e > worst_sin)
+                worst_sin = e;
+        }
+        for (i = 0; i < 100000; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            // up to 2^15 radians, the error of the angle itself grows with it
+            a = (fix16_t)seed >> 1;
+            e = sin_error(a, &worst_cos);
+            if (e > worst_sin)
+                worst_sin = e;
+        }
+        printf("worst sin %.2f, cos %.2f LSB\n", worst_sin, worst_cos);
+        TEST(worst_sin <= SIN_MAX_ERROR);
+        TEST(worst_cos <= SIN_MAX_ERROR);
+    }
+
+    {
+        COMMENT("Testing fix16_sin() and fix16_cos() at the quarter turns");
+        fix16_t half_pi = fix16_pi >> 1;
+        TEST(fix16_sin(0) == 0);
+        TEST(abs(fix16_sin(half_pi) - fix16_one) <= SIN_MAX_ERROR);
+        TEST(abs(fix16_sin(-half_pi) + fix16_one) <= SIN_MAX_ERROR);
+        TEST(abs(fix16_cos(0) - fix16_one) <= SIN_MAX_ERROR);
+        TEST(abs(fix16_cos(fix16_pi) + fix16_one) <= SIN_MAX_ERROR);
+    }
+
+    {
+        COMMENT("Testing fix16_atan2() accuracy");
+        double e, worst = 0;
+        fix16_t x, y;
+        uint32_t seed = 1;
+        int i, s;
+
+        // around the circle, at radii from tiny to huge
+        for (s = 0; s < 26; s++)
+        {
+            for (i = 0; i < 4096; i++)
+            {
+                double t = 2 * M_PI * i / 4096;
+                double r = ldexp(1.0, s - 8);
+                x = fix16_from_dbl(r * cos(t));
+                y = fix16_from_dbl(r * sin(t));
+                if (x == 0 && y == 0)
+                    continue;
+                e = lsb_error(fix16_atan2(y, x), atan2(fix16_to_dbl(y), fix16_to_dbl(x)));
+                if (e > worst)
+                    worst = e;
+            }
+        }
+        for (i = 0; i < 100000; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            x = (fix16_t)seed;
+            seed = seed * 1103515245 + 12345;
+            y = (fix16_t)seed >> (seed & 15);
+            e = lsb_error(fix16_atan2(y, x), atan2(fix16_to_dbl(y), fix16_to_dbl(x)));
+            if (e > worst)
+                worst = e;
+        }
+        printf("worst atan2 %.2f LSB\n", worst);
+        TEST(worst <= ATAN_MAX_ERROR);
+    }
+
+    {
+        COMMENT("Testing fix16_atan2() on the axes");
+        TEST(fix16_atan2(0, fix16_one) == 0);
+        TEST(abs(fix16_atan2(fix16_one, 0) - (fix16_pi >> 1)) <= ATAN_MAX_ERROR);
+        TEST(abs(fix16_atan2(0, -fix16_one) - fix16_pi) <= ATAN_MAX_ERROR);
+        TEST(abs(fix16_atan2(-fix16_one, 0) + (fix16_pi >> 1)) <= ATAN_MAX_ERROR);
+    }
+
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+
+    return status;
+}
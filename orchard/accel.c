@@ -2,6 +2,7 @@
 #include "ch.h"
 #include "hal.h"
 #include "i2c.h"
+#include "i2c-queue.h"
 
 #include "accel.h"
 #include "gpiox.h"
@@ -11,6 +12,8 @@
 #include "orchard-test.h"
 #include "test-audit.h"
 
+#include <string.h>
+
 #define REG_INT_SYSMOD                0x0b
 #define REG_INT_SYSMOD_SYSMOD1          (1 << 1)
 #define REG_INT_SYSMOD_SYSMOD0          (1 << 0)
@@ -223,7 +226,32 @@
 #define REG_CTRL5_INT_CFG_FF_MT         (1 << 2)
 #define REG_CTRL5_INT_CFG_DRDY          (1 << 0)
 
-static I2CDriver *driver;
+/*
+ * The MMA8452Q has no FIFO, and its interrupt line only reaches us through
+ * the GPIO expander, which costs two more I2C reads per interrupt. So while
+ * someone wants the stream, the accel thread reads status and all three
+ * axes in one burst every 1/ACCEL_STREAM_RATE s, keeps the samples in a
+ * ring for anyone to read back, and runs them through the motion engine.
+ * accelPoll() then answers from the ring instead of going to the bus.
+ */
+#define ACCEL_STREAM_PERIOD   MS2ST(1000 / ACCEL_STREAM_RATE)
+#define ACCEL_EVT_START       EVENT_MASK(0)
+#define ACCEL_MOTION_DEPTH    8   // pending motion events, must be a power of two
+
+static i2cq_device accel_dev;
+
+static motion_sample accel_ring[ACCEL_RING_DEPTH];  // guarded by accel_mutex
+static uint32_t accel_head;                           // samples ever written
+static uint32_t accel_start_head;                     // accel_head when the stream started
+static motion_event accel_motion_queue[ACCEL_MOTION_DEPTH];
+static uint32_t accel_motion_head, accel_motion_tail;
+static motion_engine accel_engine;
+static accel_stream_stats accel_stats;
+static mutex_t accel_mutex;
+static uint32_t accel_users;                          // accelStreamStart() calls not yet stopped
+static thread_t *accel_thread;
+static THD_WORKING_AREA(waAccelThread, 320);
+static THD_FUNCTION(accel_thread_fn, arg);
 
 event_source_t accel_x_axis_pulse;
 event_source_t accel_y_axis_pulse;
@@ -235,20 +263,18 @@ static void accel_set(uint8_t reg, uint8_t val) {
 
   uint8_t tx[2] = {reg, val};
 
-  i2cMasterTransmitTimeout(driver, accelAddr,
-                           tx, sizeof(tx),
-                           NULL, 0,
-                           TIME_INFINITE);
+  i2cqTransfer(&accel_dev,
+               tx, sizeof(tx),
+               NULL, 0);
 }
 
 static uint8_t accel_get(uint8_t reg) {
 
   uint8_t val;
 
-  i2cMasterTransmitTimeout(driver, accelAddr,
-                           &reg, 1,
-                           &val, 1,
-                           TIME_INFINITE);
+  i2cqTransfer(&accel_dev,
+               &reg, 1,
+               &val, 1);
   return val;
 }
 
@@ -260,22 +286,22 @@ static void accel_irq(void *port, int irq, int type) {
   (void)irq;
   (void)type;
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&accel_dev);
   mask = accel_get(REG_INT_SRC);
-  i2cReleaseBus(driver);
+  i2cqRelease(&accel_dev);
 
   if (mask & REG_INT_SRC_FF_MT) {
-    i2cAcquireBus(driver);
+    i2cqAcquire(&accel_dev);
     (void)accel_get(REG_FF_MT_SRC);
-    i2cReleaseBus(driver);
+    i2cqRelease(&accel_dev);
 
     chEvtBroadcast(&accel_freefall);
   }
 
   if (mask & REG_INT_SRC_LNDPRT) {
-    i2cAcquireBus(driver);
+    i2cqAcquire(&accel_dev);
     (void)accel_get(REG_PL_STATUS);
-    i2cReleaseBus(driver);
+    i2cqRelease(&accel_dev);
 
     chEvtBroadcast(&accel_landscape_portrait);
   }
@@ -284,9 +310,9 @@ static void accel_irq(void *port, int irq, int type) {
   if (mask & REG_INT_SRC_PULSE) {
     uint8_t pulsemask;
 
-    i2cAcquireBus(driver);
+    i2cqAcquire(&accel_dev);
     pulsemask = accel_get(REG_PULSE_SRC);
-    i2cReleaseBus(driver);
+    i2cqRelease(&accel_dev);
 
     if (pulsemask & REG_PULSE_SRC_AXX)
       chEvtBroadcast(&accel_x_axis_pulse);
@@ -301,7 +327,7 @@ static void accel_irq(void *port, int irq, int type) {
 
 void accelEnableFreefall(int sensitivity, int debounce) {
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&accel_dev);
 
   /* Put the accelerometer into "Standby" mode to program registers */
   while (accel_get(REG_CTRL1) & REG_CTRL1_ACTIVE)
@@ -345,12 +371,12 @@ void accelEnableFreefall(int sensitivity, int debounce) {
   /* Re-enable the accelerometer */
   accel_set(REG_CTRL1, REG_CTRL1_ACTIVE);
 
-  i2cReleaseBus(driver);
+  i2cqRelease(&accel_dev);
 }
 
 void accelDisableFreefall(void) {
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&accel_dev);
 
   /* Put the accelerometer into "Standby" mode */
   accel_set(REG_CTRL1, 0);
@@ -359,21 +385,22 @@ void accelDisableFreefall(void) {
   accel_set(REG_CTRL3, 0);
   accel_set(REG_CTRL4, 0);
   accel_set(REG_CTRL1, REG_CTRL1_ACTIVE);
-  i2cReleaseBus(driver);
+  i2cqRelease(&accel_dev);
 }
 
 void accelStop(void) {
-  i2cAcquireBus(driver);
+  i2cqAcquire(&accel_dev);
   // forces accelerometer into standby mode
   accel_set(REG_CTRL1, accel_get(REG_CTRL1) & ~REG_CTRL1_ACTIVE);
-  i2cReleaseBus(driver);
+  i2cqRelease(&accel_dev);
 }
 
 void accelStart(I2CDriver *i2cp) {
 
-  driver = i2cp;
+  (void)i2cp;  // the bus belongs to the i2c queue
+  i2cqDeviceInit(&accel_dev, "accel", accelAddr, i2cqPrioNormal);
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&accel_dev);
 
   /* Reset the chip */
   accel_set(REG_CTRL2, REG_CTRL2_RST);
@@ -383,7 +410,7 @@ void accelStart(I2CDriver *i2cp) {
   while (!(accel_get(REG_CTRL1) & REG_CTRL1_ACTIVE))
     accel_set(REG_CTRL1, REG_CTRL1_ACTIVE);
 
-  i2cReleaseBus(driver);
+  i2cqRelease(&accel_dev);
 
   chEvtObjectInit(&accel_x_axis_pulse);
   chEvtObjectInit(&accel_y_axis_pulse);
@@ -391,6 +418,11 @@ void accelStart(I2CDriver *i2cp) {
   chEvtObjectInit(&accel_freefall);
   chEvtObjectInit(&accel_landscape_portrait);
 
+  osalMutexObjectInit(&accel_mutex);
+  if( accel_thread == NULL )
+    accel_thread = chThdCreateStatic(waAccelThread, sizeof(waAccelThread),
+                                     NORMALPRIO, accel_thread_fn, NULL);
+
   gpioxRegisterHandler(GPIOX, 3, accel_irq);
   gpioxSetPadMode(GPIOX, 3, GPIOX_IN | GPIOX_IRQ_FALLING);
 
@@ -399,18 +431,19 @@ void accelStart(I2CDriver *i2cp) {
   // 22 = 1.5g, 40 = 50ms
 }
 
-msg_t accelPoll(struct accel_data *data) {
+// reads status and the three axes in one burst
+static msg_t accel_read(struct accel_data *data) {
   uint8_t tx[1];
   uint8_t rx[7];
+  msg_t ret;
 
   tx[0] = 0;
 
-  i2cAcquireBus(driver);
-  i2cMasterTransmitTimeout(driver, accelAddr,
-                           tx, sizeof(tx),
-                           rx, sizeof(rx),
-                           TIME_INFINITE);
-  i2cReleaseBus(driver);
+  i2cqAcquire(&accel_dev);
+  ret = i2cqTransfer(&accel_dev,
+                     tx, sizeof(tx),
+                     rx, sizeof(rx));
+  i2cqRelease(&accel_dev);
 
 #if (ORCHARD_BOARD_REV == ORCHARD_REV_EVT1) || (ORCHARD_BOARD_REV == ORCHARD_REV_DVT1)
   data->x  = ((rx[1] & 0xff)) << 4;
@@ -432,7 +465,134 @@ msg_t accelPoll(struct accel_data *data) {
   data->z  = ((rx[5] & 0xff)) << 4;
   data->z |= ((rx[6] >> 4) & 0x0f);
 
-  return MSG_OK;
+  return ret;
+}
+
+// 12 bit two's complement to signed
+static inline int16_t accel_signed(int v) {
+  return (int16_t) (v >= 2048 ? v - 4096 : v);
+}
+
+static void accel_motion_put(const motion_event *ev) {
+  if( accel_motion_head - accel_motion_tail >= ACCEL_MOTION_DEPTH ) {
+    accel_motion_tail++;   // drop the oldest
+    accel_stats.dropped++;
+  }
+  accel_motion_queue[accel_motion_head++ & (ACCEL_MOTION_DEPTH - 1)] = *ev;
+}
+
+static THD_FUNCTION(accel_thread_fn, arg) {
+  (void)arg;
+  struct accel_data data;
+  motion_sample sample;
+  motion_event events[ACCEL_MOTION_DEPTH];
+  unsigned n, i;
+  systime_t next = 0, now;
+
+  chRegSetThreadName("accel");
+
+  while (!chThdShouldTerminateX()) {
+    if( accel_users == 0 ) {
+      chEvtWaitAny(ACCEL_EVT_START);
+      next = chVTGetSystemTime();
+      motionInit(&accel_engine);
+    }
+
+    if( accel_read(&data) != MSG_OK ) {
+      accel_stats.errors++;
+    }
+    else {
+      sample.x = accel_signed(data.x);
+      sample.y = accel_signed(data.y);
+      sample.z = accel_signed(data.z);
+      n = motionRun(&accel_engine, &sample, 1, events, ACCEL_MOTION_DEPTH);
+
+      osalMutexLock(&accel_mutex);
+      accel_ring[accel_head++ & (ACCEL_RING_DEPTH - 1)] = sample;
+      for( i = 0; i < n; i++ )
+        accel_motion_put(&events[i]);
+      osalMutexUnlock(&accel_mutex);
+      accel_stats.samples++;
+      accel_stats.events += n;
+
+      if( n != 0 )
+        chEvtBroadcast(&accel_motion);
+    }
+
+    // keep the sample clock, unless the whole period went by already
+    now = chVTGetSystemTime();
+    if( (systime_t) (now - next) >= ACCEL_STREAM_PERIOD ) {
+      accel_stats.gaps++;
+      next = now;
+    }
+    next = chThdSleepUntilWindowed(next, next + ACCEL_STREAM_PERIOD);
+  }
+}
+
+void accelStreamStart(void) {
+  osalMutexLock(&accel_mutex);
+  if( accel_users++ == 0 ) {
+    accel_start_head = accel_head;
+    chEvtSignal(accel_thread, ACCEL_EVT_START);
+  }
+  osalMutexUnlock(&accel_mutex);
+}
+
+void accelStreamStop(void) {
+  osalMutexLock(&accel_mutex);
+  osalDbgAssert(accel_users != 0, "accel stream not started");
+  if( accel_users != 0 )
+    accel_users--;
+  osalMutexUnlock(&accel_mutex);
+}
+
+unsigned accelRead(motion_sample *samples, unsigned max, uint32_t *seq) {
+  unsigned n = 0;
+
+  osalMutexLock(&accel_mutex);
+  // samples that already left the ring are skipped
+  if( accel_head - *seq > ACCEL_RING_DEPTH )
+    *seq = accel_head - ACCEL_RING_DEPTH;
+  while( (*seq != accel_head) && (n < max) )
+    samples[n++] = accel_ring[(*seq)++ & (ACCEL_RING_DEPTH - 1)];
+  osalMutexUnlock(&accel_mutex);
+
+  return n;
+}
+
+int accelMotionGet(motion_event *ev) {
+  int ret = 0;
+
+  osalMutexLock(&accel_mutex);
+  if( accel_motion_tail != accel_motion_head ) {
+    *ev = accel_motion_queue[accel_motion_tail++ & (ACCEL_MOTION_DEPTH - 1)];
+    ret = 1;
+  }
+  osalMutexUnlock(&accel_mutex);
+
+  return ret;
+}
+
+const accel_stream_stats *accelStreamStats(void) {
+  return &accel_stats;
+}
+
+msg_t accelPoll(struct accel_data *data) {
+  motion_sample sample;
+
+  // while streaming, the newest sample is at most one period old
+  osalMutexLock(&accel_mutex);
+  if( (accel_users != 0) && (accel_head != accel_start_head) ) {
+    sample = accel_ring[(accel_head - 1) & (ACCEL_RING_DEPTH - 1)];
+    osalMutexUnlock(&accel_mutex);
+    data->x = sample.x & 0xfff;
+    data->y = sample.y & 0xfff;
+    data->z = sample.z & 0xfff;
+    return MSG_OK;
+  }
+  osalMutexUnlock(&accel_mutex);
+
+  return accel_read(data);
 }
 
 OrchardTestResult test_accel(const char *my_name, OrchardTestType test_type) {
@@ -442,9 +602,9 @@ OrchardTestResult test_accel(const char *my_name, OrchardTestType test_type) {
   switch(test_type) {
   case orchardTestPoweron:
   case orchardTestTrivial:
-    i2cAcquireBus(driver);
+    i2cqAcquire(&accel_dev);
     ret =  accel_get(REG_WHO_AM_I);
-    i2cReleaseBus(driver);
+    i2cqRelease(&accel_dev);
     if( ret != 0x2A ) {
       return orchardResultFail;
     } else {
@@ -1,6 +1,11 @@
 #ifndef __ORCHARD_ACCEL_H__
 #define __ORCHARD_ACCEL_H__
 
+#include "motion.h"
+
+#define ACCEL_STREAM_RATE   MOTION_SAMPLE_RATE  // Hz
+#define ACCEL_RING_DEPTH    32    // samples, must be a power of two
+
 struct accel_data {
   int x;
   int y;
@@ -13,6 +18,29 @@ msg_t accelPoll(struct accel_data *data);
 void accelEnableFreefall(int sensitivity, int debounce);
 void accelDisableFreefall(void);
 
+typedef struct accel_stream_stats {
+  uint32_t  samples;    // samples read into the ring
+  uint32_t  errors;     // failed reads
+  uint32_t  gaps;       // sample periods missed because the thread ran late
+  uint32_t  events;     // motion events detected
+  uint32_t  dropped;    // motion events lost because nobody took them
+} accel_stream_stats;
+
+// The accelerometer streams from the first accelStreamStart() to the
+// matching last accelStreamStop(). While it runs, accel_motion is broadcast
+// whenever the motion engine has events to take with accelMotionGet(), and
+// accelPoll() returns the newest sample without touching the bus.
+void accelStreamStart(void);
+void accelStreamStop(void);
+
+// Copies up to max samples newer than *seq, oldest first, and advances
+// *seq past them. Samples that already left the ring are skipped.
+unsigned accelRead(motion_sample *samples, unsigned max, uint32_t *seq);
+
+// Takes the oldest pending motion event, returns 0 if there is none.
+int accelMotionGet(motion_event *ev);
+const accel_stream_stats *accelStreamStats(void);
+
 extern event_source_t accel_x_axis_pulse;
 extern event_source_t accel_y_axis_pulse;
 extern event_source_t accel_z_axis_pulse;
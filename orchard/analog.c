@@ -3,6 +3,7 @@
 
 #include "orchard.h"
 #include "orchard-events.h"
+#include "orchard-evq.h"
 #include "analog.h"
 
 #include "chbsem.h"
@@ -12,8 +13,31 @@
 #include "gasgauge.h" // used in test procedure
 #include "orchard-app.h" // used in test procedure
 
-static adcsample_t mic_sample[MIC_SAMPLE_DEPTH];
-static uint8_t mic_return[MIC_SAMPLE_DEPTH];
+#include <string.h>
+
+/*
+ * The microphone is sampled continuously into a circular buffer of two
+ * MIC_SAMPLE_DEPTH halves. The ADC interrupt hands each half over to the
+ * mic thread as soon as it's full, and moves on to the other one; the thread
+ * narrows the block to 8 bits, runs it through the feature pipeline and
+ * publishes both before the ADC comes back around, so no samples are lost
+ * between blocks.
+ */
+#define MIC_STREAM_DEPTH  (MIC_SAMPLE_DEPTH * 2)
+#define MIC_EVT_BLOCK     EVENT_MASK(0)
+
+static adcsample_t mic_sample[MIC_STREAM_DEPTH];
+static uint8_t mic_block[MIC_SAMPLE_DEPTH];   // newest block, guarded by mic_mutex
+static uint8_t mic_return[MIC_SAMPLE_DEPTH];  // copy handed out by analogReadMic()
+static mic_features mic_latest;               // guarded by mic_mutex
+static mic_pipeline mic_pipe;
+static analog_mic_stats mic_stats;
+static mutex_t mic_mutex;
+static uint32_t mic_users;                    // analogMicStart() calls not yet stopped
+static adcsample_t *mic_pending;              // half last completed by the ADC
+static uint32_t mic_halves;                   // halves completed by the ADC
+static thread_t *mic_thread;
+static THD_WORKING_AREA(waMicThread, 256);
 
 #define ADC_GRPCELCIUS_NUM_CHANNELS   2
 #define ADC_GRPCELCIUS_BUF_DEPTH      1
@@ -26,6 +50,17 @@ usbStat usb_status = usbStatNC;
 static adcsample_t usb_samples[ADC_GRPUSB_NUM_CHANNELS * ADC_GRPUSB_BUF_DEPTH];
 static uint16_t usbn, usbp;
 
+static void analog_convert(const ADCConversionGroup *grpp,
+                           adcsample_t *samples, size_t depth);
+
+static void adc_event(OrchardAppEvent *evt, uint8_t code, int32_t value) {
+
+  memset(evt, 0, sizeof(*evt));
+  evt->type = adcEvent;
+  evt->adc.code = code;
+  evt->adc.value = value;
+}
+
 static void adc_temperature_end_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n) {
   (void)adcp;
   (void)n;
@@ -62,8 +97,10 @@ static void adc_temperature_end_cb(ADCDriver *adcp, adcsample_t *buffer, size_t
   int32_t delta = (((vamb - v25) * 1000000) / m);
   celcius = 25000 - delta;
 
+  OrchardAppEvent evt;
+  adc_event(&evt, adcCodeTemp, celcius);
   chSysLockFromISR();
-  chEvtBroadcastI(&celcius_rdy);
+  evqPostI(&app_evq, &evt);
   chSysUnlockFromISR();
 }
 
@@ -90,9 +127,7 @@ static const ADCConversionGroup adcgrpcelcius = {
 };
 
 void analogUpdateTemperature(void) {
-  adcAcquireBus(&ADCD1);
-  adcConvert(&ADCD1, &adcgrpcelcius, celcius_samples, ADC_GRPCELCIUS_BUF_DEPTH);
-  adcReleaseBus(&ADCD1);
+  analog_convert(&adcgrpcelcius, celcius_samples, ADC_GRPCELCIUS_BUF_DEPTH);
 }
 
 int32_t analogReadTemperature() {
@@ -104,24 +139,20 @@ static void adc_mic_end_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n) {
   (void)adcp;
   (void)n;
 
-  uint8_t i;
-
-  for( i = 0 ; i < n; i++ ) { 
-    mic_return[i] = (uint8_t) buffer[i];
-  }
-
   chSysLockFromISR();
-  chEvtBroadcastI(&mic_rdy);
+  mic_pending = buffer;
+  mic_halves++;
+  chEvtSignalI(mic_thread, MIC_EVT_BLOCK);
   chSysUnlockFromISR();
 }
 
 
 /*
  * ADC conversion group.
- * Mode:        Linear buffer, 8 samples of 1 channel, SW triggered.
+ * Mode:        Circular buffer, 1 channel, SW triggered.
  */
 static const ADCConversionGroup adcgrpmic = {
-  false,
+  true,
   1, // just one channel
   adc_mic_end_cb,
   NULL,
@@ -135,16 +166,122 @@ static const ADCConversionGroup adcgrpmic = {
   // this should give ~6.25kHz sampling rate
 };
 
-void analogUpdateMic(void) {
+static THD_FUNCTION(mic_thread_fn, arg) {
+  (void)arg;
+  uint8_t block[MIC_SAMPLE_DEPTH];
+  mic_features features;
+  OrchardAppEvent evt;
+  adcsample_t *half;
+  uint32_t halves;
+  uint32_t seen = 0;
+  uint32_t i;
+
+  chRegSetThreadName("mic");
+
+  while (!chThdShouldTerminateX()) {
+    chEvtWaitAny(MIC_EVT_BLOCK);
+
+    chSysLock();
+    half = mic_pending;
+    halves = mic_halves;
+    chSysUnlock();
+
+    if( halves - seen > 1 )
+      mic_stats.overruns += halves - seen - 1;
+    seen = halves;
+
+    for( i = 0; i < MIC_SAMPLE_DEPTH; i++ )
+      block[i] = (uint8_t) half[i];
+
+    // if the ADC came back around to this half while we were copying it,
+    // the block is torn
+    chSysLock();
+    halves = mic_halves;
+    chSysUnlock();
+    if( halves != seen ) {
+      mic_stats.overruns++;
+      continue;
+    }
+
+    micPipelineRun(&mic_pipe, block, MIC_SAMPLE_DEPTH, &features);
+
+    osalMutexLock(&mic_mutex);
+    memcpy(mic_block, block, sizeof(mic_block));
+    mic_latest = features;
+    osalMutexUnlock(&mic_mutex);
+    mic_stats.blocks++;
+
+    adc_event(&evt, adcCodeMic, features.seq);
+    evt.adc.peak = features.peak;
+    evt.adc.rms = features.rms;
+    evqPost(&app_evq, &evt);
+    if( features.beat ) {
+      mic_stats.beats++;
+      evt.adc.code = adcCodeMicBeat;
+      evqPost(&app_evq, &evt);
+      chEvtBroadcast(&mic_beat);
+    }
+  }
+}
+
+// call with the ADC bus acquired
+static void mic_stream_start(void) {
+  adcStartConversion(&ADCD1, &adcgrpmic, mic_sample, MIC_STREAM_DEPTH);
+}
+
+// call with the ADC bus acquired
+static void mic_stream_stop(void) {
+  adcStopConversion(&ADCD1);
+}
+
+// one-shot conversions share the ADC with the mic stream, which is paused
+// around them: that's the only time samples are skipped
+static void analog_convert(const ADCConversionGroup *grpp,
+                           adcsample_t *samples, size_t depth) {
   adcAcquireBus(&ADCD1);
-  adcConvert(&ADCD1, &adcgrpmic, mic_sample, MIC_SAMPLE_DEPTH);
+  if( mic_users != 0 ) {
+    mic_stream_stop();
+    mic_stats.gaps++;
+  }
+  adcConvert(&ADCD1, grpp, samples, depth);
+  if( mic_users != 0 )
+    mic_stream_start();
   adcReleaseBus(&ADCD1);
 }
 
-uint8_t *analogReadMic() {
+void analogMicStart(void) {
+  adcAcquireBus(&ADCD1);
+  if( mic_users++ == 0 )
+    mic_stream_start();
+  adcReleaseBus(&ADCD1);
+}
+
+void analogMicStop(void) {
+  adcAcquireBus(&ADCD1);
+  osalDbgAssert(mic_users != 0, "mic stream not started");
+  if( (mic_users != 0) && (--mic_users == 0) )
+    mic_stream_stop();
+  adcReleaseBus(&ADCD1);
+}
+
+uint8_t *analogReadMic(void) {
+  osalMutexLock(&mic_mutex);
+  memcpy(mic_return, mic_block, sizeof(mic_return));
+  osalMutexUnlock(&mic_mutex);
+
   return mic_return;
 }
 
+void analogMicFeatures(mic_features *features) {
+  osalMutexLock(&mic_mutex);
+  *features = mic_latest;
+  osalMutexUnlock(&mic_mutex);
+}
+
+const analog_mic_stats *analogMicStats(void) {
+  return &mic_stats;
+}
+
 
 static void adc_usb_end_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n) {
   (void)adcp;
@@ -165,7 +302,10 @@ static void adc_usb_end_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n) {
     usb_status = usbStatNC;
   }
   
+  OrchardAppEvent evt;
+  adc_event(&evt, adcCodeUsbdet, usb_status);
   chSysLockFromISR();
+  evqPostI(&app_evq, &evt);
   chEvtBroadcastI(&usbdet_rdy);
   chSysUnlockFromISR();
 }
@@ -189,9 +329,7 @@ static const ADCConversionGroup adcgrpusb = {
 };
 
 void analogUpdateUsbStatus(void) {
-  adcAcquireBus(&ADCD1);
-  adcConvert(&ADCD1, &adcgrpusb, usb_samples, ADC_GRPUSB_BUF_DEPTH);
-  adcReleaseBus(&ADCD1);
+  analog_convert(&adcgrpusb, usb_samples, ADC_GRPUSB_BUF_DEPTH);
 }
 
 usbStat analogReadUsbStatus(void) {
@@ -204,7 +342,11 @@ adcsample_t *analogReadUsbRaw(void) {
 
 
 void analogStart() {
-  
+
+  osalMutexObjectInit(&mic_mutex);
+  micPipelineInit(&mic_pipe);
+  mic_thread = chThdCreateStatic(waMicThread, sizeof(waMicThread),
+                                 NORMALPRIO + 1, mic_thread_fn, NULL);
 }
 
 
@@ -248,9 +390,11 @@ OrchardTestResult test_mic(const char *my_name, OrchardTestType test_type) {
   switch(test_type) {
   case orchardTestPoweron:
   case orchardTestTrivial:
-    analogUpdateMic();
-    chThdSleepMilliseconds(5);
+    analogMicStart();
+    // a block takes ~20ms, wait for the first complete one
+    chThdSleepMilliseconds(50);
     samples = analogReadMic();
+    analogMicStop();
     if( (samples[0] < 108) || (samples[0] > 148) ) {
       // could either be bad bias, or noisy environment
       return orchardResultUnsure;
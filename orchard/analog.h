@@ -1,4 +1,6 @@
-#define MIC_SAMPLE_DEPTH  128
+#include "mic-features.h"
+
+#define MIC_SAMPLE_DEPTH  128   // samples per mic block, ~20ms
 
 typedef enum usbStat {
   usbStatNC = 0,
@@ -10,9 +12,27 @@ typedef enum usbStat {
 void analogUpdateTemperature(void);
 int32_t analogReadTemperature(void);
 
-void analogUpdateMic(void);
+typedef struct analog_mic_stats {
+  uint32_t  blocks;     // blocks published
+  uint32_t  overruns;   // blocks lost because the mic thread fell behind
+  uint32_t  gaps;       // pauses of the stream for a one-shot conversion
+  uint32_t  beats;      // beat onsets detected
+} analog_mic_stats;
+
+// The mic streams from the first analogMicStart() to the matching last
+// analogMicStop(). While it runs, the app gets an adcCodeMic event for every
+// block of MIC_SAMPLE_DEPTH samples and adcCodeMicBeat on every beat onset.
+// Beats are also broadcast on mic_beat for listeners outside the app thread.
+void analogMicStart(void);
+void analogMicStop(void);
+
+// copy of the newest block, valid until the next call
 uint8_t *analogReadMic(void);
 
+// features of the newest block
+void analogMicFeatures(mic_features *features);
+const analog_mic_stats *analogMicStats(void);
+
 void analogUpdateUsbStatus(void);
 usbStat analogReadUsbStatus(void);
 adcsample_t *analogReadUsbRaw(void);
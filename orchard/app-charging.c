@@ -214,13 +214,13 @@ void charging_event(OrchardAppContext *context, const OrchardAppEvent *event) {
     redraw_ui(0);
   } else if( event->type == adcEvent) {
     if( event->adc.code == adcCodeTemp ) {
-      celcius = analogReadTemperature();
+      celcius = event->adc.value;
     } else if( event->adc.code == adcCodeUsbdet ) {
       buf = analogReadUsbRaw();
       usbn = (uint16_t) buf[0];
       usbp = (uint16_t) buf[1];
       
-      usbStatus = analogReadUsbStatus();
+      usbStatus = (usbStat) event->adc.value;
     }
   }
 }
@@ -14,7 +14,11 @@
 #include <string.h>
 
 #include "fixmath.h"
-#include "fix16_fft.h"
+#include "fix16_rfft.h"
+
+#if MIC_SAMPLE_DEPTH != FIX16_RFFT_LENGTH
+#error "the spectrum view expects one mic block per transform"
+#endif
 
 #define SEXTEST 0
 
@@ -129,16 +133,18 @@ static void do_oscope(void) {
   coord_t height;
   uint8_t i;
   uint8_t scale;
-  fix16_t real[MIC_SAMPLE_DEPTH];
-  fix16_t imag[MIC_SAMPLE_DEPTH];
+  int32_t fft[FIX16_RFFT_LENGTH];
+  uint32_t mag;
 
   agc( samples );
   
   if ( mode ) {
-    fix16_fft(samples, real, imag, MIC_SAMPLE_DEPTH);
+    fix16_rfft_u8(samples, fft);
+    // the upper half of the spectrum mirrors the lower half
     for( i = 0; i < MIC_SAMPLE_DEPTH; i++ ) {
-      samples[i] = fix16_to_int( fix16_sqrt(fix16_sadd(fix16_mul(real[i],real[i]),
-						       fix16_mul(imag[i],imag[i]))) );
+      mag = fix16_rfft_to_int(fix16_rfft_bin_mag(fft, i <= FIX16_RFFT_BINS ?
+                                                 i : FIX16_RFFT_LENGTH - i));
+      samples[i] = (uint8_t) (mag > 255 ? 255 : mag);
     }
     
     agc_fft(samples);
@@ -392,6 +398,12 @@ static uint32_t led_init(OrchardAppContext *context) {
   return 0;
 }
 
+static void oscope_stop(void) {
+  if( oscope_running )
+    analogMicStop();
+  oscope_running = 0;
+}
+
 static void led_start(OrchardAppContext *context) {
   
   (void)context;
@@ -439,7 +451,7 @@ void led_event(OrchardAppContext *context, const OrchardAppEvent *event) {
       else if ( event->key.code == keyRight ) {
 	effectsNextPattern();
 	last_oscope_time = chVTGetSystemTime();
-	oscope_running = 0;
+	oscope_stop();
       }
       else if( event->key.code == keyCW ) {
 	if( friend_total != 0 )
@@ -448,7 +460,7 @@ void led_event(OrchardAppContext *context, const OrchardAppEvent *event) {
 	  friend_index = 0;
 	last_ui_time = chVTGetSystemTime();
 	last_oscope_time = chVTGetSystemTime();
-	oscope_running = 0;
+	oscope_stop();
       } else if( event->key.code == keyCCW) {
 	if( friend_total != 0 ) {
 	  if( friend_index == 0 )
@@ -459,7 +471,7 @@ void led_event(OrchardAppContext *context, const OrchardAppEvent *event) {
 	}
 	last_ui_time = chVTGetSystemTime();
 	last_oscope_time = chVTGetSystemTime();
-	oscope_running = 0;
+	oscope_stop();
       } else if( event->key.code == keySelect ) {
 	last_ui_time = chVTGetSystemTime();
 	// oscope timer does not reset on select as it should swap between FFT and time domain mode
@@ -516,7 +528,6 @@ void led_event(OrchardAppContext *context, const OrchardAppEvent *event) {
 	if( context->instance->ui == NULL )
 	  redraw_ui(0);
       }
-      analogUpdateMic();
     }
   } else if (event->type == timerEvent) {
     if( sex_running == 0 )
@@ -525,7 +536,7 @@ void led_event(OrchardAppContext *context, const OrchardAppEvent *event) {
       bump_level--;
     if( context->instance->ui == NULL )
       redraw_ui(0);
-  } else if( event->type == accelEvent ) {
+  } else if( (event->type == accelEvent) && (event->accel.code == accelCodeBump) ) {
     if( (bump_level < BUMP_LIMIT) && (sex_running) )
       bump_level++;
     
@@ -554,7 +565,7 @@ void led_event(OrchardAppContext *context, const OrchardAppEvent *event) {
 
     // only kick off oscope if we're not in a UI mode...
     if( ((chVTGetSystemTime() - last_oscope_time) > OSCOPE_IDLE_TIME) && !oscope_running ) {
-      analogUpdateMic(); // this kicks off the ADC sampling; once this returns, the UI will swap modes automagically
+      analogMicStart(); // this kicks off the ADC stream; once a block is in, the UI will swap modes automagically
       oscope_running = 1;
     }
   }
@@ -563,6 +574,7 @@ void led_event(OrchardAppContext *context, const OrchardAppEvent *event) {
 static void led_exit(OrchardAppContext *context) {
 
   (void)context;
+  oscope_stop();
 }
 
 orchard_app("Blinkies!", led_init, led_start, led_event, led_exit);
@@ -46,6 +46,7 @@ static void redraw_list(struct launcher_list *list) {
   //  chsnprintf(tmp, sizeof(tmp), "%d of %d apps", list->selected + 1, list->total);
   
   orchardGfxStart();
+  orchardGfxFrameDiff();
   // draw title bar
   font = gdispOpenFont("fixed_5x8");
   width = gdispGetWidth();
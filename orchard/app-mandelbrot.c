@@ -69,7 +69,7 @@ static void mandelbrot(float x1, float y1, float x2, float y2) {
     orchardGfxStart();
     gdispFlush();
     orchardGfxEnd();
-    if (chThdShouldTerminateX())
+    if (orchardAppShouldExit())
       return;
   }
 }
@@ -86,7 +86,7 @@ static void mandelbrot_start(OrchardAppContext *context) {
 	cx = -0.086f;
 	cy = 0.85f;
 
-	while (!chThdShouldTerminateX()) {
+	while (!orchardAppShouldExit()) {
 		mandelbrot(-2.0f*zoom+cx, -1.5f*zoom+cy, 2.0f*zoom+cx, 1.5f*zoom+cy);
 
 		zoom *= 0.7f;
@@ -23,10 +23,6 @@ static void redraw_ui(void) {
   width = gdispGetWidth();    // these are thread-safe, don't lock around them
   height = gdispGetHeight();
 
-  accelPoll(&d);
-  d.x = (d.x + 2048) & 0xFFF;
-  d.y = (d.y + 2048) & 0xFFF;
-  
   // x values go up as you tilt to the right
   // y vaules go up as you tilt toward the bottom
   xo = x; yo = y;
@@ -78,9 +74,11 @@ static void marble_start(OrchardAppContext *context) {
 
   (void)context;
   
-  accelPoll(&dref);  // seed accelerometer values
+  accelStreamStart();
+  accelPoll(&dref);  // seed accelerometer values, tilt events update d from here
   dref.x = (dref.x + 2048) & 0xFFF;
   dref.y = (dref.y + 2048) & 0xFFF;
+  d = dref;
 
   orchardGfxStart();
   gdispClear(Black);
@@ -98,11 +96,14 @@ static void marble_event(OrchardAppContext *context, const OrchardAppEvent *even
     if (event->key.flags == keyDown) {
       if( event->key.code == keySelect ) {
 	// center the accelerometer reference
-	accelPoll(&dref);
-	dref.x = (dref.x + 2048) & 0xFFF;
-	dref.y = (dref.y + 2048) & 0xFFF;
+	dref = d;
       }
     }
+  } else if (event->type == accelEvent) {
+    if( event->accel.code == accelCodeTilt ) {
+      d.x = event->accel.x + 2048;
+      d.y = event->accel.y + 2048;
+    }
   } else if (event->type == timerEvent) {
     redraw_ui();
   }
@@ -111,6 +112,7 @@ static void marble_event(OrchardAppContext *context, const OrchardAppEvent *even
 static void marble_exit(OrchardAppContext *context) {
 
   (void)context;
+  accelStreamStop();
 }
 
 orchard_app("marble", marble_init, marble_start, marble_event, marble_exit);
@@ -7,7 +7,11 @@
 #include <stdlib.h>
 
 #include "fixmath.h"
-#include "fix16_fft.h"
+#include "fix16_rfft.h"
+
+#if MIC_SAMPLE_DEPTH != FIX16_RFFT_LENGTH
+#error "the spectrum view expects one mic block per transform"
+#endif
 
 static int mode = 0;
 
@@ -89,22 +93,25 @@ static void redraw_ui(uint8_t *samples) {
   coord_t height;
   uint8_t i;
   uint8_t scale;
-  fix16_t real[MIC_SAMPLE_DEPTH];
-  fix16_t imag[MIC_SAMPLE_DEPTH];
+  int32_t fft[FIX16_RFFT_LENGTH];
+  uint32_t mag;
 
   agc( samples );
   
   if ( mode ) {
-    fix16_fft(samples, real, imag, MIC_SAMPLE_DEPTH);
+    fix16_rfft_u8(samples, fft);
+    // the upper half of the spectrum mirrors the lower half
     for( i = 0; i < MIC_SAMPLE_DEPTH; i++ ) {
-      samples[i] = fix16_to_int( fix16_sqrt(fix16_sadd(fix16_mul(real[i],real[i]),
-						       fix16_mul(imag[i],imag[i]))) );
+      mag = fix16_rfft_to_int(fix16_rfft_bin_mag(fft, i <= FIX16_RFFT_BINS ?
+                                                 i : FIX16_RFFT_LENGTH - i));
+      samples[i] = (uint8_t) (mag > 255 ? 255 : mag);
     }
     
     agc_fft(samples);
   }
   
   orchardGfxStart();
+  orchardGfxFrameDiff();
   height = gdispGetHeight();
   scale = 256 / height;
 
@@ -135,7 +142,7 @@ static void oscope_start(OrchardAppContext *context) {
   (void)context;
 
   redraw_ui(NULL);
-  analogUpdateMic();
+  analogMicStart();
 }
 
 void oscope_event(OrchardAppContext *context, const OrchardAppEvent *event) {
@@ -154,13 +161,13 @@ void oscope_event(OrchardAppContext *context, const OrchardAppEvent *event) {
       samples = analogReadMic();
       redraw_ui(samples);
     }
-    analogUpdateMic();
   }
 }
 
 static void oscope_exit(OrchardAppContext *context) {
 
   (void)context;
+  analogMicStop();
 }
 
 orchard_app("Sound scope", oscope_init, oscope_start, oscope_event, oscope_exit);
@@ -48,6 +48,7 @@ static void shakebar_start(OrchardAppContext *context) {
   (void)context;
 
   bump_level = 0;
+  accelStreamStart();
   orchardAppTimer(context, RETIRE_RATE * 1000 * 1000, true);  // fire every 500ms to retire bumps
   redraw_ui();
   
@@ -64,6 +65,8 @@ static void shakebar_event(OrchardAppContext *context, const OrchardAppEvent *ev
       bump_level--;
     redraw_ui();
   } else if( event->type == accelEvent ) {
+    if( (event->accel.code != accelCodeBump) && (event->accel.code != accelCodeShake) )
+      return;
     if( bump_level < BUMP_LIMIT )
       bump_level++;
     
@@ -74,6 +77,7 @@ static void shakebar_event(OrchardAppContext *context, const OrchardAppEvent *ev
 static void shakebar_exit(OrchardAppContext *context) {
 
   (void)context;
+  accelStreamStop();
 }
 
 orchard_app("shakebar", shakebar_init, shakebar_start, shakebar_event, shakebar_exit);
@@ -77,6 +77,7 @@ static void sf_event(OrchardAppContext *ctx, const OrchardAppEvent *event) {
 
   if (event->type == timerEvent) {
     int i;
+    int steps = 1 + event->timer.overruns;  // keep the speed if frames were skipped
     uint32_t starx, stary;
 
     orchardGfxStart();
@@ -87,7 +88,7 @@ static void sf_event(OrchardAppContext *ctx, const OrchardAppEvent *event) {
       struct star *star = &sf->stars[i];
 
       /* Move the star */
-      star->z = fix16_add(star->z, star->s);
+      star->z = fix16_add(star->z, star->s * steps);
 	  
       if (fix16_to_int(star->z) >= 32)
 	      regen_star(sf, i);
@@ -53,7 +53,7 @@ static void test_event(OrchardAppContext *context, const OrchardAppEvent *event)
       chprintf(stream, "USB Detect ");
     else
       chprintf(stream, "Unknown ");
-    chprintf(stream, "source.  Value: %d\r\n", event->adc.flags);
+    chprintf(stream, "source.  Value: %d\r\n", event->adc.value);
   }
   else
     chprintf(stream, "Unrecognized event\r\n");
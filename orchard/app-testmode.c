@@ -26,14 +26,11 @@ orchard_app("~testmode", NULL, testmode_start, testmode_event, NULL);
 static void test_peer_handler(uint8_t prot, uint8_t src, uint8_t dst,
                               uint8_t length, const void *data) {
 
-  (void)length;
-  (void)prot;
-  (void)src;
   (void)dst;
 
   test_rxdat = *((uint32_t *) data);
 
-  chEvtBroadcast(&radio_app);
+  orchardAppRadioEvent(prot, src, length);
 }
 
 static void testpeer_start(OrchardAppContext *context) {
@@ -52,10 +49,8 @@ static void testpeer_event(OrchardAppContext *context,
     chprintf(stream, "received %08x, rebroadcasting...\n\r", test_rxdat);
     chsnprintf(datstr, sizeof(datstr), "%08x", test_rxdat);
     orchardTestPrompt("received:", datstr, 0);
-    radioAcquire(radioDriver);
     radioSend(radioDriver, RADIO_BROADCAST_ADDRESS, radio_prot_peer_to_dut,
               4, &test_rxdat);
-    radioRelease(radioDriver);
   }
 }
 
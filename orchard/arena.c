@@ -0,0 +1,38 @@
+#include "arena.h"
+
+#include <string.h>
+
+void arenaInit(arena *a, void *mem, size_t size) {
+  a->base = mem;
+  a->size = size & ~(size_t)(ARENA_ALIGN - 1);
+  a->used = 0;
+  a->peak = 0;
+  a->failed = 0;
+}
+
+void *arenaAlloc(arena *a, size_t size) {
+  void *p;
+
+  if( size <= a->size )
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if( size > a->size - a->used ) {
+    a->failed++;
+    return NULL;
+  }
+
+  p = a->base + a->used;
+  a->used += size;
+  if( a->used > a->peak )
+    a->peak = a->used;
+  memset(p, 0, size);
+
+  return p;
+}
+
+void arenaReset(arena *a) {
+  a->used = 0;
+}
+
+size_t arenaAvailable(const arena *a) {
+  return a->size - a->used;
+}
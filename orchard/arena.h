@@ -0,0 +1,30 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator over a fixed block. Allocations are never freed one by
+// one; arenaReset() gives the whole block back at once, which is how the
+// app host hands a clean slate to each app it switches to.
+
+#define ARENA_ALIGN   8
+
+typedef struct arena {
+  uint8_t   *base;
+  size_t    size;
+  size_t    used;
+  size_t    peak;     // most ever used at once
+  uint32_t  failed;   // allocations that didn't fit
+} arena;
+
+// mem must be ARENA_ALIGN aligned
+void arenaInit(arena *a, void *mem, size_t size);
+
+// zeroed and ARENA_ALIGN aligned, NULL if size doesn't fit
+void *arenaAlloc(arena *a, size_t size);
+
+void arenaReset(arena *a);
+size_t arenaAvailable(const arena *a);
+
+#endif /* __ARENA_H__ */
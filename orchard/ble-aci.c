@@ -0,0 +1,360 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "ble-aci.h"
+#include "fxprof.h"
+
+#include <string.h>
+
+#define BLE_ACI_EVT_RDY       EVENT_MASK(0)
+#define BLE_ACI_EVT_WORK      EVENT_MASK(1)
+
+// RDYN goes back high a few us after REQN
+#define BLE_ACI_RELEASE_SPINS 1000
+
+static THD_WORKING_AREA(waBleAciThread, 512);
+
+static int ble_aci_uses_credit(uint8_t opcode) {
+  return (opcode == NRF_SENDDATA_OP) ||
+         (opcode == NRF_REQUESTDATA_OP) ||
+         (opcode == NRF_SENDDATAACK_OP) ||
+         (opcode == NRF_SENDDATANACK_OP);
+}
+
+// call locked; takes the next packet allowed on the wire
+static int ble_aci_next_s(ble_aci *aci, ble_aci_packet *out, int *is_data) {
+
+  if( aci->cmd_count != 0 ) {
+    *out = aci->cmd[aci->cmd_head];
+    aci->cmd_head = (aci->cmd_head + 1) % BLE_ACI_CMD_QUEUE;
+    aci->cmd_count--;
+    *is_data = 0;
+    return 1;
+  }
+
+  if( aci->data_count != 0 ) {
+    if( aci->credits == 0 ) {
+      if( !aci->stalled ) {
+        aci->stalled = 1;
+        aci->stats.credit_stalls++;
+      }
+      return 0;
+    }
+    aci->stalled = 0;
+    aci->credits--;
+    *out = aci->data[aci->data_head];
+    aci->data_head = (aci->data_head + 1) % BLE_ACI_DATA_QUEUE;
+    aci->data_count--;
+    *is_data = 1;
+    return 1;
+  }
+
+  return 0;
+}
+
+// waits for RDYN low; when there's nothing to send, also comes back for new
+// work or to terminate
+static int ble_aci_wait_ready(ble_aci *aci, int sending) {
+  eventmask_t mask;
+
+  // RDYN is a level, the interrupt only says it fell, so look at the pin
+  // before sleeping on it
+  while( !aci->port->ready(aci->ctx) ) {
+    mask = chEvtWaitAnyTimeout(ALL_EVENTS,
+                               sending ? BLE_ACI_RDY_TIMEOUT : TIME_INFINITE);
+    if( mask == 0 )
+      aci->stats.timeouts++;
+    if( chThdShouldTerminateX() )
+      return 0;
+    if( !sending && (mask & BLE_ACI_EVT_WORK) )
+      return 0;
+  }
+  return 1;
+}
+
+static void ble_aci_event(ble_aci *aci, uint8_t *rx) {
+
+  aci->stats.events++;
+  aci->stats.rx_bytes += rx[1];
+
+  chSysLock();
+  if( rx[2] == NRF_DEVICESTARTEDEVENT )
+    aci->credits = rx[5];
+  else if( rx[2] == NRF_DATACREDITEVENT )
+    aci->credits += rx[3];
+  chSysUnlock();
+
+  if( aci->handler != NULL )
+    aci->handler(aci->ctx, rx);
+}
+
+static THD_FUNCTION(ble_aci_thread, arg) {
+  ble_aci *aci = arg;
+  event_listener_t el;
+  ble_aci_packet tx;
+  uint8_t rx[BLE_ACI_PACKET_SIZE + 1];  // debug byte on top
+  unsigned rxn, txn, n;
+  uint32_t start, t;
+  int sending, is_data;
+
+  chRegSetThreadName("ble");
+  chEvtRegisterMask(aci->rdy, &el, BLE_ACI_EVT_RDY);
+
+  while( !chThdShouldTerminateX() ) {
+    chSysLock();
+    sending = ble_aci_next_s(aci, &tx, &is_data);
+    aci->busy = sending;
+    if( sending )
+      chThdDequeueAllI(&aci->space, MSG_OK);
+    chSysUnlock();
+
+    // with something to send REQN goes low first, and the nRF8001 answers
+    // with RDYN; otherwise RDYN low means it has an event for us
+    start = fxprofNow();
+    if( sending )
+      aci->port->request(aci->ctx, 1);
+    if( !ble_aci_wait_ready(aci, sending) ) {
+      if( sending )
+        aci->port->request(aci->ctx, 0);
+      aci->busy = 0;
+      continue;
+    }
+
+    if( sending ) {
+      t = fxprofNow();
+      if( t - start > aci->stats.rdy_max )
+        aci->stats.rdy_max = t - start;
+      if( start - tx.queued > aci->stats.latency_max )
+        aci->stats.latency_max = start - tx.queued;
+      aci->stats.latency_total += start - tx.queued;
+      txn = tx.buf[0];
+    }
+    else {
+      aci->port->request(aci->ctx, 1);
+      memset(tx.buf, 0, sizeof(tx.buf));
+      txn = 0;
+    }
+
+    // length and opcode out, debug and length in, then whichever of the
+    // two is longer
+    aci->port->exchange(aci->ctx, 2, tx.buf, rx);
+    rxn = rx[1];
+    if( rxn > BLE_ACI_PACKET_SIZE - 1 )
+      rxn = rx[1] = BLE_ACI_PACKET_SIZE - 1;
+    n = rxn;
+    if( (txn > 0) && (n < txn - 1) )
+      n = txn - 1;
+    if( n > 0 )
+      aci->port->exchange(aci->ctx, n, tx.buf + 2, rx + 2);
+    aci->port->request(aci->ctx, 0);
+
+    for( n = 0; aci->port->ready(aci->ctx) && (n < BLE_ACI_RELEASE_SPINS); n++ )
+      ;
+    // the falling edge was for this transaction
+    chEvtGetAndClearEvents(BLE_ACI_EVT_RDY);
+
+    if( sending ) {
+      if( is_data ) {
+        aci->stats.data++;
+        if( tx.buf[1] == NRF_SENDDATA_OP )
+          aci->stats.data_bytes += txn - 2;
+      }
+      else {
+        aci->stats.commands++;
+      }
+    }
+
+    if( rxn != 0 )
+      ble_aci_event(aci, rx);
+
+    chSysLock();
+    aci->busy = 0;
+    if( rxn != 0 )
+      aci->received++;
+    chThdDequeueAllI(&aci->waiting, MSG_OK);
+    chSchRescheduleS();
+    chSysUnlock();
+  }
+
+  chEvtUnregister(aci->rdy, &el);
+}
+
+void bleAciStart(ble_aci *aci, const ble_aci_port *port, void *ctx,
+                 event_source_t *rdy, ble_aci_handler_t handler) {
+
+  osalDbgAssert(aci->thread == NULL, "BLE ACI already started");
+
+  aci->port = port;
+  aci->ctx = ctx;
+  aci->rdy = rdy;
+  aci->handler = handler;
+  aci->cmd_head = aci->cmd_count = 0;
+  aci->data_head = aci->data_count = 0;
+  aci->credits = 0;
+  aci->stalled = 0;
+  aci->busy = 0;
+  aci->received = 0;
+  chThdQueueObjectInit(&aci->space);
+  chThdQueueObjectInit(&aci->waiting);
+  bleAciResetStats(aci);
+
+  aci->thread = chThdCreateStatic(waBleAciThread, sizeof(waBleAciThread),
+                                  NORMALPRIO + 1, ble_aci_thread, aci);
+}
+
+void bleAciStop(ble_aci *aci) {
+
+  if( aci->thread == NULL )
+    return;
+
+  chThdTerminate(aci->thread);
+  chEvtSignal(aci->thread, BLE_ACI_EVT_WORK);
+  chThdWait(aci->thread);
+  aci->thread = NULL;
+}
+
+void bleAciReset(ble_aci *aci) {
+
+  chSysLock();
+  aci->cmd_head = aci->cmd_count = 0;
+  aci->data_head = aci->data_count = 0;
+  aci->credits = 0;
+  aci->stalled = 0;
+  chThdDequeueAllI(&aci->space, MSG_RESET);
+  chThdDequeueAllI(&aci->waiting, MSG_RESET);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+// call locked; waits for room in the queue packet goes to, and returns it
+static ble_aci_packet *ble_aci_slot_s(ble_aci *aci, uint8_t opcode,
+                                      systime_t timeout) {
+  ble_aci_packet *p;
+  unsigned waiting;
+
+  if( ble_aci_uses_credit(opcode) ) {
+    while( aci->data_count == BLE_ACI_DATA_QUEUE )
+      if( chThdEnqueueTimeoutS(&aci->space, timeout) == MSG_TIMEOUT )
+        return NULL;
+    p = &aci->data[(aci->data_head + aci->data_count) % BLE_ACI_DATA_QUEUE];
+    aci->data_count++;
+  }
+  else {
+    while( aci->cmd_count == BLE_ACI_CMD_QUEUE )
+      if( chThdEnqueueTimeoutS(&aci->space, timeout) == MSG_TIMEOUT )
+        return NULL;
+    p = &aci->cmd[(aci->cmd_head + aci->cmd_count) % BLE_ACI_CMD_QUEUE];
+    aci->cmd_count++;
+  }
+
+  waiting = aci->cmd_count + aci->data_count;
+  if( waiting > aci->stats.queue_max )
+    aci->stats.queue_max = waiting;
+
+  p->queued = fxprofNow();
+  return p;
+}
+
+msg_t bleAciSend(ble_aci *aci, const uint8_t *packet, systime_t timeout) {
+  ble_aci_packet *p;
+
+  osalDbgAssert(packet[0] < BLE_ACI_PACKET_SIZE, "BLE packet too long");
+
+  chSysLock();
+  p = ble_aci_slot_s(aci, packet[1], timeout);
+  if( p == NULL ) {
+    chSysUnlock();
+    return MSG_TIMEOUT;
+  }
+  p->stream = 0;
+  memset(p->buf, 0, sizeof(p->buf));
+  memcpy(p->buf, packet, packet[0] + 1);
+  chSysUnlock();
+
+  chEvtSignal(aci->thread, BLE_ACI_EVT_WORK);
+  return MSG_OK;
+}
+
+msg_t bleAciStream(ble_aci *aci, uint8_t pipe, const uint8_t *data,
+                   size_t len, systime_t timeout) {
+  ble_aci_packet *p;
+  size_t have, n;
+
+  while( len > 0 ) {
+    chSysLock();
+
+    // the last queued packet may still have room
+    p = NULL;
+    if( aci->data_count != 0 ) {
+      p = &aci->data[(aci->data_head + aci->data_count - 1) % BLE_ACI_DATA_QUEUE];
+      if( !p->stream || (p->buf[2] != pipe) ||
+          (p->buf[0] - 2 >= NRF_DATA_LENGTH) )
+        p = NULL;
+      else
+        aci->stats.streamed++;
+    }
+
+    if( p == NULL ) {
+      p = ble_aci_slot_s(aci, NRF_SENDDATA_OP, timeout);
+      if( p == NULL ) {
+        chSysUnlock();
+        return MSG_TIMEOUT;
+      }
+      memset(p->buf, 0, sizeof(p->buf));
+      p->stream = 1;
+      p->buf[0] = 2;
+      p->buf[1] = NRF_SENDDATA_OP;
+      p->buf[2] = pipe;
+    }
+
+    have = p->buf[0] - 2;
+    n = NRF_DATA_LENGTH - have;
+    if( n > len )
+      n = len;
+    memcpy(&p->buf[3 + have], data, n);
+    p->buf[0] += n;
+    data += n;
+    len -= n;
+
+    chSysUnlock();
+    chEvtSignal(aci->thread, BLE_ACI_EVT_WORK);
+  }
+
+  return MSG_OK;
+}
+
+uint32_t bleAciReceived(ble_aci *aci) {
+  return aci->received;
+}
+
+msg_t bleAciWait(ble_aci *aci, uint32_t seen, systime_t timeout) {
+  msg_t msg = MSG_OK;
+
+  chSysLock();
+  while( (aci->received == seen) && (msg == MSG_OK) )
+    msg = chThdEnqueueTimeoutS(&aci->waiting, timeout);
+  chSysUnlock();
+
+  return msg;
+}
+
+msg_t bleAciFlush(ble_aci *aci, systime_t timeout) {
+  msg_t msg = MSG_OK;
+
+  chSysLock();
+  while( ((aci->cmd_count + aci->data_count) != 0 || aci->busy) &&
+         (msg == MSG_OK) )
+    msg = chThdEnqueueTimeoutS(&aci->waiting, timeout);
+  chSysUnlock();
+
+  return msg;
+}
+
+uint8_t bleAciCredits(ble_aci *aci) {
+  return aci->credits;
+}
+
+void bleAciResetStats(ble_aci *aci) {
+  memset(&aci->stats, 0, sizeof(aci->stats));
+  aci->stats.since = chVTGetSystemTime();
+}
@@ -0,0 +1,110 @@
+#ifndef __ORCHARD_BLE_ACI_H__
+#define __ORCHARD_BLE_ACI_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "ble-registers.h"
+
+// ACI transport to the nRF8001. One thread owns the link: it sleeps on the
+// RDYN interrupt instead of spinning on the pin, sends the queued commands,
+// and hands every event it receives to the handler, on its own stack.
+//
+// Commands that need a data credit (send data, request data, data ack and
+// nack) wait in their own queue and only go out while the nRF8001 has
+// credits, everything else goes first. Pipe data written with
+// bleAciStream() is appended to a send data packet still in the queue for
+// the same pipe, so short writes go out as few full packets.
+
+#define BLE_ACI_PACKET_SIZE   NRF_MAX_PACKET_LENGTH
+#define BLE_ACI_CMD_QUEUE     4     // commands
+#define BLE_ACI_DATA_QUEUE    8     // credit consuming commands
+#define BLE_ACI_RDY_TIMEOUT   MS2ST(100)
+
+typedef struct ble_aci_port {
+  // REQN, pulled low while on
+  void  (*request)(void *ctx, int on);
+  // RDYN is low
+  int   (*ready)(void *ctx);
+  void  (*exchange)(void *ctx, size_t n, const uint8_t *tx, uint8_t *rx);
+} ble_aci_port;
+
+// called on the transport thread with a received event: debug byte, length
+// byte, then length bytes of event
+typedef void (*ble_aci_handler_t)(void *ctx, uint8_t *event);
+
+typedef struct ble_aci_stats {
+  uint32_t      commands;       // commands sent
+  uint32_t      data;           // credit consuming commands sent
+  uint32_t      data_bytes;     // pipe data sent
+  uint32_t      streamed;       // stream writes appended to a queued packet
+  uint32_t      events;         // events received
+  uint32_t      rx_bytes;
+  uint32_t      credit_stalls;  // times data waited in the queue for a credit
+  uint32_t      timeouts;       // RDYN took over BLE_ACI_RDY_TIMEOUT
+  uint32_t      queue_max;      // most packets waiting at once
+  uint64_t      latency_total;  // queueing to the wire, in fxprof counts
+  uint32_t      latency_max;
+  uint32_t      rdy_max;        // REQN low to RDYN low, in fxprof counts
+  systime_t     since;          // when the stats were cleared
+} ble_aci_stats;
+
+typedef struct ble_aci_packet {
+  uint32_t      queued;         // fxprof counts
+  uint8_t       stream;         // written by bleAciStream(), may grow
+  // length, opcode, payload; the spare byte lets the transfer clock out
+  // as many bytes past the header as the longest packet clocks in
+  uint8_t       buf[BLE_ACI_PACKET_SIZE + 1];
+} ble_aci_packet;
+
+typedef struct ble_aci {
+  const ble_aci_port  *port;
+  void                *ctx;
+  ble_aci_handler_t   handler;
+  event_source_t      *rdy;     // broadcast on the falling edge of RDYN
+  thread_t            *thread;
+
+  ble_aci_packet      cmd[BLE_ACI_CMD_QUEUE];
+  ble_aci_packet      data[BLE_ACI_DATA_QUEUE];
+  uint8_t             cmd_head, cmd_count;
+  uint8_t             data_head, data_count;
+  uint8_t             credits;
+  uint8_t             stalled;  // data is waiting for a credit
+  uint8_t             busy;     // a packet left the queue, not on the wire yet
+  uint32_t            received; // events received, for bleAciWait()
+  threads_queue_t     space;    // waiting for room in a queue
+  threads_queue_t     waiting;  // waiting for an event or an empty queue
+  ble_aci_stats       stats;
+} ble_aci;
+
+void bleAciStart(ble_aci *aci, const ble_aci_port *port, void *ctx,
+                 event_source_t *rdy, ble_aci_handler_t handler);
+void bleAciStop(ble_aci *aci);
+
+// drops everything queued and the credits, for when the nRF8001 is reset
+void bleAciReset(ble_aci *aci);
+
+// Queues a copy of packet, waiting up to timeout for room.
+// Returns MSG_OK or MSG_TIMEOUT.
+msg_t bleAciSend(ble_aci *aci, const uint8_t *packet, systime_t timeout);
+
+// Queues pipe data as send data packets, filling up one already queued for
+// the pipe first. Returns MSG_OK or MSG_TIMEOUT, with part of the data
+// queued.
+msg_t bleAciStream(ble_aci *aci, uint8_t pipe, const uint8_t *data,
+                   size_t len, systime_t timeout);
+
+// number of events received so far
+uint32_t bleAciReceived(ble_aci *aci);
+
+// Waits until an event comes after the first seen events.
+// Returns MSG_OK or MSG_TIMEOUT.
+msg_t bleAciWait(ble_aci *aci, uint32_t seen, systime_t timeout);
+
+// Waits until everything queued is on the wire.
+msg_t bleAciFlush(ble_aci *aci, systime_t timeout);
+
+uint8_t bleAciCredits(ble_aci *aci);
+void bleAciResetStats(ble_aci *aci);
+
+#endif /* __ORCHARD_BLE_ACI_H__ */
@@ -9,7 +9,9 @@
 
 #include "ble.h"
 #include "gpiox.h"
+#include "spi-arbiter.h"
 #include "hex.h"
+#include "dlog.h"
 #include "ble-service.h"
 
 #include "orchard-test.h"
@@ -17,13 +19,14 @@
 
 struct _BLEDevice {
   SPIDriver                 *spip;
+  spiarb_device             spi;
   uint64_t                  pipes_open;
   nRFEventHandler           listener;
-  uint8_t                   credits;
   nRFDeviceState            device_state;
   int                       svc_msg_num;
   nRFConnectionStatus       connection_status;
   int                       old_baudrate;
+  ble_aci                   aci;
 
   nRFCommandResponseHandler command_response_handler;
   nRFTemperatureHandler     temperature_handler;
@@ -42,7 +45,7 @@ struct _BLEDevice {
 
 BLEDevice BLE1;
 
-static nRFTxStatus ble_transmit_receive(BLEDevice *ble, nRFCommand *txCmd, uint16_t timeout);
+static nRFTxStatus ble_send(BLEDevice *ble, nRFCommand *txCmd);
 static nRFTxStatus ble_transmit_command(BLEDevice *ble, uint8_t command);
 static nRFTxStatus ble_transmit_pipe_command(BLEDevice *ble, uint8_t command, nRFPipe pipe);
 
@@ -53,29 +56,33 @@ nRFDeviceState bleDeviceState(BLEDevice *ble) {
 
 nRFCmd bleSetup(BLEDevice *ble, const struct ble_service *service)
 {
-  int last_svc_msg_num = -1;
-  int loop = 0;
+  uint32_t seen;
+  int msg_num;
 
   while ((ble->device_state != nRFSetupState)
       && (ble->device_state != PreSetup)) {
-    nrf_debug("Pumping Tx/Rx queue, waiting for 'Standby' state...\r\n");
-    ble_transmit_receive(ble, NULL, 0);
+    nrf_debug("Waiting for 'Standby' state...\r\n");
+    if (blePoll(ble, BLE_SETUP_TIMEOUT) != Success)
+      return cmdTimeout;
   }
 
   nrf_debug("State is 'Standby'.  Starting to send service commands...\r\n");
   for (ble->svc_msg_num = 0;
-      (ble->svc_msg_num >= 0) && (ble->svc_msg_num < service->count);
-       loop++) {
+      (ble->svc_msg_num >= 0) && (ble->svc_msg_num < service->count); ) {
 #if NRF_DEBUG
-    chprintf(stream, "sending setup message number %d/%d\r\n",
-            ble->svc_msg_num + 1, service->count);
+    dlog("sending setup message number %d/%d",
+         ble->svc_msg_num + 1, service->count);
 #endif
-    if (ble->svc_msg_num != last_svc_msg_num) {
-      last_svc_msg_num = ble->svc_msg_num;
-      ble_transmit_receive(ble, (nRFCommand *)service->data[ble->svc_msg_num].buffer, 0);
-    }
-    else {
-      ble_transmit_receive(ble, NULL, 0);
+    // the response to each message moves svc_msg_num on
+    msg_num = ble->svc_msg_num;
+    seen = bleAciReceived(&ble->aci);
+    if (ble_send(ble, (nRFCommand *)service->data[msg_num].buffer) != Success)
+      return cmdTimeout;
+
+    while (ble->svc_msg_num == msg_num) {
+      if (bleAciWait(&ble->aci, seen, MS2ST(BLE_SETUP_TIMEOUT)) != MSG_OK)
+        return cmdTimeout;
+      seen = bleAciReceived(&ble->aci);
     }
 
     if (ble->device_state == Standby) {
@@ -86,29 +93,47 @@ nRFCmd bleSetup(BLEDevice *ble, const struct ble_service *service)
   return cmdSetupError;
 }
 
-static void ble_select(BLEDevice *ble) {
+static void ble_request(void *ctx, int on) {
+  BLEDevice *ble = ctx;
 
-  (void)ble;
-  spiAcquireBus(ble->spip);
-  ble->old_baudrate = ble->spip->spi->BR;
-  ble->spip->spi->C1 |= (SPIx_C1_LSBFE /*| SPIx_C1_CPHA*/);
-  ble->spip->spi->BR = 0x3; /* Divide 12 MHz clock by 16 */
-  palClearPad(GPIOE, 18);
+  if (on) {
+    spiarbAcquire(&ble->spi);
+    ble->old_baudrate = ble->spip->spi->BR;
+    ble->spip->spi->C1 |= (SPIx_C1_LSBFE /*| SPIx_C1_CPHA*/);
+    ble->spip->spi->BR = 0x3; /* Divide 12 MHz clock by 16 */
+    palClearPad(GPIOE, 18);
+  }
+  else {
+    palSetPad(GPIOE, 18);
+    ble->spip->spi->C1 &= ~(SPIx_C1_LSBFE /*| SPIx_C1_CPHA*/);
+    ble->spip->spi->BR = ble->old_baudrate;
+    spiarbRelease(&ble->spi);
+  }
 }
 
-static void ble_unselect(BLEDevice *ble) {
+static int ble_is_ready(void *ctx) {
 
-  (void)ble;
-  palSetPad(GPIOE, 18);
-  ble->spip->spi->C1 &= ~(SPIx_C1_LSBFE /*| SPIx_C1_CPHA*/);
-  ble->spip->spi->BR = ble->old_baudrate;
-  spiReleaseBus(ble->spip);
+  (void)ctx;
+  return palReadPad(GPIOC, 3) == 0;
 }
 
-static int ble_is_ready(BLEDevice *ble) {
+static void ble_exchange(void *ctx, size_t n, const uint8_t *tx, uint8_t *rx) {
+  BLEDevice *ble = ctx;
 
-  (void)ble;
-  return palReadPad(GPIOC, 3) == 0;
+  spiExchange(ble->spip, n, tx, rx);
+}
+
+static const ble_aci_port ble_port = {
+  ble_request,
+  ble_is_ready,
+  ble_exchange,
+};
+
+static nRFTxStatus ble_handle_packet(BLEDevice *ble, nRFEvent *rxEvent);
+
+static void ble_received(void *ctx, uint8_t *event) {
+
+  ble_handle_packet(ctx, (nRFEvent *)event);
 }
 
 static void ble_assert_reset(BLEDevice *ble) {
@@ -125,8 +150,8 @@ static void ble_deassert_reset(BLEDevice *ble) {
 
 void bleReset(BLEDevice *ble) {
 
+  bleAciReset(&ble->aci);
   ble->device_state = Initial;
-  ble->credits = 0;
   ble->svc_msg_num = -2;
   ble->connection_status = Disconnected;
 
@@ -138,7 +163,8 @@ void bleReset(BLEDevice *ble) {
 void bleStop(BLEDevice *ble) {
   bleReset(ble);
   bleSetup(ble, &ble_broadcast);
-  bleSleep(ble);  
+  bleSleep(ble);
+  bleAciFlush(&ble->aci, MS2ST(BLE_SETUP_TIMEOUT));
 }
 
 void bleStart(BLEDevice *ble, SPIDriver *spip) {
@@ -146,6 +172,7 @@ void bleStart(BLEDevice *ble, SPIDriver *spip) {
   nrf_debug("Initializing");
 
   ble->spip = spip;
+  spiarbDeviceInit(&ble->spi, spiarbBus(spip), "ble", spiarbPrioNormal);
   // Zero all the handlers
   ble->listener = 0;
   ble->command_response_handler = 0;
@@ -168,9 +195,8 @@ void bleStart(BLEDevice *ble, SPIDriver *spip) {
   /* Set RESET pin to be an output */
   gpioxSetPadMode(GPIOX, 5, GPIOX_OUT_PUSHPULL);
 
+  bleAciStart(&ble->aci, &ble_port, ble, &ble_rdy, ble_received);
   bleReset(ble);
-
-  // Load up the first setup message and start interrupts
 }
 
 #if NRF_DEBUG
@@ -638,8 +664,7 @@ static nRFTxStatus ble_handle_packet(BLEDevice *ble, nRFEvent *rxEvent)
   // Handle response
   switch (rxEvent->event) {
   case NRF_DEVICESTARTEDEVENT:
-    ble->credits = rxEvent->msg.deviceStarted.dataCreditAvailable;
-
+    // the transport keeps the data credits
     switch (rxEvent->msg.deviceStarted.operatingMode) {
     case 0x01:
       ble->device_state = Test;
@@ -659,8 +684,8 @@ static nRFTxStatus ble_handle_packet(BLEDevice *ble, nRFEvent *rxEvent)
   case NRF_COMMANDRESPONSEEVENT: {
     if (rxEvent->msg.commandResponse.status != 0x00) {
 #if NRF_DEBUG
-      chprintf(stream, "non-success command response event: 0x%02x\r\n",
-               rxEvent->msg.commandResponse.status);
+      dlog("non-success command response event: 0x%02x",
+           rxEvent->msg.commandResponse.status);
 #endif
       if (ble->command_response_handler)
         ble->command_response_handler(
@@ -745,7 +770,6 @@ static nRFTxStatus ble_handle_packet(BLEDevice *ble, nRFEvent *rxEvent)
                   rxEvent->msg.disconnected.btLeStatus);
     break;
   case NRF_DATACREDITEVENT:
-    ble->credits += rxEvent->msg.dataCredits;
     break;
   case NRF_PIPESTATUSEVENT:
     ble->pipes_open = rxEvent->msg.pipeStatus.pipesOpen;
@@ -791,134 +815,41 @@ static nRFTxStatus ble_handle_packet(BLEDevice *ble, nRFEvent *rxEvent)
   return Success;
 }
 
-// Transmit a command, and simultaneously receive a message from nRF8001 if
-// there is one. To just receive without transmitting anything, call this
-// function with a NULL argument.
-static nRFTxStatus ble_transmit_receive(BLEDevice *ble,
-                                        nRFCommand *txCmd,
-                                        uint16_t timeout)
+// Queue a command for the transport thread, which sends it once the
+// nRF8001 is ready for it, and as soon as it has a data credit if it needs
+// one. Events come back through ble_handle_packet() on that thread.
+static nRFTxStatus ble_send(BLEDevice *ble, nRFCommand *txCmd)
 {
-  // Buffer that we will receive into
-  uint8_t rxBuffer[sizeof(nRFEvent)];
-  uint8_t txBuffer[sizeof(nRFEvent)];
-  uint8_t txLength;
-
-  nRFEvent *rxEvent = (nRFEvent *)rxBuffer;
-
-  memset(rxBuffer, 0, sizeof(rxBuffer));
-  memset(txBuffer, 0, sizeof(txBuffer));
+  osalDbgAssert(txCmd->length < NRF_MAX_PACKET_LENGTH, "BLE packet too long");
 
-  // Transmit length
-  if (txCmd) {
-    txLength = txCmd->length;
-    memcpy(txBuffer, txCmd, txLength + 1);
-  }
-  else {
-    txLength = 0;
-  }
-
-  osalDbgAssert(txLength <= NRF_MAX_PACKET_LENGTH, "BLE packet too long");
-
-  // Enough credits?
-  if (txLength &&
-     (txCmd->command == NRF_SENDDATA_OP
-   || txCmd->command == NRF_REQUESTDATA_OP
-   || txCmd->command == NRF_SENDDATAACK_OP
-   || txCmd->command == NRF_SENDDATANACK_OP)) {
-    if (ble->credits < 1) {
-      nrf_debug("transmitReceive fail, not enough credits");
-      return InsufficientCredits;
-    }
-
-    // Use a credit
-    ble->credits--;
-  }
-
-  if (txLength > 0) {
-    ble_select(ble);
 #if NRF_VERBOSE_DEBUG
-    chprintf(stream, "transmitReceive: called with transmission, "
-            "command %d\r\n", txCmd->command);
-    print_hex(stream, txBuffer, txLength + 1, 0);
+  chprintf(stream, "send: command %d\r\n", txCmd->command);
+  print_hex(stream, txCmd, txCmd->length + 1, 0);
 #endif
-  } 
-#if NRF_VERBOSE_DEBUG
-  else
-    nrf_debug("transmitReceive: called in polling mode");
-#endif
-    
-  // TODO: Timeout
 
-  if (txLength > 0 || timeout == 0) {
-    // Wait for RDYN low indefinitely
-#if NRF_VERBOSE_DEBUG
-    nrf_debug("waiting for RDYN low indefinitely");
-#endif
-    while (!ble_is_ready(ble));
-  }
-  else {
-#if NRF_VERBOSE_DEBUG
-    chprintf(stream, "polling for %d ms, waiting for BLE to be ready\r\n", timeout);
-#endif
-    int rdy = 0;
-    int wait_periods;
-    // Wait for RDYN low for 1 ms at a time
-    for (wait_periods = 0; wait_periods < timeout; wait_periods++) {
-      if (ble_is_ready(ble)) {
-        rdy = 1;
-        break;
-      }
-      else
-        chThdSleepMilliseconds(1);
-    }
-
-    if (!rdy)
-      return Timeout;
+  if (bleAciSend(&ble->aci, (uint8_t *)txCmd, MS2ST(BLE_SEND_TIMEOUT)) != MSG_OK) {
+    nrf_debug("send fail, queue full");
+    return Timeout;
   }
 
-  if (txLength == 0)
-    ble_select(ble);
-
-#if NRF_VERBOSE_DEBUG
-  nrf_debug("RDYN is low, ready to transmit/receive");
-#endif
-
-  // Send length and command bytes,
-  // receive debug and length bytes
-  spiExchange(ble->spip, 2, txBuffer, rxBuffer);
-
-  osalDbgAssert(rxEvent->length <= NRF_MAX_PACKET_LENGTH,
-      "BLE Rx packet too long");
-
-  // bytes_left points to the next byte to be transferred in
-  // txBuffer, or the next byte to be received in rxBuffer.
-  // Subtract the two bytes already transmitted/received.
-  // For TX, packets are data + 1 byte (length)
-  // For RX, packets are data + 2 bytes (debug and length)
-  int bytes_left = rxEvent->length - 0;
-  if (bytes_left < (txLength - 1))
-    bytes_left = txLength - 1;
-
-#if NRF_DEBUG
-  chprintf(stream, "Finishing up transfer, have %d bytes left (%d, %d)\r\n",
-           bytes_left, rxEvent->length, txLength);
-#endif
-  spiExchange(ble->spip, bytes_left, txBuffer + 2, rxBuffer + 2);
-
-  // Bring REQN high
-  ble_unselect(ble);
-
-  // Wait for chip to acknowledge
-  while (ble_is_ready(ble));
-
-  return ble_handle_packet(ble, rxEvent);
+  return Success;
 }
 
 // Informational functions
 
 uint8_t bleCreditsAvailable(BLEDevice *ble)
 {
-  return ble->credits;
+  return bleAciCredits(&ble->aci);
+}
+
+const ble_aci_stats *bleGetStats(BLEDevice *ble)
+{
+  return &ble->aci.stats;
+}
+
+void bleResetStats(BLEDevice *ble)
+{
+  bleAciResetStats(&ble->aci);
 }
 
 uint8_t bleIsConnected(BLEDevice *ble) {
@@ -934,7 +865,10 @@ nRFConnectionStatus bleGetConnectionStatus(BLEDevice *ble)
 
 nRFTxStatus blePoll(BLEDevice *ble, uint16_t timeout)
 {
-  return ble_transmit_receive(ble, 0, timeout);
+  if (bleAciWait(&ble->aci, bleAciReceived(&ble->aci),
+                 timeout ? MS2ST(timeout) : TIME_INFINITE) != MSG_OK)
+    return Timeout;
+  return Success;
 }
 
 uint8_t bleIsPipeOpen(BLEDevice *ble, nRFPipe servicePipeNo)
@@ -956,7 +890,7 @@ static nRFTxStatus ble_transmit_command(BLEDevice *ble, uint8_t command)
   nRFCommand cmd;
   cmd.length = 1;
   cmd.command = command;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 static nRFTxStatus ble_transmit_pipe_command(BLEDevice *ble, uint8_t command, nRFPipe pipe)
@@ -972,7 +906,7 @@ static nRFTxStatus ble_transmit_pipe_command(BLEDevice *ble, uint8_t command, nR
   cmd.length = 2;
   cmd.command = command;
   cmd.content.servicePipeNo = pipe;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleTest(BLEDevice *ble, uint8_t feature)
@@ -990,7 +924,7 @@ nRFTxStatus bleTest(BLEDevice *ble, uint8_t feature)
   cmd.length = 2;
   cmd.command = NRF_TEST_OP;
   cmd.content.testFeature = feature;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleSleep(BLEDevice *ble)
@@ -1016,7 +950,7 @@ nRFTxStatus bleEcho(BLEDevice *ble, nRFLen dataLength, uint8_t *data)
   cmd.length = dataLength + 1;
   cmd.command = NRF_ECHO_OP;
   memcpy(cmd.content.echoData, data, dataLength);
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleWakeup(BLEDevice *ble)
@@ -1045,7 +979,7 @@ nRFTxStatus bleSetTxPower(BLEDevice *ble, uint8_t powerLevel)
   cmd.length = 2;
   cmd.command = NRF_SETTXPOWER_OP;
   cmd.content.radioTxPowerLevel = powerLevel;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleGetDeviceAddress(BLEDevice *ble)
@@ -1074,7 +1008,7 @@ nRFTxStatus bleConnect(BLEDevice *ble, uint16_t timeout, uint16_t advInterval)
   cmd.command = NRF_CONNECT_OP;
   cmd.content.connect.timeout = timeout;
   cmd.content.connect.advInterval = advInterval;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleRadioReset(BLEDevice *ble)
@@ -1083,7 +1017,7 @@ nRFTxStatus bleRadioReset(BLEDevice *ble)
   nRFCommand cmd;
   cmd.length = 1;
   cmd.command = NRF_RADIORESET_OP;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleBond(BLEDevice *ble, uint16_t timeout, uint16_t advInterval)
@@ -1098,7 +1032,7 @@ nRFTxStatus bleBond(BLEDevice *ble, uint16_t timeout, uint16_t advInterval)
   cmd.command = NRF_BOND_OP;
   cmd.content.bond.timeout = timeout;
   cmd.content.bond.advInterval = advInterval;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleDisconnect(BLEDevice *ble, uint8_t reason)
@@ -1112,7 +1046,7 @@ nRFTxStatus bleDisconnect(BLEDevice *ble, uint8_t reason)
   cmd.length = 2;
   cmd.command = NRF_DISCONNECT_OP;
   cmd.content.disconnectReason = reason;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleChangeTimingRequest(BLEDevice *ble, uint16_t intervalMin,
@@ -1139,7 +1073,7 @@ nRFTxStatus bleChangeTimingRequest(BLEDevice *ble, uint16_t intervalMin,
   else
       cmd.length = 1;
 
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleOpenRemotePipe(BLEDevice *ble, nRFPipe servicePipeNo)
@@ -1163,7 +1097,7 @@ nRFTxStatus bleDtmCommand(BLEDevice *ble, uint16_t dtmCmd)
   cmd.length = 3;
   cmd.command = NRF_DTMCOMMAND_OP;
   cmd.content.dtmCommand = dtmCmd;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleReadDynamicData(BLEDevice *ble)
@@ -1184,7 +1118,7 @@ nRFTxStatus bleWriteDynamicData(BLEDevice *ble, uint8_t seqNo,
     cmd.command = NRF_WRITEDYNAMICDATA_OP;
     cmd.content.writeDynamicData.sequenceNo = seqNo;
     memcpy(cmd.content.writeDynamicData.dynamicData, data, dataLength);
-    return ble_transmit_receive(ble, &cmd, 0);
+    return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleSetApplLatency(BLEDevice *ble, uint8_t applLatencyMode,
@@ -1200,7 +1134,7 @@ nRFTxStatus bleSetApplLatency(BLEDevice *ble, uint8_t applLatencyMode,
   cmd.command = NRF_SETAPPLICATIONLATENCY_OP;
   cmd.content.setApplLatency.applLatencyMode = applLatencyMode;
   cmd.content.setApplLatency.latency = latency;
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleSetKey(BLEDevice *ble, uint8_t keyType, uint8_t *key)
@@ -1223,7 +1157,7 @@ nRFTxStatus bleSetKey(BLEDevice *ble, uint8_t keyType, uint8_t *key)
   else
     return InvalidParameter;
 
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleOpenAdvPipe(BLEDevice *ble, uint64_t advServiceDataPipes)
@@ -1238,7 +1172,7 @@ nRFTxStatus bleOpenAdvPipe(BLEDevice *ble, uint64_t advServiceDataPipes)
   cmd.command = NRF_OPENADVPIPE_OP;
   cmd.content.advServiceDataPipes = advServiceDataPipes;
 
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleBroadcast(BLEDevice *ble, uint16_t timeout, uint16_t advInterval)
@@ -1254,7 +1188,7 @@ nRFTxStatus bleBroadcast(BLEDevice *ble, uint16_t timeout, uint16_t advInterval)
   cmd.content.broadcast.timeout = timeout;
   cmd.content.broadcast.advInterval = advInterval;
 
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleBondSecurityRequest(BLEDevice *ble)
@@ -1285,11 +1219,6 @@ nRFTxStatus bleSendData(BLEDevice *ble, nRFPipe servicePipeNo,
     return PipeNotOpen;
   }
 
-  if (ble->credits <= 0) {
-    nrf_debug("not enough credits");
-    return InsufficientCredits;
-  }
-
   if (dataLength > NRF_DATA_LENGTH) {
     nrf_debug("data too long");
     return DataTooLong;
@@ -1300,7 +1229,34 @@ nRFTxStatus bleSendData(BLEDevice *ble, nRFPipe servicePipeNo,
   cmd.length = dataLength + 2;
   cmd.content.data.servicePipeNo = servicePipeNo;
   memcpy(cmd.content.data.data, data, dataLength);
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
+}
+
+nRFTxStatus bleStreamData(BLEDevice *ble, nRFPipe servicePipeNo,
+    size_t dataLength, const uint8_t *data)
+{
+  if (ble->device_state != Standby) {
+    nrf_debug("device not in Standby state");
+    return InvalidState;
+  }
+
+  if (ble->connection_status != Connected) {
+    nrf_debug("device not connected");
+    return NotConnected;
+  }
+
+  if (!(ble->pipes_open & ((uint64_t)1)<<servicePipeNo)) {
+    nrf_debug("pipe not open");
+    return PipeNotOpen;
+  }
+
+  if (bleAciStream(&ble->aci, servicePipeNo, data, dataLength,
+                   MS2ST(BLE_SEND_TIMEOUT)) != MSG_OK) {
+    nrf_debug("stream fail, queue full");
+    return Timeout;
+  }
+
+  return Success;
 }
 
 nRFTxStatus bleRequestData(BLEDevice *ble, nRFPipe servicePipeNo)
@@ -1323,7 +1279,7 @@ nRFTxStatus bleSetLocalData(BLEDevice *ble, nRFPipe servicePipeNo,
 
   memcpy(cmd.content.data.data, data, dataLength);
 
-  return ble_transmit_receive(ble, &cmd, 0);
+  return ble_send(ble, &cmd);
 }
 
 nRFTxStatus bleSendDataAck(BLEDevice *ble, nRFPipe servicePipeNo)
@@ -1345,7 +1301,7 @@ nRFTxStatus bleSendDataNack(BLEDevice *ble, nRFPipe servicePipeNo,
     cmd.content.sendDataNack.servicePipeNo = servicePipeNo;
     cmd.content.sendDataNack.errorCode = errorCode;
 
-    return ble_transmit_receive(ble, &cmd, 0);
+    return ble_send(ble, &cmd);
 }
 
 // Event handler registration
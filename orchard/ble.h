@@ -19,13 +19,20 @@ extern BLEDevice BLE1;
 #include "ble-registers.h"
 #include "ble-data.h"
 #include "ble-service.h"
+#include "ble-aci.h"
 
 #define NRF_RX_BUFFERS 5
 
+// ms to wait for each answer of the nRF8001 during setup
+#define BLE_SETUP_TIMEOUT 1000
+// ms to wait for room in the transport queue
+#define BLE_SEND_TIMEOUT 100
+
 #if NRF_DEBUG
 #include "chprintf.h"
-#define nrf_debug(msg) chprintf(stream, msg "\r\n")
-#define nrf_debugnl(msg) chprintf(stream, msg "\r\n")
+#include "dlog.h"
+#define nrf_debug(msg) dlog(msg)
+#define nrf_debugnl(msg) dlog(msg)
 void bleDebugEvent(BLEDevice *ble, nRFEvent *event);
 #else
 #define nrf_debug(msg)
@@ -58,11 +65,14 @@ void bleReset(BLEDevice *ble);
 void bleStart(BLEDevice *ble, SPIDriver *spip);
 void bleStop(BLEDevice *ble);
 
+// waits up to timeout ms, or for ever with 0, for the next event
 nRFTxStatus blePoll(BLEDevice *ble, uint16_t timeout);
 nRFDeviceState bleDeviceState(BLEDevice *ble);
 nRFCmd bleSetup(BLEDevice *ble, const struct ble_service *service);
 
 uint8_t bleCreditsAvailable(BLEDevice *ble);
+const ble_aci_stats *bleGetStats(BLEDevice *ble);
+void bleResetStats(BLEDevice *ble);
 uint8_t bleIsConnected(BLEDevice *ble);
 nRFConnectionStatus bleGetConnectionStatus(BLEDevice *ble);
 
@@ -102,6 +112,11 @@ nRFTxStatus bleDirectedConnect(BLEDevice *ble);
 nRFTxStatus bleSendData(BLEDevice *ble, nRFPipe servicePipeNo,
                    nRFLen dataLength,
                    uint8_t *data);
+// Queues data for the pipe as a byte stream: it is packed into as few send
+// data packets as possible, and may go out split differently than written.
+nRFTxStatus bleStreamData(BLEDevice *ble, nRFPipe servicePipeNo,
+                   size_t dataLength,
+                   const uint8_t *data);
 nRFTxStatus bleRequestData(BLEDevice *ble, nRFPipe servicePipeNo);
 nRFTxStatus bleSetLocalData(BLEDevice *ble, nRFPipe servicePipeNo,
                        nRFLen dataLength,
@@ -1,10 +1,12 @@
 #include "ch.h"
 #include "hal.h"
 #include "i2c.h"
+#include "i2c-queue.h"
 #include "chprintf.h"
 
 #include "orchard.h"
 #include "orchard-events.h"
+#include "orchard-evq.h"
 #include "orchard-app.h"
 
 #include "captouch.h"
@@ -14,7 +16,7 @@
 
 #include <stdlib.h>
 
-static I2CDriver *driver;
+static i2cq_device captouch_dev;
 event_source_t captouch_changed;
 static uint16_t captouch_state;
 
@@ -22,33 +24,32 @@ static void captouch_set(uint8_t reg, uint8_t val) {
 
   uint8_t tx[2] = {reg, val};
 
-  i2cMasterTransmitTimeout(driver, touchAddr,
-                           tx, sizeof(tx),
-                           NULL, 0,
-                           TIME_INFINITE);
+  i2cqTransfer(&captouch_dev,
+               tx, sizeof(tx),
+               NULL, 0);
 }
 
 static uint8_t captouch_get(uint8_t reg) {
 
   uint8_t val;
 
-  i2cMasterTransmitTimeout(driver, touchAddr,
-                           &reg, 1,
-                           (void *)&val, 1,
-                           TIME_INFINITE);
+  i2cqTransfer(&captouch_dev,
+               &reg, 1,
+               (void *)&val, 1);
   return val;
 }
 
+// one queued transfer, callers don't take the device lock so that a
+// direct read and the key change handler can share the transfer
 static uint16_t captouch_read(void) {
 
   uint16_t val;
   uint8_t reg;
 
   reg = ELE_TCHL;
-  i2cMasterTransmitTimeout(driver, touchAddr,
-                           &reg, 1,
-                           (void *)&val, 2,
-                           TIME_INFINITE);
+  i2cqRead(&captouch_dev,
+           &reg, 1,
+           (void *)&val, 2);
   return val;
 }
 
@@ -159,21 +160,26 @@ static void captouch_keychange(void *port, int irq, int type) {
 
   uint16_t mask;
   bool changed = false;
+  OrchardAppEvent evt;
 
   (void)port;
   (void)irq;
   (void)type;
 
-  i2cAcquireBus(driver);
   mask = captouch_read();
-  i2cReleaseBus(driver);
 
   if (captouch_state != mask)
     changed = true;
   captouch_state = mask;
 
-  if (changed)
+  if (changed) {
+    // the app gets the state as of this change, it may be gone by the
+    // time the app thread runs
+    evt.type = touchEvent;
+    evt.touch.mask = mask;
+    evqPost(&app_evq, &evt);
     chEvtBroadcast(&captouch_changed);
+  }
 }
 
 uint16_t captouchRead(void) {
@@ -181,28 +187,23 @@ uint16_t captouchRead(void) {
 }
 
 uint16_t captouchDirectRead(void) {
-  uint16_t val;
-  
-  i2cAcquireBus(driver);
-  val = captouch_read();
-  i2cReleaseBus(driver);
-
-  return val;
+  return captouch_read();
 }
 
 void captouchStop() {
-  i2cAcquireBus(driver);
+  i2cqAcquire(&captouch_dev);
   captouch_set(ELE_CFG, 0x00);  // disabling all electrodes puts us in stop mode
-  i2cReleaseBus(driver);
+  i2cqRelease(&captouch_dev);
 }
 
 void captouchStart(I2CDriver *i2cp) {
 
-  driver = i2cp;
+  (void)i2cp;  // the bus belongs to the i2c queue
+  i2cqDeviceInit(&captouch_dev, "captouch", touchAddr, i2cqPrioInput);
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&captouch_dev);
   captouch_config();
-  i2cReleaseBus(driver);
+  i2cqRelease(&captouch_dev);
 
   chEvtObjectInit(&captouch_changed);
 
@@ -225,9 +226,9 @@ static void dump(uint8_t *byte, uint32_t count) {
 void captouchPrint(uint8_t reg) {
   uint8_t val;
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&captouch_dev);
   val = captouch_get(reg);
-  i2cReleaseBus(driver);
+  i2cqRelease(&captouch_dev);
   
   chprintf( stream, "Value at %02x: %02x\n\r", reg, val );
 }
@@ -235,9 +236,9 @@ void captouchPrint(uint8_t reg) {
 uint8_t captouchGet(uint8_t reg) {
   uint8_t val;
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&captouch_dev);
   val = captouch_get(reg);
-  i2cReleaseBus(driver);
+  i2cqRelease(&captouch_dev);
   
   return val;
 }
@@ -245,20 +246,20 @@ uint8_t captouchGet(uint8_t reg) {
 void captouchSet(uint8_t adr, uint8_t dat) {
   //  chprintf( stream, "Writing %02x into %02x\n\r", dat, adr );
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&captouch_dev);
   captouch_set(adr, dat);
-  i2cReleaseBus(driver);
+  i2cqRelease(&captouch_dev);
 }
 
 void captouchRecal(void) {
-  i2cAcquireBus(driver);
+  i2cqAcquire(&captouch_dev);
   captouch_set(0x80, 0x63); // resets the chip
   chThdSleepMilliseconds(50);
   captouch_set(0x80, 0x00); // is this necessary??
   chThdSleepMilliseconds(50);
 
   captouch_config();
-  i2cReleaseBus(driver);
+  i2cqRelease(&captouch_dev);
 }
 
 void captouchDebug(void) {
@@ -266,9 +267,9 @@ void captouchDebug(void) {
   uint8_t val[128];
 
   for( i = 0; i < 128; i++ ) {
-    i2cAcquireBus(driver);
+    i2cqAcquire(&captouch_dev);
     val[i] = captouch_get(i);
-    i2cReleaseBus(driver);
+    i2cqRelease(&captouch_dev);
   }
   dump( val, 128 );
 
@@ -313,9 +314,7 @@ void captouchCalibrate(void) {
     captouchFastBaseline();
     chThdSleepMilliseconds(1000);
 
-    i2cAcquireBus(driver);
     captouch_state = captouch_read();
-    i2cReleaseBus(driver);
 
     if( captouch_state == 0x0 )
       break;
@@ -338,9 +337,9 @@ OrchardTestResult test_captouch(const char *my_name, OrchardTestType test_type)
   switch(test_type) {
   case orchardTestPoweron:
   case orchardTestTrivial:
-    i2cAcquireBus(driver);
+    i2cqAcquire(&captouch_dev);
     ret =  captouch_get(ATO_CFG_USL);
-    i2cReleaseBus(driver);
+    i2cqRelease(&captouch_dev);
     if( ret != 0xC4 ) { // this is a value that should have been set by us previously
       return orchardResultFail;
     } else {
@@ -2,6 +2,7 @@
 #include "ch.h"
 #include "hal.h"
 #include "i2c.h"
+#include "i2c-queue.h"
 
 #include "charger.h"
 #include "orchard.h"
@@ -12,7 +13,7 @@
 #include "analog.h"    // for test
 #include "gasgauge.h"  // for test
 
-static I2CDriver *driver;
+static i2cq_device charger_dev;
 static chargerIntent chgIntent = CHG_IDLE;
 static chargerIntent shipIntent = CHG_IDLE; // one-way flag for shipmode
 
@@ -20,12 +21,11 @@ static void charger_set(uint8_t reg, uint8_t val) {
 
   uint8_t tx[2] = {reg, val};
 
-  i2cAcquireBus(driver);
-  i2cMasterTransmitTimeout(driver, chargerAddr,
-                           tx, sizeof(tx),
-                           NULL, 0,
-                           TIME_INFINITE);
-  i2cReleaseBus(driver);
+  i2cqAcquire(&charger_dev);
+  i2cqTransfer(&charger_dev,
+               tx, sizeof(tx),
+               NULL, 0);
+  i2cqRelease(&charger_dev);
 }
 
 static void charger_get(uint8_t adr, uint8_t *data) {
@@ -34,12 +34,11 @@ static void charger_get(uint8_t adr, uint8_t *data) {
 
   tx[0] = adr;
 
-  i2cAcquireBus(driver);
-  i2cMasterTransmitTimeout(driver, chargerAddr,
-                           tx, sizeof(tx),
-                           rx, sizeof(rx),
-                           TIME_INFINITE);
-  i2cReleaseBus(driver);
+  i2cqAcquire(&charger_dev);
+  i2cqTransfer(&charger_dev,
+               tx, sizeof(tx),
+               rx, sizeof(rx));
+  i2cqRelease(&charger_dev);
 
   *data = rx[0];
 }
@@ -89,7 +88,8 @@ void chargerStop(void) {
 
 void chargerStart(I2CDriver *i2cp) {
 
-  driver = i2cp;
+  (void)i2cp;  // the bus belongs to the i2c queue
+  i2cqDeviceInit(&charger_dev, "charger", chargerAddr, i2cqPrioTelemetry);
 
   // 0x6 0xb0    -- 6 hour fast charger time limit, 1A ILIM, no TS, DPM 4.2V
   // 0x4 0x19    -- charge current at 300mA, term sense at 50mA
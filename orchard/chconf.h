@@ -55,6 +55,17 @@
  *          of ticks that is safe to specify in a timeout directive.
  *          The value one is not valid, timeouts are rounded up to
  *          this value.
+ * @note    The KL1x/KL2x tick-less driver counts on a TPM at
+ *          @p CH_CFG_ST_FREQUENCY, which must then be the 48MHz system
+ *          clock divided by a power of two up to 128, with
+ *          @p CH_CFG_TIME_QUANTUM set to zero.
+ * @note    The badge is not converted and keeps the 1kHz SysTick. Its
+ *          code compares raw chVTGetSystemTime() deltas against
+ *          millisecond constants, so the tick must stay at 1kHz, and
+ *          there is no accurate 1kHz free running counter: the TPMs and
+ *          the LPTMR on the 32.768kHz crystal count at 32768/2^n Hz,
+ *          and the LPTMR on the 1kHz LPO is untrimmed and has no
+ *          overflow interrupt to extend its 16 bits counter.
  */
 #define CH_CFG_ST_TIMEDELTA                 0
 
@@ -290,6 +301,23 @@
  */
 #define CH_CFG_USE_HEAP                     TRUE
 
+/**
+ * @brief   Segregated fit heap allocator.
+ * @details If enabled the free blocks of a heap are kept in size classes
+ *          instead of a single list, allocation and release take a bounded
+ *          time.
+ *
+ * @note    The default is @p FALSE.
+ * @note    Requires @p CH_CFG_USE_HEAP.
+ */
+#define CH_CFG_USE_HEAP_TLSF                TRUE
+
+/**
+ * @brief   First level size classes of the segregated fit allocator.
+ * @details Ten classes cover the whole 16kB of RAM.
+ */
+#define CH_CFG_HEAP_TLSF_FL_COUNT           10
+
 /**
  * @brief   Memory Pools Allocator APIs.
  * @details If enabled then the memory pools allocator APIs are included
@@ -356,13 +384,24 @@
 
 /**
  * @brief   Debug option, trace buffer.
- * @details If enabled then the context switch circular trace buffer is
- *          activated.
+ * @details If enabled then the circular trace buffer is activated, see the
+ *          "trace" shell command.
  *
  * @note    The default is @p FALSE.
  */
 #define CH_DBG_ENABLE_TRACE                 TRUE
 
+/**
+ * @brief   Trace timestamps, in core clocks.
+ * @details The M0+ has no realtime counter, the board extends SysTick.
+ */
+#define CH_DBG_TRACE_TIMESTAMP()            boardSysTickNow()
+
+/**
+ * @brief   Exception number of the ISR being traced.
+ */
+#define CH_DBG_TRACE_IRQ_NUMBER()           __get_IPSR()
+
 /**
  * @brief   Debug option, stack checks.
  * @details If enabled then a runtime stack check is performed.
@@ -475,7 +514,8 @@
  *          after processing the virtual timers queue.
  */
 #define CH_CFG_SYSTEM_TICK_HOOK() {                                         \
-  /* System tick event code here.*/                                         \
+  /* Keeps boardSysTickNow() from missing a SysTick reload.*/               \
+  (void)boardSysTickNow();                                                  \
 }
 
 /**
@@ -494,6 +534,11 @@
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
 
+#if !defined(_FROM_ASM_)
+/* Used by CH_DBG_TRACE_TIMESTAMP() and CH_CFG_SYSTEM_TICK_HOOK().*/
+#include "board.h"
+#endif
+
 #endif  /* _CHCONF_H_ */
 
 /** @} */
@@ -24,6 +24,8 @@
 
 #include "accel.h"
 
+#include <string.h>
+
 static int should_stop(void) {
   uint8_t bfr[1];
   return chnReadTimeout(serialDriver, bfr, sizeof(bfr), 1);
@@ -32,9 +34,33 @@ static int should_stop(void) {
 void cmd_accel(BaseSequentialStream *chp, int argc, char *argv[])
 {
 
-  (void)argv;
-  (void)argc;
   struct accel_data d;
+  const accel_stream_stats *stats;
+
+  if (argc > 0) {
+    if (!strcasecmp(argv[0], "start")) {
+      accelStreamStart();
+      chprintf(chp, "Accel streaming\r\n");
+    }
+    else if (!strcasecmp(argv[0], "stop")) {
+      accelStreamStop();
+      chprintf(chp, "Accel stream released\r\n");
+    }
+    else if (!strcasecmp(argv[0], "stats")) {
+      stats = accelStreamStats();
+      chprintf(chp, "Samples: %d\r\n", stats->samples);
+      chprintf(chp, "Errors:  %d\r\n", stats->errors);
+      chprintf(chp, "Gaps:    %d\r\n", stats->gaps);
+      chprintf(chp, "Events:  %d\r\n", stats->events);
+      chprintf(chp, "Dropped: %d\r\n", stats->dropped);
+    }
+    else {
+      chprintf(chp, "Usage: accel [start | stop | stats]\r\n");
+      chprintf(chp, "  with no arguments, prints samples until a key is pressed\r\n");
+    }
+    return;
+  }
+
   chprintf(chp, "\r\nPress any key to quit\r\n");
 
   while (!should_stop()) {
@@ -0,0 +1,40 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "orchard-app.h"
+#include "fxprof.h"
+
+#include <string.h>
+
+extern orchard_app_instance instance;
+
+static void cmd_apps(BaseSequentialStream *chp, int argc, char *argv[]) {
+  const orchard_app_stats *s = orchardAppStats();
+  const arena *a = &instance.state;
+
+  if( argc == 0 ) {
+    chprintf(chp, "Running %s\n\r", instance.app->name);
+    chprintf(chp, "%d switches, us: last %d  avg %d  max %d\n\r",
+             s->switches, FXPROF2US(s->last),
+             s->switches ? FXPROF2US(s->total / s->switches) : 0,
+             FXPROF2US(s->max));
+    chprintf(chp, "  worst old app exit %d us, new app start %d us\n\r",
+             FXPROF2US(s->exit_max), FXPROF2US(s->start_max));
+    chprintf(chp, "App arena: %d of %d bytes used, most %d\n\r",
+             a->used, a->size, a->peak);
+    chprintf(chp, "  %d allocations failed, %d apps didn't fit\n\r",
+             a->failed, s->overflows);
+  }
+  else if( !strcasecmp(argv[0], "reset") ) {
+    orchardAppResetStats();
+    chprintf(chp, "App stats cleared\n\r");
+  }
+  else {
+    chprintf(chp, "Usage: apps [reset]\n\r");
+    chprintf(chp, "  times app switches, from the request to the new app's start\n\r");
+  }
+}
+
+orchard_command("apps", cmd_apps);
@@ -26,6 +26,7 @@
 #include "orchard.h"
 #include "orchard-shell.h"
 #include "hex.h"
+#include "fxprof.h"
 
 #include "ble.h"
 #include "ble-service.h"
@@ -125,6 +126,34 @@ static void ble_test(BaseSequentialStream *chp, int argc, char *argv[]) {
   chprintf(chp, "%d\r\n", ret);
 }
 
+static void ble_stats(BaseSequentialStream *chp, int argc, char *argv[]) {
+
+  const ble_aci_stats *s = bleGetStats(bleDriver);
+  uint32_t ms;
+  uint32_t sent;
+
+  if (argc > 1 && !strcasecmp(argv[1], "reset")) {
+    bleResetStats(bleDriver);
+    chprintf(chp, "BLE stats cleared\r\n");
+    return;
+  }
+
+  ms = ST2MS(chVTTimeElapsedSinceX(s->since));
+  sent = s->commands + s->data;
+  chprintf(chp, "Over %d ms, %d credits left:\r\n", ms, bleCreditsAvailable(bleDriver));
+  chprintf(chp, "  sent      %d commands, %d data packets, %d data bytes (%d B/s)\r\n",
+           s->commands, s->data, s->data_bytes,
+           ms ? (uint32_t)((uint64_t)s->data_bytes * 1000 / ms) : 0);
+  chprintf(chp, "  received  %d events, %d bytes\r\n", s->events, s->rx_bytes);
+  chprintf(chp, "  streamed  %d writes into queued packets\r\n", s->streamed);
+  chprintf(chp, "  stalls    %d waits for credits, %d RDYN timeouts\r\n",
+           s->credit_stalls, s->timeouts);
+  chprintf(chp, "  queue     %d packets max\r\n", s->queue_max);
+  chprintf(chp, "  latency   %d us avg, %d us max queued, %d us max for RDYN\r\n",
+           sent ? FXPROF2US(s->latency_total / sent) : 0,
+           FXPROF2US(s->latency_max), FXPROF2US(s->rdy_max));
+}
+
 static void cmd_ble(BaseSequentialStream *chp, int argc, char *argv[])
 {
 
@@ -137,6 +166,7 @@ static void cmd_ble(BaseSequentialStream *chp, int argc, char *argv[])
     chprintf(chp, "   reset              Reset BLE radio completely\r\n");
     chprintf(chp, "   test               Run carrier wave test\r\n");
     chprintf(chp, "   bond [timeout] [interval]  Pair with something\r\n");
+    chprintf(chp, "   stats [reset]      Show transport throughput and latency\r\n");
     return;
   }
 
@@ -154,6 +184,8 @@ static void cmd_ble(BaseSequentialStream *chp, int argc, char *argv[])
     ble_bond(chp, argc, argv);
   else if (!strcasecmp(argv[0], "test"))
     ble_test(chp, argc, argv);
+  else if (!strcasecmp(argv[0], "stats"))
+    ble_stats(chp, argc, argv);
   else
     chprintf(chp, "Unrecognized BLE command\r\n");
 }
@@ -0,0 +1,38 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "dlog.h"
+
+#include <string.h>
+
+// One line per record, all hex: format address, time in ticks, arguments.
+// dlog-decode.py turns a capture of this back into text.
+static void cmd_dlog(BaseSequentialStream *chp, int argc, char *argv[]) {
+  const dlog_stats *s = dlogStats();
+  dlog_record r;
+  unsigned i;
+
+  if( argc == 0 ) {
+    chprintf(chp, "DLOG TICKS %d\n\r", CH_CFG_ST_FREQUENCY);
+    while( dlogRead(&r) ) {
+      chprintf(chp, "DLOG %lx %lx", (unsigned long) r.fmt, (unsigned long) r.time);
+      for( i = 0; i < r.nargs; i++ )
+        chprintf(chp, " %lx", (unsigned long) r.args[i]);
+      chprintf(chp, "\n\r");
+    }
+    chprintf(chp, "DLOG END written %d, dropped %d, most %d of %d words\n\r",
+             s->written, s->dropped, s->depth_max, DLOG_WORDS);
+  }
+  else if( !strcasecmp(argv[0], "clear") ) {
+    dlogClear();
+    dlogResetStats();
+    chprintf(chp, "Log cleared\n\r");
+  }
+  else {
+    chprintf(chp, "Usage: dlog [clear]\n\r");
+  }
+}
+
+orchard_command("dlog", cmd_dlog);
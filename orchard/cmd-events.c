@@ -0,0 +1,58 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "orchard-evq.h"
+#include "orchard-app.h"
+
+#include <string.h>
+
+static const char * const type_names[EVQ_TYPES] = {
+  [keyEvent] = "key",
+  [appEvent] = "app",
+  [timerEvent] = "timer",
+  [uiEvent] = "ui",
+  [adcEvent] = "adc",
+  [radioEvent] = "radio",
+  [accelEvent] = "accel",
+  [touchEvent] = "touch",
+};
+
+extern orchard_app_instance instance;
+
+static void cmd_events(BaseSequentialStream *chp, int argc, char *argv[]) {
+  const evq_stats *s = &app_evq.stats;
+  const dtimer *t;
+  unsigned i;
+
+  if( argc == 0 ) {
+    chprintf(chp, "App event queue: %d of %d waiting, most %d\n\r",
+             evqPending(&app_evq), EVQ_SIZE, s->depth_max);
+    chprintf(chp, "  posted %d  delivered %d  dropped %d\n\r",
+             s->posted, s->delivered, s->dropped);
+    chprintf(chp, "  %d batches, largest %d\n\r", s->batches, s->batch_max);
+    for( i = 0; i < EVQ_TYPES; i++ )
+      if( s->dropped_type[i] != 0 )
+        chprintf(chp, "  dropped %-5s %d\n\r", type_names[i], s->dropped_type[i]);
+
+    chprintf(chp, "timer  period us    fired  overruns  late max\n\r");
+    for( i = 0; i < ORCHARD_APP_TIMERS; i++ ) {
+      t = &instance.timers[i];
+      chprintf(chp, "%5d  %9d  %7d  %8d  %5d ms\n\r", i,
+               t->period ? t->usecs : 0, t->stats.fired, t->stats.overruns,
+               ST2MS(t->stats.late_max));
+    }
+  }
+  else if( !strcasecmp(argv[0], "reset") ) {
+    evqResetStats(&app_evq);
+    for( i = 0; i < ORCHARD_APP_TIMERS; i++ )
+      dtimerResetStats(&instance.timers[i]);
+    chprintf(chp, "Event stats cleared\n\r");
+  }
+  else {
+    chprintf(chp, "Usage: events [reset]\n\r");
+  }
+}
+
+orchard_command("events", cmd_events);
@@ -10,8 +10,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define FRIENDS_INIT_CREDIT 4
-
 void cmd_friendlist(BaseSequentialStream *chp, int argc, char *argv[])
 {
   (void)argv;
@@ -20,36 +18,29 @@ void cmd_friendlist(BaseSequentialStream *chp, int argc, char *argv[])
   int i;
   
   friends = friendsGet();
-  for(i = 0; i < MAX_FRIENDS; i++) {
-    if( friends[i] != NULL ) {
-      chprintf(chp, "%d: %d %s\n\r", i, (int) friends[i][0], &(friends[i][1]));
-    }
+  friendsLock();
+  for(i = 0; i < friendCount(); i++) {
+    chprintf(chp, "%d: %d %s\n\r", i, (int) friends[i][0], &(friends[i][1]));
   }
+  friendsUnlock();
 }
 
 orchard_command("friendlist", cmd_friendlist);
 
 void cmd_friendadd(BaseSequentialStream *chp, int argc, char *argv[]) {
-  char **friends;
-  uint32_t i;
+  const char *record;
 
-  if (argc != 2) {
-    chprintf(chp, "Usage: friendadd <index> <name>\r\n");
+  if (argc != 1) {
+    chprintf(chp, "Usage: friendadd <name>\r\n");
     return;
   }
-  friends = (char **)friendsGet();
-  
-  i = strtoul(argv[0], NULL, 0);
-  if( i > MAX_FRIENDS )
-    i = MAX_FRIENDS;
-   
-  if( friends[i] != NULL ) {
-    chprintf(chp, "Index used. Incrementing %s instead.\n\r", &(friends[i][1]));
-    friends[i][0]++;
-  } else {
-    friends[i] = (char *) chHeapAlloc(NULL, GENE_NAMELENGTH + 2); // space for NULL + metric byte
-    friends[i][0] = FRIENDS_INIT_CREDIT;
-    strncpy(&(friends[i][1]), argv[1], GENE_NAMELENGTH);
+
+  record = friend_lookup(argv[0]);
+  if( record != NULL ) {
+    chprintf(chp, "Already a friend. Incrementing %s instead.\n\r", &(record[1]));
+    friend_seen(argv[0]);
+  } else if( friend_add(argv[0]) == NULL ) {
+    chprintf(chp, "Friend list full.\n\r");
   }
 }
 orchard_command("friendadd", cmd_friendadd);
@@ -59,7 +50,7 @@ void cmd_friendping(BaseSequentialStream *chp, int argc, char *argv[]) {
   (void) argc;
   (void) argv;
 
-  chEvtBroadcast(&radio_app);
+  orchardAppRadioEvent(0, 0, 0);
 }
 orchard_command("friendping", cmd_friendping);
 
@@ -83,10 +74,8 @@ void cmd_friendsim(BaseSequentialStream *chp, int argc, char *argv[]) {
   
   while(!should_stop()) {
     i = rand() & 0xF; // maybe we should do it in-order to guarantee all addresses are pinged?
-    radioAcquire(radioDriver);
     radioSend(radioDriver, RADIO_BROADCAST_ADDRESS, radio_prot_ping,
 	      strlen(friendlist[i]) + 1, friendlist[i]);
-    radioRelease(radioDriver);
     chThdSleepMilliseconds((5000 + rand() % 2000) / 16); // simulate timeouts
   }
 }
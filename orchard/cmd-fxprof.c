@@ -0,0 +1,34 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "orchard-effects.h"
+#include "fxprof.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void cmd_fxprof(BaseSequentialStream *chp, int argc, char *argv[]) {
+
+  if( argc == 0 ) {
+    fxprofReport(chp, orchard_effects_start());
+    return;
+  }
+
+  if( !strcasecmp(argv[0], "reset") ) {
+    fxprofReset();
+    chprintf(chp, "Effect profile cleared\n\r");
+  }
+  else if( !strcasecmp(argv[0], "budget") && (argc == 2) ) {
+    fxprofSetBudget(US2FXPROF(strtoul(argv[1], NULL, 0)));
+    chprintf(chp, "Frame budget set to %d us\n\r", FXPROF2US(fxprofGetBudget()));
+  }
+  else {
+    chprintf(chp, "Usage: fxprof [reset | budget <us>]\n\r");
+    chprintf(chp, "  with no arguments, lists effect frame times, slowest first\n\r");
+    chprintf(chp, "  budget 0 turns off frame budget enforcement\n\r");
+  }
+}
+
+orchard_command("fxprof", cmd_fxprof);
@@ -0,0 +1,44 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "i2c-queue.h"
+#include "fxprof.h"
+
+#include <string.h>
+
+static const char * const prio_names[] = {
+  [i2cqPrioTelemetry] = "telem",
+  [i2cqPrioNormal] = "normal",
+  [i2cqPrioInput] = "input",
+};
+
+static void cmd_i2c(BaseSequentialStream *chp, int argc, char *argv[]) {
+  i2cq_device *dev;
+  const i2cq_stats *s;
+
+  if( argc == 0 ) {
+    chprintf(chp, "device     prio    xfers  merged  errs    bytes   bus us  max us  wait us\n\r");
+    for( dev = i2cqDevices(); dev != NULL; dev = dev->next ) {
+      s = &dev->stats;
+      chprintf(chp, "%-10s %-6s %6d  %6d  %4d  %7d  %7d  %6d  %7d\n\r",
+               dev->name, prio_names[dev->prio], s->transfers, s->coalesced,
+               s->errors, s->bytes,
+               FXPROF2US(s->bus_time),
+               FXPROF2US(s->bus_max), FXPROF2US(s->wait_max));
+    }
+    return;
+  }
+
+  if( !strcasecmp(argv[0], "reset") ) {
+    i2cqResetStats();
+    chprintf(chp, "I2C stats cleared\n\r");
+  }
+  else {
+    chprintf(chp, "Usage: i2c [reset]\n\r");
+    chprintf(chp, "  with no arguments, lists bus use per device\n\r");
+  }
+}
+
+orchard_command("i2c", cmd_i2c);
@@ -22,17 +22,21 @@
 
 void cmd_mem(BaseSequentialStream *chp, int argc, char *argv[])
 {
-  size_t n, size;
+  heap_stats_t stats;
 
   (void)argv;
   if (argc > 0) {
     chprintf(chp, "Usage: mem\r\n");
     return;
   }
-  n = chHeapStatus(NULL, &size);
+  chHeapStats(NULL, &stats);
   chprintf(chp, "core free memory : %u bytes\r\n", chCoreGetStatusX());
-  chprintf(chp, "heap fragments   : %u\r\n", n);
-  chprintf(chp, "heap free total  : %u bytes\r\n", size);
+  chprintf(chp, "heap fragments   : %u\r\n", stats.fragments);
+  chprintf(chp, "heap free total  : %u bytes\r\n", stats.free);
+  chprintf(chp, "heap largest     : %u bytes\r\n", stats.largest);
+  chprintf(chp, "heap used (peak) : %u (%u) bytes\r\n", stats.used, stats.peak);
+  chprintf(chp, "heap allocs      : %u, %u freed, %u failed\r\n",
+           stats.allocs, stats.frees, stats.failures);
 }
 
 orchard_command("mem", cmd_mem);
@@ -0,0 +1,43 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "analog.h"
+
+#include <string.h>
+
+static void cmd_mic(BaseSequentialStream *chp, int argc, char *argv[]) {
+  const analog_mic_stats *stats;
+  mic_features features;
+
+  if( argc == 0 ) {
+    stats = analogMicStats();
+    analogMicFeatures(&features);
+    chprintf(chp, "Blocks:   %d\n\r", stats->blocks);
+    chprintf(chp, "Overruns: %d\n\r", stats->overruns);
+    chprintf(chp, "Gaps:     %d\n\r", stats->gaps);
+    chprintf(chp, "Beats:    %d\n\r", stats->beats);
+    chprintf(chp, "Block %d: dc %d peak %d rms %d\n\r", features.seq,
+             features.dc, features.peak, features.rms);
+    chprintf(chp, "Bands:    low %d mid %d high %d, bass average %d\n\r",
+             features.bands[MIC_BAND_LOW], features.bands[MIC_BAND_MID],
+             features.bands[MIC_BAND_HIGH], features.beat_avg);
+    return;
+  }
+
+  if( !strcasecmp(argv[0], "start") ) {
+    analogMicStart();
+    chprintf(chp, "Mic streaming\n\r");
+  }
+  else if( !strcasecmp(argv[0], "stop") ) {
+    analogMicStop();
+    chprintf(chp, "Mic stream released\n\r");
+  }
+  else {
+    chprintf(chp, "Usage: mic [start | stop]\n\r");
+    chprintf(chp, "  with no arguments, prints stream stats and the newest block's features\n\r");
+  }
+}
+
+orchard_command("mic", cmd_mic);
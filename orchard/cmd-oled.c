@@ -0,0 +1,34 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "oled.h"
+
+#include <string.h>
+
+static void cmd_oled(BaseSequentialStream *chp, int argc, char *argv[]) {
+  const oled_frame_stats *s = oledStats();
+  uint32_t total;
+
+  if( argc == 0 ) {
+    total = s->bytes_sent + s->bytes_skipped;
+    chprintf(chp, "Flushes:  %d\n\r", s->flushes);
+    chprintf(chp, "Segments: %d\n\r", s->segments);
+    chprintf(chp, "Sent:     %d bytes\n\r", s->bytes_sent);
+    chprintf(chp, "Skipped:  %d bytes (%d%%)\n\r", s->bytes_skipped,
+             total ? (int)((uint64_t)s->bytes_skipped * 100 / total) : 0);
+    return;
+  }
+
+  if( !strcasecmp(argv[0], "reset") ) {
+    oledResetStats();
+    chprintf(chp, "OLED stats cleared\n\r");
+  }
+  else {
+    chprintf(chp, "Usage: oled [reset]\n\r");
+    chprintf(chp, "  with no arguments, shows what the flushes sent\n\r");
+  }
+}
+
+orchard_command("oled", cmd_oled);
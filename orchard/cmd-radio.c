@@ -27,6 +27,7 @@
 #include "orchard-shell.h"
 
 #include "radio.h"
+#include "radio-queue.h"
 #include "hex.h"
 
 static void radio_get(BaseSequentialStream *chp, int argc, char *argv[]) {
@@ -102,6 +103,32 @@ static void radio_addr(BaseSequentialStream *chp, int argc, char *argv[]) {
   chprintf(chp, "Set radio address to %d\r\n", addr);
 }
 
+static void radio_stats(BaseSequentialStream *chp, int argc, char *argv[]) {
+
+  const struct radio_rx_stats *stats = radioRxStats(radioDriver);
+  const struct radio_tx_stats *tx = radioTxStats(radioDriver);
+
+  (void)argc;
+  (void)argv;
+
+  chprintf(chp, "Received:   %d\r\n", stats->received);
+  chprintf(chp, "Dispatched: %d\r\n", stats->dispatched);
+  chprintf(chp, "Unhandled:  %d\r\n", stats->unhandled);
+  chprintf(chp, "Dropped:    %d (of %d buffers, at most %d waiting)\r\n",
+           stats->dropped, RADIO_RX_POOL_SIZE, stats->high_water);
+  chprintf(chp, "Malformed:  %d\r\n", stats->malformed);
+  chprintf(chp, "Overruns:   %d\r\n", stats->overruns);
+
+  chprintf(chp, "Sent:       %d (in %d batches, %d failed)\r\n",
+           tx->sent, tx->batches, tx->failed);
+  chprintf(chp, "Queue:      %d of %d at most, %d full\r\n",
+           tx->high_water, RADIO_TX_QUEUE_SIZE, tx->full);
+  if (tx->sent)
+    chprintf(chp, "Latency:    %d/%d/%d ms min/avg/max\r\n",
+             ST2MS(tx->latency_min), ST2MS(tx->latency_total / tx->sent),
+             ST2MS(tx->latency_max));
+}
+
 static void cmd_radio(BaseSequentialStream *chp, int argc, char *argv[]) {
 
   if (argc == 0) {
@@ -110,6 +137,7 @@ static void cmd_radio(BaseSequentialStream *chp, int argc, char *argv[]) {
     chprintf(chp, "   set [addr] [val]     Set a SPI register\r\n");
     chprintf(chp, "   dump [addr] [count]  Dump a set of SPI registers\r\n");
     chprintf(chp, "   addr [addr]          Set radio node address\r\n");
+    chprintf(chp, "   stats                Show receive and transmit queue counters\r\n");
     return;
   }
 
@@ -121,6 +149,8 @@ static void cmd_radio(BaseSequentialStream *chp, int argc, char *argv[]) {
     radio_dump(chp, argc, argv);
   else if (!strcasecmp(argv[0], "addr"))
     radio_addr(chp, argc, argv);
+  else if (!strcasecmp(argv[0], "stats"))
+    radio_stats(chp, argc, argv);
   else
     chprintf(chp, "Unrecognized radio command\r\n");
 }
@@ -141,9 +171,7 @@ static void cmd_msg(BaseSequentialStream *chp, int argc, char *argv[]) {
   addr = strtoul(argv[0], NULL, 0);
   chprintf(chp, "Sending '%s' to address %d\r\n", argv[1], addr);
   while(1) {
-    radioAcquire(radioDriver);
     radioSend(radioDriver, addr, 0, strlen(argv[1]) + 1, argv[1]);
-    radioRelease(radioDriver);
   }
 }
 orchard_command("msg", cmd_msg);
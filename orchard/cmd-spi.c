@@ -0,0 +1,66 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "spi-arbiter.h"
+#include "fxprof.h"
+
+#include <string.h>
+
+static const char * const prio_names[] = {
+  [spiarbPrioDisplay] = "disp",
+  [spiarbPrioNormal] = "normal",
+  [spiarbPrioRadio] = "radio",
+};
+
+static void print_hist(BaseSequentialStream *chp, const char *what,
+                       const uint32_t *hist) {
+  unsigned i;
+
+  chprintf(chp, "  %-5s", what);
+  for( i = 0; i < SPIARB_HIST_BUCKETS; i++ )
+    chprintf(chp, " %5d", hist[i]);
+  chprintf(chp, "\n\r");
+}
+
+static void cmd_spi(BaseSequentialStream *chp, int argc, char *argv[]) {
+  spiarb_device *dev;
+  const spiarb_stats *s;
+  unsigned i;
+
+  if( argc == 0 ) {
+    chprintf(chp, "device     prio      got  waited  yields    hold us  max us  wait max\n\r");
+    for( dev = spiarbDevices(); dev != NULL; dev = dev->next ) {
+      s = &dev->stats;
+      chprintf(chp, "%-10s %-6s %6d  %6d  %6d  %9d  %6d  %8d\n\r",
+               dev->name, prio_names[dev->prio], s->acquired, s->contended,
+               s->yielded, FXPROF2US(s->hold_time),
+               FXPROF2US(s->hold_max), FXPROF2US(s->wait_max));
+    }
+    return;
+  }
+
+  if( !strcasecmp(argv[0], "hist") ) {
+    chprintf(chp, "us     ");
+    for( i = 0; i < SPIARB_HIST_BUCKETS; i++ )
+      chprintf(chp, " %5d", i == 0 ? 0 : 1 << i);
+    chprintf(chp, "\n\r");
+    for( dev = spiarbDevices(); dev != NULL; dev = dev->next ) {
+      chprintf(chp, "%s\n\r", dev->name);
+      print_hist(chp, "wait", dev->stats.wait_hist);
+      print_hist(chp, "hold", dev->stats.hold_hist);
+    }
+  }
+  else if( !strcasecmp(argv[0], "reset") ) {
+    spiarbResetStats();
+    chprintf(chp, "SPI stats cleared\n\r");
+  }
+  else {
+    chprintf(chp, "Usage: spi [hist|reset]\n\r");
+    chprintf(chp, "  with no arguments, lists bus use per device\n\r");
+    chprintf(chp, "  hist: wait and hold times, from the listed us up\n\r");
+  }
+}
+
+orchard_command("spi", cmd_spi);
@@ -36,6 +36,7 @@ void cmd_storage_test(BaseSequentialStream *chp, int argc, char *argv[]) {
 
   // testing routines for storage, this will erase all memory to start from a known state
   flashErase(F_USER_SECTOR_START, SECTOR_COUNT);
+  storageStart();
 
   chprintf( chp, "Test 0: basic store and fetch\n\r" );
   // test getting data sector on an empty FS
@@ -134,7 +135,7 @@ void cmd_storage_test(BaseSequentialStream *chp, int argc, char *argv[]) {
       return;
     }
   }
-  for( i = 4; i < (BLOCK_SIZE / sizeof(uint32_t)) - sizeof(orfs_head) / sizeof(uint32_t) + 1; i++ ) {
+  for( i = 4; i < storageGetSize(block) / sizeof(uint32_t); i++ ) {
     if( data[i] != 0xFFFFFFFF ) {
       chprintf( chp, "FAIL: test5: original data disturbed, blank area isn't blank\n\r" );
       chprintf( chp, "  index: %d, data: %x\n\r", i, data[i] );
@@ -224,5 +225,23 @@ void cmd_storage_test2(BaseSequentialStream *chp, int argc, char *argv[]) {
 }
 orchard_command("storetest2", cmd_storage_test2);
 
+void cmd_storage_stat(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void) argc;
+  (void) argv;
+
+  const orfs_stats *stats = storageGetStats();
+  uint32_t i;
+
+  chprintf( chp, "lookups: %d, index builds: %d, header reads: %d\r\n",
+	    stats->lookups, stats->indexBuilds, stats->headerReads );
+  chprintf( chp, "record appends: %d, relocations: %d, erases: %d\r\n",
+	    stats->appends, stats->relocations, stats->erases );
+  chprintf( chp, "erases per sector:" );
+  for( i = 0; i < SECTOR_COUNT; i++ )
+    chprintf( chp, " %d", stats->sectorErases[i] );
+  chprintf( chp, "\r\n" );
+}
+orchard_command("storestat", cmd_storage_stat);
+
 // to blank memory after the tests, use:
 // flasherase 120,8, this will blank the whole user memory area to a virgin state
@@ -0,0 +1,87 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard.h"
+#include "orchard-shell.h"
+#include "fxprof.h"
+#include "trace.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#if CH_DBG_ENABLE_TRACE
+
+#define TRACE_PACKET    255
+
+// Streams the trace buffer for ms milliseconds, see trace.h for the format.
+// The stream itself shows up in the trace: the shell thread waking up and
+// the UART interrupts of sending the packets.
+static void cmd_trace(BaseSequentialStream *chp, int argc, char *argv[]) {
+  uint8_t packet[2 + TRACE_PACKET];
+  ch_trace_event_t e;
+  trace_encoder enc;
+  systime_t start, duration;
+  uint32_t mask, old_mask, lost;
+  thread_t *tp;
+  size_t n;
+
+  if( argc < 1 ) {
+    chprintf(chp, "Usage: trace <ms> [isr]\n\r");
+    return;
+  }
+  duration = MS2ST(strtoul(argv[0], NULL, 0));
+
+  // ISRs come at least once per tick, only when asked for
+  mask = CH_TRACE_MASK_ALL;
+  if( (argc < 2) || strcasecmp(argv[1], "isr") )
+    mask &= ~(CH_TRACE_MASK(CH_TRACE_TYPE_ISR_ENTER) |
+              CH_TRACE_MASK(CH_TRACE_TYPE_ISR_LEAVE));
+
+  chprintf(chp, "TRACE START %d\n\r", FXPROF_FREQUENCY);
+  tp = chRegFirstThread();
+  do {
+    chprintf(chp, "TRACE THREAD %lx %s\n\r", (uint32_t)tp, tp->p_name);
+    tp = chRegNextThread(tp);
+  } while( tp != NULL );
+
+  // the records from before the start would come out with no threads
+  // running in between
+  chSysLock();
+  old_mask = ch.dbg.trace_buffer.tb_mask;
+  while( chDbgTraceReadI(&e) )
+    ;
+  ch.dbg.trace_buffer.tb_mask = mask;
+  lost = ch.dbg.trace_buffer.tb_lost;
+  chSysUnlock();
+
+  traceEncoderInit(&enc);
+  packet[0] = TRACE_SYNC;
+  start = chVTGetSystemTime();
+  while( (chVTGetSystemTime() - start) < duration ) {
+    n = 0;
+    chSysLock();
+    while( (n + TRACE_RECORD_MAX <= TRACE_PACKET) && chDbgTraceReadI(&e) )
+      n += traceEncode(&enc, &e, packet + 2 + n);
+    chSysUnlock();
+
+    if( n == 0 ) {
+      chThdSleepMilliseconds(5);
+      continue;
+    }
+    packet[1] = n;
+    chSequentialStreamWrite(chp, packet, 2 + n);
+  }
+
+  chSysLock();
+  ch.dbg.trace_buffer.tb_mask = old_mask;
+  lost = ch.dbg.trace_buffer.tb_lost - lost;
+  chSysUnlock();
+
+  packet[1] = 0;
+  chSequentialStreamWrite(chp, packet, 2);
+  chprintf(chp, "\n\rTRACE END lost %d\n\r", lost);
+}
+
+orchard_command("trace", cmd_trace);
+
+#endif /* CH_DBG_ENABLE_TRACE */
@@ -0,0 +1,104 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "deadline-timer.h"
+
+#include <string.h>
+
+static void dtimer_post(dtimer *t) {
+  OrchardAppEvent evt;
+
+  if( t->pending ) {
+    t->missed++;
+    t->stats.overruns++;
+    return;
+  }
+
+  memset(&evt, 0, sizeof(evt));
+  evt.type = timerEvent;
+  evt.timer.usecs = t->usecs;
+  evt.timer.id = t->id;
+  evt.timer.overruns = t->missed;
+  if( !evqPostI(t->q, &evt) ) {
+    t->missed++;
+    t->stats.overruns++;
+    return;
+  }
+  t->pending = true;
+  t->missed = 0;
+  t->stats.fired++;
+}
+
+static void dtimer_expired(void *arg) {
+  dtimer *t = arg;
+  systime_t now, late, delay, skipped;
+
+  chSysLockFromISR();
+  now = chVTGetSystemTimeX();
+  late = now - t->deadline;
+  if( late > t->stats.late_max )
+    t->stats.late_max = late;
+
+  dtimer_post(t);
+
+  if( t->period != 0 ) {
+    // from the deadline, not from now, so a late callback doesn't shift the
+    // ones after it; whole periods that went by meanwhile are overruns
+    t->deadline += t->period;
+    delay = t->deadline - now;
+    if( (delay == 0) || (delay > t->period) ) {
+      skipped = (now - t->deadline) / t->period + 1;
+      t->deadline += skipped * t->period;
+      t->missed += skipped;
+      t->stats.overruns += skipped;
+      delay = t->deadline - now;
+    }
+    chVTSetI(&t->vt, delay, dtimer_expired, t);
+  }
+  chSysUnlockFromISR();
+}
+
+void dtimerInit(dtimer *t, orchard_evq *q, uint8_t id) {
+  memset(t, 0, sizeof(*t));
+  chVTObjectInit(&t->vt);
+  t->q = q;
+  t->id = id;
+}
+
+void dtimerStart(dtimer *t, uint32_t usecs, bool repeating) {
+  systime_t delay;
+
+  if( usecs == 0 ) {
+    dtimerStop(t);
+    return;
+  }
+
+  // same rounding as a plain chVTSet() of usecs
+  delay = US2ST(usecs);
+  if( delay == 0 )
+    delay = 1;
+
+  chSysLock();
+  chVTResetI(&t->vt);
+  t->usecs = usecs;
+  t->period = repeating ? delay : 0;
+  t->deadline = chVTGetSystemTimeX() + delay;
+  t->missed = 0;
+  chVTSetI(&t->vt, delay, dtimer_expired, t);
+  chSysUnlock();
+}
+
+void dtimerStop(dtimer *t) {
+  chSysLock();
+  chVTResetI(&t->vt);
+  t->usecs = 0;
+  t->period = 0;
+  t->pending = false;
+  chSysUnlock();
+}
+
+void dtimerResetStats(dtimer *t) {
+  chSysLock();
+  memset(&t->stats, 0, sizeof(t->stats));
+  chSysUnlock();
+}
@@ -0,0 +1,57 @@
+#ifndef __DEADLINE_TIMER_H__
+#define __DEADLINE_TIMER_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard-evq.h"
+
+// Timers that post timerEvent records to an event queue. A repeating timer
+// keeps its own schedule: each deadline is the previous one plus the
+// period, set again from the timer callback, so neither the time the event
+// spends in the queue nor the time the handler takes pushes the next one
+// back.
+//
+// A deadline that comes while the event of the previous one is still
+// waiting or being handled is an overrun. It isn't posted, so a slow
+// handler gets the frames it can take instead of a backlog; the next event
+// says how many were skipped.
+
+typedef struct dtimer_stats {
+  uint32_t      fired;      // events posted
+  uint32_t      overruns;   // deadlines skipped
+  systime_t     late_max;   // most ticks a callback ran past its deadline
+} dtimer_stats;
+
+typedef struct dtimer {
+  virtual_timer_t     vt;
+  orchard_evq         *q;
+  uint8_t             id;
+  uint32_t            usecs;      // 0 when stopped
+  systime_t           period;     // ticks, 0 for a one-shot
+  systime_t           deadline;
+  volatile bool       pending;    // posted and not handled yet
+  uint16_t            missed;     // overruns since the last event
+  dtimer_stats        stats;
+} dtimer;
+
+void dtimerInit(dtimer *t, orchard_evq *q, uint8_t id);
+
+// (Re)starts the timer, the first deadline is usecs from now. A usecs of 0
+// stops it.
+void dtimerStart(dtimer *t, uint32_t usecs, bool repeating);
+void dtimerStop(dtimer *t);
+
+// Reader: the event of this timer was handled, the next one may be posted.
+static inline void dtimerDone(dtimer *t) {
+  t->pending = false;
+}
+
+// Reader: false if the timer was stopped after the event was posted.
+static inline bool dtimerRunning(const dtimer *t) {
+  return t->usecs != 0;
+}
+
+void dtimerResetStats(dtimer *t);
+
+#endif /* __DEADLINE_TIMER_H__ */
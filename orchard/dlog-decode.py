@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+#
+# Expands the records of the deferred log (see dlog.h) captured from the
+# "dlog" shell command. The format strings, and the strings passed for %s,
+# are read out of the ELF file the badge was flashed with.
+#
+#   ./dlog-decode.py build/orchard.elf capture.txt
+#
+# Lines of the capture that aren't DLOG records are skipped, so a whole
+# terminal log can be fed in. Reads stdin if no capture is given.
+
+import sys
+
+from elf import Elf
+
+
+def to_signed(value, bits):
+    value &= (1 << bits) - 1
+    if value & (1 << (bits - 1)):
+        value -= 1 << bits
+    return value
+
+
+def expand(elf, fmt, args):
+    # the subset of chprintf(): [-][0][width][.precision][l]conversion
+    out = []
+    args = list(args)
+    i = 0
+    while i < len(fmt):
+        c = fmt[i]
+        i += 1
+        if c != '%':
+            out.append(c)
+            continue
+        left = fmt.startswith('-', i)
+        if left:
+            i += 1
+        filler = ' '
+        if fmt.startswith('0', i):
+            filler = '0'
+            i += 1
+        width = 0
+        while i < len(fmt) and fmt[i].isdigit():
+            width = width * 10 + int(fmt[i])
+            i += 1
+        precision = 0
+        if fmt.startswith('.', i):
+            i += 1
+            while i < len(fmt) and fmt[i].isdigit():
+                precision = precision * 10 + int(fmt[i])
+                i += 1
+        if fmt.startswith(('l', 'L'), i):
+            i += 1
+        if i >= len(fmt):
+            break
+        conv = fmt[i]
+        i += 1
+
+        if conv in 'cCsSdDiIuUxXoO' and not args:
+            text = '<?>'
+        elif conv in 'cC':
+            text = chr(args.pop(0) & 0xff)
+            filler = ' '
+        elif conv in 'sS':
+            addr = args.pop(0)
+            s = elf.string(addr) if addr else '(null)'
+            text = s if s is not None else '<%x>' % addr
+            if precision:
+                text = text[:precision]
+            filler = ' '
+        elif conv in 'dDiI':
+            text = str(to_signed(args.pop(0), 32))
+        elif conv in 'uU':
+            text = str(args.pop(0) & 0xffffffff)
+        elif conv in 'xX':
+            text = '%X' % (args.pop(0) & 0xffffffff)
+        elif conv in 'oO':
+            text = '%o' % (args.pop(0) & 0xffffffff)
+        else:
+            text = conv
+
+        if len(text) < width:
+            pad = filler * (width - len(text))
+            if left:
+                text = text + ' ' * (width - len(text))
+            elif filler == '0' and text.startswith('-'):
+                text = '-' + pad + text[1:]
+            else:
+                text = pad + text
+        out.append(text)
+    return ''.join(out)
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.stderr.write('usage: %s orchard.elf [capture]\n' % sys.argv[0])
+        return 1
+    elf = Elf(sys.argv[1])
+    capture = open(sys.argv[2], errors='replace') if len(sys.argv) == 3 \
+        else sys.stdin
+
+    ticks = 1000
+    for line in capture:
+        words = line.split()
+        if 'DLOG' not in words:
+            continue
+        words = words[words.index('DLOG') + 1:]
+        if not words:
+            continue
+        if words[0] == 'TICKS':
+            ticks = int(words[1])
+            continue
+        if words[0] == 'END':
+            print('-- ' + ' '.join(words[1:]))
+            continue
+        try:
+            values = [int(w, 16) for w in words]
+        except ValueError:
+            continue
+        if len(values) < 2:
+            continue
+        fmt = elf.string(values[0])
+        if fmt is None:
+            text = '<format at %x> %s' % (values[0], ' '.join(words[2:]))
+        else:
+            text = expand(elf, fmt, values[2:]).rstrip('\r\n')
+        print('%10.3f  %s' % (values[1] / ticks, text))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,102 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "dlog.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+// A record is the format pointer, then the time shifted left by 3 with the
+// argument count in the low bits (so the time wraps 8 times as often as
+// systime_t does), then the arguments.
+#define DLOG_HEADER     2
+
+static struct {
+  dlog_word_t   ring[DLOG_WORDS];
+  uint32_t      head;       // next word to write
+  uint32_t      tail;       // first word of the oldest record
+  dlog_stats    stats;
+} dlog_buf;
+
+static void dlog_vwrite(unsigned n, va_list ap) {
+  uint32_t used;
+  unsigned i;
+
+  chDbgCheckClassI();
+
+  if( n > DLOG_MAX_ARGS )
+    n = DLOG_MAX_ARGS;
+
+  used = dlog_buf.head - dlog_buf.tail;
+  if( used + DLOG_HEADER + n > DLOG_WORDS ) {
+    dlog_buf.stats.dropped++;
+    return;
+  }
+
+  dlog_buf.ring[dlog_buf.head++ & (DLOG_WORDS - 1)] = va_arg(ap, dlog_word_t);
+  dlog_buf.ring[dlog_buf.head++ & (DLOG_WORDS - 1)] =
+    ((dlog_word_t) chVTGetSystemTimeX() << 3) | n;
+  for( i = 0; i < n; i++ )
+    dlog_buf.ring[dlog_buf.head++ & (DLOG_WORDS - 1)] = va_arg(ap, dlog_word_t);
+
+  dlog_buf.stats.written++;
+  used += DLOG_HEADER + n;
+  if( used > dlog_buf.stats.depth_max )
+    dlog_buf.stats.depth_max = used;
+}
+
+void dlogWriteI(unsigned n, ...) {
+  va_list ap;
+
+  va_start(ap, n);
+  dlog_vwrite(n, ap);
+  va_end(ap);
+}
+
+void dlogWrite(unsigned n, ...) {
+  va_list ap;
+
+  va_start(ap, n);
+  chSysLock();
+  dlog_vwrite(n, ap);
+  chSysUnlock();
+  va_end(ap);
+}
+
+bool dlogRead(dlog_record *r) {
+  dlog_word_t w;
+  unsigned i;
+
+  chSysLock();
+  if( dlog_buf.tail == dlog_buf.head ) {
+    chSysUnlock();
+    return false;
+  }
+
+  r->fmt = (const char *) dlog_buf.ring[dlog_buf.tail++ & (DLOG_WORDS - 1)];
+  w = dlog_buf.ring[dlog_buf.tail++ & (DLOG_WORDS - 1)];
+  r->time = (systime_t) (w >> 3);
+  r->nargs = w & 7;
+  for( i = 0; i < r->nargs; i++ )
+    r->args[i] = dlog_buf.ring[dlog_buf.tail++ & (DLOG_WORDS - 1)];
+  dlog_buf.stats.read++;
+  chSysUnlock();
+
+  return true;
+}
+
+void dlogClear(void) {
+  chSysLock();
+  dlog_buf.tail = dlog_buf.head;
+  chSysUnlock();
+}
+
+const dlog_stats *dlogStats(void) {
+  return &dlog_buf.stats;
+}
+
+void dlogResetStats(void) {
+  chSysLock();
+  memset(&dlog_buf.stats, 0, sizeof(dlog_buf.stats));
+  chSysUnlock();
+}
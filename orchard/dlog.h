@@ -0,0 +1,69 @@
+#ifndef __DLOG_H__
+#define __DLOG_H__
+
+#include "ch.h"
+#include "hal.h"
+
+// Deferred-format log. dlog() doesn't format anything: it stores the
+// address of the format string and its arguments, each as one word, in a
+// ring. The "dlog" shell command dumps the records as hex, and
+// dlog-decode.py expands them on the host, reading the format strings out
+// of the ELF the badge runs. Cheap enough to leave in the storage and radio
+// paths, where a chprintf() would stall on the serial queue.
+//
+// Every argument is saved as a word, so %s only makes sense for strings
+// that stay where they are (constants in flash), and %f isn't supported.
+// When the ring is full new records are dropped and counted.
+
+#ifndef DLOG_WORDS
+#define DLOG_WORDS      64    // ring size, power of two
+#endif
+#define DLOG_MAX_ARGS   6
+
+typedef uintptr_t dlog_word_t;
+
+typedef struct dlog_record {
+  const char    *fmt;
+  systime_t     time;
+  unsigned      nargs;
+  dlog_word_t   args[DLOG_MAX_ARGS];
+} dlog_record;
+
+typedef struct dlog_stats {
+  uint32_t      written;
+  uint32_t      read;
+  uint32_t      dropped;      // records that didn't fit
+  uint32_t      depth_max;    // most words in use at once
+} dlog_stats;
+
+// n arguments follow the format string, all of them dlog_word_t
+void dlogWriteI(unsigned n, ...);
+void dlogWrite(unsigned n, ...);
+
+// Oldest record into r; false if there's none.
+bool dlogRead(dlog_record *r);
+
+void dlogClear(void);
+const dlog_stats *dlogStats(void);
+void dlogResetStats(void);
+
+// dlog(fmt, args...) and dlogI() from a locked context, up to DLOG_MAX_ARGS
+// arguments after the format.
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define DLOG_NARGS(...) DLOG_NARGS_(__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0, x)
+#define DLOG_W(a) ((dlog_word_t) (a))
+#define DLOG_C0(f) DLOG_W(f)
+#define DLOG_C1(f, a) DLOG_C0(f), DLOG_W(a)
+#define DLOG_C2(f, a, ...) DLOG_C0(f), DLOG_C1(a, __VA_ARGS__)
+#define DLOG_C3(f, a, ...) DLOG_C0(f), DLOG_C2(a, __VA_ARGS__)
+#define DLOG_C4(f, a, ...) DLOG_C0(f), DLOG_C3(a, __VA_ARGS__)
+#define DLOG_C5(f, a, ...) DLOG_C0(f), DLOG_C4(a, __VA_ARGS__)
+#define DLOG_C6(f, a, ...) DLOG_C0(f), DLOG_C5(a, __VA_ARGS__)
+#define DLOG_CAT_(a, b) a ## b
+#define DLOG_CAT(a, b) DLOG_CAT_(a, b)
+#define DLOG_CAST(...) DLOG_CAT(DLOG_C, DLOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+#define dlog(...) dlogWrite(DLOG_NARGS(__VA_ARGS__), DLOG_CAST(__VA_ARGS__))
+#define dlogI(...) dlogWriteI(DLOG_NARGS(__VA_ARGS__), DLOG_CAST(__VA_ARGS__))
+
+#endif /* __DLOG_H__ */
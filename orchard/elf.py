@@ -0,0 +1,75 @@
+# Minimal ELF reader for the host scripts: loaded section contents and the
+# symbol table, for 32 and 64 bit little endian files (the badge firmware
+# and the host test build).
+
+import struct
+
+SHF_ALLOC = 0x2
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+STT_OBJECT = 1
+STT_FUNC = 2
+
+
+class Elf:
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF':
+            raise ValueError('%s: not an ELF file' % path)
+        self.wide = self.data[4] == 2
+        self.word = 8 if self.wide else 4
+        if self.wide:
+            shoff, = struct.unpack_from('<Q', self.data, 0x28)
+            shentsize, shnum = struct.unpack_from('<HH', self.data, 0x3a)
+        else:
+            shoff, = struct.unpack_from('<I', self.data, 0x20)
+            shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2e)
+
+        headers = []
+        for i in range(shnum):
+            off = shoff + i * shentsize
+            if self.wide:
+                _, typ, flags, addr, offset, size, link, _, _, entsize = \
+                    struct.unpack_from('<IIQQQQIIQQ', self.data, off)
+            else:
+                _, typ, flags, addr, offset, size, link, _, _, entsize = \
+                    struct.unpack_from('<IIIIIIIIII', self.data, off)
+            headers.append((typ, flags, addr, offset, size, link, entsize))
+
+        # loaded sections with contents, as (address, size, file offset)
+        self.sections = []
+        for typ, flags, addr, offset, size, _, _ in headers:
+            if flags & SHF_ALLOC and typ != SHT_NOBITS and addr != 0:
+                self.sections.append((addr, size, offset))
+
+        # functions and data objects, as address: name
+        self.symbols = {}
+        for typ, _, _, offset, size, link, entsize in headers:
+            if typ != SHT_SYMTAB or entsize == 0:
+                continue
+            strtab = headers[link][3]
+            for off in range(offset, offset + size, entsize):
+                if self.wide:
+                    name, info, _, _, value, _ = \
+                        struct.unpack_from('<IBBHQQ', self.data, off)
+                else:
+                    name, value, _, info, _, _ = \
+                        struct.unpack_from('<IIIBBH', self.data, off)
+                if (info & 0xf) not in (STT_OBJECT, STT_FUNC) or value == 0:
+                    continue
+                end = self.data.index(b'\0', strtab + name)
+                # Thumb functions have bit 0 set
+                self.symbols.setdefault(value & ~1, self.data[strtab + name:end]
+                                        .decode('latin-1'))
+
+    def string(self, addr):
+        for base, size, offset in self.sections:
+            if base <= addr < base + size:
+                start = offset + addr - base
+                end = self.data.index(b'\0', start, offset + size)
+                return self.data[start:end].decode('latin-1')
+        return None
+
+    def symbol(self, addr):
+        return self.symbols.get(addr & ~1)
@@ -0,0 +1,219 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "friends.h"
+
+#include <string.h>
+
+#define HASH_EMPTY  0xFF
+#define HASH_MASK   (FRIENDS_HASH_SIZE - 1)
+
+static char slab[MAX_FRIENDS][FRIEND_RECORD_SIZE]; // credit 0 marks a free record
+static uint32_t hashes[MAX_FRIENDS];     // name hash of every record in use
+static uint8_t table[FRIENDS_HASH_SIZE]; // slab index, or HASH_EMPTY
+static char *order[MAX_FRIENDS];         // records in display order, count of them used
+static uint8_t pos[MAX_FRIENDS];         // where each record sits in order[]
+static uint8_t free_list[MAX_FRIENDS];
+static uint8_t free_count;
+static uint8_t count;
+static mutex_t friend_mutex;
+
+static uint32_t name_hash(const char *name) {
+  uint32_t h = 2166136261U;   // FNV-1a
+  uint32_t i;
+
+  for( i = 0; (i < GENE_NAMELENGTH) && (name[i] != '\0'); i++ ) {
+    h ^= (uint8_t) name[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+static inline uint8_t record_index(const char *record) {
+  return (uint8_t) ((record - &slab[0][0]) / FRIEND_RECORD_SIZE);
+}
+
+// table bucket holding name, or the empty bucket where it would go
+static uint32_t find_bucket(const char *name, uint32_t h) {
+  uint32_t b = h & HASH_MASK;
+  uint8_t idx;
+
+  while( (idx = table[b]) != HASH_EMPTY ) {
+    if( (hashes[idx] == h) &&
+        (strncmp(&slab[idx][1], name, GENE_NAMELENGTH) == 0) )
+      break;
+    b = (b + 1) & HASH_MASK;
+  }
+  return b;
+}
+
+// backward shift delete, so linear probing never needs tombstones
+static void unhash(uint32_t b) {
+  uint32_t next = b;
+  uint32_t home;
+
+  for(;;) {
+    next = (next + 1) & HASH_MASK;
+    if( table[next] == HASH_EMPTY )
+      break;
+    home = hashes[table[next]] & HASH_MASK;
+    // move the entry back unless its home lies cyclically in (b, next]
+    if( ((next - home) & HASH_MASK) >= ((next - b) & HASH_MASK) ) {
+      table[b] = table[next];
+      b = next;
+    }
+  }
+  table[b] = HASH_EMPTY;
+}
+
+void friendsInit(void) {
+  uint32_t i;
+
+  memset(slab, 0, sizeof(slab));
+  memset(table, HASH_EMPTY, sizeof(table));
+  for( i = 0; i < MAX_FRIENDS; i++ ) {
+    order[i] = NULL;
+    free_list[i] = (uint8_t) (MAX_FRIENDS - 1 - i);
+  }
+  free_count = MAX_FRIENDS;
+  count = 0;
+  osalMutexObjectInit(&friend_mutex);
+}
+
+char *friend_lookup(const char *name) {
+  uint8_t idx;
+
+  osalMutexLock(&friend_mutex);
+  idx = table[find_bucket(name, name_hash(name))];
+  osalMutexUnlock(&friend_mutex);
+
+  return idx == HASH_EMPTY ? NULL : slab[idx];
+}
+
+// call with friend_mutex held
+static char *add_locked(const char *name) {
+  uint32_t h = name_hash(name);
+  uint32_t b = find_bucket(name, h);
+  uint8_t idx;
+  char *record;
+
+  if( table[b] != HASH_EMPTY )
+    return slab[table[b]];  // friend already exists, don't add it again
+
+  // if the slab is full, we can't add the friend
+  if( free_count == 0 )
+    return NULL;
+
+  idx = free_list[--free_count];
+  record = slab[idx];
+  record[0] = FRIENDS_INIT_CREDIT;
+  strncpy(&record[1], name, GENE_NAMELENGTH);
+  record[GENE_NAMELENGTH + 1] = '\0';
+  hashes[idx] = h;
+  table[b] = idx;
+
+  pos[idx] = count;
+  order[count++] = record;
+  return record;
+}
+
+char *friend_add(const char *name) {
+  char *record;
+
+  osalMutexLock(&friend_mutex);
+  record = add_locked(name);
+  osalMutexUnlock(&friend_mutex);
+
+  return record;
+}
+
+char *friend_seen(const char *name) {
+  char *record;
+
+  osalMutexLock(&friend_mutex);
+  record = add_locked(name);
+  if( (record != NULL) && (record[0] < FRIENDS_MAX_CREDIT) )
+    record[0]++;
+  osalMutexUnlock(&friend_mutex);
+
+  return record;
+}
+
+// call with friend_mutex held
+static void remove_locked(uint8_t idx) {
+  uint32_t i;
+
+  unhash(find_bucket(&slab[idx][1], hashes[idx]));
+
+  // close up the display order behind the record
+  for( i = pos[idx]; i + 1 < count; i++ ) {
+    order[i] = order[i + 1];
+    pos[record_index(order[i])] = (uint8_t) i;
+  }
+  order[--count] = NULL;
+
+  slab[idx][0] = 0;
+  free_list[free_count++] = idx;
+}
+
+// to be called periodically to decrement credits and de-alloc friends we haven't seen in a while
+void friend_cleanup(void) {
+  uint32_t i;
+
+  osalMutexLock(&friend_mutex);
+  for( i = 0; i < MAX_FRIENDS; i++ ) {
+    if( slab[i][0] == 0 )
+      continue;
+
+    slab[i][0]--;
+    if( slab[i][0] == 0 )
+      remove_locked((uint8_t) i);
+  }
+  osalMutexUnlock(&friend_mutex);
+}
+
+static int friend_comp(const char *a, const char *b) {
+  if( (a[0] != b[0]) &&
+      ((a[0] < (FRIENDS_MAX_CREDIT - FRIENDS_SORT_HYSTERESIS)) ||
+       (b[0] < (FRIENDS_MAX_CREDIT - FRIENDS_SORT_HYSTERESIS))) ) {
+    return a[0] > b[0] ? -1 : 1;
+  } else {
+    // sort alphabetically from here
+    return strncmp(&a[1], &b[1], GENE_NAMELENGTH + 1);
+  }
+}
+
+// insertion sort: the order is kept from one sort to the next, so only the
+// few records whose credit changed since move, in about count compares
+void friendsSort(void) {
+  uint32_t i, j;
+  char *record;
+
+  osalMutexLock(&friend_mutex);
+  for( i = 1; i < count; i++ ) {
+    record = order[i];
+    for( j = i; (j > 0) && (friend_comp(order[j - 1], record) > 0); j-- ) {
+      order[j] = order[j - 1];
+      pos[record_index(order[j])] = (uint8_t) j;
+    }
+    order[j] = record;
+    pos[record_index(record)] = (uint8_t) j;
+  }
+  osalMutexUnlock(&friend_mutex);
+}
+
+void friendsLock(void) {
+  osalMutexLock(&friend_mutex);
+}
+
+void friendsUnlock(void) {
+  osalMutexUnlock(&friend_mutex);
+}
+
+const char **friendsGet(void) {
+  return (const char **) order;   // you shouldn't modify this record outside of here, hence const
+}
+
+uint8_t friendCount(void) {
+  return count;
+}
@@ -0,0 +1,48 @@
+#ifndef __ORCHARD_FRIENDS_H__
+#define __ORCHARD_FRIENDS_H__
+
+#include "ch.h"
+#include "hal.h"
+#include "genes.h"
+
+// Friend records live in a fixed slab instead of on the heap, and are found
+// by name through an open addressing hash table, so a ping costs one hash and
+// usually a single strncmp however many badges are around.
+//
+// Every record is GENE_NAMELENGTH + 2 bytes: the credit in byte 0, then the
+// NUL terminated name. friendsGet() returns the records in display order:
+// new friends are appended, expired ones are closed up, and friendsSort()
+// only moves the records whose credit changed since the last sort.
+
+#define MAX_FRIENDS  50   // max # of friends to track
+#define FRIENDS_INIT_CREDIT  4  // defines how long a friend record stays around before expiration
+// max level of credit a friend can have; defines how long a record can stay around
+// once a friend goes away. Roughly equal to
+// 2 * (PING_MIN_INTERVAL + PING_RAND_INTERVAL / 2 * MAX_CREDIT) milliseconds
+#define FRIENDS_MAX_CREDIT   12
+#define FRIENDS_SORT_HYSTERESIS 4
+#define FRIENDS_HASH_SIZE    128  // power of two, keeps the table at most 40% full
+
+#define FRIEND_RECORD_SIZE   (GENE_NAMELENGTH + 2)
+
+void friendsInit(void);
+
+// record of name, or NULL if it isn't a friend
+char *friend_lookup(const char *name);
+
+// record of name, added with FRIENDS_INIT_CREDIT if needed; NULL if the table is full
+char *friend_add(const char *name);
+
+// friend_add(), and one more credit up to FRIENDS_MAX_CREDIT, in one go
+char *friend_seen(const char *name);
+
+// takes one credit from every friend, and drops the ones that run out
+void friend_cleanup(void);
+
+void friendsSort(void);
+const char **friendsGet(void);
+void friendsLock(void);
+void friendsUnlock(void);
+uint8_t friendCount(void);
+
+#endif /* __ORCHARD_FRIENDS_H__ */
@@ -0,0 +1,130 @@
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "orchard-effects.h"
+#include "fxprof.h"
+
+#include <string.h>
+
+static fxprof_entry entries[FXPROF_MAX_EFFECTS];
+static uint32_t budget;
+
+#if PORT_SUPPORTS_RT
+uint32_t fxprofNow(void) {
+  return (uint32_t) chSysGetRealtimeCounterX();
+}
+#elif CH_CFG_ST_TIMEDELTA > 0
+// SysTick is not running without a periodic tick
+uint32_t fxprofNow(void) {
+  return (uint32_t) chVTGetSystemTimeX();
+}
+#else
+// the M0+ has no cycle counter, the board extends SysTick instead. this is
+// the same clock the trace records are stamped with.
+uint32_t fxprofNow(void) {
+  return boardSysTickNow();
+}
+#endif
+
+void fxprofReset(void) {
+  uint32_t i;
+
+  memset(entries, 0, sizeof(entries));
+  for( i = 0; i < FXPROF_MAX_EFFECTS; i++ ) {
+    entries[i].min = 0xFFFFFFFF;
+    entries[i].decimate = 1;
+  }
+}
+
+void fxprofSetBudget(uint32_t counts) {
+  uint32_t i;
+
+  budget = counts;
+  for( i = 0; i < FXPROF_MAX_EFFECTS; i++ ) {
+    entries[i].decimate = 1;
+    entries[i].phase = 0;
+  }
+}
+
+uint32_t fxprofGetBudget(void) {
+  return budget;
+}
+
+uint8_t fxprofRun(const OrchardEffects *fx, uint32_t index, effects_config *config) {
+  fxprof_entry *e;
+  uint32_t start, cost;
+
+  if( index >= FXPROF_MAX_EFFECTS ) {
+    fx[index].computeEffect(config);
+    return 1;
+  }
+  e = &entries[index];
+  if( e->phase != 0 ) {
+    e->phase--;
+    e->skipped++;
+    return 0;
+  }
+
+  start = fxprofNow();
+  fx[index].computeEffect(config);
+  cost = fxprofNow() - start;
+
+  e->calls++;
+  e->total += cost;
+  if( cost < e->min )
+    e->min = cost;
+  if( cost > e->max )
+    e->max = cost;
+
+  if( budget != 0 ) {
+    if( cost > budget ) {
+      e->overruns++;
+      if( e->decimate < FXPROF_MAX_DECIMATE )
+        e->decimate <<= 1;
+    }
+    else if( e->decimate > 1 ) {
+      e->decimate >>= 1;
+    }
+    e->phase = e->decimate - 1;
+  }
+
+  return 1;
+}
+
+const fxprof_entry *fxprofGet(uint32_t index) {
+  if( index >= FXPROF_MAX_EFFECTS )
+    return NULL;
+  return &entries[index];
+}
+
+static uint32_t avg_of(const fxprof_entry *e) {
+  return e->calls ? (uint32_t) (e->total / e->calls) : 0;
+}
+
+void fxprofReport(BaseSequentialStream *chp, const OrchardEffects *fx) {
+  uint8_t order[FXPROF_MAX_EFFECTS];
+  uint32_t ranked = 0;
+  uint32_t i, j;
+  const fxprof_entry *e;
+
+  // insertion sort of the effects that ran, by average cost
+  for( i = 0; (i < FXPROF_MAX_EFFECTS) && (fx[i].name != NULL); i++ ) {
+    if( entries[i].calls == 0 )
+      continue;
+    for( j = ranked; j > 0 && avg_of(&entries[order[j - 1]]) < avg_of(&entries[i]); j-- )
+      order[j] = order[j - 1];
+    order[j] = (uint8_t) i;
+    ranked++;
+  }
+
+  chprintf(chp, "budget %d us\n\r", FXPROF2US(budget));
+  chprintf(chp, "%-12s %8s %8s %8s %8s %6s %6s %4s\n\r", "effect", "calls",
+           "min us", "avg us", "max us", "over", "held", "dec");
+  for( i = 0; i < ranked; i++ ) {
+    e = &entries[order[i]];
+    chprintf(chp, "%-12s %8d %8d %8d %8d %6d %6d %4d\n\r", fx[order[i]].name, e->calls,
+             FXPROF2US(e->min), FXPROF2US(avg_of(e)), FXPROF2US(e->max),
+             e->overruns, e->skipped, e->decimate);
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef __FXPROF_H__
+#define __FXPROF_H__
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "orchard-effects.h"
+
+// Frame-time profiler for the orchard_effects() registry. Every
+// computeEffect() call made through fxprofRun() is timed, and the
+// min/avg/max cost is kept per effect.
+//
+// With a frame budget set, an effect that goes over it is decimated: it only
+// runs every 2nd, 4th... up to every FXPROF_MAX_DECIMATE-th frame, and the
+// previous frame is held in between (which the LED compositor then skips
+// sending). Each call that comes back in budget halves the decimation again.
+
+#define FXPROF_MAX_EFFECTS    32
+#define FXPROF_MAX_DECIMATE   8
+
+#if PORT_SUPPORTS_RT
+// realtime counter of the host simulator, in microseconds
+#define FXPROF_FREQUENCY      1000000
+#elif CH_CFG_ST_TIMEDELTA > 0
+// tick-less, the free running system timer is fine enough
+#define FXPROF_FREQUENCY      CH_CFG_ST_FREQUENCY
+#else
+// SysTick down-counter composed with the system time, in core clocks
+#define FXPROF_FREQUENCY      KINETIS_SYSCLK_FREQUENCY
+#endif
+
+#define US2FXPROF(us)                                                     \
+  ((uint32_t) (((uint64_t) (us) * FXPROF_FREQUENCY) / 1000000))
+#define FXPROF2US(counts)                                                 \
+  ((uint32_t) (((uint64_t) (counts) * 1000000) / FXPROF_FREQUENCY))
+
+typedef struct fxprof_entry {
+  uint32_t  calls;      // computeEffect() calls timed
+  uint32_t  min;        // cheapest call, in counts
+  uint32_t  max;        // most expensive call, in counts
+  uint64_t  total;      // sum of all the calls, in counts
+  uint32_t  overruns;   // calls that went over the frame budget
+  uint32_t  skipped;    // frames held to bring the effect back into budget
+  uint8_t   decimate;   // the effect runs one frame out of this many
+  uint8_t   phase;      // frames until the effect runs again
+} fxprof_entry;
+
+// current value of the profiling counter
+uint32_t fxprofNow(void);
+
+// clears every entry, keeps the budget
+void fxprofReset(void);
+
+// per-frame budget in counts, 0 disables budget enforcement
+void fxprofSetBudget(uint32_t counts);
+uint32_t fxprofGetBudget(void);
+
+// runs effect index of the fx table for one frame, timing it
+// returns 0 if the effect was held to stay in budget
+uint8_t fxprofRun(const OrchardEffects *fx, uint32_t index, effects_config *config);
+
+const fxprof_entry *fxprofGet(uint32_t index);
+
+// prints the effects of the NULL-terminated fx table that ran, most expensive
+// on average first
+void fxprofReport(BaseSequentialStream *chp, const OrchardEffects *fx);
+
+#endif /* __FXPROF_H__ */
@@ -2,6 +2,7 @@
 #include "ch.h"
 #include "hal.h"
 #include "i2c.h"
+#include "i2c-queue.h"
 
 #include "orchard.h"
 #include "gasgauge.h"
@@ -11,38 +12,37 @@
 #include "orchard-test.h"
 #include "test-audit.h"
 
-static I2CDriver *driver;
+static i2cq_device gg_dev;
 
 static void gg_set(uint8_t cmdcode, int16_t val) {
 
   uint8_t tx[3] = {cmdcode, (uint8_t) val & 0xFF, (uint8_t) (val >> 8) & 0xFF};
 
-  i2cMasterTransmitTimeout(driver, ggAddr,
-                           tx, sizeof(tx),
-                           NULL, 0,
-                           TIME_INFINITE);
+  i2cqTransfer(&gg_dev,
+               tx, sizeof(tx),
+               NULL, 0);
 }
 
 static void gg_set_byte(uint8_t cmdcode, uint8_t val) {
 
   uint8_t tx[2] = {cmdcode, val};
 
-  i2cMasterTransmitTimeout(driver, ggAddr,
-                           tx, sizeof(tx),
-                           NULL, 0,
-                           TIME_INFINITE);
+  i2cqTransfer(&gg_dev,
+               tx, sizeof(tx),
+               NULL, 0);
 }
 
+// a single register read is one queued transfer and needs no device lock,
+// so polls of the same register from several threads share one transfer
 static void gg_get(uint8_t cmdcode, int16_t *data) {
   uint8_t tx[1];
   uint8_t rx[2];
 
   tx[0] = cmdcode;
 
-  i2cMasterTransmitTimeout(driver, ggAddr,
-                           tx, sizeof(tx),
-                           rx, sizeof(rx),
-                           TIME_INFINITE);
+  i2cqRead(&gg_dev,
+           tx, sizeof(tx),
+           rx, sizeof(rx));
 
   *data = rx[0] | (rx[1] << 8);
 }
@@ -53,36 +53,34 @@ static void gg_get_byte(uint8_t cmdcode, uint8_t *data) {
 
   tx[0] = cmdcode;
 
-  i2cMasterTransmitTimeout(driver, ggAddr,
-                           tx, sizeof(tx),
-                           rx, sizeof(rx),
-                           TIME_INFINITE);
+  i2cqRead(&gg_dev,
+           tx, sizeof(tx),
+           rx, sizeof(rx));
 
   *data = rx[0];
 }
 
 void ggStart(I2CDriver *i2cp) {
 
-  driver = i2cp;
+  (void)i2cp;  // the bus belongs to the i2c queue
+  i2cqDeviceInit(&gg_dev, "gasgauge", ggAddr, i2cqPrioTelemetry);
 
   // clear hibernate state, if it was set
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gg_dev);
   gg_set(GG_CMD_CNTL, GG_CODE_CLR_HIB);
-  i2cReleaseBus(driver);
+  i2cqRelease(&gg_dev);
 }
 
 void ggSetHibernate(void) {
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gg_dev);
   gg_set(GG_CMD_CNTL, GG_CODE_SET_HIB);
-  i2cReleaseBus(driver);
+  i2cqRelease(&gg_dev);
 }
 
 int16_t ggAvgCurrent(void) {
   int16_t data;
   
-  i2cAcquireBus(driver);
   gg_get( GG_CMD_AVGCUR, &data );
-  i2cReleaseBus(driver);
 
   return data;
 }
@@ -90,9 +88,7 @@ int16_t ggAvgCurrent(void) {
 int16_t ggAvgPower(void) {
   int16_t data;
   
-  i2cAcquireBus(driver);
   gg_get( GG_CMD_AVGPWR, &data );
-  i2cReleaseBus(driver);
 
   return data;
 }
@@ -100,9 +96,7 @@ int16_t ggAvgPower(void) {
 int16_t ggRemainingCapacity(void) {
   int16_t data;
   
-  i2cAcquireBus(driver);
   gg_get( GG_CMD_RM, &data );
-  i2cReleaseBus(driver);
 
   return data;
 }
@@ -110,9 +104,7 @@ int16_t ggRemainingCapacity(void) {
 int16_t ggStateofCharge(void) {
   int16_t data;
   
-  i2cAcquireBus(driver);
   gg_get( GG_CMD_SOC, &data );
-  i2cReleaseBus(driver);
 
   return data;
 }
@@ -120,9 +112,7 @@ int16_t ggStateofCharge(void) {
 int16_t ggVoltage(void) {
   int16_t data;
   
-  i2cAcquireBus(driver);
   gg_get( GG_CMD_VOLT, &data );
-  i2cReleaseBus(driver);
 
   return data;
 }
@@ -146,7 +136,7 @@ uint16_t setDesignCapacity(uint16_t mAh) {
   uint8_t  blockdata[33];
   uint8_t  i;
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gg_dev);
   
   gg_set(GG_CMD_CNTL, GG_CODE_DEVTYPE);
   gg_get(GG_CMD_CNTL, &flags);
@@ -206,7 +196,7 @@ uint16_t setDesignCapacity(uint16_t mAh) {
   gg_get(GG_CMD_CNTL, &flags);
   chprintf( stream, "control status: %04x\n\r", flags );
 
-  i2cReleaseBus(driver);
+  i2cqRelease(&gg_dev);
 
   return designCapacity;
   
@@ -219,10 +209,10 @@ OrchardTestResult test_gasgauge(const char *my_name, OrchardTestType test_type)
   switch(test_type) {
   case orchardTestPoweron:
   case orchardTestTrivial:
-    i2cAcquireBus(driver);
+    i2cqAcquire(&gg_dev);
     gg_set(GG_CMD_CNTL, GG_CODE_DEVTYPE);
     gg_get(GG_CMD_CNTL, &ret);
-    i2cReleaseBus(driver);
+    i2cqRelease(&gg_dev);
     if( ret != 0x0421 ) {
       return orchardResultFail;
     } else {
@@ -1,3 +1,6 @@
+#ifndef __GENES_H__
+#define __GENES_H__
+
 #define GENE_SIGNATURE  0x424D3135  // BM15
 #define GENE_BLOCK  0
 #define GENE_OFFSET 0
@@ -40,3 +43,5 @@ void geneStart(void);
 void generateName(char *result);
 void computeGeneExpression(const genome *hapM, const genome *hapP, genome *expr);
 uint8_t getConsent(char *who);
+
+#endif /* __GENES_H__ */
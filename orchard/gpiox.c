@@ -4,6 +4,7 @@
 #include "ch.h"
 #include "hal.h"
 #include "i2c.h"
+#include "i2c-queue.h"
 
 #include "gpiox.h"
 #include "orchard.h"
@@ -27,7 +28,7 @@ typedef void (*gpiox_callback_t)(void *port, int pad, int type);
 
 gpiox_callback_t gpiox_handlers[8];
 
-static I2CDriver *driver;
+static i2cq_device gpiox_dev;
 static uint8_t gpiox_pal_mode[GPIOX_NUM_PADS];
 static uint8_t regcache[10];
 
@@ -37,10 +38,9 @@ static void gpiox_set(uint8_t reg, uint8_t val) {
 
   uint8_t tx[2] = {reg, val};
 
-  i2cMasterTransmitTimeout(driver, gpioxAddr,
-                           tx, sizeof(tx),
-                           NULL, 0,
-                           TIME_INFINITE);
+  i2cqTransfer(&gpiox_dev,
+               tx, sizeof(tx),
+               NULL, 0);
 }
 
 static void gpiox_sync(uint8_t reg) {
@@ -53,10 +53,9 @@ static uint8_t gpiox_get(uint8_t reg) {
   const uint8_t tx[1] = {reg};
   uint8_t rx[1];
 
-  i2cMasterTransmitTimeout(driver, gpioxAddr,
-                           tx, sizeof(tx),
-                           rx, sizeof(rx),
-                           TIME_INFINITE);
+  i2cqTransfer(&gpiox_dev,
+               tx, sizeof(tx),
+               rx, sizeof(rx));
   return rx[0];
 }
 
@@ -84,27 +83,28 @@ static THD_FUNCTION(gpiox_poll_thread, arg) {
 #endif
 
 void gpioxStop(void) {
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gpiox_dev);
   gpiox_set(0x11, 0xFF);  // mask all interrupts
   gpiox_set(0x3, 0x0);  // force all gpios to inputs
   gpiox_set(0xB, 0x0);  // disable pull-up/pulldowns
-  i2cReleaseBus(driver);
+  i2cqRelease(&gpiox_dev);
 }
 
 void gpioxStart(I2CDriver *i2cp) {
 
   unsigned int i;
 
-  driver = i2cp;
+  (void)i2cp;  // the bus belongs to the i2c queue
+  i2cqDeviceInit(&gpiox_dev, "gpiox", gpioxAddr, i2cqPrioNormal);
 
   for (i = 0; i < ARRAY_SIZE(regcache); i++)
     regcache[i] = 0;
 
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gpiox_dev);
   gpiox_set(REG_ID, 1);
   /* Wait for the reset to complete */
   while (!(gpiox_get(REG_ID) & (1 << 1)));
-  i2cReleaseBus(driver);
+  i2cqRelease(&gpiox_dev);
 
 #if ORCHARD_BOARD_REV == ORCHARD_REV_EVT1
   chThdCreateStatic(waGpioxPollThread, sizeof(waGpioxPollThread),
@@ -116,9 +116,9 @@ void gpioxStart(I2CDriver *i2cp) {
 
 uint8_t gpioxGetDebug(uint8_t reg) {
   uint8_t ret;
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gpiox_dev);
   ret = gpiox_get(reg);
-  i2cReleaseBus(driver);
+  i2cqRelease(&gpiox_dev);
 
   return ret;
 }
@@ -128,9 +128,9 @@ void gpioxSetPad(void *port, int pad) {
   (void)port;
   
   regcache[REG_OUT / 2] |= (1 << pad);
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gpiox_dev);
   gpiox_sync(REG_OUT);
-  i2cReleaseBus(driver);
+  i2cqRelease(&gpiox_dev);
 }
 
 void gpioxClearPad(void *port, int pad) {
@@ -138,9 +138,9 @@ void gpioxClearPad(void *port, int pad) {
   (void)port;
   
   regcache[REG_OUT / 2] &= ~(1 << pad);
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gpiox_dev);
   gpiox_sync(REG_OUT);
-  i2cReleaseBus(driver);
+  i2cqRelease(&gpiox_dev);
 }
 
 void gpioxTogglePad(void *port, int pad) {
@@ -148,9 +148,9 @@ void gpioxTogglePad(void *port, int pad) {
   (void)port;
   
   regcache[REG_OUT / 2] ^= (1 << pad);
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gpiox_dev);
   gpiox_sync(REG_OUT);
-  i2cReleaseBus(driver);
+  i2cqRelease(&gpiox_dev);
 }
 
 void gpioxSetPadMode(void *port, int pad, int mode) {
@@ -166,7 +166,7 @@ void gpioxSetPadMode(void *port, int pad, int mode) {
 
   /* Start out by masking the IRQ, to prevent spurrious interrupts */
   regcache[REG_IRQ_MASK / 2] |= bit;
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gpiox_dev);
   gpiox_sync(REG_IRQ_MASK);
 
   switch (mode & GPIOX_IRQMASK) {
@@ -246,7 +246,7 @@ void gpioxSetPadMode(void *port, int pad, int mode) {
   gpiox_sync(REG_IRQ_LEVEL);
   gpiox_sync(REG_IRQ_MASK);
 
-  i2cReleaseBus(driver);
+  i2cqRelease(&gpiox_dev);
 }
 
 uint8_t gpioxReadPad(void *port, int pad) {
@@ -254,9 +254,9 @@ uint8_t gpioxReadPad(void *port, int pad) {
   (void)port;
   uint8_t val;
   
-  i2cAcquireBus(driver);
+  i2cqAcquire(&gpiox_dev);
   val = gpiox_read_pad(port, pad);
-  i2cReleaseBus(driver);
+  i2cqRelease(&gpiox_dev);
 
   return val;
 }
@@ -326,9 +326,9 @@ static void gpiox_poll_int(int ign) {
 
   while (gpiox_irq_are_pending(NULL)) {
 
-    i2cAcquireBus(driver);
+    i2cqAcquire(&gpiox_dev);
     irq_state = gpiox_get(REG_IRQ_STATUS);
-    i2cReleaseBus(driver);
+    i2cqRelease(&gpiox_dev);
 
     interrupt_count++;
 
@@ -336,13 +336,13 @@ static void gpiox_poll_int(int ign) {
       irq_check_and_broadcast(irq_state, pad);
 
     /* Acknowledge the IRQ by writing new values to watch */
-    i2cAcquireBus(driver);
+    i2cqAcquire(&gpiox_dev);
     /* Mask off the pins that caused this interrupt, while we re-set the level */
     gpiox_set(REG_IRQ_MASK, regcache[REG_IRQ_MASK / 2] | irq_state);
     gpiox_sync(REG_IRQ_LEVEL);
     /* Unmask the new pins */
     gpiox_sync(REG_IRQ_MASK);
-    i2cReleaseBus(driver);
+    i2cqRelease(&gpiox_dev);
   }
 
   return;
@@ -357,9 +357,9 @@ OrchardTestResult test_gpiox(const char *my_name, OrchardTestType test_type) {
   default:
   case orchardTestPoweron:
   case orchardTestTrivial:
-    i2cAcquireBus(driver);
+    i2cqAcquire(&gpiox_dev);
     ret =  gpiox_get(REG_ID);
-    i2cReleaseBus(driver);
+    i2cqRelease(&gpiox_dev);
     if( ret != 0xA0 ) {
       return orchardResultFail;
     } else {
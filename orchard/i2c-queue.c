@@ -0,0 +1,200 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "i2c-queue.h"
+#include "fxprof.h"
+
+#include <string.h>
+
+static i2cq_xfer_t i2cq_xfer;
+static i2cq_request *i2cq_head;       // waiting requests, highest priority first
+static i2cq_device *i2cq_devices;
+static thread_reference_t i2cq_idle;  // the queue thread, while the queue is empty
+static thread_t *i2cq_thread;
+static THD_WORKING_AREA(waI2cqThread, 256);
+
+// call locked; does not reschedule
+static void i2cq_enqueue_s(i2cq_request *req) {
+  i2cq_request **pp, *q;
+
+  req->next = NULL;
+  req->followers = NULL;
+  req->waiter = NULL;
+  req->queued = fxprofNow();
+
+  if( req->coalesce ) {
+    for( q = i2cq_head; q != NULL; q = q->next ) {
+      if( q->coalesce && (q->dev == req->dev) &&
+          (q->txn == req->txn) && (q->rxn == req->rxn) &&
+          !memcmp(q->tx, req->tx, req->txn) ) {
+        req->next = q->followers;
+        q->followers = req;
+        req->dev->stats.coalesced++;
+        return;
+      }
+    }
+  }
+
+  for( pp = &i2cq_head; *pp != NULL; pp = &(*pp)->next )
+    if( (*pp)->dev->prio < req->dev->prio )
+      break;
+  req->next = *pp;
+  *pp = req;
+
+  chThdResumeI(&i2cq_idle, MSG_OK);
+}
+
+static void i2cq_complete(i2cq_request *req, msg_t result) {
+  req->result = result;
+  if( req->done != NULL ) {
+    req->done(req);
+  }
+  else {
+    chSysLock();
+    chThdResumeS(&req->waiter, result);
+    chSysUnlock();
+  }
+}
+
+static THD_FUNCTION(i2cq_thread_fn, arg) {
+  (void)arg;
+  i2cq_request *req, *f, *next;
+  i2cq_stats *stats;
+  uint32_t start, cost;
+  msg_t result;
+
+  chRegSetThreadName("i2c");
+
+  while (1) {
+    chSysLock();
+    while( i2cq_head == NULL )
+      chThdSuspendS(&i2cq_idle);
+    req = i2cq_head;
+    i2cq_head = req->next;
+    chSysUnlock();
+
+    start = fxprofNow();
+    result = i2cq_xfer(req->dev->addr, req->tx, req->txn, req->rx, req->rxn);
+    cost = fxprofNow() - start;
+
+    stats = &req->dev->stats;
+    stats->transfers++;
+    stats->bytes += req->txn + req->rxn;
+    stats->bus_time += cost;
+    if( cost > stats->bus_max )
+      stats->bus_max = cost;
+    if( start - req->queued > stats->wait_max )
+      stats->wait_max = start - req->queued;
+    if( result != MSG_OK )
+      stats->errors++;
+
+    // nothing joins a request once it left the queue, and a request may be
+    // gone as soon as it's completed
+    for( f = req->followers; f != NULL; f = next ) {
+      next = f->next;
+      memcpy(f->rx, req->rx, req->rxn);
+      i2cq_complete(f, result);
+    }
+    i2cq_complete(req, result);
+  }
+}
+
+void i2cqInit(i2cq_xfer_t xfer) {
+  i2cq_xfer = xfer;
+  if( i2cq_thread == NULL )
+    i2cq_thread = chThdCreateStatic(waI2cqThread, sizeof(waI2cqThread),
+                                    NORMALPRIO + 2, i2cq_thread_fn, NULL);
+}
+
+#if HAL_USE_I2C
+static I2CDriver *i2cq_driver;
+
+static msg_t i2cq_hw_xfer(uint8_t addr, const uint8_t *tx, size_t txn,
+                          uint8_t *rx, size_t rxn) {
+  return i2cMasterTransmitTimeout(i2cq_driver, addr,
+                                  tx, txn,
+                                  rx, rxn,
+                                  TIME_INFINITE);
+}
+
+void i2cqStart(I2CDriver *i2cp) {
+  i2cq_driver = i2cp;
+  i2cqInit(i2cq_hw_xfer);
+}
+#endif
+
+void i2cqDeviceInit(i2cq_device *dev, const char *name, uint8_t addr, i2cq_prio prio) {
+  i2cq_device *d;
+
+  dev->name = name;
+  dev->addr = addr;
+  dev->prio = prio;
+  osalMutexObjectInit(&dev->lock);
+  memset(&dev->stats, 0, sizeof(dev->stats));
+
+  for( d = i2cq_devices; d != NULL; d = d->next )
+    if( d == dev )
+      return;
+  dev->next = i2cq_devices;
+  i2cq_devices = dev;
+}
+
+void i2cqAcquire(i2cq_device *dev) {
+  osalMutexLock(&dev->lock);
+}
+
+void i2cqRelease(i2cq_device *dev) {
+  osalMutexUnlock(&dev->lock);
+}
+
+void i2cqSubmit(i2cq_request *req) {
+  chSysLock();
+  i2cq_enqueue_s(req);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+static msg_t i2cq_wait(i2cq_device *dev, const uint8_t *tx, size_t txn,
+                       uint8_t *rx, size_t rxn, uint8_t coalesce) {
+  i2cq_request req;
+  msg_t result;
+
+  req.dev = dev;
+  req.tx = tx;
+  req.txn = txn;
+  req.rx = rx;
+  req.rxn = rxn;
+  req.coalesce = coalesce;
+  req.done = NULL;
+  req.arg = NULL;
+
+  // queued and suspended in one go, so the queue thread can't complete the
+  // request before there is someone to wake
+  chSysLock();
+  i2cq_enqueue_s(&req);
+  result = chThdSuspendS(&req.waiter);
+  chSysUnlock();
+
+  return result;
+}
+
+msg_t i2cqTransfer(i2cq_device *dev, const uint8_t *tx, size_t txn,
+                   uint8_t *rx, size_t rxn) {
+  return i2cq_wait(dev, tx, txn, rx, rxn, 0);
+}
+
+msg_t i2cqRead(i2cq_device *dev, const uint8_t *tx, size_t txn,
+               uint8_t *rx, size_t rxn) {
+  return i2cq_wait(dev, tx, txn, rx, rxn, 1);
+}
+
+i2cq_device *i2cqDevices(void) {
+  return i2cq_devices;
+}
+
+void i2cqResetStats(void) {
+  i2cq_device *d;
+
+  for( d = i2cq_devices; d != NULL; d = d->next )
+    memset(&d->stats, 0, sizeof(d->stats));
+}
@@ -0,0 +1,94 @@
+#ifndef __ORCHARD_I2C_QUEUE_H__
+#define __ORCHARD_I2C_QUEUE_H__
+
+#include "ch.h"
+#include "hal.h"
+
+// All I2C traffic goes through one queue, served by a thread that owns the
+// bus. Requests are served highest priority first and in order within a
+// priority, so a touch read waits for at most the one transfer on the bus,
+// never for a queue of battery telemetry. A register read that is
+// identical to one still waiting in the queue does not go on the bus
+// again: it is answered with the same data.
+//
+// Devices no longer lock the whole bus around a sequence of transfers,
+// i2cqAcquire() only keeps other users of the same device out. A single
+// register read is one request and is not taken under the device lock,
+// otherwise it could never meet an identical read in the queue.
+
+typedef enum i2cq_prio {
+  i2cqPrioTelemetry = 0,  // gas gauge, charger
+  i2cqPrioNormal,         // GPIO expander, accelerometer
+  i2cqPrioInput,          // captouch, feeds the key and dial events
+} i2cq_prio;
+
+typedef struct i2cq_stats {
+  uint32_t      transfers;    // transfers that went on the bus
+  uint32_t      coalesced;    // reads answered by an identical queued read
+  uint32_t      errors;       // transfers that did not return MSG_OK
+  uint32_t      bytes;        // bytes sent and received
+  uint64_t      bus_time;     // time on the bus, in fxprof counts
+  uint32_t      bus_max;      // longest transfer
+  uint32_t      wait_max;     // longest time from queueing to the bus
+} i2cq_stats;
+
+typedef struct i2cq_device {
+  const char          *name;
+  uint8_t             addr;
+  uint8_t             prio;   // i2cq_prio
+  mutex_t             lock;
+  i2cq_stats          stats;
+  struct i2cq_device  *next;  // all the devices, for the stats
+} i2cq_device;
+
+struct i2cq_request;
+// called on the queue thread once the request is done
+typedef void (*i2cq_done_t)(struct i2cq_request *req);
+
+typedef struct i2cq_request {
+  struct i2cq_request *next;        // queue order
+  struct i2cq_request *followers;   // identical reads answered with this one
+  i2cq_device         *dev;
+  const uint8_t       *tx;
+  size_t              txn;
+  uint8_t             *rx;
+  size_t              rxn;
+  uint8_t             coalesce;     // may share its transfer with identical reads
+  msg_t               result;
+  uint32_t            queued;       // fxprof counts
+  i2cq_done_t         done;
+  void                *arg;
+  thread_reference_t  waiter;
+} i2cq_request;
+
+// moves one transfer on the bus, from the queue thread
+typedef msg_t (*i2cq_xfer_t)(uint8_t addr, const uint8_t *tx, size_t txn,
+                             uint8_t *rx, size_t rxn);
+
+void i2cqInit(i2cq_xfer_t xfer);
+#if HAL_USE_I2C
+void i2cqStart(I2CDriver *i2cp);
+#endif
+
+void i2cqDeviceInit(i2cq_device *dev, const char *name, uint8_t addr, i2cq_prio prio);
+void i2cqAcquire(i2cq_device *dev);
+void i2cqRelease(i2cq_device *dev);
+
+// Queues a request and returns; req->done is called with req->result once
+// it is done. req, tx and rx must stay valid until then.
+void i2cqSubmit(i2cq_request *req);
+
+// Queues a transfer and waits for it, only the caller blocks.
+msg_t i2cqTransfer(i2cq_device *dev, const uint8_t *tx, size_t txn,
+                   uint8_t *rx, size_t rxn);
+
+// Same as i2cqTransfer() for a register read without side effects, which
+// may be coalesced with an identical read already in the queue.
+msg_t i2cqRead(i2cq_device *dev, const uint8_t *tx, size_t txn,
+               uint8_t *rx, size_t rxn);
+
+// first of the registered devices, follow ->next for the rest
+i2cq_device *i2cqDevices(void);
+void i2cqResetStats(void);
+
+#endif /* __ORCHARD_I2C_QUEUE_H__ */
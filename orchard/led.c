@@ -16,14 +16,16 @@
 #include "gasgauge.h"
 
 #include "genes.h"
+#include "lightgene.h"
+#include "ws2812b.h"
+#include "trace.h"
+#include "fxprof.h"
 
 #include <string.h>
 #include <math.h>
 
 orchard_effects_end();
 
-extern void ledUpdate(uint8_t *fb, uint32_t len);
-
 static void ledSetRGB(void *ptr, int x, uint8_t r, uint8_t g, uint8_t b, uint8_t shift);
 static void ledSetColor(void *ptr, int x, Color c, uint8_t shift);
 static void ledSetRGBClipped(void *fb, uint32_t i,
@@ -42,6 +44,8 @@ static struct led_config {
   uint32_t      max_pixels;   // maximal generation length
   uint8_t       *ui_fb; // frame buffer for UI effects
   uint32_t      ui_pixels;  // number of LEDs on the PCB itself for UI use
+  uint32_t      fb_hash;    // hash of the effects frame buffer at the last blend
+  uint8_t       dirty;      // set when final_fb must be recomposed regardless of the hash
 } led_config;
 
 // global effects state
@@ -70,6 +74,12 @@ static uint8_t ledsOff = 1;
 
 genome diploid;   // not static so we can access/debug from other files
 
+// lightgene state is owned by the effects thread: other threads only post
+// a genome here, and do_lightgene() compiles it at the top of the next frame
+static genome lg_pending;
+static volatile uint8_t lg_update = 0;
+static genome lg_genome;
+
 uint8_t effectsStop(void) {
   ledExitRequest = 1;
   return ledsOff;
@@ -92,6 +102,7 @@ void ledStart(uint32_t leds, uint8_t *o_fb, uint32_t ui_leds, uint8_t *o_ui_fb)
 
   led_config.fb = o_fb;
   led_config.ui_fb = o_ui_fb;
+  led_config.dirty = 1;
 
   led_config.final_fb = chHeapAlloc( NULL, sizeof(uint8_t) * led_config.max_pixels * 3 );
   
@@ -100,9 +111,11 @@ void ledStart(uint32_t leds, uint8_t *o_fb, uint32_t ui_leds, uint8_t *o_ui_fb)
   for (j = 0; j < ui_leds * 3; j++)
     led_config.ui_fb[j] = 0x0;
 
-  chSysLock();
-  ledUpdate(led_config.fb, led_config.max_pixels);
-  chSysUnlock();
+  fxprofReset();
+  fxprofSetBudget(US2FXPROF(EFFECTS_BUDGET_US));
+
+  ws2812bStart(led_config.max_pixels);
+  ws2812bUpdate(led_config.fb, led_config.max_pixels);
 }
 
 void uiLedGet(uint8_t index, Color *c) {
@@ -121,6 +134,7 @@ void uiLedSet(uint8_t index, Color c) {
   led_config.ui_fb[index*3] = c.g;
   led_config.ui_fb[index*3+1] = c.r;
   led_config.ui_fb[index*3+2] = c.b;
+  led_config.dirty = 1;
 }
 
 static void ledSetRGBClipped(void *fb, uint32_t i,
@@ -159,6 +173,7 @@ void ledSetCount(uint32_t count) {
   if (count > led_config.max_pixels)
     return;
   led_config.pixel_count = count;
+  led_config.dirty = 1;
 }
 
 void setShift(uint8_t s) {
@@ -213,129 +228,33 @@ static void do_lightgene(struct effects_config *config) {
   uint8_t *fb = config->hwconfig->fb;
   uint32_t count = config->count;
   uint32_t loop = config->loop & 0x1FF;
-  uint32_t shoot;
-  HsvColor hsvC;
-  RgbColor rgbC;
-  uint32_t i;
   uint32_t tau;
-  uint32_t curtime, indextime;
-  fix16_t time, space;
-  fix16_t twopi;
-  fix16_t spacetime;
-  uint8_t overrideHSV = 0;
-  uint8_t overshift;
-  uint32_t hue_rate;
-  uint8_t hue_dir;
-  uint32_t hue_temp;
-  // diploid is static to this function and set when the lightgene is selected
-
-  tau = (uint32_t) map(diploid.cd_rate, 0, 255, 700, 8000);
+  uint32_t curtime;
+
+  if( lg_update ) {
+    chSysLock();
+    lg_genome = lg_pending;
+    lg_update = 0;
+    chSysUnlock();
+    lightgeneCompile(&lg_genome, count);
+  }
+
+  tau = lightgeneTau();
   curtime = chVTGetSystemTime();
   if( (curtime - reftime_lg) > tau )
     reftime_lg = curtime;
-  indextime = reftime_lg - curtime;
 
   if( bumped ) {
     bumped = 0;
-    sat_offset = satadd_8(sat_offset, map(diploid.accel, 0, 255, 0, 64));
+    sat_offset = satadd_8(sat_offset, map(lg_genome.accel, 0, 255, 0, 64));
   } else {
     if( (loop % 3) == 0 )  // cheesy make the time constant to baseline longer.
       sat_offset = satsub_8(sat_offset, 1);
   }
-  for( i = 0; i < count; i++ ) {
-    overrideHSV = 0;
-    // compute one pixel's color
-    // count is the current pixel index
-    // loop is the current point in effect cycle, e.g. all effects loop on a 0-511 basis
-    // hue chromosome
-    hue_rate = (uint32_t) diploid.hue_ratedir & 0xF;
-    hue_dir = (((diploid.hue_ratedir >> 4) & 0xF) > 10) ? 1 : 0;
-    /*
-      refactor: we want the pattern applied from 0-7 to be inversely applied from 8-15
-      0 1 2 3 4 5 6 7  7 6 5 4 3 2 1 0
-     */
-    // 254L cheesily avoids rounding errors.
-    if( !hue_dir ) {
-      hue_temp = ((128L / (count / 2)) * i + (loop * hue_rate)) - 0L;
-      hue_temp &= 0x1FF;
-      if( hue_temp <= 0xFF )
-	hsvC.h = (uint8_t) hue_temp;
-      else {
-	hsvC.h = (uint8_t) (511-hue_temp);
-      }
-    } else {
-      hue_temp = ((128L / (count / 2)) * i - (loop * hue_rate)) - 0L;
-      hue_temp &= 0x1FF;
-      if( hue_temp <= 0xFF )
-	hsvC.h = (uint8_t) hue_temp;
-      else {
-	hsvC.h = (uint8_t) (511-hue_temp);
-      }
-    }
-    hsvC.h = map_16( (int16_t) hsvC.h, 0, 255,
-		     (int16_t) diploid.hue_base, (int16_t) diploid.hue_bound );
-    
-    // chprintf( stream, "%d ", hsvC.h );
-
-    // saturation chromosome
-    hsvC.s = satadd_8(diploid.sat, sat_offset);
-
-    // compute the value overlay
-    // use cos b/c value is 1.0 when input is 0
-    // value = 255 * cos( cd_period * 2pi * (i/(count-1))
-    //                    +/- (indextime / tau(cd_rate)) * 2pi )
-    // sign of rate is determined by cd_dir
-
-    twopi = fix16_mul( fix16_from_int(2), fix16_pi );
-    // space = 2pi * diploid.cd_period * (i / (count-1))
-    space = fix16_mul(twopi, fix16_mul( fix16_from_int(diploid.cd_period),
-					 fix16_div(fix16_from_int(i), fix16_from_int(count-1)) ));
 
-    // time = 2pi * (indextime) / tau
-    time = fix16_mul(twopi, fix16_div( fix16_from_int(indextime), fix16_from_int(tau) ));
-
-    //    time = fix16_from_int(0);
-    
-    // space +/- time based on direction
-    if( diploid.cd_dir > 128 ) {
-      spacetime = fix16_add( space, time );
-    } else {
-      spacetime = fix16_sub( space, time );
-    }
-
-    // hsv.v = 127 * (1 + cos(spacetime))
-    hsvC.v = (uint8_t) fix16_to_int( fix16_mul( fix16_from_int(127),
-						fix16_add( fix16_from_int(1),
-							   fix16_cos(spacetime))));
-
-    if( diploid.nonlin > 127 )
-      // add some nonlinearity to gamma-correct brightness
-      hsvC.v = (uint8_t) (((uint16_t) hsvC.v * (uint16_t) hsvC.v) >> 8 & 0xFF);
-
-    // now compute lin effect, but only if the threshold is met
-    if( diploid.lin < 90 ) {  // rare variant after a summing expression ~3% chance
-      shoot = loop % count;
-      if( shoot == i ) {
-	overrideHSV = 1;
-      }
-    }
-
-    // now compute strobe effect, but only if the threshold is met
-    if( diploid.strobe < 10 ) {
-      // for now, do nothing...this one is a pain in the ass to implement and probably not too interesting anyways
-    }
-
-    // go from RGB to HSV for a particular pixel
-    if( !overrideHSV ) {
-      rgbC = HsvToRgb(hsvC);
-      ledSetRGB(fb, i, rgbC.r, rgbC.g, rgbC.b, shift);
-    } else {
-      overshift = shift - 2; // make this effect brighter so it's obvious
-      if( overshift > 4 )
-	overshift = 4;
-      ledSetRGB(fb, i, 255, 255, 255, overshift);
-    }
-  }
+  // count is the number of pixels
+  // loop is the current point in effect cycle, e.g. all effects loop on a 0-511 basis
+  lightgeneRender(fb, count, loop, curtime - reftime_lg, sat_offset, shift);
 }
 
 static void lg0FB(struct effects_config *config) {
@@ -837,9 +756,10 @@ static void draw_pattern(void) {
     bump_amount = 0;
   }
 
-  curfx += fx_index;
-
-  curfx->computeEffect(&fx_config);
+  // an effect held back to stay in its frame budget leaves fb untouched
+  chDbgTraceMark(TRACE_MARK_FX_BEGIN, fx_index);
+  (void) fxprofRun(curfx, fx_index, &fx_config);
+  chDbgTraceMark(TRACE_MARK_FX_END, fx_index);
 }
 
 const char *effectsCurName(void) {
@@ -881,6 +801,12 @@ void check_lightgene_hack(void) {
     family_member = effectsCurName()[2] - '0';
     computeGeneExpression(&(family->haploidM[family_member]),
 			  &(family->haploidP[family_member]), &diploid);
+
+    // the effects thread may be rendering the old genome; let it recompile
+    chSysLock();
+    lg_pending = diploid;
+    lg_update = 1;
+    chSysUnlock();
   }
 }
 
@@ -921,22 +847,52 @@ void effectsPrevPattern(void) {
   check_lightgene_hack();
 }
 
-static void blendFbs(void) {
-  uint8_t i;
-  // UI FB + effects FB blend (just do a saturating add)
-  for( i = 0; i < led_config.ui_pixels * 3; i ++ ) {
-    led_config.final_fb[i] = satadd_8(led_config.fb[i], led_config.ui_fb[i]);
-  }
+// FNV-1a over the frame buffer, a word at a time when it's aligned
+static uint32_t fbHash(const uint8_t *fb, uint32_t len) {
+  uint32_t hash = 2166136261UL;
+  uint32_t i = 0;
 
-  // copy over the remainder of the effects FB that extends beyond UI FB
-  for( i = led_config.ui_pixels * 3; i < led_config.max_pixels * 3; i++ ) {
-    led_config.final_fb[i] = led_config.fb[i];
+  if( ((uintptr_t) fb & 3) == 0 ) {
+    for( ; i + 4 <= len; i += 4 )
+      hash = (hash ^ *(const aliased_word *) (fb + i)) * 16777619UL;
   }
+  for( ; i < len; i++ )
+    hash = (hash ^ fb[i]) * 16777619UL;
+
+  return hash;
+}
+
+// merges the UI and effects frame buffers into final_fb
+// returns 0 if neither changed since the last blend, and the LEDs are up to date
+static uint8_t blendFbs(void) {
+  uint32_t len = led_config.pixel_count * 3;
+  uint32_t ui_len = led_config.ui_pixels * 3;
+  uint32_t hash;
+
   if( ledExitRequest ) {
-    for( i = 0; i < led_config.max_pixels * 3; i++ ) {
-      led_config.final_fb[i] = 0; // turn all the LEDs off
-    }
+    memset(led_config.final_fb, 0, len); // turn all the LEDs off
+    led_config.dirty = 1;
+    return 1;
   }
+
+  // static patterns redraw the same frame every cycle, so skip the blend
+  // and the LED update unless the effect or the UI changed something
+  hash = fbHash(led_config.fb, len);
+  if( !led_config.dirty && (hash == led_config.fb_hash) )
+    return 0;
+  led_config.fb_hash = hash;
+  led_config.dirty = 0;
+
+  if( ui_len > len )
+    ui_len = len;
+
+  // UI FB + effects FB blend (just do a saturating add)
+  satadd_8_buf(led_config.final_fb, led_config.fb, led_config.ui_fb, ui_len);
+
+  // copy over the remainder of the effects FB that extends beyond UI FB
+  memcpy(led_config.final_fb + ui_len, led_config.fb + ui_len, len - ui_len);
+
+  return 1;
 }
 
 static THD_WORKING_AREA(waEffectsThread, 256);
@@ -946,12 +902,10 @@ static THD_FUNCTION(effects_thread, arg) {
   chRegSetThreadName("LED effects");
 
   while (!ledsOff) {
-    blendFbs();
-    
-    // transmit the actual framebuffer to the LED chain
-    chSysLock();
-    ledUpdate(led_config.final_fb, led_config.pixel_count);
-    chSysUnlock();
+    // hand the frame to the LED chain; it goes out in the background
+    // while the next one is rendered
+    if( blendFbs() )
+      ws2812bUpdate(led_config.final_fb, led_config.pixel_count);
 
     // wait until the next update cycle
     chThdYield();
@@ -963,8 +917,9 @@ static THD_FUNCTION(effects_thread, arg) {
     if( ledExitRequest ) {
       // force one full cycle through an update on request to force LEDs off
       blendFbs(); 
+      ws2812bUpdate(led_config.final_fb, led_config.pixel_count);
+      ws2812bWait();
       chSysLock();
-      ledUpdate(led_config.final_fb, led_config.pixel_count);
       ledsOff = 1;
       chThdExitS(MSG_OK);
       chSysUnlock();
@@ -1044,9 +999,7 @@ OrchardTestResult test_led(const char *my_name, OrchardTestType test_type) {
       led_config.final_fb[i+1] = 0;
       led_config.final_fb[i+2] = 0;
     }
-    chSysLock();
-    ledUpdate(led_config.final_fb, led_config.pixel_count);
-    chSysUnlock();
+    ws2812bUpdate(led_config.final_fb, led_config.pixel_count);
     orchardTestPrompt("green LED test", "", 0);
     chThdSleepMilliseconds(GG_UPDATE_INTERVAL_MS * 2);
     orchardTestPrompt("press button", "to advance", interactive);
@@ -1060,9 +1013,7 @@ OrchardTestResult test_led(const char *my_name, OrchardTestType test_type) {
       led_config.final_fb[i+1] = 255;
       led_config.final_fb[i+2] = 0;
     }
-    chSysLock();
-    ledUpdate(led_config.final_fb, led_config.pixel_count);
-    chSysUnlock();
+    ws2812bUpdate(led_config.final_fb, led_config.pixel_count);
     orchardTestPrompt("red LED test", "", 0);
     chThdSleepMilliseconds(GG_UPDATE_INTERVAL_MS * 2);
     orchardTestPrompt("press button", "to advance", interactive);
@@ -1076,9 +1027,7 @@ OrchardTestResult test_led(const char *my_name, OrchardTestType test_type) {
       led_config.final_fb[i+2] = 255;
     }
     orchardTestPrompt("blue LED test", "", 0);
-    chSysLock();
-    ledUpdate(led_config.final_fb, led_config.pixel_count);
-    chSysUnlock();
+    ws2812bUpdate(led_config.final_fb, led_config.pixel_count);
     chThdSleepMilliseconds(GG_UPDATE_INTERVAL_MS * 2);
     orchardTestPrompt("press button", "to advance", interactive);
     if( abs( ggAvgCurrent() - offCurrent ) < 20)
@@ -54,5 +54,8 @@ const char *lightgeneName(void);
 void check_lightgene_hack(void);
 
 #define EFFECTS_REDRAW_MS 35
+// per-frame time budget of an effect, effects over it are run on fewer frames
+// 0 never holds effects back, it can be changed from the shell with fxprof
+#define EFFECTS_BUDGET_US 0
 
 #endif /* __LED_H__ */
@@ -0,0 +1,156 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "led.h"
+#include "genes.h"
+#include "lightgene.h"
+#include "orchard-math.h"
+#include "fixmath.h"
+
+#define VALUE_STEPS      (1 << LIGHTGENE_VALUE_BITS)
+#define VALUE_FRAC_BITS  (LIGHTGENE_PHASE_BITS - LIGHTGENE_VALUE_BITS)
+
+// the effect compiled for the current genome
+static struct lightgene_program {
+  genome    genome;      // copy of the genome, to recompile on pixel count changes
+  uint32_t  count;       // pixel count the per-pixel tables were compiled for
+  uint32_t  alloc;       // pixels the per-pixel tables have room for
+  uint16_t  *space;      // spatial phase of each pixel
+  uint16_t  *hue;        // spatial hue offset of each pixel, 0-0x1FF
+  uint32_t  tau;         // wave period in ticks
+  uint32_t  tau_recip;   // 2^24 / tau, turns elapsed ticks into a phase
+  uint8_t   hue_rate;
+  uint8_t   hue_dir;
+  uint8_t   forward;     // set if the wave phase moves with time
+  uint8_t   sat;
+  uint8_t   lin;         // set if the shooting pixel is expressed
+  uint8_t   hue_map[256];          // folded hue mapped into the genome's hue range
+  uint8_t   value[VALUE_STEPS];    // 127 * (1 + cos(phase)), gamma corrected
+} lg;
+
+uint8_t lightgeneCompile(const genome *g, uint32_t count) {
+  fix16_t twopi;
+  fix16_t cosv;
+  uint32_t i;
+  uint32_t hue_step;
+  uint16_t *tables;
+  uint8_t v;
+
+  if( count > lg.alloc ) {
+    tables = chHeapAlloc(NULL, count * 2 * sizeof(uint16_t));
+    if( tables == NULL )
+      return 0;
+    if( lg.space != NULL )
+      chHeapFree(lg.space);
+    lg.space = tables;
+    lg.hue = tables + count;
+    lg.alloc = count;
+  }
+  if( &lg.genome != g )
+    lg.genome = *g;
+  lg.count = count;
+
+  lg.tau = (uint32_t) map(g->cd_rate, 0, 255, 700, 8000);
+  lg.tau_recip = (1UL << 24) / lg.tau;
+  lg.hue_rate = g->hue_ratedir & 0xF;
+  lg.hue_dir = (((g->hue_ratedir >> 4) & 0xF) > 10) ? 1 : 0;
+  lg.forward = (g->cd_dir > 128) ? 1 : 0;
+  lg.sat = g->sat;
+  lg.lin = (g->lin < 90) ? 1 : 0;  // rare variant after a summing expression ~3% chance
+
+  // per-pixel phase of the value wave: cd_period turns over the strip,
+  // whole turns drop out so only the fractional part is kept
+  // per-pixel hue offset: the pattern applied from 0-7 is inversely applied from 8-15
+  hue_step = (count / 2) ? (128L / (count / 2)) : 0;
+  for( i = 0; i < count; i++ ) {
+    if( count > 1 )
+      lg.space[i] = (uint16_t) ((((uint32_t) g->cd_period * i) % (count - 1)) *
+                                (1UL << LIGHTGENE_PHASE_BITS) / (count - 1));
+    else
+      lg.space[i] = 0;
+    lg.hue[i] = (uint16_t) ((hue_step * i) & 0x1FF);
+  }
+
+  for( i = 0; i < 256; i++ ) {
+    lg.hue_map[i] = (uint8_t) map_16( (int16_t) i, 0, 255,
+                                      (int16_t) g->hue_base, (int16_t) g->hue_bound );
+  }
+
+  // value = 127 * (1 + cos(phase)), cos b/c value is 1.0 when the phase is 0
+  twopi = fix16_mul( fix16_from_int(2), fix16_pi );
+  for( i = 0; i < VALUE_STEPS; i++ ) {
+    cosv = fix16_cos( fix16_mul(twopi, (fix16_t) (i << (16 - LIGHTGENE_VALUE_BITS))) );
+    v = (uint8_t) fix16_to_int( fix16_mul( fix16_from_int(127),
+                                           fix16_add( fix16_from_int(1), cosv )));
+    if( g->nonlin > 127 )
+      // add some nonlinearity to gamma-correct brightness
+      v = (uint8_t) (((uint16_t) v * (uint16_t) v) >> 8 & 0xFF);
+    lg.value[i] = v;
+  }
+
+  return 1;
+}
+
+uint32_t lightgeneTau(void) {
+  return lg.tau;
+}
+
+void lightgeneRender(uint8_t *fb, uint32_t count, uint32_t loop, uint32_t elapsed,
+                     uint8_t sat_offset, uint8_t shift) {
+  HsvColor hsvC;
+  RgbColor rgbC;
+  uint8_t *buf;
+  uint32_t i;
+  uint32_t shoot = count;  // no shooting pixel
+  uint32_t hue_time;
+  uint32_t hue_temp;
+  uint16_t time;
+  uint16_t phase;
+  int32_t v0, v1;
+  uint8_t overshift;
+
+  if( (count != lg.count) && !lightgeneCompile(&lg.genome, count) )
+    return;
+
+  // time = -(elapsed / tau) turns, space +/- time based on direction
+  time = (uint16_t) ((elapsed * lg.tau_recip) >> (24 - LIGHTGENE_PHASE_BITS));
+  if( lg.forward )
+    time = -time;
+
+  hue_time = loop * lg.hue_rate;
+  hsvC.s = satadd_8(lg.sat, sat_offset);
+
+  if( lg.lin )
+    shoot = loop % count;
+  overshift = shift - 2; // make the shooting pixel brighter so it's obvious
+  if( overshift > 4 )
+    overshift = 4;
+
+  for( i = 0; i < count; i++ ) {
+    buf = fb + (3 * i);
+    if( i == shoot ) {
+      buf[0] = 255 >> overshift;
+      buf[1] = 255 >> overshift;
+      buf[2] = 255 >> overshift;
+      continue;
+    }
+
+    if( !lg.hue_dir )
+      hue_temp = (lg.hue[i] + hue_time) & 0x1FF;
+    else
+      hue_temp = (lg.hue[i] - hue_time) & 0x1FF;
+    if( hue_temp > 0xFF )
+      hue_temp = 511 - hue_temp;
+    hsvC.h = lg.hue_map[hue_temp];
+
+    phase = lg.space[i] + time;
+    v0 = lg.value[phase >> VALUE_FRAC_BITS];
+    v1 = lg.value[((phase >> VALUE_FRAC_BITS) + 1) & (VALUE_STEPS - 1)];
+    hsvC.v = (uint8_t) (v0 + (((v1 - v0) * (phase & ((1 << VALUE_FRAC_BITS) - 1))) >> VALUE_FRAC_BITS));
+
+    rgbC = HsvToRgb(hsvC);
+    buf[0] = rgbC.g >> shift;
+    buf[1] = rgbC.r >> shift;
+    buf[2] = rgbC.b >> shift;
+  }
+}
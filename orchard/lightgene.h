@@ -0,0 +1,30 @@
+#ifndef __LIGHTGENE_H__
+#define __LIGHTGENE_H__
+
+#include "hal.h"
+#include "genes.h"
+
+// The lightgene effect is a function of the expressed genome, the pixel index
+// and the time. Everything that only depends on the genome and the pixel index
+// is compiled into tables once per genome change, so that rendering a frame
+// only takes adds, shifts and table lookups -- the M0+ has no divider, and
+// the fix16 divides/cosines per pixel used to dominate the effects thread.
+
+// phases are expressed in 1/65536ths of a turn, so they wrap for free in a uint16_t
+#define LIGHTGENE_PHASE_BITS   16
+// the cosine/gamma table has 2^LIGHTGENE_VALUE_BITS entries per turn, linearly interpolated
+#define LIGHTGENE_VALUE_BITS   8
+
+// compile the effect for a genome and a pixel count
+// returns 0 if the tables for count pixels couldn't be allocated
+uint8_t lightgeneCompile(const genome *g, uint32_t count);
+
+// period of the temporal wave in system ticks, as encoded by the compiled genome
+uint32_t lightgeneTau(void);
+
+// render one frame into fb (GRB, 3 bytes per pixel)
+// elapsed is the time since the start of the current wave period, 0..tau
+void lightgeneRender(uint8_t *fb, uint32_t count, uint32_t loop, uint32_t elapsed,
+                     uint8_t sat_offset, uint8_t shift);
+
+#endif /* __LIGHTGENE_H__ */
@@ -17,6 +17,7 @@
 #include "ch.h"
 #include "hal.h"
 #include "i2c.h"
+#include "i2c-queue.h"
 #include "spi.h"
 
 #include "shell.h"
@@ -25,6 +26,7 @@
 #include "orchard.h"
 #include "orchard-shell.h"
 #include "orchard-events.h"
+#include "orchard-evq.h"
 #include "orchard-app.h"
 #include "orchard-test.h"
 #include "orchard-math.h"
@@ -39,6 +41,7 @@
 #include "oled.h"
 #include "radio.h"
 #include "flash.h"
+#include "storage.h"
 #include "analog.h"
 #include "gasgauge.h"
 #include "genes.h"
@@ -47,6 +50,8 @@
 
 #include "gfx.h"
 
+#include <string.h>
+
 struct evt_table orchard_events;
 
 uint8_t pee_pbe(void);
@@ -58,8 +63,9 @@ void cpuVLLS0(void);
 
 #define LED_COUNT 16
 #define UI_LED_COUNT 16
-static uint8_t fb[LED_COUNT * 3];
-static uint8_t ui_fb[LED_COUNT * 3];
+// word aligned so the LED compositor can blend them a word at a time
+static uint8_t fb[LED_COUNT * 3] __attribute__((aligned(4)));
+static uint8_t ui_fb[LED_COUNT * 3] __attribute__((aligned(4)));
 
 static const I2CConfig i2c_config = {
   100000
@@ -89,8 +95,7 @@ static void orchard_app_restart(eventid_t id) {
   static int i = 1;
   (void)id;
 
-  chprintf(stream, "\r\nRunning next app (pid #%d)\r\n", ++i);
-  orchardAppRestart();
+  chprintf(stream, "\r\nRunning next app (switch #%d)\r\n", ++i);
 }
 
 static void key_mod(eventid_t id) {
@@ -165,11 +170,15 @@ static void key_mod(eventid_t id) {
 }
 
 static void freefall(eventid_t id) {
+  OrchardAppEvent evt;
 
   (void)id;
   chprintf(stream, "A");
   bump(5);
-  chEvtBroadcast(&accel_bump);
+  memset(&evt, 0, sizeof(evt));
+  evt.type = accelEvent;
+  evt.accel.code = accelCodeBump;
+  evqPost(&app_evq, &evt);
 }
 
 extern int print_hex(BaseSequentialStream *chp,
@@ -253,9 +262,11 @@ int main(void)
   print_mcu_info();
 
   flashStart();
+  storageStart();
   orchardTestInit();
 
   i2cStart(i2cDriver, &i2c_config);
+  i2cqStart(i2cDriver);
   spiStart(&SPID1, &spi_config);
   spiStart(&SPID2, &spi_config);
   adcStart(&ADCD1, &adccfg1);
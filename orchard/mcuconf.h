@@ -73,6 +73,9 @@
 #define KINETIS_SPI_USE_SPI1                    TRUE
 #define KINETIS_SPI_SPI0_IRQ_PRIORITY           3
 #define KINETIS_SPI_SPI1_IRQ_PRIORITY           1
+/* OLED frames on SPI1; channels 0-2 belong to the WS2812B driver */
+#define KINETIS_SPI_USE_SPI1_DMA                TRUE
+#define KINETIS_SPI_SPI1_DMA_CHANNEL            3
 
 /*
  * I2C system settings.
@@ -0,0 +1,76 @@
+#include "mic-features.h"
+#include "orchard-math.h"
+
+#include <string.h>
+
+#define LP_LOW_SHIFT    3   // alpha 1/8, ~130Hz at MIC_SAMPLE_RATE
+#define LP_MID_SHIFT    1   // alpha 1/2, ~700Hz
+#define DC_SHIFT        10  // alpha 1/1024, ~1Hz
+
+void micPipelineInit(mic_pipeline *p) {
+  memset(p, 0, sizeof(*p));
+  p->dc = MIC_BIAS << 16;
+}
+
+// square of a filter output kept << 8, in sample units squared
+static inline uint32_t energy(int32_t v) {
+  v >>= 4;
+  return (uint32_t) (v * v) >> 8;
+}
+
+void micPipelineRun(mic_pipeline *p, const uint8_t *samples, uint32_t n,
+                    mic_features *out) {
+  uint32_t sq = 0;
+  uint32_t bands[MIC_BANDS] = {0, 0, 0};
+  uint32_t peak = 0;
+  uint32_t i, mag;
+  int32_t dc, x, lp_low, lp_mid;
+
+  dc = p->dc;
+  lp_low = p->lp_low;
+  lp_mid = p->lp_mid;
+  for( i = 0; i < n; i++ ) {
+    // the bias is tracked sample by sample, a block is too short to
+    // average out a bass tone
+    dc += (((int32_t) samples[i] << 16) - dc) >> DC_SHIFT;
+    x = ((int32_t) samples[i] << 8) - (dc >> 8);
+
+    mag = (uint32_t) (x < 0 ? -x : x) >> 8;
+    if( mag > peak )
+      peak = mag;
+    sq += energy(x);
+
+    lp_low += (x - lp_low) >> LP_LOW_SHIFT;
+    lp_mid += (x - lp_mid) >> LP_MID_SHIFT;
+    bands[MIC_BAND_LOW] += energy(lp_low);
+    bands[MIC_BAND_MID] += energy(lp_mid - lp_low);
+    bands[MIC_BAND_HIGH] += energy(x - lp_mid);
+  }
+  p->dc = dc;
+  p->lp_low = lp_low;
+  p->lp_mid = lp_mid;
+
+  out->seq = p->seq++;
+  out->dc = (uint8_t) ((dc + (1 << 15)) >> 16);
+  out->peak = (uint8_t) (peak > 255 ? 255 : peak);
+  out->rms = isqrt_32(sq / n);
+  for( i = 0; i < MIC_BANDS; i++ )
+    out->bands[i] = bands[i] / n;
+
+  // onset: the bass jumps well over its recent average
+  out->beat = 0;
+  if( p->holdoff != 0 ) {
+    p->holdoff--;
+  }
+  else if( (out->bands[MIC_BAND_LOW] >= MIC_BEAT_MIN_ENERGY) &&
+           (out->bands[MIC_BAND_LOW] * MIC_BEAT_RATIO_DEN >
+            p->beat_avg * MIC_BEAT_RATIO_NUM) ) {
+    out->beat = 1;
+    p->holdoff = MIC_BEAT_HOLDOFF;
+  }
+  if( out->bands[MIC_BAND_LOW] >= p->beat_avg )
+    p->beat_avg += (out->bands[MIC_BAND_LOW] - p->beat_avg) >> MIC_BEAT_RISE_SHIFT;
+  else
+    p->beat_avg -= (p->beat_avg - out->bands[MIC_BAND_LOW]) >> MIC_BEAT_FALL_SHIFT;
+  out->beat_avg = p->beat_avg;
+}
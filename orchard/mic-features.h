@@ -0,0 +1,55 @@
+#ifndef __ORCHARD_MIC_FEATURES_H__
+#define __ORCHARD_MIC_FEATURES_H__
+
+#include <stdint.h>
+
+// Streaming feature extraction for the microphone. Every block of samples
+// captured by analog.c is run through micPipelineRun(), which keeps its
+// filter and beat tracking state from one block to the next so the
+// features stay continuous across blocks.
+//
+// Bands are split with one-pole low-pass filters at about 130Hz and 700Hz:
+// bass below the first, mids between the two, highs above the second.
+// A beat onset is a block whose bass energy jumps over 3/2 of
+// its running average, at most once every MIC_BEAT_HOLDOFF blocks. The
+// average rises faster than it decays, so a sustained bass note only counts
+// once.
+
+#define MIC_SAMPLE_RATE       6250  // Hz, set by the ADC clock and averaging
+#define MIC_BIAS              128   // mid-scale, where the DC tracking starts
+#define MIC_BANDS             3
+#define MIC_BAND_LOW          0
+#define MIC_BAND_MID          1
+#define MIC_BAND_HIGH         2
+
+#define MIC_BEAT_RATIO_NUM    3     // onset when energy > 3/2 of the average
+#define MIC_BEAT_RATIO_DEN    2
+#define MIC_BEAT_MIN_ENERGY   64    // ignores onsets out of near silence
+#define MIC_BEAT_HOLDOFF      8     // blocks, ~160ms at 128 samples a block
+#define MIC_BEAT_RISE_SHIFT   1     // the average catches up with a loud bass in a few blocks,
+#define MIC_BEAT_FALL_SHIFT   3     // and decays over ~8 blocks once it stops
+
+typedef struct mic_features {
+  uint32_t  seq;                // block number
+  uint8_t   dc;                 // bias level, tracked across blocks
+  uint8_t   peak;               // largest deviation from dc
+  uint16_t  rms;                // RMS deviation from dc, in sample units
+  uint32_t  bands[MIC_BANDS];   // mean square per band, in sample units squared
+  uint32_t  beat_avg;           // running average of the bass energy
+  uint8_t   beat;               // 1 if a beat starts in this block
+} mic_features;
+
+typedef struct mic_pipeline {
+  int32_t   dc;                 // sample units << 16
+  int32_t   lp_low;             // filter states, sample units << 8
+  int32_t   lp_mid;
+  uint32_t  beat_avg;
+  uint8_t   holdoff;
+  uint32_t  seq;
+} mic_pipeline;
+
+void micPipelineInit(mic_pipeline *p);
+void micPipelineRun(mic_pipeline *p, const uint8_t *samples, uint32_t n,
+                    mic_features *out);
+
+#endif /* __ORCHARD_MIC_FEATURES_H__ */
@@ -0,0 +1,187 @@
+#include "motion.h"
+
+#include <string.h>
+
+enum {
+  tapIdle = 0,
+  tapSpike,     // over MOTION_TAP_THRESH, counting its length
+  tapQuiet,     // spike ended, waiting for it to stay quiet
+  tapBusy,      // too long to be a tap, waiting for the motion to settle
+};
+
+void motionInit(motion_engine *m) {
+  memset(m, 0, sizeof(*m));
+}
+
+static inline int32_t iabs(int32_t v) {
+  return v < 0 ? -v : v;
+}
+
+static motion_orient orient_of(int32_t x, int32_t y, int32_t z) {
+  int32_t ax = iabs(x), ay = iabs(y), az = iabs(z);
+
+  if( (az >= ax) && (az >= ay) && (az >= MOTION_ORIENT_MIN) )
+    return z > 0 ? motionOrientFaceUp : motionOrientFaceDown;
+  if( (ay >= ax) && (ay >= MOTION_ORIENT_MIN) )
+    return y > 0 ? motionOrientPortraitDown : motionOrientPortraitUp;
+  if( ax >= MOTION_ORIENT_MIN )
+    return x > 0 ? motionOrientLandscapeRight : motionOrientLandscapeLeft;
+  return motionOrientUnknown;
+}
+
+static void emit(motion_engine *m, motion_type type, motion_event *out,
+                 unsigned max, unsigned *count) {
+  if( *count >= max )
+    return;
+  out[*count].type = type;
+  out[*count].orient = m->orient;
+  out[*count].x = (int16_t) (m->gx >> MOTION_GRAVITY_SHIFT);
+  out[*count].y = (int16_t) (m->gy >> MOTION_GRAVITY_SHIFT);
+  (*count)++;
+}
+
+static void tap_step(motion_engine *m, int32_t motion, motion_event *out,
+                     unsigned max, unsigned *count) {
+  switch( m->tap_state ) {
+  case tapIdle:
+    if( motion > MOTION_TAP_THRESH ) {
+      m->tap_state = tapSpike;
+      m->tap_count = 1;
+    }
+    break;
+
+  case tapSpike:
+    if( motion > MOTION_TAP_QUIET_LEVEL ) {
+      if( ++m->tap_count > MOTION_TAP_LENGTH ) {
+        m->tap_state = tapBusy;
+        m->tap_count = 0;
+      }
+    }
+    else {
+      m->tap_state = tapQuiet;
+      m->tap_count = 1;
+    }
+    break;
+
+  case tapQuiet:
+    if( motion > MOTION_TAP_QUIET_LEVEL ) {
+      m->tap_state = tapBusy;
+      m->tap_count = 0;
+    }
+    else if( ++m->tap_count >= MOTION_TAP_QUIET ) {
+      m->tap_state = tapIdle;
+      emit(m, motionTap, out, max, count);
+    }
+    break;
+
+  case tapBusy:
+  default:
+    if( motion > MOTION_TAP_QUIET_LEVEL )
+      m->tap_count = 0;
+    else if( ++m->tap_count >= MOTION_TAP_QUIET )
+      m->tap_state = tapIdle;
+    break;
+  }
+}
+
+static void shake_step(motion_engine *m, int32_t motion, motion_event *out,
+                       unsigned max, unsigned *count) {
+  if( m->shake_holdoff != 0 ) {
+    m->shake_holdoff--;
+    return;
+  }
+
+  if( m->shake_window != 0 )
+    m->shake_window--;
+  else
+    m->shake_hits = 0;
+
+  if( motion > MOTION_SHAKE_THRESH ) {
+    if( m->shake_hits++ == 0 )
+      m->shake_window = MOTION_SHAKE_WINDOW;
+    if( m->shake_hits >= MOTION_SHAKE_COUNT ) {
+      m->shake_hits = 0;
+      m->shake_window = 0;
+      m->shake_holdoff = MOTION_SHAKE_HOLDOFF;
+      // the spikes of a shake are not taps
+      m->tap_state = tapBusy;
+      m->tap_count = 0;
+      emit(m, motionShake, out, max, count);
+    }
+  }
+}
+
+static void orient_step(motion_engine *m, motion_event *out,
+                        unsigned max, unsigned *count) {
+  motion_orient now;
+
+  now = orient_of(m->gx >> MOTION_GRAVITY_SHIFT, m->gy >> MOTION_GRAVITY_SHIFT,
+                  m->gz >> MOTION_GRAVITY_SHIFT);
+  if( (now == motionOrientUnknown) || (now == m->orient) ) {
+    m->orient_hold = 0;
+    return;
+  }
+
+  if( now != m->orient_next ) {
+    m->orient_next = now;
+    m->orient_hold = 1;
+  }
+  else if( ++m->orient_hold >= MOTION_ORIENT_HOLD ) {
+    m->orient = now;
+    m->orient_hold = 0;
+    emit(m, motionOrient, out, max, count);
+  }
+}
+
+static void tilt_step(motion_engine *m, motion_event *out,
+                      unsigned max, unsigned *count) {
+  int32_t x = m->gx >> MOTION_GRAVITY_SHIFT;
+  int32_t y = m->gy >> MOTION_GRAVITY_SHIFT;
+
+  if( (iabs(x - m->tilt_x) >= MOTION_TILT_STEP) ||
+      (iabs(y - m->tilt_y) >= MOTION_TILT_STEP) ) {
+    m->tilt_x = (int16_t) x;
+    m->tilt_y = (int16_t) y;
+    emit(m, motionTilt, out, max, count);
+  }
+}
+
+unsigned motionRun(motion_engine *m, const motion_sample *samples, unsigned n,
+                   motion_event *out, unsigned max) {
+  const motion_sample *s;
+  unsigned count = 0;
+  unsigned i;
+  int32_t motion;
+
+  for( i = 0; i < n; i++ ) {
+    s = &samples[i];
+
+    // the first sample is all gravity, so nothing moves at start
+    if( !m->primed ) {
+      m->primed = 1;
+      m->gx = (int32_t) s->x << MOTION_GRAVITY_SHIFT;
+      m->gy = (int32_t) s->y << MOTION_GRAVITY_SHIFT;
+      m->gz = (int32_t) s->z << MOTION_GRAVITY_SHIFT;
+      m->tilt_x = s->x;
+      m->tilt_y = s->y;
+      m->orient = orient_of(s->x, s->y, s->z);
+      continue;
+    }
+
+    // whatever is not gravity is motion, summed over the axes
+    motion = iabs(s->x - (m->gx >> MOTION_GRAVITY_SHIFT)) +
+             iabs(s->y - (m->gy >> MOTION_GRAVITY_SHIFT)) +
+             iabs(s->z - (m->gz >> MOTION_GRAVITY_SHIFT));
+
+    m->gx += s->x - (m->gx >> MOTION_GRAVITY_SHIFT);
+    m->gy += s->y - (m->gy >> MOTION_GRAVITY_SHIFT);
+    m->gz += s->z - (m->gz >> MOTION_GRAVITY_SHIFT);
+
+    shake_step(m, motion, out, max, &count);
+    tap_step(m, motion, out, max, &count);
+    orient_step(m, out, max, &count);
+    tilt_step(m, out, max, &count);
+  }
+
+  return count;
+}
@@ -0,0 +1,93 @@
+#ifndef __ORCHARD_MOTION_H__
+#define __ORCHARD_MOTION_H__
+
+#include <stdint.h>
+
+// Integer motion detection over the accelerometer stream. Every sample
+// captured by accel.c is run through motionRun(), which keeps a low-passed
+// gravity vector and a little state per detector from one sample to the
+// next, and reports what happened as motion_events.
+//
+// - tilt: gravity moved by MOTION_TILT_STEP on x or y since the last report
+// - shake: the motion on top of gravity is over MOTION_SHAKE_THRESH on
+//   MOTION_SHAKE_COUNT samples within MOTION_SHAKE_WINDOW
+// - tap: a spike over MOTION_TAP_THRESH at most MOTION_TAP_LENGTH samples
+//   long, followed by MOTION_TAP_QUIET quiet samples
+// - orientation: another axis took gravity and held it for
+//   MOTION_ORIENT_HOLD samples
+//
+// Counts are 12 bit two's complement at +/-2g, samples come in at
+// MOTION_SAMPLE_RATE.
+
+#define MOTION_SAMPLE_RATE    50    // Hz
+#define MOTION_1G             1024  // counts per g
+
+#define MOTION_GRAVITY_SHIFT  3     // alpha 1/8, ~0.16s at MOTION_SAMPLE_RATE
+#define MOTION_TILT_STEP      64    // counts, ~3.6 degrees
+
+#define MOTION_SHAKE_THRESH   (MOTION_1G * 3 / 4)   // sum over the axes
+#define MOTION_SHAKE_COUNT    4
+#define MOTION_SHAKE_WINDOW   25    // samples, 0.5s
+#define MOTION_SHAKE_HOLDOFF  25    // samples after a shake before the next one
+
+#define MOTION_TAP_THRESH     (MOTION_1G / 2)
+#define MOTION_TAP_QUIET_LEVEL (MOTION_1G / 8)
+#define MOTION_TAP_LENGTH     2     // samples, longer is not a tap
+#define MOTION_TAP_QUIET      5     // samples, 0.1s
+
+#define MOTION_ORIENT_MIN     (MOTION_1G * 3 / 4)   // gravity on the axis
+#define MOTION_ORIENT_HOLD    10    // samples, 0.2s
+
+typedef struct motion_sample {
+  int16_t   x;
+  int16_t   y;
+  int16_t   z;
+} motion_sample;
+
+typedef enum motion_type {
+  motionTilt = 0,
+  motionShake,
+  motionTap,
+  motionOrient,
+} motion_type;
+
+// which axis gravity pulls along, named for the badge held up facing you
+typedef enum motion_orient {
+  motionOrientUnknown = 0,
+  motionOrientPortraitUp,       // -y
+  motionOrientPortraitDown,     // +y
+  motionOrientLandscapeLeft,    // -x
+  motionOrientLandscapeRight,   // +x
+  motionOrientFaceUp,           // +z
+  motionOrientFaceDown,         // -z
+} motion_orient;
+
+typedef struct motion_event {
+  uint8_t   type;     // motion_type
+  uint8_t   orient;   // motion_orient, for every type
+  int16_t   x;        // gravity in counts, for every type
+  int16_t   y;
+} motion_event;
+
+typedef struct motion_engine {
+  int32_t   gx, gy, gz;         // gravity, counts << MOTION_GRAVITY_SHIFT
+  int16_t   tilt_x, tilt_y;     // gravity at the last tilt event
+  uint8_t   primed;
+  uint8_t   shake_hits;
+  uint8_t   shake_window;
+  uint8_t   shake_holdoff;
+  uint8_t   tap_state;
+  uint8_t   tap_count;
+  uint8_t   orient;
+  uint8_t   orient_next;
+  uint8_t   orient_hold;
+} motion_engine;
+
+void motionInit(motion_engine *m);
+
+// Runs n samples through the engine and stores up to max events in out.
+// Returns the number of events stored; events past max are dropped.
+unsigned motionRun(motion_engine *m, const motion_sample *samples, unsigned n,
+                   motion_event *out, unsigned max);
+
+#endif /* __ORCHARD_MOTION_H__ */
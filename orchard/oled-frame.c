@@ -0,0 +1,129 @@
+#include "oled-frame.h"
+
+#include <string.h>
+
+void oledFrameEndDraw(oled_frame *f) {
+  memset(f->inval_lo, OLED_WIDTH, sizeof(f->inval_lo));
+  memset(f->inval_hi, 0, sizeof(f->inval_hi));
+  f->invalidated = 0;
+  f->diff = 0;
+}
+
+void oledFrameInit(oled_frame *f) {
+  memset(f, 0, sizeof(*f));
+  oledFrameEndDraw(f);
+}
+
+void oledFrameLost(oled_frame *f) {
+  f->valid = 0;
+}
+
+void oledFrameInvalidate(oled_frame *f, int x, int y, int cx, int cy) {
+  int page, last;
+
+  if( x < 0 ) {
+    cx += x;
+    x = 0;
+  }
+  if( y < 0 ) {
+    cy += y;
+    y = 0;
+  }
+  if( x + cx > OLED_WIDTH )
+    cx = OLED_WIDTH - x;
+  if( y + cy > OLED_PAGES * 8 )
+    cy = OLED_PAGES * 8 - y;
+  if( (cx <= 0) || (cy <= 0) )
+    return;
+
+  f->invalidated = 1;
+  last = (y + cy - 1) / 8;
+  for( page = y / 8; page <= last; page++ ) {
+    if( x < f->inval_lo[page] )
+      f->inval_lo[page] = x;
+    if( x + cx - 1 > f->inval_hi[page] )
+      f->inval_hi[page] = x + cx - 1;
+  }
+}
+
+void oledFrameSetDiff(oled_frame *f, int on) {
+  f->diff = !!on;
+}
+
+void oledFrameWrite(oled_frame *f, const uint8_t *data, size_t n) {
+  unsigned page, col;
+  int changed;
+
+  while( n-- ) {
+    page = f->pos / OLED_WIDTH;
+    col = f->pos % OLED_WIDTH;
+
+    if( !f->valid )
+      changed = 1;
+    else if( f->invalidated &&
+             ((col < f->inval_lo[page]) || (col > f->inval_hi[page])) )
+      changed = 0;
+    else
+      changed = !f->diff || (f->shadow[f->pos] != *data);
+
+    if( changed ) {
+      f->shadow[f->pos] = *data;
+      f->dirty[page][col / 32] |= 1UL << (col % 32);
+    }
+
+    data++;
+    f->written++;
+    f->pos = (f->pos + 1) % OLED_FRAME_SIZE;
+  }
+}
+
+// first column to send from col on, OLED_WIDTH if none
+static unsigned next_dirty(const oled_frame *f, unsigned page, unsigned col) {
+  uint32_t bits;
+
+  while( col < OLED_WIDTH ) {
+    bits = f->dirty[page][col / 32] >> (col % 32);
+    if( bits == 0 ) {
+      col = (col / 32 + 1) * 32;
+      continue;
+    }
+    while( !(bits & 1) ) {
+      bits >>= 1;
+      col++;
+    }
+    return col;
+  }
+  return OLED_WIDTH;
+}
+
+void oledFrameSend(oled_frame *f, oled_segment_t segment, void *ctx) {
+  unsigned page, col, start, end;
+  uint32_t sent = 0, segments = 0;
+
+  for( page = 0; page < OLED_PAGES; page++ ) {
+    col = next_dirty(f, page, 0);
+    while( col < OLED_WIDTH ) {
+      // the segment runs over short gaps, the panel already shows them
+      start = end = col;
+      while( ((col = next_dirty(f, page, end + 1)) < OLED_WIDTH) &&
+             (col - end - 1 <= OLED_SEGMENT_GAP) )
+        end = col;
+
+      segment(ctx, page, start, &f->shadow[page * OLED_WIDTH + start],
+              end - start + 1);
+      sent += end - start + 1;
+      segments++;
+    }
+  }
+  memset(f->dirty, 0, sizeof(f->dirty));
+
+  if( f->written >= OLED_FRAME_SIZE )
+    f->valid = 1;
+  if( segments != 0 )
+    f->stats.flushes++;
+  f->stats.segments += segments;
+  f->stats.bytes_sent += sent;
+  if( f->written > sent )
+    f->stats.bytes_skipped += f->written - sent;
+  f->written = 0;
+}
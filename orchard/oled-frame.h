@@ -0,0 +1,68 @@
+#ifndef __ORCHARD_OLED_FRAME_H__
+#define __ORCHARD_OLED_FRAME_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Keeps what the SSD1306 shows, so a flush only sends what changed. The
+// gdisp driver still hands over the whole frame on every flush, page after
+// page from the top left. The bytes go into a shadow of the panel memory,
+// and for each page the columns that changed are sent as segments.
+//
+// What counts as changed is up to the frame being drawn:
+//  - by default every byte of the flushed frame, as before;
+//  - with rectangles invalidated, only bytes inside them: an app that
+//    knows what it redrew doesn't pay for the rest of the screen;
+//  - with frame diff on, only bytes that differ from the shadow: for apps
+//    that clear and redraw the whole screen with mostly the same content.
+// Until the panel was written once in full, everything counts as changed.
+
+#define OLED_WIDTH        128
+#define OLED_PAGES        8     // rows of 8 pixels
+#define OLED_FRAME_SIZE   (OLED_WIDTH * OLED_PAGES)
+
+// unchanged columns sent along rather than starting a new segment, about
+// what the addressing commands of a segment cost
+#define OLED_SEGMENT_GAP  6
+
+typedef struct oled_frame_stats {
+  uint32_t      flushes;        // frames that sent at least one segment
+  uint32_t      segments;
+  uint32_t      bytes_sent;     // data bytes that went to the panel
+  uint32_t      bytes_skipped;  // bytes of the flushed frames that did not
+} oled_frame_stats;
+
+// sends n bytes of panel memory, starting at column col of page
+typedef void (*oled_segment_t)(void *ctx, unsigned page, unsigned col,
+                               const uint8_t *data, size_t n);
+
+typedef struct oled_frame {
+  uint8_t           shadow[OLED_FRAME_SIZE];  // what the panel shows
+  uint32_t          dirty[OLED_PAGES][OLED_WIDTH / 32];   // columns to send
+  uint8_t           inval_lo[OLED_PAGES];     // invalidated columns per page
+  uint8_t           inval_hi[OLED_PAGES];
+  uint8_t           invalidated;    // rectangles were invalidated
+  uint8_t           diff;           // frame diff is on
+  uint8_t           valid;          // the shadow matches the panel
+  uint16_t          pos;            // where the next byte goes
+  uint32_t          written;        // bytes handed over since the last send
+  oled_frame_stats  stats;
+} oled_frame;
+
+void oledFrameInit(oled_frame *f);
+
+// the panel lost its memory, the next flush sends everything
+void oledFrameLost(oled_frame *f);
+
+// Options of the frame being drawn, dropped by oledFrameEndDraw().
+void oledFrameInvalidate(oled_frame *f, int x, int y, int cx, int cy);
+void oledFrameSetDiff(oled_frame *f, int on);
+void oledFrameEndDraw(oled_frame *f);
+
+// A flush: the bytes of the frame in panel order, then the segments that
+// changed are sent. Like the panel memory with horizontal addressing, the
+// position wraps around at the end of the frame.
+void oledFrameWrite(oled_frame *f, const uint8_t *data, size_t n);
+void oledFrameSend(oled_frame *f, oled_segment_t segment, void *ctx);
+
+#endif /* __ORCHARD_OLED_FRAME_H__ */
@@ -1,10 +1,12 @@
 #include "ch.h"
 #include "hal.h"
 #include "oled.h"
+#include "oled-frame.h"
 #include "spi.h"
 
 #include "orchard.h"
 #include "gpiox.h"
+#include "spi-arbiter.h"
 #include "orchard-ui.h"
 
 #include "gfx.h"
@@ -12,7 +14,11 @@
 #include "orchard-test.h"
 #include "test-audit.h"
 
+#include <string.h>
+
 static SPIDriver *driver;
+static spiarb_device spi;
+static oled_frame frame;
 
 static void oled_command_mode(void) {
 #if ORCHARD_BOARD_REV == ORCHARD_REV_EVT1
@@ -57,11 +63,15 @@ void oledStop(SPIDriver *spip) {
   
   // wait 100ms per datasheet
   chThdSleepMilliseconds(100);
+
+  oledFrameLost(&frame);
 }
 
 void oledStart(SPIDriver *spip) {
 
   driver = spip;
+  spiarbDeviceInit(&spi, spiarbBus(spip), "oled", spiarbPrioDisplay);
+  oledFrameInit(&frame);
 
   gpioxSetPadMode(GPIOX, oledResPad, GPIOX_OUT_PUSHPULL | GPIOX_VAL_HIGH);
   gpioxSetPadMode(GPIOX, 4, GPIOX_OUT_PUSHPULL | GPIOX_VAL_HIGH);
@@ -74,22 +84,69 @@ void oledCmd(uint8_t cmd) {
   spiSend(driver, 1, &cmd);
 }
 
-void oledData(uint8_t *data, uint16_t length) {
-  unsigned int i;
+// a window of one page from col on, then its data. between two segments
+// the bus goes to whoever of higher priority waits for it
+static void oled_segment(void *ctx, unsigned page, unsigned col,
+                         const uint8_t *data, size_t n) {
+  const uint8_t window[6] = {
+    0x21, col, col + n - 1,   // column address
+    0x22, page, page,         // page address
+  };
+  (void)ctx;
+
+  if( spiarbWaiting(&spi) ) {
+    oled_unselect();
+    spiarbYield(&spi);
+    oled_select();
+  }
 
+  oled_command_mode();
+  spiSend(driver, sizeof(window), window);
+  // long enough segments go out by DMA
   oled_data_mode();
-  for( i = 0; i < length; i++ )
-    spiSend(driver, 1, &data[i]);
+  spiSend(driver, n, data);
+}
+
+// The driver's frame goes into the shadow, and only the segments that
+// changed go out when it releases the bus.
+void oledData(uint8_t *data, uint16_t length) {
+  oledFrameWrite(&frame, data, length);
 }
 
 void oledAcquireBus(void) {
-  spiAcquireBus(driver);
+  spiarbAcquire(&spi);
   oled_select();
 }
 
 void oledReleaseBus(void) {
+  if( frame.written != 0 ) {
+    // windows only work with horizontal addressing
+    oledCmd(0x20);
+    oledCmd(0x00);
+    oledFrameSend(&frame, oled_segment, NULL);
+  }
   oled_unselect();
-  spiReleaseBus(driver);
+  spiarbRelease(&spi);
+}
+
+void oledInvalidate(coord_t x, coord_t y, coord_t cx, coord_t cy) {
+  oledFrameInvalidate(&frame, x, y, cx, cy);
+}
+
+void oledSetFrameDiff(bool on) {
+  oledFrameSetDiff(&frame, on);
+}
+
+void oledEndDraw(void) {
+  oledFrameEndDraw(&frame);
+}
+
+const oled_frame_stats *oledStats(void) {
+  return &frame.stats;
+}
+
+void oledResetStats(void) {
+  memset(&frame.stats, 0, sizeof(frame.stats));
 }
 
 void oledOrchardBanner(void) {
@@ -2,6 +2,8 @@
 #define __OLED_H__
 
 #include "spi.h"
+#include "gfx.h"
+#include "oled-frame.h"
 
 void oledStart(SPIDriver *device);
 void oledStop(SPIDriver *device);
@@ -11,4 +13,13 @@ void oledCmd(uint8_t cmd);
 void oledData(uint8_t *data, uint16_t length);
 void oledOrchardBanner(void);
 
+// Options of the frame being drawn, see oled-frame.h; orchardGfxEnd() drops
+// them.
+void oledInvalidate(coord_t x, coord_t y, coord_t cx, coord_t cy);
+void oledSetFrameDiff(bool on);
+void oledEndDraw(void);
+
+const oled_frame_stats *oledStats(void);
+void oledResetStats(void);
+
 #endif /* __OLED_H__ */
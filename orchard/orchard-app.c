@@ -8,6 +8,7 @@
 #include "orchard.h"
 #include "orchard-app.h"
 #include "orchard-events.h"
+#include "orchard-evq.h"
 #include "orchard-math.h"
 #include "captouch.h"
 #include "orchard-ui.h"
@@ -22,6 +23,8 @@
 #include "TransceiverReg.h"
 #include "gasgauge.h"
 #include "userconfig.h"
+#include "fxprof.h"
+#include "trace.h"
 
 #include "shell.h" // for friend testing function
 #include "orchard-shell.h" // for friend testing function
@@ -41,6 +44,13 @@ static bool run_launcher_timer_engaged;
 
 orchard_app_instance instance;  // the one and in fact only instance of any orchard app
 
+// app state lives here instead of on the host thread's stack
+static uint64_t app_arena_mem[ORCHARD_APP_ARENA / sizeof(uint64_t)];
+
+static volatile bool app_switching;   // leave the current app's event loop
+static uint32_t switch_requested;     // fxprofNow() of the request
+static orchard_app_stats app_stats;
+
 typedef enum _DirIntent {
   dirNone = 0x0,
   dirCW = 0x1,
@@ -56,7 +66,6 @@ static struct jogdial_state {
 
 event_source_t orchard_app_terminated;
 event_source_t orchard_app_terminate;
-event_source_t timer_expired;
 event_source_t ui_completed;
 
 static virtual_timer_t keycollect_timer;
@@ -75,20 +84,12 @@ static virtual_timer_t ping_timer;
 static event_source_t ping_timeout;
 #define PING_MIN_INTERVAL  5000 // base time between pings
 #define PING_RAND_INTERVAL 2000 // randomization zone for pings
-static char *friends[MAX_FRIENDS]; // array of pointers to friends' names; first byte is priority metric
-#define FRIENDS_INIT_CREDIT  4  // defines how long a friend record stays around before expiration
-// max level of credit a friend can have; defines how long a record can stay around
-// once a friend goes away. Roughly equal to
-// 2 * (PING_MIN_INTERVAL + PING_RAND_INTERVAL / 2 * MAX_CREDIT) milliseconds
-#define FRIENDS_MAX_CREDIT   12
-#define FRIENDS_SORT_HYSTERESIS 4 
-
 static uint8_t cleanup_state = 0;
-mutex_t friend_mutex;
 
 static uint8_t ui_override = 0;
 
-void friend_cleanup(void);
+// signalled by app_evq, above the event table ids
+#define APP_EVQ_EVENT   EVENT_MASK(31)
 
 #define MAIN_MENU_MASK  ((1 << 11) | (1 << 0))
 #define MAIN_MENU_VALUE ((1 << 11) | (1 << 0))
@@ -112,10 +113,8 @@ static void handle_ping_timeout(eventid_t id) {
   const struct genes *family;
   family = (const struct genes *) storageGetData(GENE_BLOCK);
 
-  radioAcquire(radioDriver);
   radioSend(radioDriver, RADIO_BROADCAST_ADDRESS, radio_prot_ping,
 	    strlen(family->name) + 1, family->name);
-  radioRelease(radioDriver);
     
   // cleanup every other ping we send, to make sure friends that are
   // nearby build up credit over time to max credits
@@ -124,65 +123,11 @@ static void handle_ping_timeout(eventid_t id) {
   // clean-up rate
   if( cleanup_state ) {
     friend_cleanup();
-    chEvtBroadcast(&radio_app);
+    orchardAppRadioEvent(0, 0, 0);
   }
   cleanup_state = !cleanup_state;
 }
 
-char *friend_lookup(char *name) {
-  int i;
-
-  osalMutexLock(&friend_mutex);
-  for( i = 0; i < MAX_FRIENDS; i++ ) {
-    if( friends[i] != NULL ) {
-      if(0 == strncmp(&(friends[i][1]), name, GENE_NAMELENGTH)) {
-	osalMutexUnlock(&friend_mutex);
-	return friends[i];
-      }
-    }
-  }
-  osalMutexUnlock(&friend_mutex);
-  return NULL;
-}
-
-uint8_t friendCount(void) {
-  int i;
-  uint8_t count = 0;
-  
-  osalMutexLock(&friend_mutex);
-  for( i = 0; i < MAX_FRIENDS; i++ ) {
-    if( friends[i] != NULL )
-      count++;
-  }
-  osalMutexUnlock(&friend_mutex);
-  
-  return count;
-}
-
-char *friend_add(char *name) {
-  char *record;
-  uint32_t i;
-
-  record = friend_lookup(name);
-  if( record != NULL )
-    return record;  // friend already exists, don't add it again
-
-  osalMutexLock(&friend_mutex);
-  for( i = 0; i < MAX_FRIENDS; i++ ) {
-    if( friends[i] == NULL ) {
-      friends[i] = (char *) chHeapAlloc(NULL, GENE_NAMELENGTH + 2); // space for NULL + metric byte
-      friends[i][0] = FRIENDS_INIT_CREDIT;
-      strncpy(&(friends[i][1]), name, GENE_NAMELENGTH);
-      osalMutexUnlock(&friend_mutex);
-      return friends[i];
-    }
-  }
-  osalMutexUnlock(&friend_mutex);
-
-  // if we got here, we couldn't add the friend because we ran out of space
-  return NULL;
-}
-
 // generate a one-time list of random names and populate the friend list
 // for testing only
 void cmd_friendlocal(BaseSequentialStream *chp, int argc, char *argv[]) {
@@ -202,84 +147,13 @@ void cmd_friendlocal(BaseSequentialStream *chp, int argc, char *argv[]) {
 }
 orchard_command("friendlocal", cmd_friendlocal);
 
-// to be called periodically to decrement credits and de-alloc friends we haven't seen in a while
-void friend_cleanup(void) {
-  uint32_t i;
-
-  osalMutexLock(&friend_mutex);
-  for( i = 0; i < MAX_FRIENDS; i++ ) {
-    if( friends[i] == NULL )
-      continue;
-
-    friends[i][0]--;
-    if( friends[i][0] == 0 ) {
-      chHeapFree(friends[i]);
-      friends[i] = NULL;
-    }
-  }
-  osalMutexUnlock(&friend_mutex);
-}
-
-int friend_comp(const void *a, const void *b) {
-  char **mya;
-  char **myb;
-  
-  mya = (char **)a;
-  myb = (char **)b;
-
-  if( *mya == NULL && *myb == NULL )
-    return 0;
-
-  if( *mya == NULL )
-    return 1;
-
-  if( *myb == NULL )
-    return -1;
-
-  if( ((*mya)[0] != (*myb)[0]) &&
-      (((*mya)[0] < (FRIENDS_MAX_CREDIT - FRIENDS_SORT_HYSTERESIS)) ||
-       ((*myb)[0] < (FRIENDS_MAX_CREDIT - FRIENDS_SORT_HYSTERESIS))) ) {
-    return (*mya)[0] > (*myb)[0] ? -1 : 1;
-  } else {
-    // sort alphabetically from here
-    return strncmp(&((*mya)[1]), &((*myb)[1]), GENE_NAMELENGTH + 1);
-  }
-}
-
-void friendsSort(void) {
-  osalMutexLock(&friend_mutex);
-  qsort(friends, MAX_FRIENDS, sizeof(char *), friend_comp);
-  osalMutexUnlock(&friend_mutex);
-}
-
-void friendsLock(void) {
-  osalMutexLock(&friend_mutex);
-}
-
-void friendsUnlock(void) {
-  osalMutexUnlock(&friend_mutex);
-}
-
-const char **friendsGet(void) {
-  return (const char **) friends;   // you shouldn't modify this record outside of here, hence const
-}
-
 static void radio_ping_received(uint8_t prot, uint8_t src, uint8_t dst,
                                    uint8_t length, const void *data) {
-  (void) prot;
-  (void) src;
   (void) dst;
-  (void) length;
-  char *friend;
 
-  friend = friend_lookup((char *) data);
-  if( friend == NULL )
-    friend = friend_add((char *) data);
+  friend_seen((const char *) data);
 
-  if(friend[0] < FRIENDS_MAX_CREDIT)
-    friend[0]++;
-
-  chEvtBroadcast(&radio_app);
+  orchardAppRadioEvent(prot, src, length);
 }
 
 static void meiosis(genome *gamete, const genome *haploidM, const genome *haploidP) {
@@ -628,7 +502,8 @@ static void run_launcher(void *arg) {
   chSysLockFromISR();
   /* Launcher is the first app in the list */
   instance.next_app = orchard_app_list;
-  instance.thr->p_flags |= CH_FLAG_TERMINATE;
+  switch_requested = fxprofNow();
+  app_switching = true;
   chEvtBroadcastI(&orchard_app_terminate);
   run_launcher_timer_engaged = false;
   chSysUnlockFromISR();
@@ -867,62 +742,35 @@ static void run_ping(void *arg) {
   chSysUnlockFromISR();
 }
 
-static void key_event_timer(eventid_t id) {
-  (void)id;
-  captouch_collected_state |= captouchRead(); // accumulate events
+static void key_event_timer(uint16_t mask) {
+  captouch_collected_state |= mask; // accumulate events
 
   // (re)set a timer to collect accumulated events...
   chVTReset(&keycollect_timer);
   chVTSet(&keycollect_timer, MS2ST(COLLECT_INTERVAL), run_keycollect_timer, NULL);
 }
 
-static void adc_temp_event(eventid_t id) {
-  (void) id;
-  OrchardAppEvent evt;
-
-  evt.type = adcEvent;
-  evt.adc.code = adcCodeTemp;
-  if( !ui_override )
-    instance.app->event(instance.context, &evt);
-}
-
-static void adc_mic_event(eventid_t id) {
-  (void) id;
-  OrchardAppEvent evt;
-
-  evt.type = adcEvent;
-  evt.adc.code = adcCodeMic;
-  if( !ui_override )
-    instance.app->event(instance.context, &evt);
-}
-
-static void accel_bump_event(eventid_t id) {
-  (void) id;
-  OrchardAppEvent evt;
-  
-  evt.type = accelEvent;
-  evt.accel.code = accelCodeBump;
-  if( !ui_override )
-    instance.app->event(instance.context, &evt);
-}
-
-static void adc_usb_event(eventid_t id) {
+static void accel_motion_event(eventid_t id) {
   (void) id;
+  static const uint8_t codes[] = {
+    [motionTilt] = accelCodeTilt,
+    [motionShake] = accelCodeShake,
+    [motionTap] = accelCodeTap,
+    [motionOrient] = accelCodePL,
+  };
   OrchardAppEvent evt;
-
-  evt.type = adcEvent;
-  evt.adc.code = adcCodeUsbdet;
-  if( !ui_override )
-    instance.app->event(instance.context, &evt);
-}
-
-static void radio_app_event(eventid_t id) {
-  (void)id;
-  OrchardAppEvent evt;
-
-  evt.type = radioEvent;
-  if( !ui_override )
-    instance.app->event(instance.context, &evt);
+  motion_event motion;
+
+  // drain them all, one broadcast can stand for several events
+  while( accelMotionGet(&motion) ) {
+    evt.type = accelEvent;
+    evt.accel.code = codes[motion.type];
+    evt.accel.orient = motion.orient;
+    evt.accel.x = motion.x;
+    evt.accel.y = motion.y;
+    if( !ui_override )
+      instance.app->event(instance.context, &evt);
+  }
 }
 
 static void key_event(eventid_t id) {
@@ -985,9 +833,7 @@ static void key_event(eventid_t id) {
 }
 
 // handle jogdial events (in parallel to key events)
-static void dial_event(eventid_t id) {
-  (void)id;
-  uint32_t val = captouchRead();
+static void dial_event(uint16_t val) {
   unsigned int curtime;
   OrchardAppEvent evt;
 
@@ -1035,32 +881,29 @@ static void terminate(eventid_t id) {
   evt.type = appEvent;
   evt.app.event = appTerminate;
   instance.app->event(instance.context, &evt);
-  chThdTerminate(instance.thr);
+  app_switching = true;
 }
 
-static void timer_event(eventid_t id) {
+// everything that came through app_evq, in the order it was posted
+static void app_evq_event(void *ctx, const OrchardAppEvent *evt) {
 
-  (void)id;
-  OrchardAppEvent evt;
-
-  if (!instance.app->event)
-    return;
-
-  evt.type = timerEvent;
-  evt.timer.usecs = instance.timer_usecs;
-  if( !ui_override )
-    instance.app->event(instance.context, &evt);
-
-  if (instance.timer_repeating)
-    orchardAppTimer(instance.context, instance.timer_usecs, true);
-}
-
-static void timer_do_send_message(void *arg) {
+  (void)ctx;
+  chDbgTraceMark(TRACE_MARK_APP_BEGIN, evt->type);
+  if (evt->type == touchEvent) {
+    key_event_timer(evt->touch.mask);
+    dial_event(evt->touch.mask);
+  }
+  else if (evt->type == timerEvent) {
+    dtimer *t = &instance.timers[evt->timer.id];
 
-  (void)arg;
-  chSysLockFromISR();
-  chEvtBroadcastI(&timer_expired);
-  chSysUnlockFromISR();
+    if( !ui_override && dtimerRunning(t) )
+      instance.app->event(instance.context, evt);
+    // a deadline that passed while the app was busy is an overrun
+    dtimerDone(t);
+  }
+  else if( !ui_override )
+    instance.app->event(instance.context, evt);
+  chDbgTraceMark(TRACE_MARK_APP_END, evt->type);
 }
 
 const OrchardApp *orchardAppByName(const char *name) {
@@ -1078,143 +921,204 @@ const OrchardApp *orchardAppByName(const char *name) {
 
 void orchardAppRun(const OrchardApp *app) {
   instance.next_app = app;
-  chThdTerminate(instance.thr);
+  switch_requested = fxprofNow();
+  app_switching = true;
   chEvtBroadcast(&orchard_app_terminate);
 }
 
 void orchardAppExit(void) {
   instance.next_app = orchard_app_start();  // the first app is the launcher
-  chThdTerminate(instance.thr);
+  switch_requested = fxprofNow();
+  app_switching = true;
   chEvtBroadcast(&orchard_app_terminate);
 }
 
+bool orchardAppShouldExit(void) {
+  return app_switching;
+}
+
+void *orchardAppAlloc(const OrchardAppContext *context, size_t size) {
+  return arenaAlloc(&context->instance->state, size);
+}
+
+const orchard_app_stats *orchardAppStats(void) {
+  return &app_stats;
+}
+
+void orchardAppResetStats(void) {
+  memset(&app_stats, 0, sizeof(app_stats));
+}
+
+void orchardAppRadioEvent(uint8_t prot, uint8_t src, uint8_t length) {
+  OrchardAppEvent evt;
+
+  memset(&evt, 0, sizeof(evt));
+  evt.type = radioEvent;
+  evt.radio.prot = prot;
+  evt.radio.src = src;
+  evt.radio.length = length;
+  evqPost(&app_evq, &evt);
+}
+
+void orchardAppTimerId(const OrchardAppContext *context,
+                       uint8_t id,
+                       uint32_t usecs,
+                       bool repeating) {
+
+  osalDbgAssert(id < ORCHARD_APP_TIMERS, "no such app timer");
+  dtimerStart(&context->instance->timers[id], usecs, repeating);
+}
+
 void orchardAppTimer(const OrchardAppContext *context,
                      uint32_t usecs,
                      bool repeating) {
 
-  if (!usecs) {
-    chVTReset(&context->instance->timer);
-    context->instance->timer_usecs = 0;
-    return;
-  }
+  orchardAppTimerId(context, 0, usecs, repeating);
+}
 
-  context->instance->timer_usecs = usecs;
-  context->instance->timer_repeating = repeating;
-  chVTSet(&context->instance->timer, US2ST(usecs), timer_do_send_message, NULL);
+static void switch_timed(uint32_t requested, uint32_t exited,
+                         uint32_t started) {
+  uint32_t now = fxprofNow();
+
+  app_stats.switches++;
+  app_stats.last = now - requested;
+  app_stats.total += app_stats.last;
+  if (app_stats.last > app_stats.max)
+    app_stats.max = app_stats.last;
+  if (exited - requested > app_stats.exit_max)
+    app_stats.exit_max = exited - requested;
+  if (now - started > app_stats.start_max)
+    app_stats.start_max = now - started;
 }
 
-static THD_WORKING_AREA(waOrchardAppThread, 0x800);
+/* The app's state is in the arena, not on this stack, so it only needs to
+   hold the handlers themselves.*/
+static THD_WORKING_AREA(waOrchardAppThread, 0x600);
 static THD_FUNCTION(orchard_app_thread, arg) {
 
-  (void)arg;
   struct orchard_app_instance *instance = arg;
   struct evt_table orchard_app_events;
   OrchardAppContext app_context;
-
-  ui_override = 0;
-  memset(&app_context, 0, sizeof(app_context));
-  instance->context = &app_context;
-  app_context.instance = instance;
-  
-  // set UI elements to null
-  instance->ui = NULL;
-  instance->uicontext = NULL;
-  instance->ui_result = 0;
+  uint32_t started, exited = 0;
+  bool timed = false;
+  unsigned i;
 
   chRegSetThreadName("Orchard App");
 
-  instance->keymask = captouchRead();
-
+  /* Every app runs on this thread, so the listeners are hooked once.*/
   evtTableInit(orchard_app_events, 32);
-  evtTableHook(orchard_app_events, radio_app, radio_app_event);
   evtTableHook(orchard_app_events, ui_completed, ui_complete_cleanup);
-  evtTableHook(orchard_app_events, captouch_changed, key_event_timer);
-  evtTableHook(orchard_app_events, captouch_changed, dial_event);
   evtTableHook(orchard_app_events, keycollect_timeout, key_event);
   evtTableHook(orchard_app_events, orchard_app_terminate, terminate);
-  evtTableHook(orchard_app_events, timer_expired, timer_event);
-  evtTableHook(orchard_app_events, celcius_rdy, adc_temp_event);
-  evtTableHook(orchard_app_events, mic_rdy, adc_mic_event);
-  evtTableHook(orchard_app_events, usbdet_rdy, adc_usb_event);
-  evtTableHook(orchard_app_events, accel_bump, accel_bump_event);
-
-  if (instance->app->init)
-    app_context.priv_size = instance->app->init(&app_context);
-  else
-    app_context.priv_size = 0;
-
-  /* Allocate private data on the stack (word-aligned) */
-  uint32_t priv_data[app_context.priv_size / 4];
-  if (app_context.priv_size) {
-    memset(priv_data, 0, sizeof(priv_data));
-    app_context.priv = priv_data;
-  }
-  else
-    app_context.priv = NULL;
-
-  if (instance->app->start)
-    instance->app->start(&app_context);
-  if (instance->app->event) {
-    {
-      OrchardAppEvent evt;
-      evt.type = appEvent;
-      evt.app.event = appStart;
-      instance->app->event(instance->context, &evt);
+  evtTableHook(orchard_app_events, accel_motion, accel_motion_event);
+
+  while (true) {
+    ui_override = 0;
+    memset(&app_context, 0, sizeof(app_context));
+    instance->context = &app_context;
+    app_context.instance = instance;
+
+    // set UI elements to null
+    instance->ui = NULL;
+    instance->uicontext = NULL;
+    instance->ui_result = 0;
+
+    instance->keymask = captouchRead();
+
+    // touch, ADC and radio events come with their data through app_evq;
+    // anything still in it was meant for the previous app
+    evqSetReader(&app_evq, chThdGetSelfX(), APP_EVQ_EVENT);
+
+    started = fxprofNow();
+    arenaReset(&instance->state);
+    if (instance->app->init)
+      app_context.priv_size = instance->app->init(&app_context);
+    else
+      app_context.priv_size = 0;
+
+    if (app_context.priv_size) {
+      app_context.priv = arenaAlloc(&instance->state, app_context.priv_size);
+      if (app_context.priv == NULL) {
+        /* Doesn't fit, back to the launcher rather than run without it.*/
+        osalDbgAssert(instance->app != orchard_app_list,
+                      "launcher state over the app arena");
+        app_stats.overflows++;
+        instance->app = orchard_app_list;
+        continue;
+      }
     }
-    while (!chThdShouldTerminateX())
-      chEvtDispatch(evtHandlers(orchard_app_events), chEvtWaitOne(ALL_EVENTS));
-  }
+    else
+      app_context.priv = NULL;
+
+    if (instance->app->start)
+      instance->app->start(&app_context);
+    if (instance->app->event) {
+      {
+        OrchardAppEvent evt;
+        evt.type = appEvent;
+        evt.app.event = appStart;
+        instance->app->event(instance->context, &evt);
+      }
+      if (timed)
+        switch_timed(switch_requested, exited, started);
 
-  chVTReset(&instance->timer);
+      while (!app_switching) {
+        eventmask_t mask = chEvtWaitOne(ALL_EVENTS);
 
-  if (instance->app->exit)
-    instance->app->exit(&app_context);
+        // one flag for however many events were posted since the last drain
+        if (mask == APP_EVQ_EVENT)
+          evqDrain(&app_evq, app_evq_event, NULL);
+        else
+          chEvtDispatch(evtHandlers(orchard_app_events), mask);
+      }
+    }
 
-  instance->context = NULL;
+    for (i = 0; i < ORCHARD_APP_TIMERS; i++)
+      dtimerStop(&instance->timers[i]);
 
-  /* Set up the next app to run when the orchard_app_terminated message is
-     acted upon.*/
-  if (instance->next_app)
-    instance->app = instance->next_app;
-  else
-    instance->app = orchard_app_list;
-  instance->next_app = NULL;
+    if (instance->app->exit)
+      instance->app->exit(&app_context);
 
-  chVTReset(&run_launcher_timer);
-  run_launcher_timer_engaged = false;
+    instance->context = NULL;
 
-  evtTableUnhook(orchard_app_events, accel_bump, accel_bump_event);
-  evtTableUnhook(orchard_app_events, usbdet_rdy, adc_usb_event);
-  evtTableUnhook(orchard_app_events, mic_rdy, adc_mic_event);
-  evtTableUnhook(orchard_app_events, celcius_rdy, adc_temp_event);
-  evtTableUnhook(orchard_app_events, timer_expired, timer_event);
-  evtTableUnhook(orchard_app_events, orchard_app_terminate, terminate);
-  evtTableUnhook(orchard_app_events, keycollect_timeout, key_event);
-  evtTableUnhook(orchard_app_events, captouch_changed, dial_event);
-  evtTableUnhook(orchard_app_events, captouch_changed, key_event_timer);
-  evtTableUnhook(orchard_app_events, ui_completed, ui_complete_cleanup);
-  evtTableUnhook(orchard_app_events, radio_app, radio_app_event);
-
-  /* Atomically broadcasting the event source and terminating the thread,
-     there is not a chSysUnlock() because the thread terminates upon return.*/
-  chSysLock();
-  chEvtBroadcastI(&orchard_app_terminated);
-  chThdExitS(MSG_OK);
+    chVTReset(&run_launcher_timer);
+    run_launcher_timer_engaged = false;
+
+    /* Nothing the old app was waiting for may reach the next one.*/
+    chVTReset(&keycollect_timer);
+    captouch_collected_state = 0;
+    chEvtGetAndClearEvents(ALL_EVENTS);
+
+    /* Swap in the next app, a request from here on is for that one.*/
+    chSysLock();
+    if (instance->next_app)
+      instance->app = instance->next_app;
+    else
+      instance->app = orchard_app_list;
+    instance->next_app = NULL;
+    app_switching = false;
+    chSysUnlock();
+
+    exited = fxprofNow();
+    timed = true;
+    chEvtBroadcast(&orchard_app_terminated);
+  }
 }
 
 void orchardAppInit(void) {
-  int i;
+  unsigned i;
 
   orchard_app_list = orchard_app_start();
   instance.app = orchard_app_list;
   chEvtObjectInit(&orchard_app_terminated);
   chEvtObjectInit(&orchard_app_terminate);
-  chEvtObjectInit(&timer_expired);
   chEvtObjectInit(&keycollect_timeout);
   chEvtObjectInit(&chargecheck_timeout);
   chEvtObjectInit(&ping_timeout);
   chEvtObjectInit(&ui_completed);
-  chVTReset(&instance.timer);
+  for (i = 0; i < ORCHARD_APP_TIMERS; i++)
+    dtimerInit(&instance.timers[i], &app_evq, i);
+  arenaInit(&instance.state, app_arena_mem, sizeof(app_arena_mem));
 
   /* Hook this outside of the app-specific runloop, so it runs even if
      the app isn't listening for events.*/
@@ -1254,20 +1158,14 @@ void orchardAppInit(void) {
   jogdial_state.direction_intent = dirNone;
   jogdial_state.lasttime = chVTGetSystemTime();
 
-  for( i = 0; i < MAX_FRIENDS; i++ ) {
-    friends[i] = NULL;
-  }
-  osalMutexObjectInit(&friend_mutex);
+  friendsInit();
 }
 
 void orchardAppRestart(void) {
 
-  /* Recovers memory of the previous application. */
-  if (instance.thr) {
-    osalDbgAssert(chThdTerminatedX(instance.thr), "App thread still running");
-    chThdRelease(instance.thr);
-    instance.thr = NULL;
-  }
+  /* The host thread runs for good, apps are swapped on it.*/
+  if (instance.thr)
+    return;
 
   instance.thr = chThdCreateStatic(waOrchardAppThread,
                                    sizeof(waOrchardAppThread),
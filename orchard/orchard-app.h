@@ -9,6 +9,9 @@
 #include "gfx.h"
 #include "orchard-ui.h"
 #include "orchard-events.h"
+#include "deadline-timer.h"
+#include "arena.h"
+#include "friends.h"
 
 struct _OrchardApp;
 typedef struct _OrchardApp OrchardApp;
@@ -26,21 +29,51 @@ extern event_source_t orchard_app_terminated;
 extern event_source_t ui_completed;
 
 void orchardAppInit(void);
+// Starts the app host thread. It runs every app from then on, switching
+// between them in place.
 void orchardAppRestart(void);
 void orchardAppWatchdog(void);
 const OrchardApp *orchardAppByName(const char *name);
 void orchardAppRun(const OrchardApp *app);
 void orchardAppExit(void);
+// True once another app was asked for; for apps that loop in start()
+bool orchardAppShouldExit(void);
 void orchardAppTimer(const OrchardAppContext *context,
                      uint32_t usecs,
                      bool repeating);
-void friendsSort(void);
-const char **friendsGet(void);
-void friendsLock(void);
-void friendsUnlock(void);
-uint8_t friendCount(void);
+// Like orchardAppTimer(), for timer id; orchardAppTimer() is timer 0.
+// Repeating timers keep to period multiples of the first deadline however
+// long the app takes to handle them.
+void orchardAppTimerId(const OrchardAppContext *context,
+                       uint8_t id,
+                       uint32_t usecs,
+                       bool repeating);
+// Zeroed memory that stays valid until the app exits, NULL if the app
+// arena is full. The priv area of init() comes from the same arena.
+void *orchardAppAlloc(const OrchardAppContext *context, size_t size);
+// Queues a radioEvent for the app. prot is 0 when the friend list changed
+// without a packet.
+void orchardAppRadioEvent(uint8_t prot, uint8_t src, uint8_t length);
 uint8_t getMutationRate(void);
-#define MAX_FRIENDS  50   // max # of friends to track
+
+#define ORCHARD_APP_TIMERS  4
+#define ORCHARD_APP_ARENA   0x400   // bytes of app state, priv included
+
+// App switches, timed from orchardAppRun(), orchardAppExit() or the main
+// menu keys to the appStart event of the next app, in fxprof counts
+typedef struct orchard_app_stats {
+  uint32_t  switches;
+  uint32_t  last;
+  uint32_t  max;
+  uint32_t  total;
+  uint32_t  exit_max;       // of which the old app handling appTerminate
+                            // and exit()
+  uint32_t  start_max;      // of which the new app's init() and start()
+  uint32_t  overflows;      // apps whose priv area didn't fit the arena
+} orchard_app_stats;
+
+const orchard_app_stats *orchardAppStats(void);
+void orchardAppResetStats(void);
 
 typedef struct _OrchardAppContext {
   struct orchard_app_instance *instance;
@@ -62,9 +95,8 @@ typedef struct orchard_app_instance {
   OrchardAppContext     *context;
   thread_t              *thr;
   uint32_t              keymask;
-  virtual_timer_t       timer;
-  uint32_t              timer_usecs;
-  bool                  timer_repeating;
+  dtimer                timers[ORCHARD_APP_TIMERS];
+  arena                 state;          // reset on every switch
   const OrchardUi       *ui;
   OrchardUiContext      *uicontext;
   uint32_t              ui_result;
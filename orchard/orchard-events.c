@@ -3,21 +3,20 @@
 #include "ext.h"
 #include "radio.h"
 #include "orchard-events.h"
+#include "orchard-evq.h"
 
 event_source_t ble_rdy;
 event_source_t rf_pkt_rdy;
 event_source_t gpiox_rdy;
 
-event_source_t celcius_rdy;
-event_source_t mic_rdy;
 event_source_t usbdet_rdy;
+event_source_t mic_beat;
 
 event_source_t radio_page;
 event_source_t radio_sex_req;
 event_source_t radio_sex_ack;
-event_source_t radio_app;
 
-event_source_t accel_bump;
+event_source_t accel_motion;
 
 static void ble_rdyn_cb(EXTDriver *extp, expchannel_t channel) {
 
@@ -58,18 +57,19 @@ void orchardEventsStart(void) {
   chEvtObjectInit(&gpiox_rdy);
 
   // ADC-related events
-  chEvtObjectInit(&celcius_rdy);
-  chEvtObjectInit(&mic_rdy);
   chEvtObjectInit(&usbdet_rdy);
+  chEvtObjectInit(&mic_beat);
 
   // radio protocol events
   chEvtObjectInit(&radio_page);
   chEvtObjectInit(&radio_sex_req);
   chEvtObjectInit(&radio_sex_ack);
-  chEvtObjectInit(&radio_app);
 
   // accel events
-  chEvtObjectInit(&accel_bump);
+  chEvtObjectInit(&accel_motion);
+
+  // app events that carry data
+  evqInit(&app_evq);
 
   extStart(&EXTD1, &ext_config);
 }
@@ -70,19 +70,19 @@ extern event_source_t ble_rdy;
 extern event_source_t rf_pkt_rdy;
 extern event_source_t gpiox_rdy;
 
-// adc-related events
-extern event_source_t celcius_rdy;
-extern event_source_t mic_rdy;
+// adc-related events; temperature and mic results go to the app as
+// adcEvent records through app_evq (orchard-evq.h). Beats are broadcast
+// as well, effects and other threads can't read the app queue.
 extern event_source_t usbdet_rdy;
+extern event_source_t mic_beat;
 
 // BM radio protocol events
 extern event_source_t radio_page;
 extern event_source_t radio_sex_req;
 extern event_source_t radio_sex_ack;
-extern event_source_t radio_app;
 
 // accelerometer events
-extern event_source_t accel_bump;
+extern event_source_t accel_motion;
 
 void orchardEventsStart(void);
 
@@ -96,6 +96,7 @@ typedef enum _OrchardAppEventType {
   adcEvent,
   radioEvent,
   accelEvent,
+  touchEvent,   // raw captouch state, turned into key events by the app thread
 } OrchardAppEventType;
 
 /* ------- */
@@ -131,16 +132,34 @@ typedef enum _OrchardUiEventFlags {
 typedef struct _OrchardAdcEvent {
   uint8_t   code;
   uint8_t   flags;
+  uint8_t   peak;     // adcCodeMic/adcCodeMicBeat: mic_features of the block
+  uint16_t  rms;
+  int32_t   value;    // temperature in millidegrees C, mic block number,
+                      // or usbStat, as of when the event was posted
 } OrchardAdcEvent;
 
+typedef struct _OrchardRadioEvent {
+  uint8_t   prot;     // radio_prot_*, 0 when the friend list changed locally
+  uint8_t   src;
+  uint8_t   length;
+} OrchardRadioEvent;
+
+typedef struct _OrchardTouchEvent {
+  uint16_t  mask;     // captouch state after the change
+} OrchardTouchEvent;
+
 typedef struct _OrchardAccelEvent {
   uint8_t   code;
+  uint8_t   orient;   // motion_orient, except for accelCodeBump
+  int16_t   x;        // gravity in counts (1024 per g), except for accelCodeBump
+  int16_t   y;
 } OrchardAccelEvent;
 
 typedef enum _OrchardAdcEventCode {
   adcCodeTemp = 0x01,
   adcCodeMic,
   adcCodeUsbdet,
+  adcCodeMicBeat,
 } OrchardAdcEventCode;
 
 // note: no ADC flags yet
@@ -148,6 +167,9 @@ typedef enum _OrchardAdcEventCode {
 typedef enum _OrchardAccelEventCode {
   accelCodeBump = 0x01,
   accelCodePL,  // portrat/landscape trigger
+  accelCodeTilt,
+  accelCodeShake,
+  accelCodeTap,
 } OrchardAccelEventCode;
   
 typedef struct _OrchardAppKeyEvent {
@@ -170,6 +192,8 @@ typedef struct _OrchardAppLifeEvent {
 
 typedef struct _OrchardAppTimerEvent {
   uint32_t  usecs;
+  uint8_t   id;         // which of the app's timers, see orchardAppTimerId()
+  uint16_t  overruns;   // periods skipped since the last event of this timer
 } OrchardAppTimerEvent;
 
 /* ------- */
@@ -183,6 +207,8 @@ typedef struct _OrchardAppEvent {
     OrchardUiEvent        ui;
     OrchardAdcEvent       adc;
     OrchardAccelEvent     accel;
+    OrchardRadioEvent     radio;
+    OrchardTouchEvent     touch;
   };
 } OrchardAppEvent;
 
@@ -0,0 +1,88 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard-evq.h"
+
+#include <string.h>
+
+orchard_evq app_evq;
+
+void evqInit(orchard_evq *q) {
+  memset(q, 0, sizeof(*q));
+}
+
+void evqSetReader(orchard_evq *q, thread_t *reader, eventmask_t mask) {
+  chSysLock();
+  q->reader = reader;
+  q->mask = mask;
+  q->tail = q->head;
+  chSysUnlock();
+}
+
+bool evqPostI(orchard_evq *q, const OrchardAppEvent *evt) {
+  uint32_t depth;
+
+  chDbgCheckClassI();
+
+  depth = q->head - q->tail;
+  if( depth >= EVQ_SIZE ) {
+    q->stats.dropped++;
+    if( (unsigned)evt->type < EVQ_TYPES )
+      q->stats.dropped_type[evt->type]++;
+    return false;
+  }
+
+  q->ring[q->head & (EVQ_SIZE - 1)] = *evt;
+  q->head++;
+  q->stats.posted++;
+  if( depth + 1 > q->stats.depth_max )
+    q->stats.depth_max = depth + 1;
+
+  if( q->reader != NULL )
+    chEvtSignalI(q->reader, q->mask);
+  return true;
+}
+
+bool evqPost(orchard_evq *q, const OrchardAppEvent *evt) {
+  bool ok;
+
+  chSysLock();
+  ok = evqPostI(q, evt);
+  chSchRescheduleS();
+  chSysUnlock();
+
+  return ok;
+}
+
+unsigned evqDrain(orchard_evq *q, evq_handler_t handler, void *ctx) {
+  OrchardAppEvent evt;
+  uint32_t head = q->head;
+  unsigned n = 0;
+
+  // a record is complete once head moved past it, and producers don't
+  // touch it again until tail moved past it too
+  while( q->tail != head ) {
+    evt = q->ring[q->tail & (EVQ_SIZE - 1)];
+    q->tail++;
+    handler(ctx, &evt);
+    n++;
+  }
+
+  if( n != 0 ) {
+    q->stats.delivered += n;
+    q->stats.batches++;
+    if( n > q->stats.batch_max )
+      q->stats.batch_max = n;
+  }
+  return n;
+}
+
+unsigned evqPending(const orchard_evq *q) {
+  return q->head - q->tail;
+}
+
+void evqResetStats(orchard_evq *q) {
+  chSysLock();
+  memset(&q->stats, 0, sizeof(q->stats));
+  chSysUnlock();
+}
@@ -0,0 +1,67 @@
+#ifndef __ORCHARD_EVQ_H__
+#define __ORCHARD_EVQ_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "orchard-events.h"
+
+// A ring of OrchardAppEvent records for the app loop. An event source
+// broadcast only says that something happened since the last wakeup, so
+// several captouch changes or mic blocks in a row used to reach the app as
+// one, with the handler reading whatever the global state was by then.
+// Events posted here carry their data as it was when they were posted, and
+// each one is delivered, in order.
+//
+// Any thread or ISR may post; posting copies the record in a short critical
+// section (the M0+ has no exclusive loads and stores to do it without), and
+// signals the reader thread with one event flag. The reader drains the ring
+// without locking. When the ring is full the new event is dropped and
+// counted, by type.
+
+#define EVQ_SIZE        32    // power of two
+#define EVQ_TYPES       8     // counted event types, see OrchardAppEventType
+
+typedef struct evq_stats {
+  uint32_t      posted;               // events that went into the ring
+  uint32_t      delivered;
+  uint32_t      dropped;              // events posted to a full ring
+  uint32_t      dropped_type[EVQ_TYPES];
+  uint32_t      depth_max;            // most events waiting at once
+  uint32_t      batches;              // drains that delivered something
+  uint32_t      batch_max;            // most events delivered by one drain
+} evq_stats;
+
+typedef struct orchard_evq {
+  OrchardAppEvent     ring[EVQ_SIZE];
+  volatile uint32_t   head;           // next to post, moved by producers
+  volatile uint32_t   tail;           // next to deliver, moved by the reader
+  thread_t            *reader;
+  eventmask_t         mask;
+  evq_stats           stats;
+} orchard_evq;
+
+typedef void (*evq_handler_t)(void *ctx, const OrchardAppEvent *evt);
+
+// the queue of the app thread
+extern orchard_evq app_evq;
+
+void evqInit(orchard_evq *q);
+
+// Thread signalled with mask when an event is posted, NULL for none. Events
+// still in the ring are dropped, they were meant for the previous reader.
+void evqSetReader(orchard_evq *q, thread_t *reader, eventmask_t mask);
+
+// Copies evt into the ring. Returns false if it was full.
+bool evqPostI(orchard_evq *q, const OrchardAppEvent *evt);
+bool evqPost(orchard_evq *q, const OrchardAppEvent *evt);
+
+// Reader only: hands the events that are in the ring to handler, in the
+// order they were posted. Events posted meanwhile are left for the next
+// drain, their post signals the reader again. Returns the number delivered.
+unsigned evqDrain(orchard_evq *q, evq_handler_t handler, void *ctx);
+
+unsigned evqPending(const orchard_evq *q);
+void evqResetStats(orchard_evq *q);
+
+#endif /* __ORCHARD_EVQ_H__ */
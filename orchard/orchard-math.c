@@ -4,7 +4,8 @@
 #include "fixmath.h"
 
 static uint32_t rstate[2] = {0xbabeface, 0xfade1337};
-static uint32_t key[2] = {0x243F6A88, 0x85A308D3}; // from pi
+// btea() takes a 128-bit key, the MX rounds index all four words
+static uint32_t key[4] = {0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344}; // from pi
 
 unsigned int shift_lfsr(unsigned int v) {
   /*
@@ -138,6 +139,28 @@ uint8_t satadd_8_limit(uint8_t a, uint8_t b, uint8_t limit) {
     return (uint8_t) (c & 0xFF);
 }
 
+// saturating add of two byte buffers, dst[i] = a[i]+b[i] stopping at 255.
+// four bytes are added at a time when all three buffers are word aligned:
+// the low 7 bits of each byte are added without crossing into the next byte,
+// then the top bits are folded back in and every byte that carried out is
+// forced to 255.
+void satadd_8_buf(uint8_t *dst, const uint8_t *a, const uint8_t *b, uint32_t len) {
+  uint32_t x, y, sum, carry;
+  uint32_t i = 0;
+
+  if( (((uintptr_t) dst | (uintptr_t) a | (uintptr_t) b) & 3) == 0 ) {
+    for( ; i + 4 <= len; i += 4 ) {
+      x = *(const aliased_word *) (a + i);
+      y = *(const aliased_word *) (b + i);
+      sum = ((x & 0x7F7F7F7F) + (y & 0x7F7F7F7F)) ^ ((x ^ y) & 0x80808080);
+      carry = ((x & y) | ((x | y) & ~sum)) & 0x80808080;
+      *(aliased_word *) (dst + i) = sum | ((carry >> 7) * 0xFF);
+    }
+  }
+  for( ; i < len; i++ )
+    dst[i] = satadd_8(a[i], b[i]);
+}
+
 // saturating subtract, acting on a whole RGB pixel
 Color satsub_8p(Color c, uint8_t val) {
   Color rc;
@@ -181,3 +204,24 @@ int map(int x, int in_min, int in_max, int out_min, int out_max)
 {
   return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
+
+// integer square root, bit by bit so it needs no divide (the M0+ has none)
+uint16_t isqrt_32(uint32_t x) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+
+  while (bit > x)
+    bit >>= 2;
+
+  while (bit != 0) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint16_t) root;
+}
@@ -3,13 +3,18 @@
 
 #include <stdint.h>
 
+// word access to byte buffers, exempt from strict aliasing
+typedef uint32_t __attribute__((__may_alias__)) aliased_word;
+
 unsigned int shift_lfsr(unsigned int v);
 uint8_t satsub_8(uint8_t a, uint8_t b);
 uint8_t satadd_8(uint8_t a, uint8_t b);
+void satadd_8_buf(uint8_t *dst, const uint8_t *a, const uint8_t *b, uint32_t len);
 void addEntropy(uint32_t value);
 int rand(void);
 int16_t map_16(int16_t x, int16_t in_min, int16_t in_max, int16_t out_min, int16_t out_max);
 int map(int x, int in_min, int in_max, int out_min, int out_max);
 uint8_t satadd_8_limit(uint8_t a, uint8_t b, uint8_t limit);
+uint16_t isqrt_32(uint32_t x);
 
 #endif /* __ORCHARD_MATH_H__ */
@@ -1,4 +1,5 @@
 #include "orchard-ui.h"
+#include "oled.h"
 #include <string.h>
 
 // mutex to lock the graphics subsystem for safe multi-threaded drawing
@@ -31,6 +32,19 @@ void orchardGfxStart(void) {
 
 void orchardGfxEnd(void) {
   
+  oledEndDraw();
   osalMutexUnlock(&orchard_gfxMutex);
   
 }
+
+void orchardGfxInvalidate(coord_t x, coord_t y, coord_t cx, coord_t cy) {
+
+  oledInvalidate(x, y, cx, cy);
+
+}
+
+void orchardGfxFrameDiff(void) {
+
+  oledSetFrameDiff(true);
+
+}
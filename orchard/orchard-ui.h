@@ -57,4 +57,11 @@ void uiStart(void);
 void orchardGfxStart(void);
 void orchardGfxEnd(void);
 
+// Between orchardGfxStart() and orchardGfxEnd(), these say what the next
+// gdispFlush() has to send to the OLED. Invalidated rectangles limit it to
+// what was redrawn; frame diff drops what the panel already shows, for
+// apps that clear and redraw the whole screen.
+void orchardGfxInvalidate(coord_t x, coord_t y, coord_t cx, coord_t cy);
+void orchardGfxFrameDiff(void);
+
 #endif /* __ORCHARD_UI_H__ */
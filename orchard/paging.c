@@ -17,6 +17,7 @@ static void redraw_ui(void) {
   char seqstr[16];
 
   orchardGfxStart();
+  orchardGfxFrameDiff();
   // draw the title bar
   font = gdispOpenFont("ui2");
   width = gdispGetWidth();
@@ -0,0 +1,189 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "radio.h"
+#include "radio-queue.h"
+
+#include <string.h>
+
+void radioQueueInit(radio_queue *q) {
+
+  memset(q->handlers, 0, sizeof(q->handlers));
+  q->default_handler = NULL;
+  q->in_use = 0;
+  memset(&q->stats, 0, sizeof(q->stats));
+
+  chPoolObjectInit(&q->pool, sizeof(radio_rx_packet), NULL);
+  chPoolLoadArray(&q->pool, q->packets, RADIO_RX_POOL_SIZE);
+  // as many mailbox slots as buffers, so posting never blocks
+  chMBObjectInit(&q->mbox, q->mbox_buf, RADIO_RX_POOL_SIZE);
+}
+
+void radioQueueSetHandler(radio_queue *q, uint8_t prot, radio_handler_t handler) {
+
+  osalDbgAssert(prot < RADIO_PROT_MAX, "Packet handler prot out of range");
+  q->handlers[prot] = handler;
+}
+
+void radioQueueSetDefaultHandler(radio_queue *q, radio_handler_t handler) {
+
+  q->default_handler = handler;
+}
+
+radio_rx_packet *radioQueueAllocI(radio_queue *q) {
+  radio_rx_packet *rx;
+
+  chDbgCheckClassI();
+
+  rx = chPoolAllocI(&q->pool);
+  if (rx == NULL) {
+    q->stats.dropped++;
+    return NULL;
+  }
+
+  q->in_use++;
+  if (q->in_use > q->stats.high_water)
+    q->stats.high_water = q->in_use;
+  return rx;
+}
+
+radio_rx_packet *radioQueueAlloc(radio_queue *q) {
+  radio_rx_packet *rx;
+
+  chSysLock();
+  rx = radioQueueAllocI(q);
+  chSysUnlock();
+
+  return rx;
+}
+
+void radioQueuePostI(radio_queue *q, radio_rx_packet *rx) {
+
+  chDbgCheckClassI();
+
+  (void) chMBPostI(&q->mbox, (msg_t) rx);
+  q->stats.received++;
+}
+
+void radioQueuePost(radio_queue *q, radio_rx_packet *rx) {
+
+  chSysLock();
+  radioQueuePostI(q, rx);
+  chSysUnlock();
+}
+
+void radioQueueFree(radio_queue *q, radio_rx_packet *rx) {
+
+  chSysLock();
+  chPoolFreeI(&q->pool, rx);
+  q->in_use--;
+  chSysUnlock();
+}
+
+uint32_t radioQueueDispatch(radio_queue *q) {
+  msg_t msg;
+  radio_rx_packet *rx;
+  radio_handler_t handler;
+  uint32_t count = 0;
+
+  while (chMBFetch(&q->mbox, &msg, TIME_IMMEDIATE) == MSG_OK) {
+    rx = (radio_rx_packet *) msg;
+
+    handler = NULL;
+    if (rx->pkt.prot < RADIO_PROT_MAX)
+      handler = q->handlers[rx->pkt.prot];
+    if (handler == NULL)
+      handler = q->default_handler;
+
+    if (handler != NULL) {
+      handler(rx->pkt.prot, rx->pkt.src, rx->pkt.dst,
+              rx->pkt.length - sizeof(RadioPacket), rx->pkt.payload);
+      q->stats.dispatched++;
+    }
+    else {
+      q->stats.unhandled++;
+    }
+
+    radioQueueFree(q, rx);
+    count++;
+  }
+
+  return count;
+}
+
+void radioTxQueueInit(radio_tx_queue *q) {
+
+  memset(&q->stats, 0, sizeof(q->stats));
+  q->stats.latency_min = (systime_t) -1;
+
+  chPoolObjectInit(&q->pool, sizeof(radio_tx_packet), NULL);
+  chPoolLoadArray(&q->pool, q->packets, RADIO_TX_QUEUE_SIZE);
+  chSemObjectInit(&q->free, RADIO_TX_QUEUE_SIZE);
+  chMBObjectInit(&q->mbox, q->mbox_buf, RADIO_TX_QUEUE_SIZE);
+}
+
+msg_t radioTxQueuePut(radio_tx_queue *q, uint8_t src, uint8_t dest, uint8_t prot,
+                      size_t len, const void *payload,
+                      radio_tx_done_t done, void *arg, systime_t timeout) {
+  radio_tx_packet *tx;
+  uint32_t depth;
+
+  osalDbgAssert(len + sizeof(RadioPacket) < RADIO_PACKET_MAX, "Packet is too large");
+
+  if (chSemWaitTimeout(&q->free, timeout) != MSG_OK) {
+    q->stats.full++;
+    return MSG_TIMEOUT;
+  }
+
+  /* A buffer is guaranteed once the semaphore is taken.*/
+  tx = chPoolAlloc(&q->pool);
+  tx->done = done;
+  tx->arg = arg;
+  tx->pkt.length = len + sizeof(RadioPacket);
+  tx->pkt.src = src;
+  tx->pkt.dst = dest;
+  tx->pkt.prot = prot;
+  memcpy(tx->pkt.payload, payload, len);
+
+  chSysLock();
+  tx->queued = chVTGetSystemTimeX();
+  (void) chMBPostI(&q->mbox, (msg_t) tx);
+  q->stats.queued++;
+  depth = RADIO_TX_QUEUE_SIZE - (uint32_t) chSemGetCounterI(&q->free);
+  if (depth > q->stats.high_water)
+    q->stats.high_water = depth;
+  chSysUnlock();
+
+  return MSG_OK;
+}
+
+radio_tx_packet *radioTxQueueGet(radio_tx_queue *q) {
+  msg_t msg;
+
+  if (chMBFetch(&q->mbox, &msg, TIME_IMMEDIATE) != MSG_OK)
+    return NULL;
+  return (radio_tx_packet *) msg;
+}
+
+void radioTxQueueDone(radio_tx_queue *q, radio_tx_packet *tx, msg_t result) {
+  systime_t latency;
+
+  if (result == MSG_OK) {
+    latency = chVTTimeElapsedSinceX(tx->queued);
+    q->stats.sent++;
+    q->stats.latency_total += latency;
+    if (latency < q->stats.latency_min)
+      q->stats.latency_min = latency;
+    if (latency > q->stats.latency_max)
+      q->stats.latency_max = latency;
+  }
+  else {
+    q->stats.failed++;
+  }
+
+  if (tx->done != NULL)
+    tx->done(tx->arg, result);
+
+  chPoolFree(&q->pool, tx);
+  chSemSignal(&q->free);
+}
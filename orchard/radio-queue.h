@@ -0,0 +1,120 @@
+#ifndef __ORCHARD_RADIO_QUEUE_H__
+#define __ORCHARD_RADIO_QUEUE_H__
+
+#include "ch.h"
+#include "hal.h"
+#include "radio.h"
+
+// Received packets are unloaded from the radio FIFO into buffers of a fixed
+// pool by the radio RX thread, and queued on a mailbox for the event thread
+// to dispatch. A slow handler only ever holds up the dispatch: the FIFO keeps
+// being drained, and once the pool runs dry new packets are counted and
+// dropped instead of overrunning the radio.
+
+#define RADIO_RX_POOL_SIZE    8     // packets held between the radio and the handlers
+#define RADIO_PACKET_MAX      66    // radio FIFO depth, the largest packet we can receive
+#define RADIO_PROT_MAX        16    // protocols with their own handler slot
+#define RADIO_TX_QUEUE_SIZE   4     // packets waiting for the air
+
+// Packets to send are copied into a pool as well and queued for the radio
+// thread, so senders only block when the queue is full. The radio thread
+// sends queued packets back to back, and only returns to RX once the queue
+// has drained.
+
+typedef void (*radio_handler_t)(uint8_t prot, uint8_t src, uint8_t dst,
+                                uint8_t length, const void *data);
+
+typedef union radio_rx_packet {
+  RadioPacket   pkt;
+  uint8_t       raw[RADIO_PACKET_MAX];
+  void          *align;   // the pool links free buffers through their first word
+} radio_rx_packet;
+
+typedef struct radio_rx_stats {
+  uint32_t      received;     // packets queued for dispatch
+  uint32_t      dispatched;   // packets passed to a handler
+  uint32_t      unhandled;    // packets with no handler and no default handler
+  uint32_t      dropped;      // packets lost because the pool was empty
+  uint32_t      malformed;    // packets with a length byte out of range
+  uint32_t      overruns;     // radio FIFO overruns
+  uint32_t      high_water;   // most buffers in use at once
+} radio_rx_stats;
+
+// called on the radio thread once a packet is sent (MSG_OK) or given up on
+typedef void (*radio_tx_done_t)(void *arg, msg_t result);
+
+typedef struct radio_tx_packet {
+  radio_tx_done_t   done;
+  void              *arg;
+  systime_t         queued;       // when the packet was queued, for the latency stats
+  union {
+    RadioPacket     pkt;
+    uint8_t         raw[RADIO_PACKET_MAX];
+  };
+} radio_tx_packet;
+
+typedef struct radio_tx_stats {
+  uint32_t      queued;         // packets accepted by radioTxQueuePut()
+  uint32_t      sent;           // packets that made it on the air
+  uint32_t      failed;         // packets that timed out in the radio
+  uint32_t      full;           // puts that timed out on a full queue
+  uint32_t      high_water;     // most packets queued or in flight at once
+  uint32_t      batches;        // runs of back to back packets between two RX periods
+  systime_t     latency_min;    // ticks from queueing to sent
+  systime_t     latency_max;
+  uint32_t      latency_total;
+} radio_tx_stats;
+
+typedef struct radio_tx_queue {
+  memory_pool_t     pool;
+  semaphore_t       free;         // counts the free buffers
+  mailbox_t         mbox;
+  msg_t             mbox_buf[RADIO_TX_QUEUE_SIZE];
+  radio_tx_packet   packets[RADIO_TX_QUEUE_SIZE];
+  radio_tx_stats    stats;
+} radio_tx_queue;
+
+typedef struct radio_queue {
+  memory_pool_t     pool;
+  mailbox_t         mbox;
+  msg_t             mbox_buf[RADIO_RX_POOL_SIZE];
+  radio_rx_packet   packets[RADIO_RX_POOL_SIZE];
+  radio_handler_t   handlers[RADIO_PROT_MAX];
+  radio_handler_t   default_handler;
+  uint32_t          in_use;     // buffers allocated and not yet freed
+  radio_rx_stats    stats;
+} radio_queue;
+
+void radioQueueInit(radio_queue *q);
+void radioQueueSetHandler(radio_queue *q, uint8_t prot, radio_handler_t handler);
+void radioQueueSetDefaultHandler(radio_queue *q, radio_handler_t handler);
+
+// returns a free packet buffer, or NULL (counted as a drop) if the pool is empty
+radio_rx_packet *radioQueueAlloc(radio_queue *q);
+radio_rx_packet *radioQueueAllocI(radio_queue *q);
+
+// hands a filled buffer over for dispatch
+void radioQueuePost(radio_queue *q, radio_rx_packet *rx);
+void radioQueuePostI(radio_queue *q, radio_rx_packet *rx);
+
+// gives back a buffer that was allocated but not posted
+void radioQueueFree(radio_queue *q, radio_rx_packet *rx);
+
+// dispatches every queued packet, returns the number dispatched
+uint32_t radioQueueDispatch(radio_queue *q);
+
+void radioTxQueueInit(radio_tx_queue *q);
+
+// copies a packet into the queue, waiting up to timeout for room
+// returns MSG_OK, or MSG_TIMEOUT if the queue stayed full
+msg_t radioTxQueuePut(radio_tx_queue *q, uint8_t src, uint8_t dest, uint8_t prot,
+                      size_t len, const void *payload,
+                      radio_tx_done_t done, void *arg, systime_t timeout);
+
+// next packet to send, or NULL if the queue is empty
+radio_tx_packet *radioTxQueueGet(radio_tx_queue *q);
+
+// completes a packet returned by radioTxQueueGet(), and frees its buffer
+void radioTxQueueDone(radio_tx_queue *q, radio_tx_packet *tx, msg_t result);
+
+#endif /* __ORCHARD_RADIO_QUEUE_H__ */
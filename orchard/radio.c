@@ -8,6 +8,9 @@
 #include "orchard.h"
 #include "orchard-events.h"
 #include "radio.h"
+#include "radio-queue.h"
+#include "spi-arbiter.h"
+#include "trace.h"
 
 #include "TransceiverReg.h"
 
@@ -21,10 +24,12 @@
 
 #define RADIO_XTAL_FREQUENCY      32000000 /* 32 MHz crystal */
 #define RADIO_FIFO_DEPTH          66
-#define RADIO_BUFFER_SIZE         64
-#define RADIO_BUFFER_MASK         (RADIO_BUFFER_SIZE - 1)
+#define RADIO_TX_TIMEOUT_MS       100 /* longest packet at 50 kbps is ~11 ms */
 
-#define MAX_PACKET_HANDLERS       10
+#define RADIO_EVT_RX              EVENT_MASK(0) /* PayloadReady in RX mode */
+#define RADIO_EVT_TX_DONE         EVENT_MASK(1) /* PacketSent in TX mode */
+#define RADIO_EVT_TX              EVENT_MASK(2) /* a packet was queued */
+#define RADIO_EVT_STOP            EVENT_MASK(3) /* radioStop() */
 
 /* This number was guessed based on observations (133 at 30 degrees) */
 static int temperature_offset = 133 + 30;
@@ -53,35 +58,22 @@ enum encoding_type {
   encoding_whitening = 2,
 };
 
-typedef struct _PacketHandler {
-    void (*handler)(uint8_t prot, uint8_t src, uint8_t dst,
-                    uint8_t length, const void *data);
-      uint8_t prot;
-} PacketHandler;
-
 /* Kinetis Radio definition */
 struct _KRadioDevice {
   uint16_t                bit_rate;
   uint16_t                fdev;
   uint32_t                channel;
-  uint8_t                 rx_buf[RADIO_BUFFER_SIZE];
-  uint32_t                rx_buf_end;
-  uint32_t                rx_buf_pos;
   uint8_t                 address;
   uint8_t                 broadcast;
-  uint8_t                 num_handlers;
-  PacketHandler           handlers[MAX_PACKET_HANDLERS];
-  void                    (*default_handler)(uint8_t prot,
-                                             uint8_t src,
-                                             uint8_t dst,
-                                             uint8_t length,
-                                             const void *data);
+  radio_queue             rxq;
+  radio_tx_queue          txq;
   enum modulation_type    modulation;
   enum radio_mode         mode;
   enum encoding_type      encoding;
   SPIDriver               *driver;
-  thread_reference_t      thread;
-  mutex_t                 radio_mutex;
+  spiarb_device           spi;
+  thread_t                *thread;
+  bool                    stopping;
 };
 
 KRadioDevice KRADIO1;
@@ -200,14 +192,14 @@ static uint8_t const default_registers[] = {
 
 static void radio_select(KRadioDevice *radio) {
 
-  spiAcquireBus(radio->driver);
+  spiarbAcquire(&radio->spi);
   spiSelect(radio->driver);
 }
 
 static void radio_unselect(KRadioDevice *radio) {
 
   spiUnselect(radio->driver);
-  spiReleaseBus(radio->driver);
+  spiarbRelease(&radio->spi);
 }
 
 static void radio_set(KRadioDevice *radio, uint8_t addr, uint8_t val) {
@@ -344,62 +336,160 @@ static void radio_set_broadcast_address(KRadioDevice *radio, uint8_t address) {
   radio_set(radio, RADIO_BroadcastAddress, address);
 }
 
-static void radio_unload_packet(eventid_t id) {
-  
-  (void)id;
+static void radio_drain_fifo(KRadioDevice *radio) {
+
+  while (radio_get(radio, RADIO_IrqFlags2) & IrqFlags2_FifoNotEmpty)
+    (void)radio_get(radio, RADIO_Fifo);
+}
 
-  KRadioDevice *radio = radioDriver;
-  RadioPacket pkt;
+/* Unloads one packet from the FIFO into a buffer of the RX pool.*/
+static void radio_unload_packet(KRadioDevice *radio) {
+
+  radio_rx_packet *rx;
   uint8_t reg, crc;
 
+  reg = radio_get(radio, RADIO_IrqFlags2);
+  if (reg & IrqFlags2_FifoOverrun) {
+    /* Writing the flag back clears the FIFO */
+    radio->rxq.stats.overruns++;
+    radio_set(radio, RADIO_IrqFlags2, IrqFlags2_FifoOverrun);
+    return;
+  }
+
+  rx = radioQueueAlloc(&radio->rxq);
+  if (rx == NULL) {
+    radio_drain_fifo(radio);
+    return;
+  }
+
   radio_select(radio);
   reg = RADIO_Fifo;
   spiSend(radio->driver, 1, &reg);
 
-  /* Read the "length" byte */
-  spiReceive(radio->driver, sizeof(pkt), &pkt);
+  /* Read the "length" byte and the rest of the header */
+  spiReceive(radio->driver, sizeof(rx->pkt), &rx->pkt);
 
-  uint8_t payload[pkt.length - sizeof(pkt)];
+  /* The length byte comes off the air, don't trust it with the buffer */
+  if ((rx->pkt.length < sizeof(rx->pkt)) || (rx->pkt.length > RADIO_PACKET_MAX)) {
+    radio_unselect(radio);
+    radio->rxq.stats.malformed++;
+    radioQueueFree(&radio->rxq, rx);
+    radio_drain_fifo(radio);
+    return;
+  }
 
   /* read the remainder of the packet */
-  spiReceive(radio->driver, sizeof(payload), payload);
+  spiReceive(radio->driver, rx->pkt.length - sizeof(rx->pkt), rx->pkt.payload);
   spiReceive(radio->driver, sizeof(crc), &crc);
   radio_unselect(radio);
 
-  /* Dispatch the packet handler */
-  unsigned int i;
-  bool handled = false;
-  for (i = 0; i < radio->num_handlers; i++) {
-    if (radio->handlers[i].prot == pkt.prot) {
-      radio->handlers[i].handler(pkt.prot,
-                                 pkt.src,
-                                 pkt.dst,
-                                 sizeof(payload),
-                                 payload);
-      handled = true;
-      break;
-    }
-  }
+  chDbgTraceMark(TRACE_MARK_RADIO_RX, (rx->pkt.prot << 8) | rx->pkt.length);
+  radioQueuePost(&radio->rxq, rx);
+}
+
+/* Loads a queued packet into the FIFO, the radio must be in TX mode.*/
+static void radio_load_packet(KRadioDevice *radio, radio_tx_packet *tx) {
 
-  /* If the packet wasn't handled, pass it to the default handler */
-  if (!handled && radio->default_handler)
-      radio->default_handler(pkt.prot,
-                             pkt.src,
-                             pkt.dst,
-                             sizeof(payload),
-                             payload);
+  uint8_t reg;
+
+  /* Ideally, we'd poll for DIO1 to see when the FIFO can accept data.
+   * This is not wired up on Orchard, so we can't transmit packets larger
+   * than the FIFO.
+   */
+  osalDbgAssert(tx->pkt.length < RADIO_FIFO_DEPTH, "Packet is too large");
+
+  /* Transmit the packet as soon as the entire thing is in the Fifo */
+  radio_set(radio, RADIO_FifoThresh, tx->pkt.length - 1);
+
+  radio_select(radio);
+
+  /* Select the FIFO */
+  reg = RADIO_Fifo | 0x80;
+  spiSend(radio->driver, 1, &reg);
+
+  /* Load the header and the payload into the Fifo */
+  spiSend(radio->driver, tx->pkt.length, tx->raw);
+  radio_unselect(radio);
 }
 
-void radioStop(KRadioDevice *radio) {
-  radio_set(radio, RADIO_OpMode, 0x80); // force into sleep mode immediately
+static void radio_set_mode(KRadioDevice *radio, enum radio_mode mode) {
+
+  radio->mode = mode;
+  radio_set(radio, RADIO_OpMode, OpMode_Sequencer_On
+                               | OpMode_Listen_Off
+                               | ((mode == mode_transmitting) ?
+                                  OpMode_Transmitter : OpMode_Receiver));
+}
+
+/* The radio thread owns the FIFO: it unloads received packets, and sends the
+   queued ones back to back, going back to RX once the queue is empty. Once
+   radioStop() asks, it exits as soon as the queue is empty.*/
+static THD_WORKING_AREA(waRadioThread, 256);
+static THD_FUNCTION(radio_thread, arg) {
+
+  KRadioDevice *radio = arg;
+  radio_tx_packet *tx = NULL;
+  eventmask_t events;
+
+  chRegSetThreadName("radio");
+
+  while (1) {
+    events = chEvtWaitAnyTimeout(ALL_EVENTS, (tx != NULL) ?
+                                 MS2ST(RADIO_TX_TIMEOUT_MS) : TIME_INFINITE);
+
+    if (tx != NULL) {
+      if (events & RADIO_EVT_TX_DONE) {
+        radioTxQueueDone(&radio->txq, tx, MSG_OK);
+        tx = NULL;
+      }
+      else if (events == 0) {
+        /* PacketSent never came, give up on the packet */
+        radioTxQueueDone(&radio->txq, tx, MSG_TIMEOUT);
+        tx = NULL;
+      }
+    }
+
+    if ((events & RADIO_EVT_RX) && (radio->mode == mode_receiving)) {
+      radio_unload_packet(radio);
+      chEvtBroadcast(&rf_pkt_rdy);
+    }
+
+    if (tx == NULL) {
+      tx = radioTxQueueGet(&radio->txq);
+      if (tx != NULL) {
+        if (radio->mode != mode_transmitting)
+          radio_set_mode(radio, mode_transmitting);
+        radio_load_packet(radio, tx);
+      }
+      else {
+        if (radio->mode == mode_transmitting) {
+          radio_set_mode(radio, mode_receiving);
+          radio->txq.stats.batches++;
+        }
+        if (radio->stopping)
+          return;
+      }
+    }
+  }
 }
 
-void radioAcquire(KRadioDevice *radio) {
-  osalMutexLock(&(radio->radio_mutex));
+static void radio_dispatch_packets(eventid_t id) {
+
+  (void)id;
+
+  radioQueueDispatch(&radioDriver->rxq);
 }
 
-void radioRelease(KRadioDevice *radio) {
-  osalMutexUnlock(&(radio->radio_mutex));
+void radioStop(KRadioDevice *radio) {
+
+  /* Let the thread send what's queued, then put the chip to sleep */
+  if (radio->thread != NULL) {
+    radio->stopping = true;
+    chEvtSignal(radio->thread, RADIO_EVT_STOP);
+    chThdWait(radio->thread);
+    radio->thread = NULL;
+  }
+  radio_set(radio, RADIO_OpMode, 0x80); // force into sleep mode immediately
 }
 
 void radioStart(KRadioDevice *radio, SPIDriver *spip) {
@@ -407,8 +497,17 @@ void radioStart(KRadioDevice *radio, SPIDriver *spip) {
   unsigned int reg;
 
   radio->driver = spip;
+  spiarbDeviceInit(&radio->spi, spiarbBus(spip), "radio", spiarbPrioRadio);
+
+  radioQueueInit(&radio->rxq);
+  radioTxQueueInit(&radio->txq);
+  radio->stopping = false;
+  evtTableHook(orchard_events, rf_pkt_rdy, radio_dispatch_packets);
 
-  evtTableHook(orchard_events, rf_pkt_rdy, radio_unload_packet);
+  /* The FIFO is serviced by a thread of its own, above the event thread that
+     runs the handlers */
+  radio->thread = chThdCreateStatic(waRadioThread, sizeof(waRadioThread),
+                                    NORMALPRIO + 2, radio_thread, radio);
 
   reg = 0;
   while (reg < ARRAY_SIZE(default_registers)) {
@@ -436,16 +535,10 @@ void radioStart(KRadioDevice *radio, SPIDriver *spip) {
   radio_set_node_address(radio, 1);
 
   /* Drain the Fifo */
-  while (radio_get(radio, RADIO_IrqFlags2) & IrqFlags2_FifoNotEmpty)
-    (void)radio_get(radio, RADIO_Fifo);
+  radio_drain_fifo(radio);
 
   /* Move into "Rx" mode */
-  radio->mode = mode_receiving;
-  radio_set(radio, RADIO_OpMode, OpMode_Sequencer_On
-                               | OpMode_Listen_Off
-                               | OpMode_Receiver);
-
-  osalMutexObjectInit(&(radio->radio_mutex));  
+  radio_set_mode(radio, mode_receiving);
 }
 
 void radioSetDefaultHandler(KRadioDevice *radio,
@@ -454,7 +547,7 @@ void radioSetDefaultHandler(KRadioDevice *radio,
                                             uint8_t dst,
                                             uint8_t length,
                                             const void *data)) {
-  radio->default_handler = handler;
+  radioQueueSetDefaultHandler(&radio->rxq, handler);
 }
 
 void radioSetHandler(KRadioDevice *radio, uint8_t prot,
@@ -463,22 +556,12 @@ void radioSetHandler(KRadioDevice *radio, uint8_t prot,
                                      uint8_t dst,
                                      uint8_t length,
                                      const void *data)) {
-  unsigned int i;
+  radioQueueSetHandler(&radio->rxq, prot, handler);
+}
 
-  /* Replace an existing handler? */
-  for (i = 0; i < radio->num_handlers; i++) {
-    if (radio->handlers[i].prot == prot) {
-      radio->handlers[i].handler = handler;
-      return;
-    }
-  }
+const struct radio_rx_stats *radioRxStats(KRadioDevice *radio) {
 
-  /* New handler */
-  osalDbgAssert(radio->num_handlers < MAX_PACKET_HANDLERS,
-                "Too many packet handler prots");
-  radio->handlers[radio->num_handlers].prot    = prot;
-  radio->handlers[radio->num_handlers].handler = handler;
-  radio->num_handlers++;
+  return &radio->rxq.stats;
 }
 
 uint8_t radioRead(KRadioDevice *radio, uint8_t addr) {
@@ -555,16 +638,15 @@ void radioSetNetwork(KRadioDevice *radio, const uint8_t *id, uint8_t len) {
 
 static void radio_handle_interrupt(KRadioDevice *radio) {
 
-  if (radio->mode == mode_transmitting) {
-    osalSysLockFromISR();
-    osalThreadResumeI(&(radio)->thread, MSG_OK);
-    osalSysUnlockFromISR();
-  }
-  else if (radio->mode == mode_receiving) {
-    chSysLockFromISR();
-    chEvtBroadcastI(&rf_pkt_rdy);
-    chSysUnlockFromISR();
+  chSysLockFromISR();
+  /* none after radioStop() */
+  if (radio->thread != NULL) {
+    if (radio->mode == mode_transmitting)
+      chEvtSignalI(radio->thread, RADIO_EVT_TX_DONE);
+    else if (radio->mode == mode_receiving)
+      chEvtSignalI(radio->thread, RADIO_EVT_RX);
   }
+  chSysUnlockFromISR();
 }
 
 void radioInterrupt(EXTDriver *extp, expchannel_t channel) {
@@ -586,58 +668,41 @@ uint8_t radioAddress(KRadioDevice *radio) {
   return radio->address;
 }
 
-void radioSend(KRadioDevice *radio,
-               uint8_t addr,
-               uint8_t prot,
-               size_t bytes,
-               const void *payload) {
-
-  RadioPacket pkt;
-  uint8_t reg;
+msg_t radioSendAsync(KRadioDevice *radio,
+                     uint8_t addr,
+                     uint8_t prot,
+                     size_t bytes,
+                     const void *payload,
+                     void (*done)(void *arg, msg_t result),
+                     void *arg,
+                     systime_t timeout) {
 
-  pkt.length = bytes + sizeof(pkt);
-  pkt.src = radio->address;
-  pkt.dst = addr;
-  pkt.prot = prot;
+  msg_t msg;
 
-  /* Ideally, we'd poll for DIO1 to see when the FIFO can accept data.
-   * This is not wired up on Orchard, so we can't transmit packets larger
-   * than the FIFO.
-   */
-  osalDbgAssert(pkt.length < RADIO_FIFO_DEPTH, "Packet is too large");
+  if (radio->stopping)
+    return MSG_RESET;
 
-  /* Enter transmission mode */
-  radio->mode = mode_transmitting;
-  radio_set(radio, RADIO_OpMode, OpMode_Sequencer_On
-                               | OpMode_Listen_Off
-                               | OpMode_Transmitter);
-
-  /* Transmit the packet as soon as the entire thing is in the Fifo */
-  radio_set(radio, RADIO_FifoThresh, pkt.length - 1);
-
-  radio_select(radio);
+  msg = radioTxQueuePut(&radio->txq, radio->address, addr, prot,
+                        bytes, payload, done, arg, timeout);
+  if (msg == MSG_OK)
+    chEvtSignal(radio->thread, RADIO_EVT_TX);
 
-  /* Select the FIFO */
-  reg = RADIO_Fifo | 0x80;
-  spiSend(radio->driver, 1, &reg);
+  return msg;
+}
 
-  /* Load the header into the Fifo */
-  spiSend(radio->driver, sizeof(pkt), &pkt);
+void radioSend(KRadioDevice *radio,
+               uint8_t addr,
+               uint8_t prot,
+               size_t bytes,
+               const void *payload) {
 
-  /* Load the payload into the Fifo */
-  spiSend(radio->driver, bytes, payload);
-  radio_unselect(radio);
+  (void) radioSendAsync(radio, addr, prot, bytes, payload,
+                        NULL, NULL, TIME_INFINITE);
+}
 
-  /* Wait for the transmission to complete (will be unlocked in IRQ) */
-  osalSysLock();
-  (void) osalThreadSuspendS(&radio->thread);
-  osalSysUnlock();
+const struct radio_tx_stats *radioTxStats(KRadioDevice *radio) {
 
-  /* Move back into "Rx" mode */
-  radio->mode = mode_receiving;
-  radio_set(radio, RADIO_OpMode, OpMode_Sequencer_On
-                               | OpMode_Listen_Off
-                               | OpMode_Receiver);
+  return &radio->txq.stats;
 }
 
 static uint32_t test_rxseq = 0;
@@ -703,10 +768,8 @@ OrchardTestResult test_radio(const char *my_name, OrchardTestType test_type) {
         chsnprintf(promptA, sizeof(promptA), "radio tx: %d", i+1 );
         chsnprintf(promptB, sizeof(promptB), "retry: %d", j++ );
         orchardTestPrompt(promptA, promptB, 0);
-	radioAcquire(radioDriver);
         radioSend(radioDriver, RADIO_BROADCAST_ADDRESS, radio_prot_dut_to_peer,
                   sizeof(nonce), &nonce);
-	radioRelease(radioDriver);
         if (chVTGetSystemTime() - starttime > RADIO_TEST_TIMEOUT_MS) {
           orchardTestPrompt("radio test", "timeout fail!", 0);
           return orchardResultFail;
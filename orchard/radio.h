@@ -3,6 +3,8 @@
 
 struct _KRadioDevice;
 typedef struct _KRadioDevice KRadioDevice;
+struct radio_rx_stats;
+struct radio_tx_stats;
 
 #define RADIO_NETWORK_MAX_LENGTH 8
 #define RADIO_BROADCAST_ADDRESS 255
@@ -26,15 +28,29 @@ enum radio_protocols {
 
 extern KRadioDevice KRADIO1;
 
+#if HAL_USE_SPI
 void radioStart(KRadioDevice *radio, SPIDriver *spip);
+#endif
+/* Sends the packets still queued, stops the radio thread and puts the chip
+   to sleep. radioSend() drops packets from then on.*/
 void radioStop(KRadioDevice *radio);
 uint8_t radioRead(KRadioDevice *radio, uint8_t addr);
 void radioWrite(KRadioDevice *radio, uint8_t addr, uint8_t val);
 int radioDump(KRadioDevice *radio, uint8_t addr, void *bfr, int count);
 int radioTemperature(KRadioDevice *radio);
 void radioSetNetwork(KRadioDevice *radio, const uint8_t *id, uint8_t len);
+
+/* Queues a packet for the radio thread and returns as soon as it's copied,
+   only blocking while the transmit queue is full.*/
 void radioSend(KRadioDevice *radio, uint8_t dest, uint8_t prot,
                                     size_t len, const void *payload);
+/* Same, with a callback run on the radio thread once the packet is sent
+   (MSG_OK) or given up on, and a timeout on a full queue (MSG_TIMEOUT).
+   MSG_RESET once the radio is stopped.*/
+msg_t radioSendAsync(KRadioDevice *radio, uint8_t dest, uint8_t prot,
+                     size_t len, const void *payload,
+                     void (*done)(void *arg, msg_t result), void *arg,
+                     systime_t timeout);
 void radioSetAddress(KRadioDevice *radio, uint8_t addr);
 uint8_t radioAddress(KRadioDevice *radio);
 
@@ -51,8 +67,11 @@ void radioSetHandler(KRadioDevice *radio, uint8_t prot,
                                      uint8_t length,
                                      const void *data));
 
+const struct radio_rx_stats *radioRxStats(KRadioDevice *radio);
+const struct radio_tx_stats *radioTxStats(KRadioDevice *radio);
+
+#if HAL_USE_EXT
 void radioInterrupt(EXTDriver *extp, expchannel_t channel);
-void radioAcquire(KRadioDevice *radio);
-void radioRelease(KRadioDevice *radio);
+#endif
 
 #endif /* __ORCHARD_RADIO_H__ */
@@ -0,0 +1,205 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "spi-arbiter.h"
+#include "fxprof.h"
+
+#include <string.h>
+
+static spiarb_bus spiarb_buses[SPIARB_MAX_BUSES];
+static spiarb_device *spiarb_devices;
+
+spiarb_bus *spiarbBus(const void *driver) {
+  unsigned i;
+
+  for( i = 0; i < SPIARB_MAX_BUSES; i++ )
+    if( spiarb_buses[i].driver == driver )
+      return &spiarb_buses[i];
+
+  for( i = 0; i < SPIARB_MAX_BUSES; i++ ) {
+    if( spiarb_buses[i].driver == NULL ) {
+      spiarb_buses[i].driver = driver;
+      chMtxObjectInit(&spiarb_buses[i].mutex);
+      chCondObjectInit(&spiarb_buses[i].turn);
+      return &spiarb_buses[i];
+    }
+  }
+
+  osalDbgAssert(false, "too many SPI buses");
+  return NULL;
+}
+
+void spiarbDeviceInit(spiarb_device *dev, spiarb_bus *bus, const char *name,
+                      spiarb_prio prio) {
+  spiarb_device *d;
+
+  dev->name = name;
+  dev->bus = bus;
+  dev->prio = prio;
+  dev->since = 0;
+  memset(&dev->stats, 0, sizeof(dev->stats));
+
+  for( d = spiarb_devices; d != NULL; d = d->next )
+    if( d == dev )
+      return;
+  dev->next = spiarb_devices;
+  spiarb_devices = dev;
+}
+
+unsigned spiarbBucket(uint32_t us) {
+  unsigned b = 0;
+
+  // no CLZ on the M0+, and the loop is short
+  while( (us >>= 1) != 0 && (b < SPIARB_HIST_BUCKETS - 1) )
+    b++;
+  return b;
+}
+
+// call locked; whether a device of higher priority than dev is waiting
+static int spiarb_higher_s(spiarb_bus *bus, spiarb_device *dev) {
+  unsigned prio;
+
+  for( prio = dev->prio + 1; prio < sizeof(bus->pending); prio++ )
+    if( bus->pending[prio] != 0 )
+      return 1;
+  return 0;
+}
+
+// call locked, with the bus mutex; whether dev has to let another device
+// go first: one of higher priority, or one of its own that yielded
+static int spiarb_not_turn_s(spiarb_bus *bus, spiarb_device *dev) {
+
+  if( spiarb_higher_s(bus, dev) )
+    return 1;
+  return (bus->yielder != NULL) && (bus->yielder != dev) &&
+         (bus->yielder->prio >= dev->prio);
+}
+
+// call locked, with the bus mutex; waits on the condition variable, without
+// the mutex, until it is dev's turn. returns with the mutex
+static int spiarb_wait_turn_s(spiarb_device *dev) {
+  spiarb_bus *bus = dev->bus;
+  int waited = 0;
+
+  while( spiarb_not_turn_s(bus, dev) ) {
+    (void) chCondWaitS(&bus->turn);
+    waited = 1;
+  }
+  bus->owner = dev;
+  return waited;
+}
+
+// call locked, with the bus mutex; wakes the waiters that were not given
+// their turn, they get back in line for the mutex. does not reschedule
+static void spiarb_let_go_s(spiarb_bus *bus) {
+
+  bus->owner = NULL;
+  chCondBroadcastI(&bus->turn);
+}
+
+static void spiarb_got(spiarb_device *dev, uint32_t start, int waited) {
+  spiarb_stats *s = &dev->stats;
+  uint32_t wait;
+
+  dev->since = fxprofNow();
+  wait = dev->since - start;
+
+  s->acquired++;
+  if( waited )
+    s->contended++;
+  if( wait > s->wait_max )
+    s->wait_max = wait;
+  s->wait_hist[spiarbBucket(FXPROF2US(wait))]++;
+}
+
+static void spiarb_held(spiarb_device *dev) {
+  spiarb_stats *s = &dev->stats;
+  uint32_t hold = fxprofNow() - dev->since;
+
+  s->hold_time += hold;
+  if( hold > s->hold_max )
+    s->hold_max = hold;
+  s->hold_hist[spiarbBucket(FXPROF2US(hold))]++;
+}
+
+void spiarbAcquire(spiarb_device *dev) {
+  spiarb_bus *bus = dev->bus;
+  uint32_t start = fxprofNow();
+  int waited;
+
+  osalDbgAssert(bus->owner != dev, "SPI bus already held");
+
+  chSysLock();
+  bus->pending[dev->prio]++;
+  chSysUnlock();
+
+  // a busy bus is a kernel mutex wait, the holder inherits our priority
+  waited = !chMtxTryLock(&bus->mutex);
+  if( waited )
+    chMtxLock(&bus->mutex);
+
+  chSysLock();
+  waited |= spiarb_wait_turn_s(dev);
+  bus->pending[dev->prio]--;
+  chSysUnlock();
+
+  spiarb_got(dev, start, waited);
+}
+
+void spiarbRelease(spiarb_device *dev) {
+
+  osalDbgAssert(dev->bus->owner == dev, "SPI bus not held");
+  spiarb_held(dev);
+
+  chSysLock();
+  spiarb_let_go_s(dev->bus);
+  chMtxUnlockS(&dev->bus->mutex);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+int spiarbWaiting(spiarb_device *dev) {
+  int higher;
+
+  chSysLock();
+  higher = spiarb_higher_s(dev->bus, dev);
+  chSysUnlock();
+
+  return higher;
+}
+
+int spiarbYield(spiarb_device *dev) {
+  spiarb_bus *bus = dev->bus;
+  uint32_t start;
+
+  // waiters only come and never leave while we hold the bus, so one that
+  // shows up after this look waits for the next chunk
+  if( !spiarbWaiting(dev) )
+    return 0;
+
+  spiarb_held(dev);
+  start = fxprofNow();
+
+  chSysLock();
+  // the rest of the transfer goes before other devices of its priority
+  spiarb_let_go_s(bus);
+  bus->yielder = dev;
+  (void) spiarb_wait_turn_s(dev);
+  bus->yielder = NULL;
+  chSysUnlock();
+
+  dev->stats.yielded++;
+  spiarb_got(dev, start, 1);
+  return 1;
+}
+
+spiarb_device *spiarbDevices(void) {
+  return spiarb_devices;
+}
+
+void spiarbResetStats(void) {
+  spiarb_device *d;
+
+  for( d = spiarb_devices; d != NULL; d = d->next )
+    memset(&d->stats, 0, sizeof(d->stats));
+}
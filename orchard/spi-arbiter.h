@@ -0,0 +1,86 @@
+#ifndef __ORCHARD_SPI_ARBITER_H__
+#define __ORCHARD_SPI_ARBITER_H__
+
+#include "ch.h"
+#include "hal.h"
+
+// The devices on an SPI bus take turns through an arbiter. Holding the bus
+// is holding a kernel mutex of its own, so the thread holding it inherits
+// the priority of the threads waiting for it, and the arbiter only orders
+// the turns on top: devices waiting for the bus get it highest priority
+// first, and in order within a priority. A waiter whose turn it isn't lets
+// go of the mutex and sleeps on a condition variable until the bus is
+// released. A device with a long transfer, like the OLED pushing a frame,
+// sends it in chunks and calls spiarbYield() between them with its chip
+// select released: a device of higher priority that is waiting gets the
+// bus there, so it waits for one chunk rather than a whole frame.
+//
+// Every device keeps histograms of the time it waited for the bus and of
+// the time it held it, in power of two microseconds.
+
+#define SPIARB_MAX_BUSES      2
+#define SPIARB_HIST_BUCKETS   12    // <2us, 2us, 4us ... 2048us and over
+
+typedef enum spiarb_prio {
+  spiarbPrioDisplay = 0,  // OLED frames
+  spiarbPrioNormal,       // BLE
+  spiarbPrioRadio,        // radio FIFO
+} spiarb_prio;
+
+typedef struct spiarb_stats {
+  uint32_t      acquired;     // times the device got the bus
+  uint32_t      contended;    // of those, times it had to wait for it
+  uint32_t      yielded;      // times it let a waiting device in between chunks
+  uint64_t      hold_time;    // time holding the bus, in fxprof counts
+  uint32_t      hold_max;
+  uint32_t      wait_max;     // longest time from asking to getting the bus
+  uint32_t      wait_hist[SPIARB_HIST_BUCKETS];
+  uint32_t      hold_hist[SPIARB_HIST_BUCKETS];
+} spiarb_stats;
+
+struct spiarb_device;
+
+typedef struct spiarb_bus {
+  const void            *driver;    // the SPIDriver, or whatever stands for it
+  struct spiarb_device  *owner;
+  struct spiarb_device  *yielder;   // goes first among its priority
+  mutex_t               mutex;      // held with the bus
+  condition_variable_t  turn;       // waiters whose turn it isn't
+  uint8_t               pending[spiarbPrioRadio + 1]; // waiters per priority
+} spiarb_bus;
+
+typedef struct spiarb_device {
+  const char            *name;
+  spiarb_bus            *bus;
+  uint8_t               prio;       // spiarb_prio
+  uint32_t              since;      // when it got the bus, in fxprof counts
+  spiarb_stats          stats;
+  struct spiarb_device  *next;      // all the devices, for the stats
+} spiarb_device;
+
+// the arbiter of the bus driven by driver, set up on first use
+spiarb_bus *spiarbBus(const void *driver);
+
+void spiarbDeviceInit(spiarb_device *dev, spiarb_bus *bus, const char *name,
+                      spiarb_prio prio);
+
+// Waits for the bus. Only one device of a bus holds it at a time.
+void spiarbAcquire(spiarb_device *dev);
+void spiarbRelease(spiarb_device *dev);
+
+// a device of higher priority than dev, which holds the bus, waits for it
+int spiarbWaiting(spiarb_device *dev);
+
+// Between two chunks of a transfer, with the chip select released: hands
+// the bus over if a device of higher priority is waiting, and waits to get
+// it back, ahead of the devices of its own priority. Returns 1 if it did.
+int spiarbYield(spiarb_device *dev);
+
+// index of the histogram bucket for a time in microseconds
+unsigned spiarbBucket(uint32_t us);
+
+// first of the registered devices, follow ->next for the rest
+spiarb_device *spiarbDevices(void);
+void spiarbResetStats(void);
+
+#endif /* __ORCHARD_SPI_ARBITER_H__ */
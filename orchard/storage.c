@@ -5,69 +5,195 @@
 
 #include "flash.h"
 #include "storage.h"
+#include "dlog.h"
 
 #include <string.h>
 #include <stdlib.h>
 
+// in-RAM map of the ORFS sector space. It is built once by storageStart() and
+// kept in sync by init_sector() and the record writers, so lookups never have to
+// walk the sector headers in FLASH. Sector numbers in here are relative to SECTOR_MIN.
+static struct {
+  uint8_t   built;
+  uint8_t   cursor;                           // sector last handed out by find_empty_sector()
+  uint8_t   blockSector[ORFS_MAX_SECTORS];    // newest sector holding each block
+  uint8_t   sectorBlock[ORFS_MAX_SECTORS];    // block held by each sector
+  uint8_t   sectorRecords[ORFS_MAX_SECTORS];  // committed records in each log sector
+  uint16_t  sectorExtent[ORFS_MAX_SECTORS];   // record size of each log sector, or ORFS_EXTENT_FLAT
+  uint32_t  sectorJournal[ORFS_MAX_SECTORS];  // journal revision held by each sector
+} orfs_index;
+
+static orfs_stats storage_stats;
+
+static const orfs_head *sector_header(uint32_t i) {
+  storage_stats.headerReads++;
+  return (const orfs_head *) ((uintptr_t) (SECTOR_MIN + i) * SECTOR_SIZE);
+}
+
+static uint32_t records_per_sector(uint32_t extent) {
+  return ORFS_LOG_SIZE / (extent + sizeof(uint32_t));
+}
+
+// each record is extent bytes of data followed by its commit word
+static const uint32_t *record_data(uint32_t i, uint32_t record) {
+  return (const uint32_t *) ((uintptr_t) (SECTOR_MIN + i) * SECTOR_SIZE + sizeof(orfs_head) +
+                             record * (orfs_index.sectorExtent[i] + sizeof(uint32_t)));
+}
+
+// current data of the block held by a sector
+static const uint32_t *sector_data(uint32_t i) {
+  if( orfs_index.sectorExtent[i] == ORFS_EXTENT_FLAT )
+    return &(((orfs_head *) ((uintptr_t) (SECTOR_MIN + i) * SECTOR_SIZE))->firstData);
+  if( orfs_index.sectorRecords[i] == 0 )
+    return record_data(i, 0);  // nothing written yet, reads blank
+  return record_data(i, orfs_index.sectorRecords[i] - 1);
+}
+
+// bytes readable behind sector_data()
+static uint32_t sector_size(uint32_t i) {
+  if( orfs_index.sectorExtent[i] == ORFS_EXTENT_FLAT )
+    return ORFS_FLAT_SIZE;
+  if( orfs_index.sectorExtent[i] == ORFS_EXTENT_NONE )
+    return ORFS_LOG_SIZE;
+  return orfs_index.sectorExtent[i];
+}
+
+// a sector is live if it holds the newest copy of its block
+static uint8_t sector_is_live(uint32_t i) {
+  uint8_t block = orfs_index.sectorBlock[i];
+
+  if( (block == ORFS_SECTOR_BLANK) || (block == ORFS_SECTOR_STALE) )
+    return 0;
+  return orfs_index.blockSector[block] == i;
+}
+
+// fills in the layout of a sector from its header, returns 0 if it holds nothing usable
+static uint8_t index_scan(uint32_t i, const orfs_head *header) {
+  uint32_t r;
+
+  if( header->version == ORFS_REV_FLAT ) {
+    orfs_index.sectorExtent[i] = ORFS_EXTENT_FLAT;
+    return 1;
+  }
+  if( header->version != ORFS_REV_LOG )
+    return 0;
+
+  orfs_index.sectorRecords[i] = 0;
+  if( header->extent == 0xFFFFFFFF ) {
+    orfs_index.sectorExtent[i] = ORFS_EXTENT_NONE;  // allocated, but never written
+    return 1;
+  }
+  if( (header->extent == 0) || (header->extent > ORFS_LOG_MAX_EXTENT) ||
+      ((header->extent % sizeof(uint32_t)) != 0) )
+    return 0;
+  orfs_index.sectorExtent[i] = header->extent;
+
+  // records are committed in order, the first uncommitted one ends the log
+  for( r = 0; r < records_per_sector(header->extent); r++ ) {
+    if( record_data(i, r)[header->extent / sizeof(uint32_t)] != ORFS_COMMIT )
+      break;
+    orfs_index.sectorRecords[i]++;
+  }
+
+  // if the first record was never committed, an older copy of the block wins
+  return orfs_index.sectorRecords[i] != 0;
+}
+
+static void index_build(void) {
+  const orfs_head *header;
+  uint32_t i;
+  uint32_t newest = JOURNAL_INVALID;
+  uint8_t cur;
+
+  osalDbgAssert(SECTOR_COUNT <= ORFS_MAX_SECTORS, "ORFS_MAX_SECTORS is too small for this part\n\r");
+
+  memset( orfs_index.blockSector, ORFS_SECTOR_BLANK, sizeof(orfs_index.blockSector) );
+  memset( orfs_index.sectorBlock, ORFS_SECTOR_BLANK, sizeof(orfs_index.sectorBlock) );
+  orfs_index.cursor = SECTOR_COUNT - 1;
+
+  for( i = 0; i < SECTOR_COUNT; i++ ) {
+    header = sector_header(i);
+    if( header->signature != ORFS_SIG )
+      continue;  // blank, free for the taking
+    if( (header->block >= BLOCK_TOTAL) || !index_scan(i, header) ) {
+      orfs_index.sectorBlock[i] = ORFS_SECTOR_STALE;  // garbage, reclaim it
+      continue;
+    }
+    orfs_index.sectorBlock[i] = header->block;
+    orfs_index.sectorJournal[i] = header->journalrev;
+
+    // journal numbers go down from 0xFFFFFFFE, so the lowest one is the newest
+    cur = orfs_index.blockSector[header->block];
+    if( (cur == ORFS_SECTOR_BLANK) || (header->journalrev <= orfs_index.sectorJournal[cur]) )
+      orfs_index.blockSector[header->block] = i;
+
+    // resume the round-robin after the most recently allocated sector
+    if( header->journalrev < newest ) {
+      newest = header->journalrev;
+      orfs_index.cursor = i;
+    }
+  }
+
+  orfs_index.built = 1;
+  storage_stats.indexBuilds++;
+}
+
+// record a freshly initialized sector as the newest copy of its block
+static void index_record(uint32_t sector, uint32_t block, uint32_t journalrev, uint32_t extent) {
+  uint32_t i = sector - SECTOR_MIN;
+
+  orfs_index.sectorBlock[i] = block;
+  orfs_index.sectorJournal[i] = journalrev;
+  orfs_index.sectorExtent[i] = extent;
+  orfs_index.sectorRecords[i] = 0;
+  orfs_index.blockSector[block] = i;
+}
+
 // returns a pointer to the data section of the new sector
-const uint32_t *init_sector(uint32_t sector, uint32_t block, uint32_t journalrev) {
+// extent is ORFS_EXTENT_FLAT for a flat sector, ORFS_EXTENT_NONE for a log sector
+// whose record size is picked on first write, or the record size of a log sector
+const uint32_t *init_sector(uint32_t sector, uint32_t block, uint32_t journalrev, uint32_t extent) {
   orfs_head header;
-  orfs_head *rethead;
   int8_t ret;
 
-  chprintf(stream, " init_sector: sector %d, block %d, journal %x\n\r", sector, block, journalrev);
+  dlog("init_sector: sector %d, block %d, journal %x", sector, block, journalrev);
   // initialize a sector to a blank state
   flashErase(sector, 1);
+  storage_stats.erases++;
+  storage_stats.sectorErases[sector - SECTOR_MIN]++;
+  orfs_index.sectorBlock[sector - SECTOR_MIN] = ORFS_SECTOR_BLANK;
 
   header.signature = ORFS_SIG;
-  header.version = ORFS_REV;
+  header.version = (extent == ORFS_EXTENT_FLAT) ? ORFS_REV_FLAT : ORFS_REV_LOG;
   header.block = block;
   header.journalrev = journalrev;
-  header.firstData = 0xFFFFFFFF;  // don't set it
-  
-  ret = flashProgram((uint8_t *) &header, (uint8_t *) (sector * SECTOR_SIZE), sizeof(orfs_head));
+  if( (extent == ORFS_EXTENT_FLAT) || (extent == ORFS_EXTENT_NONE) )
+    header.firstData = 0xFFFFFFFF;  // don't set it
+  else
+    header.extent = extent;
+
+  ret = flashProgram((uint8_t *) &header, (uint8_t *) ((uintptr_t) sector * SECTOR_SIZE), sizeof(orfs_head));
   if( ret != F_ERR_OK ) {
     osalDbgAssert(FALSE, "Sector init failed on programming error\n\r");
     return NULL;
   }
+  index_record(sector, block, journalrev, extent);
 
-  rethead = (orfs_head *) (sector * SECTOR_SIZE);
-  return &(rethead->firstData);
+  return sector_data(sector - SECTOR_MIN);
 }
 
 // there should always be at least one empty sector
 static uint32_t find_empty_sector(void) {
-  uint32_t blockToSector[BLOCK_TOTAL];  // stores the sector that a block is located at
-  uint32_t journalRevs[BLOCK_TOTAL];
   uint32_t i;
-  orfs_head *header;
+  uint32_t n;
 
-  memset( blockToSector, 0xFF, sizeof(blockToSector) );
-  memset( journalRevs, 0xFF, sizeof(journalRevs) );
-  
-  // do a search through sector space for the first duplicated sector
-  // we want the first duplicated sector number with the lower journal revision
-  for( i = 0; i < SECTOR_COUNT; i++ ) {
-    header = (orfs_head *) ((SECTOR_MIN + i) * SECTOR_SIZE);
-    // first try a search for blank memory, if it's blank just return
-    if( header->signature != ORFS_SIG ) {
+  // walk round-robin from the last sector handed out, so that every sector
+  // not holding a live block takes its turn at being erased
+  for( n = 1; n <= SECTOR_COUNT; n++ ) {
+    i = (orfs_index.cursor + n) % SECTOR_COUNT;
+    if( !sector_is_live(i) ) {
+      orfs_index.cursor = i;
       return i + SECTOR_MIN;
-    } else {
-      if( blockToSector[header->block] == 0xFFFFFFFF ) {
-	blockToSector[header->block] = i; // record the last sector we saw
-	journalRevs[header->block] = header->journalrev;
-      } else {
-	// this block has already been mapped to a sector.
-	// either this is the newer version, or the older version. Find out.
-	if( header->journalrev < journalRevs[header->block] ) {
-	  // in this case, the current header is /newer/ than the one we saw
-	  // (journal numbers go down from 0xFFFFFFFE)
-	  // so return the old sector number
-	  return blockToSector[header->block] + SECTOR_MIN;
-	} else {
-	  return i + SECTOR_MIN;
-	}
-      }
     }
   }
 
@@ -76,67 +202,133 @@ static uint32_t find_empty_sector(void) {
   return SECTOR_INVALID;
 }
 
+void storageStart(void) {
+  index_build();
+}
+
+const orfs_stats *storageGetStats(void) {
+  return &storage_stats;
+}
+
 const void *storageGetData(uint32_t block) {
-  uint32_t *foundData = NULL;
-  uint32_t journalrev = JOURNAL_YOUNGEST;
-  uint32_t i;
-  orfs_head *header;
-  // do a linear search for the sector holding our block
-  for( i = 0; i < SECTOR_COUNT; i++ ) {
-    header = (orfs_head *) ((SECTOR_MIN + i) * SECTOR_SIZE);
-    if( header->signature == ORFS_SIG ) {
-      if( (header->block == block) && (header->journalrev <= journalrev ) ) {
-	foundData = &(header->firstData);
-	journalrev = header->journalrev;
-      }
-    }
+  uint8_t sector;
+
+  if( block >= BLOCK_TOTAL ) {
+    osalDbgAssert(FALSE, "block number is out of range\n\r");
+    return NULL;
   }
-  if( foundData != NULL ) {
-    return foundData;
+  if( !orfs_index.built )
+    index_build();
+
+  storage_stats.lookups++;
+  sector = orfs_index.blockSector[block];
+  if( sector != ORFS_SECTOR_BLANK ) {
+    return sector_data(sector);
   } else {
     // we're dealing with virgin memory, just create a block out of thin air
-    return init_sector(find_empty_sector(), block, JOURNAL_YOUNGEST);
+    return init_sector(find_empty_sector(), block, JOURNAL_YOUNGEST, ORFS_EXTENT_NONE);
   }
 }
 
-// return the journal entry number for a block
-// if the block doesn't exist, create it
-static uint32_t storage_get_journal(uint32_t block) {
-  uint32_t *foundData = NULL;
-  uint32_t journalrev = JOURNAL_YOUNGEST;
-  uint32_t i;
-  orfs_head *header;
-  // do a linear search for the sector holding our block
-  for( i = 0; i < SECTOR_COUNT; i++ ) {
-    header = (orfs_head *) ((SECTOR_MIN + i) * SECTOR_SIZE);
-    if( header->signature == ORFS_SIG ) {
-      if( (header->block == block) && (header->journalrev <= journalrev ) ) {
-	foundData = &(header->firstData);
-	journalrev = header->journalrev;
-      }
-    }
+uint32_t storageGetSize(uint32_t block) {
+  if( storageGetData(block) == NULL )
+    return 0;
+  return sector_size(orfs_index.blockSector[block]);
+}
+
+// bytes up to and including the last programmed word
+static uint32_t used_size(const uint32_t *src, uint32_t size) {
+  while( (size > 0) && (src[size / sizeof(uint32_t) - 1] == 0xFFFFFFFF) )
+    size -= sizeof(uint32_t);
+  return size;
+}
+
+// pick the record size for a block using `used` bytes, leaving some headroom
+// for blocks that grow by tacking data onto their end, like the audit log
+static uint32_t choose_extent(uint32_t used) {
+  uint32_t extent;
+
+  extent = used + used / 4;
+  extent = (extent + ORFS_RECORD_ALIGN - 1) & ~(ORFS_RECORD_ALIGN - 1);
+  if( extent == 0 )
+    extent = ORFS_RECORD_ALIGN;
+  if( extent > ORFS_LOG_MAX_EXTENT )
+    return ORFS_EXTENT_FLAT;
+  return extent;
+}
+
+// program a patched copy of srcSize bytes of src into the blank area at dest,
+// which holds destSize bytes; words past srcSize are left blank
+static int8_t program_patched(uint32_t *dest, uint32_t destSize, const uint32_t *src, uint32_t srcSize,
+                              uint32_t *data, uint32_t offset, uint32_t size) {
+  int8_t ret;
+
+  if( srcSize > destSize )
+    srcSize = destSize;
+
+  // copy over the data up to the offset
+  if( offset > 0 ) {
+    ret = flashProgram((uint8_t *) src, (uint8_t *) dest, offset < srcSize ? offset : srcSize);
+    osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
+    if( ret != F_ERR_OK )
+      return ret;
   }
-  if( foundData != NULL ) {
-    return journalrev;
-  } else {
-    init_sector(find_empty_sector(), block, JOURNAL_YOUNGEST);    
-    return JOURNAL_YOUNGEST;
+
+  // patch in the new data
+  ret = flashProgram((uint8_t *) data, (uint8_t *) ((uintptr_t) dest + offset), size);
+  osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
+  if( ret != F_ERR_OK )
+    return ret;
+
+  // copy over data from the end of the patch block
+  if( (offset + size) < srcSize ) {
+    ret = flashProgram((uint8_t *) ((uintptr_t) src + offset + size),
+                       (uint8_t *) ((uintptr_t) dest + offset + size),
+                       srcSize - (offset + size));
+    osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
   }
+
+  return ret;
+}
+
+// write a patched copy of the block as the next record of log sector i
+static int8_t append_record(uint32_t i, const uint32_t *src, uint32_t srcSize,
+                            uint32_t *data, uint32_t offset, uint32_t size) {
+  uint32_t extent = orfs_index.sectorExtent[i];
+  uint32_t *dest = (uint32_t *) record_data(i, orfs_index.sectorRecords[i]);
+  uint32_t commit = ORFS_COMMIT;
+  int8_t ret;
+
+  ret = program_patched(dest, extent, src, srcSize, data, offset, size);
+  if( ret != F_ERR_OK )
+    return ret;
+
+  // the record only becomes the block's data once its commit word is down
+  ret = flashProgram((uint8_t *) &commit, (uint8_t *) &dest[extent / sizeof(uint32_t)], sizeof(commit));
+  osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
+  if( ret == F_ERR_OK )
+    orfs_index.sectorRecords[i]++;
+
+  return ret;
 }
 
 // return code based on F_ERR system
 // you can patch a blank block, it will just allocate and initialize it
 // offset and size are in bytes, and must be word-aligned
 int8_t storagePatchData(uint32_t block, uint32_t *data, uint32_t offset, uint32_t size) {
+  const uint32_t *srcData;
   const uint32_t *destData;
-  uint32_t *srcData;
+  orfs_head *header;
   uint32_t i;
   uint8_t isblank = 1;
-  uint8_t ret = F_ERR_OK;
+  int8_t ret;
+  uint32_t sector;
   uint32_t destSector;
+  uint32_t extent;
+  uint32_t used;
   uint32_t journalrev;
   
-  if( (offset + size) > SECTOR_SIZE ) {
+  if( (offset + size) > ORFS_FLAT_SIZE ) {
     // we're out of bounds, should we as a policy fail, or just truncate?
     osalDbgAssert(FALSE, "offset + size out of bounds\n\r");
     return F_ERR_RANGE;
@@ -151,54 +343,71 @@ int8_t storagePatchData(uint32_t block, uint32_t *data, uint32_t offset, uint32_
   
   // first, retrieve the block in question to be patched
   // if the block hasn't been allocated the following function will automatically do that too
-  destData = storageGetData(block);
-  osalDbgAssert(destData != NULL, "Couldn't find/allocate storage block to patch\n\r");
+  srcData = storageGetData(block);
+  osalDbgAssert(srcData != NULL, "Couldn't find/allocate storage block to patch\n\r");
+  sector = orfs_index.blockSector[block];
+  extent = orfs_index.sectorExtent[sector];
 
-  for( i = 0; i < size / sizeof(uint32_t); i++ ) {
-    if( destData[i + (offset / sizeof(uint32_t))] != 0xFFFFFFFF )
-      isblank = 0;
+  // a log sector that was never written has no record to patch in place yet
+  if( (extent != ORFS_EXTENT_NONE) && ((offset + size) <= sector_size(sector)) ) {
+    for( i = 0; i < size / sizeof(uint32_t); i++ ) {
+      if( srcData[i + (offset / sizeof(uint32_t))] != 0xFFFFFFFF )
+        isblank = 0;
+    }
+    if(isblank) {
+      // we can patch in the new data
+      ret = flashProgram((uint8_t *) data, (uint8_t *) ((uintptr_t) srcData + offset), size);
+      osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
+      return ret;
+    }
   }
-  if(isblank) {
-    // we can patch in the new data
-    ret = flashProgram((uint8_t *) data, (uint8_t *) ((uint32_t) destData + offset), size);
-    osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
-    return ret;
-  } else {
-    // if it's not blank:
-    // allocate a new sector
-    // decrement the journal number
-    // program in the patched data
-    journalrev = storage_get_journal(block);
-    destSector = find_empty_sector();
-    
-    osalDbgAssert(destSector != SECTOR_INVALID, "ORFS general error, couldn't find the empty sector (there should always be exactly one)\n\r");
-
-    if( journalrev == 0 ) {
-      chprintf( stream, "Journaling overflow, we somehow went through 4 billion revisions...\n\r" );
-      return F_ERR_JOURNAL_OVER;
-      // TODO: a graceful way to handle this would be to simply reset journal to
-      // youngest value, but make sure the older block is low-level erased so it doesn't
-      // show up in the journaling sweep...
+
+  if( extent == ORFS_EXTENT_NONE ) {
+    // first write to a fresh log sector: size its records, then commit the first one
+    extent = choose_extent(offset + size);
+    if( extent != ORFS_EXTENT_FLAT ) {
+      header = (orfs_head *) ((uintptr_t) (SECTOR_MIN + sector) * SECTOR_SIZE);
+      ret = flashProgram((uint8_t *) &extent, (uint8_t *) &header->extent, sizeof(extent));
+      osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
+      if( ret != F_ERR_OK )
+        return ret;
+      orfs_index.sectorExtent[sector] = extent;
+      return append_record(sector, srcData, 0, data, offset, size);
     }
-    
-    srcData = (uint32_t *) destData; // we now swap the meaning of source and destination:
-    // we have to copy the old destination to the new destination with the patches
-    destData = init_sector(destSector, block, journalrev - 1);
+  } else if( (extent != ORFS_EXTENT_FLAT) && ((offset + size) <= extent) &&
+             (orfs_index.sectorRecords[sector] < records_per_sector(extent)) ) {
+    // there's room left in the sector, append the patched record
+    storage_stats.appends++;
+    return append_record(sector, srcData, extent, data, offset, size);
+  }
 
-    // copy over the data up to the offset
-    ret = flashProgram((uint8_t *) srcData, (uint8_t *) destData, offset);
-    osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
+  // otherwise:
+  // allocate a new sector
+  // decrement the journal number
+  // program in the patched data
+  journalrev = orfs_index.sectorJournal[sector];
+  if( journalrev == 0 ) {
+    chprintf( stream, "Journaling overflow, we somehow went through 4 billion revisions...\n\r" );
+    return F_ERR_JOURNAL_OVER;
+    // TODO: a graceful way to handle this would be to simply reset journal to
+    // youngest value, but make sure the older block is low-level erased so it doesn't
+    // show up in the journaling sweep...
+  }
 
-    // patch in the new data
-    ret = flashProgram((uint8_t *) data, (uint8_t *) ((uint32_t) destData + offset), size);
-    osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
+  used = used_size(srcData, sector_size(sector));
+  if( used < (offset + size) )
+    used = offset + size;
+  extent = choose_extent(used);
 
-    // copy over data from the end of the patch block
-    ret = flashProgram((uint8_t *) ((uint32_t) srcData + offset + size),
-		       (uint8_t *) ((uint32_t) destData + offset + size),
-		       SECTOR_SIZE - (offset + size) - (sizeof(orfs_head) - 4));
-    osalDbgAssert(ret == F_ERR_OK, "Low level programming error in storagePatchData\n\r");
-  }
-    
-  return F_ERR_OK;
+  destSector = find_empty_sector();
+  osalDbgAssert(destSector != SECTOR_INVALID, "ORFS general error, couldn't find the empty sector (there should always be exactly one)\n\r");
+
+  destData = init_sector(destSector, block, journalrev - 1, extent);
+  if( destData == NULL )
+    return F_ERR_LOWLEVEL;
+  storage_stats.relocations++;
+
+  if( extent == ORFS_EXTENT_FLAT )
+    return program_patched((uint32_t *) destData, ORFS_FLAT_SIZE, srcData, used, data, offset, size);
+  return append_record(destSector - SECTOR_MIN, srcData, used, data, offset, size);
 }
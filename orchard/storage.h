@@ -26,21 +26,42 @@
 #define JOURNAL_INVALID  0xFFFFFFFF
 #define JOURNAL_YOUNGEST 0xFFFFFFFE  // journal numbers start from 0xFFFFFFFE and count down
 
+// upper bound on SECTOR_COUNT, sizes the in-RAM block index
+#define ORFS_MAX_SECTORS  16
+#define ORFS_SECTOR_BLANK 0xFF  // index marker: sector holds no ORFS data
+#define ORFS_SECTOR_STALE 0xFE  // index marker: sector holds a corrupt header
+
 #define ORFS_SIG   0x4F524653
-#define ORFS_REV   1
+#define ORFS_REV_FLAT  1  // one copy of the block data fills the sector
+#define ORFS_REV_LOG   2  // the sector holds a log of fixed-size block records
+
+#define ORFS_COMMIT        0x52454344  // 'RECD', programmed after a record is complete
+#define ORFS_EXTENT_FLAT   0           // index marker: sector uses the flat layout
+#define ORFS_EXTENT_NONE   0xFFFF      // index marker: log sector with no record size yet
+#define ORFS_RECORD_ALIGN  32          // record sizes are rounded up to this many bytes
 
 typedef struct orfs_head {
   // note all elements are word-aligned because the data patching algorithm can only
   // patch on a 32-bit *word* basis
   uint32_t  signature;  // set to 'ORFS'; if invalid, assumed the sector can be erased
-  uint32_t   version;    // set to 1
+  uint32_t   version;    // ORFS_REV_FLAT or ORFS_REV_LOG
   uint32_t  block;     // set to the block number
   uint32_t  journalrev; // decrement every time a block is updated
-  uint32_t   firstData;  // first data word
+  union {
+    uint32_t   firstData;  // ORFS_REV_FLAT: first data word
+    uint32_t   extent;     // ORFS_REV_LOG: bytes of data in each record, blank until first write
+  };
   // no checksum because we want to be able to do efficient patching without having
   // to nuke the structure to reprogram a new checksum
 } orfs_head;
 
+// bytes of block data a flat sector can hold
+#define ORFS_FLAT_SIZE  (SECTOR_SIZE - (sizeof(orfs_head) - sizeof(uint32_t)))
+// bytes available for records in a log sector; each record is followed by a commit word
+#define ORFS_LOG_SIZE   (SECTOR_SIZE - sizeof(orfs_head))
+// blocks using more than this are stored flat, as fewer than two records would fit
+#define ORFS_LOG_MAX_EXTENT  (ORFS_LOG_SIZE / 2 - sizeof(uint32_t))
+
 // Hardware restrictions:
 // * Pages are 1k in size
 // * You can't write 0's over 0's -- it reduces flash lifetime
@@ -50,13 +71,41 @@ typedef struct orfs_head {
 // * Virtualize blocks, so that there is (sectors-1) blocks available
 // * Reserve at least one sector for erasing and updating
 // * Allocate blocks in empty sectors on demand
-// * When all sectors are full, look for the duplicated block with the lowest journal number;
-//   erase that sector that holds that block, and blast the new data into it
+// * Patches over blank words are programmed in place
+// * Small blocks are kept as a log of records: a patch over programmed words appends a
+//   patched copy of the block's record to the free tail of its sector, and the newest
+//   committed record is the block's current data. Only once the tail is used up is the
+//   block copied to a fresh sector, so a sector erase is amortized over many updates
+// * Blocks too large for two records per sector use the flat layout and are copied to a
+//   fresh sector on every patch over programmed words
+// * Fresh sectors are taken round-robin from the ones not holding a live block, so the
+//   erases are spread over the whole storage area
+
+typedef struct orfs_stats {
+  uint32_t  headerReads;  // sector headers read out of FLASH
+  uint32_t  indexBuilds;  // full scans of the sector space
+  uint32_t  lookups;      // storageGetData() calls served by the index
+  uint32_t  appends;      // patches written as a new record in the same sector
+  uint32_t  relocations;  // patches that copied the block into a fresh sector
+  uint32_t  erases;       // sector erases issued by ORFS
+  uint32_t  sectorErases[ORFS_MAX_SECTORS];  // erases per sector, relative to SECTOR_MIN
+} orfs_stats;
+
+// builds the in-RAM block index, call once after flashStart() and again
+// whenever the storage sectors are erased behind ORFS's back
+void storageStart(void);
+
+const orfs_stats *storageGetStats(void);
 
 // returns a read-only pointer to the data of the current sector
 // the data is directly in FLASH so you can't write to it
+// the pointer is only good until the next storagePatchData() on the same block
 const void *storageGetData(uint32_t block);
 
+// returns the number of bytes readable behind storageGetData(); only the words
+// written so far are meaningful, the rest of a fresh block reads blank
+uint32_t storageGetSize(uint32_t block);
+
 // updating a sector happens by "patching"
 // the function automatically handles migrating the non-patch data to the new sector copy
 // offset and size are in bytes, but should be word-aligned
@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+#
+# Converts the output of the "trace" shell command (see trace.h) to Chrome
+# trace event JSON, for chrome://tracing or https://ui.perfetto.dev.
+#
+#   ./trace-json.py capture.bin -e build/orchard.elf -o trace.json
+#
+# The capture has to be saved raw, the packets are binary. With the ELF file
+# the badge runs, timer callbacks, event sources and mutexes get their names.
+# Each thread is a track with a slice for every time it ran, next to tracks
+# for interrupts and timer callbacks; the time between a broadcast or an
+# interrupt and the switch to the thread it woke is the scheduling latency.
+
+import argparse
+import json
+import struct
+import sys
+
+from elf import Elf
+
+SYNC = 0xA5
+
+SWITCH, ISR_ENTER, ISR_LEAVE, VT_ENTER, VT_LEAVE, BROADCAST, MUTEX, MARK = \
+    range(1, 9)
+
+STATES = ['READY', 'CURRENT', 'WTSTART', 'SUSPENDED', 'QUEUED', 'WTSEM',
+          'WTMTX', 'WTCOND', 'SLEEPING', 'WTEXIT', 'WTOREVT', 'WTANDEVT',
+          'SNDMSGQ', 'SNDMSG', 'WTMSG', 'FINAL']
+
+# marker id: (name, phase), see TRACE_MARK_ in trace.h
+MARKS = {
+    1: ('effect', 'B'),
+    2: ('effect', 'E'),
+    3: ('radio rx', 'i'),
+    4: ('app event', 'B'),
+    5: ('app event', 'E'),
+}
+
+EXCEPTIONS = {11: 'SVCall', 14: 'PendSV', 15: 'SysTick'}
+
+PID = 1
+TID_ISR = 1000
+TID_TIMER = 1001
+
+
+def parse(data):
+    """Returns the timestamp frequency, the thread names by address, the
+    record bytes and the lost record count."""
+    start = data.find(b'TRACE START ')
+    if start < 0:
+        raise ValueError('no TRACE START in the capture')
+    pos = data.index(b'\n', start)
+    freq = int(data[start + 12:pos].split()[0])
+    pos += 1
+
+    threads = {}
+    while True:
+        while data[pos:pos + 1] in (b'\r', b'\n'):
+            pos += 1
+        if data.startswith(b'TRACE THREAD ', pos):
+            end = data.index(b'\n', pos)
+            words = data[pos + 13:end].decode('latin-1').strip().split(' ', 1)
+            threads[int(words[0], 16)] = words[1] if len(words) > 1 else ''
+            pos = end + 1
+        else:
+            break
+
+    records = bytearray()
+    while True:
+        if pos + 2 > len(data) or data[pos] != SYNC:
+            sys.stderr.write('capture cut short at byte %d\n' % pos)
+            break
+        length = data[pos + 1]
+        pos += 2
+        if length == 0:
+            break
+        records += data[pos:pos + length]
+        pos += length
+
+    lost = 0
+    end = data.find(b'TRACE END lost ', pos)
+    if end >= 0:
+        lost = int(data[end + 15:data.index(b'\n', end)].split()[0])
+    return freq, threads, bytes(records), lost
+
+
+def records(data):
+    """Yields (type, time, state, obj, arg) from the record bytes."""
+    pos = 0
+    time = 0
+    while pos < len(data):
+        typ = data[pos]
+        pos += 1
+        delta = shift = 0
+        while True:
+            b = data[pos]
+            pos += 1
+            delta |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        time += delta
+        state = obj = arg = 0
+        if typ in (SWITCH, MARK):
+            state, obj, arg = struct.unpack_from('<BII', data, pos)
+            pos += 9
+        elif typ in (ISR_ENTER, ISR_LEAVE):
+            state = data[pos]
+            pos += 1
+        elif typ == VT_LEAVE:
+            obj, = struct.unpack_from('<I', data, pos)
+            pos += 4
+        elif typ in (VT_ENTER, BROADCAST, MUTEX):
+            obj, arg = struct.unpack_from('<II', data, pos)
+            pos += 8
+        else:
+            raise ValueError('unknown record type %d at byte %d' % (typ, pos))
+        yield typ, time, state, obj, arg
+
+
+class Converter:
+    def __init__(self, freq, threads, elf):
+        self.freq = freq
+        self.elf = elf
+        self.names = dict(threads)
+        self.tids = {}
+        self.events = []
+        self.current = None
+        self.since = None
+        self.isr_depth = 0
+        for tid, name in ((TID_ISR, 'interrupts'), (TID_TIMER, 'timers')):
+            self.meta(tid, name)
+
+    def meta(self, tid, name):
+        self.events.append({'ph': 'M', 'name': 'thread_name', 'pid': PID,
+                            'tid': tid, 'args': {'name': name}})
+
+    def tid(self, tp):
+        if tp not in self.tids:
+            self.tids[tp] = len(self.tids) + 1
+            self.meta(self.tids[tp], self.thread_name(tp))
+        return self.tids[tp]
+
+    def thread_name(self, tp):
+        return self.names.get(tp) or '%x' % tp
+
+    def name(self, addr):
+        sym = self.elf.symbol(addr) if self.elf else None
+        return sym or '%x' % addr
+
+    def us(self, time):
+        return time * 1e6 / self.freq
+
+    def add(self, ph, name, tid, time, **args):
+        e = {'ph': ph, 'name': name, 'pid': PID, 'tid': tid,
+             'ts': self.us(time)}
+        if ph == 'i':
+            e['s'] = 't'
+        if args:
+            e['args'] = args
+        self.events.append(e)
+
+    def here(self):
+        # instant events go where the code that made them ran
+        if self.isr_depth:
+            return TID_ISR
+        return self.tid(self.current) if self.current is not None else TID_ISR
+
+    def record(self, typ, time, state, obj, arg):
+        if typ == SWITCH:
+            if self.current is not None:
+                out = STATES[state] if state < len(STATES) else str(state)
+                e = {'ph': 'X', 'name': 'running', 'pid': PID,
+                     'tid': self.tid(self.current), 'ts': self.us(self.since),
+                     'dur': self.us(time - self.since),
+                     'args': {'left as': out}}
+                if arg:
+                    e['args']['waiting on'] = self.name(arg)
+                self.events.append(e)
+            self.current = obj
+            self.since = time
+            self.tid(obj)
+        elif typ in (ISR_ENTER, ISR_LEAVE):
+            if state >= 16:
+                name = 'IRQ %d' % (state - 16)
+            else:
+                name = EXCEPTIONS.get(state, 'ISR %d' % state)
+            if typ == ISR_ENTER:
+                self.isr_depth += 1
+                self.add('B', name, TID_ISR, time)
+            elif self.isr_depth:
+                self.isr_depth -= 1
+                self.add('E', name, TID_ISR, time)
+        elif typ == VT_ENTER:
+            self.add('B', self.name(obj), TID_TIMER, time,
+                     parameter='%x' % arg)
+        elif typ == VT_LEAVE:
+            self.add('E', self.name(obj), TID_TIMER, time)
+        elif typ == BROADCAST:
+            self.add('i', 'broadcast ' + self.name(obj), self.here(), time,
+                     flags='%x' % arg)
+        elif typ == MUTEX:
+            self.add('i', 'contended ' + self.name(obj), self.here(), time,
+                     owner=self.thread_name(arg))
+        elif typ == MARK:
+            name, ph = MARKS.get(state, ('mark %d' % state, 'i'))
+            self.add(ph, name, self.tid(obj), time, value=arg)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Converts a "trace" capture to Chrome trace JSON.')
+    parser.add_argument('capture', help='raw capture of the trace command')
+    parser.add_argument('-e', '--elf', help='ELF file the badge runs')
+    parser.add_argument('-o', '--output', help='JSON file, stdout if none')
+    args = parser.parse_args()
+
+    with open(args.capture, 'rb') as f:
+        freq, threads, data, lost = parse(f.read())
+    conv = Converter(freq, threads, Elf(args.elf) if args.elf else None)
+    count = 0
+    for rec in records(data):
+        conv.record(*rec)
+        count += 1
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    json.dump({'traceEvents': conv.events, 'displayTimeUnit': 'ns',
+               'otherData': {'records': count, 'lost': lost}}, out)
+    out.write('\n')
+    sys.stderr.write('%d records, %d lost\n' % (count, lost))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,58 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "trace.h"
+
+#if CH_DBG_ENABLE_TRACE
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+  *p++ = v;
+  *p++ = v >> 8;
+  *p++ = v >> 16;
+  *p++ = v >> 24;
+  return p;
+}
+
+void traceEncoderInit(trace_encoder *enc) {
+  enc->last = 0;
+}
+
+size_t traceEncode(trace_encoder *enc, const ch_trace_event_t *e, uint8_t *out) {
+  uint8_t *p = out;
+  uint32_t delta;
+
+  *p++ = e->te_type;
+
+  // records come out in order, so this only wraps with the timestamp
+  delta = e->te_time - enc->last;
+  enc->last = e->te_time;
+  while( delta >= 0x80 ) {
+    *p++ = (delta & 0x7F) | 0x80;
+    delta >>= 7;
+  }
+  *p++ = delta;
+
+  switch( e->te_type ) {
+  case CH_TRACE_TYPE_SWITCH:
+  case CH_TRACE_TYPE_MARK:
+    *p++ = e->te_state;
+    p = put32(p, (uint32_t)(uintptr_t)e->te_objp);
+    p = put32(p, (uint32_t)e->te_arg);
+    break;
+  case CH_TRACE_TYPE_ISR_ENTER:
+  case CH_TRACE_TYPE_ISR_LEAVE:
+    *p++ = e->te_state;
+    break;
+  case CH_TRACE_TYPE_VT_LEAVE:
+    p = put32(p, (uint32_t)(uintptr_t)e->te_objp);
+    break;
+  default:
+    p = put32(p, (uint32_t)(uintptr_t)e->te_objp);
+    p = put32(p, (uint32_t)e->te_arg);
+    break;
+  }
+
+  return p - out;
+}
+
+#endif /* CH_DBG_ENABLE_TRACE */
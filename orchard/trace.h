@@ -0,0 +1,53 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "ch.h"
+#include "hal.h"
+
+// Streaming of the kernel trace buffer (CH_DBG_ENABLE_TRACE, see chdebug.h)
+// over the shell, and the markers orchard code puts in it.
+//
+// The "trace" command drains the buffer while it runs, so it isn't limited
+// to the last CH_DBG_TRACE_BUFFER_SIZE records; trace-json.py turns the
+// capture into a Chrome/Perfetto trace. On the wire, after the text lines
+//
+//   TRACE START <timestamp frequency>
+//   TRACE THREAD <address> <name>          one per thread
+//
+// come packets of 0xA5, a length byte and that many bytes of records, up to
+// a packet of length 0, then "TRACE END lost <records>". A record is its
+// type byte, the time since the previous record as an unsigned LEB128, and
+// then, depending on the type, little endian:
+//
+//   switch         state byte, thread switched in, object waited on
+//   ISR enter/leave  exception number byte
+//   timer enter    callback, parameter
+//   timer leave    callback
+//   broadcast      event source, flags
+//   mutex          mutex, owner thread
+//   marker         id byte, thread, value
+//
+// Addresses and values are sent as 32 bits.
+
+// marker ids, see chDbgTraceMark()
+#define TRACE_MARK_FX_BEGIN     1   // effect index
+#define TRACE_MARK_FX_END       2
+#define TRACE_MARK_RADIO_RX     3   // prot << 8 | payload length
+#define TRACE_MARK_APP_BEGIN    4   // app event type
+#define TRACE_MARK_APP_END      5
+
+#define TRACE_SYNC              0xA5
+#define TRACE_RECORD_MAX        15  // longest encoded record
+
+#if CH_DBG_ENABLE_TRACE
+typedef struct trace_encoder {
+  uint32_t      last;       // time of the previous record
+} trace_encoder;
+
+void traceEncoderInit(trace_encoder *enc);
+
+// Writes e to out, at most TRACE_RECORD_MAX bytes. Returns the length.
+size_t traceEncode(trace_encoder *enc, const ch_trace_event_t *e, uint8_t *out);
+#endif
+
+#endif /* __TRACE_H__ */
@@ -15,6 +15,7 @@ static void list_redraw(OrchardAppContext *context) {
   const char **itemhandles;
   
   orchardGfxStart();
+  orchardGfxFrameDiff();
   font = gdispOpenFont("fixed_5x8");
   width = gdispGetWidth();
   
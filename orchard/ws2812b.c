@@ -0,0 +1,187 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "ws2812b.h"
+
+static ws2812b_stats stats;
+static binary_semaphore_t ws2812b_ready;  // taken while a frame is in flight
+static uint32_t max_pixels;
+
+#if WS2812B_USE_DMA
+#include "kinetis_tpm.h"
+
+/*
+  The WS2812B waveform is built from three compare events of TPM0 per bit,
+  each one triggering a byte-wide DMA write to the GPIO set/clear registers:
+
+    CH0 at the start of the bit  DMA_SET  writes the pin mask to PSOR
+    CH1 at T0H                   DMA_DATA writes the pin mask to PCOR for a "0",
+                                          and 0 (no effect) for a "1"
+    CH2 at T1H                   DMA_CLR  writes the pin mask to PCOR
+
+  Every bit of the frame takes one byte in the transmit buffer. The channels
+  stop on their own once their byte count runs out; the end of DMA_CLR stops
+  the timer and the latch time is waited out on a virtual timer.
+ */
+
+#define WS2812B_GPIO         GPIOE   // PTE17, same pin as ws2812b_ll.s
+#define WS2812B_PIN          17
+#define WS2812B_TPM          TPM0
+#define WS2812B_TPM_CLOCK    KINETIS_SYSCLK_FREQUENCY  // MCGPLLCLK/2, see hal_lld.c
+
+#define NS2TICKS(ns)  ((uint32_t) (((uint64_t) WS2812B_TPM_CLOCK * (ns)) / 1000000000ULL))
+#define WS2812B_BIT_TICKS    NS2TICKS(1250)
+#define WS2812B_T0H_TICKS    NS2TICKS(400)
+#define WS2812B_T1H_TICKS    NS2TICKS(800)
+#define WS2812B_LATCH_TIME   MS2ST(1)  // >50us of low resets the chain
+
+#define DMAMUX_TPM0_CH(n)    (24 + (n))
+#define DMA_8BIT             1
+
+#define PIN_MASK    ((uint8_t) (1 << (WS2812B_PIN % 8)))
+#define PSOR_BYTE   ((volatile uint8_t *) &WS2812B_GPIO->PSOR + (WS2812B_PIN / 8))
+#define PCOR_BYTE   ((volatile uint8_t *) &WS2812B_GPIO->PCOR + (WS2812B_PIN / 8))
+
+static const uint8_t pin_mask = PIN_MASK;
+static uint8_t *txbuf;
+static virtual_timer_t latch_vt;
+
+static void latch_done(void *arg) {
+  (void) arg;
+
+  chSysLockFromISR();
+  chBSemSignalI(&ws2812b_ready);
+  chSysUnlockFromISR();
+}
+
+CH_IRQ_HANDLER(Vector48) {   // DMA channel 2, WS2812B_DMA_CLR
+
+  CH_IRQ_PROLOGUE();
+  DMA->ch[WS2812B_DMA_CLR].DSR_BCR = DMA_DSR_BCRn_DONE;
+  WS2812B_TPM->SC = TPM_SC_CMOD_DISABLE;
+
+  chSysLockFromISR();
+  chVTSetI(&latch_vt, WS2812B_LATCH_TIME, latch_done, NULL);
+  chSysUnlockFromISR();
+  CH_IRQ_EPILOGUE();
+}
+
+static void dma_setup(uint32_t ch, const volatile void *src, volatile void *dst,
+                      uint32_t count, uint32_t flags) {
+  DMA->ch[ch].DSR_BCR = DMA_DSR_BCRn_DONE;
+  DMA->ch[ch].SAR = (uint32_t) src;
+  DMA->ch[ch].DAR = (uint32_t) dst;
+  DMA->ch[ch].DSR_BCR = DMA_DSR_BCRn_BCR(count);
+  DMA->ch[ch].DCR = DMA_DCRn_ERQ | DMA_DCRn_CS | DMA_DCRn_D_REQ |
+    DMA_DCRn_SSIZE(DMA_8BIT) | DMA_DCRn_DSIZE(DMA_8BIT) | flags;
+}
+
+// call with the system locked
+static void ws2812b_kick(uint32_t bits) {
+  uint32_t i;
+
+  dma_setup(WS2812B_DMA_SET, &pin_mask, PSOR_BYTE, bits, 0);
+  dma_setup(WS2812B_DMA_DATA, txbuf, PCOR_BYTE, bits, DMA_DCRn_SINC);
+  dma_setup(WS2812B_DMA_CLR, &pin_mask, PCOR_BYTE, bits, DMA_DCRn_EINT);
+
+  for( i = 0; i < 3; i++ )
+    WS2812B_TPM->C[i].SC |= TPM_CnSC_CHF;
+  WS2812B_TPM->CNT = 0;
+  WS2812B_TPM->SC = TPM_SC_CMOD_LPTPM_CLK;
+}
+
+void ws2812bStart(uint32_t max_leds) {
+  uint32_t i;
+
+  max_pixels = max_leds;
+  txbuf = chHeapAlloc(NULL, max_leds * 24);
+  osalDbgAssert(txbuf != NULL, "no memory for the LED transmit buffer\n\r");
+  chBSemObjectInit(&ws2812b_ready, FALSE);
+  chVTObjectInit(&latch_vt);
+
+  SIM->SCGC6 |= SIM_SCGC6_TPM0 | SIM_SCGC6_DMAMUX;
+  SIM->SCGC7 |= SIM_SCGC7_DMA;
+
+  WS2812B_TPM->SC = TPM_SC_CMOD_DISABLE;
+  WS2812B_TPM->MOD = WS2812B_BIT_TICKS - 1;
+  // software compares, the pin is driven by the DMA writes
+  WS2812B_TPM->C[0].V = 1;
+  WS2812B_TPM->C[1].V = 1 + WS2812B_T0H_TICKS;
+  WS2812B_TPM->C[2].V = 1 + WS2812B_T1H_TICKS;
+  for( i = 0; i < 3; i++ ) {
+    WS2812B_TPM->C[i].SC = TPM_CnSC_MSA | TPM_CnSC_DMA;
+    DMAMUX->CHCFG[i] = 0;
+  }
+  DMAMUX->CHCFG[WS2812B_DMA_SET] = DMAMUX_CHCFGn_ENBL | DMAMUX_CHCFGn_SOURCE(DMAMUX_TPM0_CH(0));
+  DMAMUX->CHCFG[WS2812B_DMA_DATA] = DMAMUX_CHCFGn_ENBL | DMAMUX_CHCFGn_SOURCE(DMAMUX_TPM0_CH(1));
+  DMAMUX->CHCFG[WS2812B_DMA_CLR] = DMAMUX_CHCFGn_ENBL | DMAMUX_CHCFGn_SOURCE(DMAMUX_TPM0_CH(2));
+
+  nvicEnableVector(DMA2_IRQn, WS2812B_DMA_IRQ_PRIORITY);
+}
+
+void ws2812bUpdate(uint8_t *fb, uint32_t len) {
+  uint8_t *out;
+  uint8_t pix;
+  uint32_t i;
+  uint8_t bit;
+
+  if( len > max_pixels )
+    len = max_pixels;
+  // nothing to send: a zero-length kick never completes and would leave
+  // ws2812b_ready taken for good
+  if( len == 0 )
+    return;
+
+  stats.frames++;
+  chSysLock();
+  if( chBSemGetStateI(&ws2812b_ready) )
+    stats.waits++;
+  chSysUnlock();
+  chBSemWait(&ws2812b_ready);
+
+  // the line is dropped at T0H for a "0" bit, and held until T1H for a "1"
+  out = txbuf;
+  for( i = 0; i < len * 3; i++ ) {
+    pix = fb[i];
+    for( bit = 0; bit < 8; bit++ ) {
+      *out++ = (pix & 0x80) ? 0 : PIN_MASK;
+      pix <<= 1;
+    }
+  }
+
+  chSysLock();
+  ws2812b_kick(len * 24);
+  chSysUnlock();
+}
+
+#else /* !WS2812B_USE_DMA */
+
+extern void ledUpdate(uint8_t *fb, uint32_t len);
+
+void ws2812bStart(uint32_t max_leds) {
+  max_pixels = max_leds;
+  chBSemObjectInit(&ws2812b_ready, FALSE);
+}
+
+void ws2812bUpdate(uint8_t *fb, uint32_t len) {
+  if( len > max_pixels )
+    len = max_pixels;
+
+  stats.frames++;
+  chBSemWait(&ws2812b_ready);
+  chSysLock();
+  ledUpdate(fb, len);
+  chSysUnlock();
+  chBSemSignal(&ws2812b_ready);
+}
+
+#endif /* !WS2812B_USE_DMA */
+
+void ws2812bWait(void) {
+  chBSemWait(&ws2812b_ready);
+  chBSemSignal(&ws2812b_ready);
+}
+
+const ws2812b_stats *ws2812bGetStats(void) {
+  return &stats;
+}
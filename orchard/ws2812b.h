@@ -0,0 +1,40 @@
+#ifndef __WS2812B_H__
+#define __WS2812B_H__
+
+#include "hal.h"
+
+// When set, frames are shifted out by TPM0 and three DMA channels while the CPU
+// carries on, and interrupts stay live. The only critical section left is the
+// few register writes that arm the transfer.
+//
+// When clear, the cycle-counted ws2812b_ll.s loop is used under chSysLock(),
+// which holds off every interrupt for 30us per pixel: 480us for the 16 LEDs on
+// the badge, enough to drop radio packets and captouch events.
+#ifndef WS2812B_USE_DMA
+#define WS2812B_USE_DMA   TRUE
+#endif
+
+#define WS2812B_DMA_SET   0   // DMA channel raising the line at the start of a bit
+#define WS2812B_DMA_DATA  1   // DMA channel dropping the line early for "0" bits
+#define WS2812B_DMA_CLR   2   // DMA channel dropping the line for "1" bits
+
+#define WS2812B_DMA_IRQ_PRIORITY  3
+
+typedef struct ws2812b_stats {
+  uint32_t  frames;     // frames handed to ws2812bUpdate()
+  uint32_t  waits;      // frames that had to wait for the previous one to finish
+} ws2812b_stats;
+
+// allocates the transmit buffer for up to max_leds pixels and sets up the hardware
+void ws2812bStart(uint32_t max_leds);
+
+// copies a GRB frame buffer of len pixels into the transmit buffer and starts
+// shifting it out; fb can be reused as soon as this returns
+void ws2812bUpdate(uint8_t *fb, uint32_t len);
+
+// blocks until the last frame is out and latched
+void ws2812bWait(void);
+
+const ws2812b_stats *ws2812bGetStats(void);
+
+#endif /* __WS2812B_H__ */
@@ -64,6 +64,11 @@ The part that I have has the following pins exposed:
   PTE30
 */
 
+/**
+ * @brief   SysTick reloads seen by @p boardSysTickNow(), in core clocks.
+ */
+uint32_t board_systick_base;
+
 #if HAL_USE_PAL || defined(__DOXYGEN__)
 /**
  * @brief   PAL setup.
@@ -42,6 +42,8 @@
 #endif
 
 #if !defined(_FROM_ASM_)
+#include "kl17z.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -49,11 +51,35 @@ extern "C" {
   extern uint32_t __storage_start__[];
   extern uint32_t __storage_size__[];
   extern uint32_t __storage_end__[];
+  extern uint32_t board_systick_base;
 
   void boardInit(void);
 #ifdef __cplusplus
 }
 #endif
+
+/*
+ * Core clocks since boot, from SysTick. The counter runs down from LOAD and
+ * sets COUNTFLAG when it reaches zero; this is the only reader of CTRL, so
+ * every reload is seen here exactly once, also from inside the SysTick ISR
+ * before the tick is counted. It must run at least once per system tick,
+ * CH_CFG_SYSTEM_TICK_HOOK does.
+ */
+static inline uint32_t boardSysTickNow(void) {
+  uint32_t primask = __get_PRIMASK();
+  uint32_t val;
+
+  __disable_irq();
+  val = SysTick->VAL;
+  if ((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0U) {
+    board_systick_base += SysTick->LOAD + 1U;
+    val = SysTick->VAL;
+  }
+  val = board_systick_base - val;
+  __set_PRIMASK(primask);
+
+  return val;
+}
 #endif /* _FROM_ASM_ */
 
 #endif /* _BOARD_H_ */
@@ -67,6 +67,36 @@ static char *long_to_string_with_divisor(char *p,
   return p;
 }
 
+#if CHPRINTF_BUFFER_SIZE > 0
+typedef struct {
+  BaseSequentialStream  *chp;
+  size_t                n;
+  uint8_t               buf[CHPRINTF_BUFFER_SIZE];
+} outbuf_t;
+
+static void out_flush(outbuf_t *ob) {
+
+  if (ob->n > 0) {
+    chSequentialStreamWrite(ob->chp, ob->buf, ob->n);
+    ob->n = 0;
+  }
+}
+
+static void out_put(outbuf_t *ob, char c) {
+
+  ob->buf[ob->n++] = (uint8_t)c;
+  if (ob->n == CHPRINTF_BUFFER_SIZE)
+    out_flush(ob);
+}
+#else
+typedef struct {
+  BaseSequentialStream  *chp;
+} outbuf_t;
+
+#define out_flush(ob)
+#define out_put(ob, c) chSequentialStreamPut((ob)->chp, (uint8_t)(c))
+#endif
+
 static char *ch_ltoa(char *p, long num, unsigned radix) {
 
   return long_to_string_with_divisor(p, num, radix, 0);
@@ -109,6 +139,8 @@ static char *ftoa(char *p, double num, unsigned long precision) {
  *          - <b>c</b> character.
  *          - <b>s</b> string.
  *          .
+ * @note    The output is written to @p chp in blocks of up to
+ *          @p CHPRINTF_BUFFER_SIZE characters.
  *
  * @param[in] chp       pointer to a @p BaseSequentialStream implementing object
  * @param[in] fmt       formatting string
@@ -130,13 +162,21 @@ int chvprintf(BaseSequentialStream *chp, const char *fmt, va_list ap) {
 #else
   char tmpbuf[MAX_FILLER + 1];
 #endif
+  outbuf_t ob;
+
+  ob.chp = chp;
+#if CHPRINTF_BUFFER_SIZE > 0
+  ob.n = 0;
+#endif
 
   while (TRUE) {
     c = *fmt++;
-    if (c == 0)
+    if (c == 0) {
+      out_flush(&ob);
       return n;
+    }
     if (c != '%') {
-      chSequentialStreamPut(chp, (uint8_t)c);
+      out_put(&ob, c);
       n++;
       continue;
     }
@@ -254,22 +294,22 @@ unsigned_common:
       width = -width;
     if (width < 0) {
       if (*s == '-' && filler == '0') {
-        chSequentialStreamPut(chp, (uint8_t)*s++);
+        out_put(&ob, *s++);
         n++;
         i--;
       }
       do {
-        chSequentialStreamPut(chp, (uint8_t)filler);
+        out_put(&ob, filler);
         n++;
       } while (++width != 0);
     }
     while (--i >= 0) {
-      chSequentialStreamPut(chp, (uint8_t)*s++);
+      out_put(&ob, *s++);
       n++;
     }
 
     while (width) {
-      chSequentialStreamPut(chp, (uint8_t)filler);
+      out_put(&ob, filler);
       n++;
       width--;
     }
@@ -34,6 +34,16 @@
 #define CHPRINTF_USE_FLOAT          FALSE
 #endif
 
+/**
+ * @brief   Output buffer size.
+ * @details The formatted output is collected in a buffer of this size on
+ *          the stack and handed to the stream one buffer at a time, instead
+ *          of one character at a time. Zero disables the buffer.
+ */
+#if !defined(CHPRINTF_BUFFER_SIZE) || defined(__DOXYGEN__)
+#define CHPRINTF_BUFFER_SIZE        32
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -53,6 +53,12 @@
 #define KINETIS_UART1_IRQ_VECTOR    Vector74
 #define KINETIS_UART2_IRQ_VECTOR    Vector78
 
+/* DMA attributes.*/
+#define KINETIS_DMA0_IRQ_VECTOR     Vector40
+#define KINETIS_DMA1_IRQ_VECTOR     Vector44
+#define KINETIS_DMA2_IRQ_VECTOR     Vector48
+#define KINETIS_DMA3_IRQ_VECTOR     Vector4C
+
 /* SPI attributes.*/
 #define KINETIS_SPI0_IRQ_VECTOR     Vector68
 #define KINETIS_SPI1_IRQ_VECTOR     Vector6C
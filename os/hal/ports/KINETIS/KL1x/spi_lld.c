@@ -38,28 +38,13 @@
 #define KINETIS_SPI_USE_SPI1                TRUE
 #endif
 
-#if !defined(KINETIS_SPI0_RX_DMA_IRQ_PRIORITY)
-#define KINETIS_SPI0_RX_DMA_IRQ_PRIORITY    8
-#endif
+#define DMAMUX_SPI0_TX_SOURCE   17
+#define DMAMUX_SPI1_TX_SOURCE   19
 
-#if !defined(KINETIS_SPI0_RX_DMAMUX_CHANNEL)
-#define KINETIS_SPI0_RX_DMAMUX_CHANNEL      0
-#endif
+#define DMA_8BIT                1
 
-#if !defined(KINETIS_SPI0_RX_DMA_CHANNEL)
-#define KINETIS_SPI0_RX_DMA_CHANNEL         0
-#endif
-
-#if !defined(KINETIS_SPI0_TX_DMAMUX_CHANNEL)
-#define KINETIS_SPI0_TX_DMAMUX_CHANNEL      1
-#endif
-
-#if !defined(KINETIS_SPI0_TX_DMA_CHANNEL)
-#define KINETIS_SPI0_TX_DMA_CHANNEL         1
-#endif
-
-#define DMAMUX_SPI_RX_SOURCE    16
-#define DMAMUX_SPI_TX_SOURCE    17
+#define SPI_DMA_IRQ_VECTOR(ch)  SPI_DMA_IRQ_VECTOR_(ch)
+#define SPI_DMA_IRQ_VECTOR_(ch) KINETIS_DMA##ch##_IRQ_VECTOR
 
 /*===========================================================================*/
 /* Driver exported variables.                                                */
@@ -115,6 +100,63 @@ static void spi_stop_xfer(SPIDriver *spip)
   spip->state = SPI_READY;
 }
 
+#if KINETIS_SPI_DMA
+/*
+ * The channel writes the transmit buffer into DL every time the SPI asks
+ * for a word, with no interrupt until all but the last one are written.
+ * Nothing reads DL along the way: the received words are of no interest to
+ * a send, and they just overrun in the receive buffer.
+ */
+static void spi_start_dma(SPIDriver *spip)
+{
+  uint8_t ch = spip->dma;
+
+  osalDbgAssert(spip->state == SPI_ACTIVE, "Invalid SPI state");
+
+  /* Reset the SPI Match Flag if it's set.  We don't use this feature. */
+  if (spip->spi->S & SPIx_S_SPMF)
+    spip->spi->S |= SPIx_S_SPMF;
+
+  DMA->ch[ch].DSR_BCR = DMA_DSR_BCRn_DONE;
+  DMA->ch[ch].SAR = (uint32_t)spip->txbuf;
+  DMA->ch[ch].DAR = (uint32_t)&spip->spi->DL;
+  DMA->ch[ch].DSR_BCR = DMA_DSR_BCRn_BCR(spip->count - 1);
+  DMA->ch[ch].DCR = DMA_DCRn_EINT | DMA_DCRn_ERQ | DMA_DCRn_CS |
+                    DMA_DCRn_D_REQ | DMA_DCRn_SINC |
+                    DMA_DCRn_SSIZE(DMA_8BIT) | DMA_DCRn_DSIZE(DMA_8BIT);
+
+  spip->spi->C2 |= SPIx_C2_TXDMAE;
+}
+
+/*
+ * The SPI has no busy flag, and SPRF overran long ago, so the end of the
+ * send is told by the last word. It is written by hand: once it reaches the
+ * shifter the word before it is complete, and SPRF, cleared then, next sets
+ * at the end of the last frame, where the SPI interrupt ends the send. At
+ * most two frames are waited for here.
+ */
+static void spi_dma_tail(SPIDriver *spip)
+{
+
+  while (!(spip->spi->S & SPIx_S_SPTEF))
+    ;
+  spip->spi->DL = spip->txbuf[spip->count - 1];
+
+  /* SPRF must be cleared before the last frame ends, nothing may come
+     in between.*/
+  osalSysLockFromISR();
+  while (!(spip->spi->S & SPIx_S_SPTEF))
+    ;
+  if (spip->spi->S & SPIx_S_SPRF)
+    (void)spip->spi->DL;
+  osalSysUnlockFromISR();
+
+  spip->txoffset = spip->count;
+  spip->rxoffset = spip->count - 1;
+  spip->spi->C1 |= SPIx_C1_SPIE;
+}
+#endif /* KINETIS_SPI_DMA */
+
 /*===========================================================================*/
 /* Driver interrupt handlers.                                                */
 /*===========================================================================*/
@@ -141,6 +183,39 @@ static void spi_handle_isr(SPIDriver *spip)
   }
 }
 
+#if KINETIS_SPI_DMA
+static void spi_handle_dma_isr(SPIDriver *spip)
+{
+
+  osalDbgAssert(spip->state == SPI_ACTIVE, "Invalid SPI state");
+
+  DMA->ch[spip->dma].DSR_BCR = DMA_DSR_BCRn_DONE;
+  spip->spi->C2 &= ~SPIx_C2_TXDMAE;
+
+  spi_dma_tail(spip);
+}
+#endif
+
+#if KINETIS_SPI0_DMA
+OSAL_IRQ_HANDLER(SPI_DMA_IRQ_VECTOR(KINETIS_SPI_SPI0_DMA_CHANNEL)) {
+  OSAL_IRQ_PROLOGUE();
+
+  spi_handle_dma_isr(&SPID1);
+
+  OSAL_IRQ_EPILOGUE();
+}
+#endif
+
+#if KINETIS_SPI1_DMA
+OSAL_IRQ_HANDLER(SPI_DMA_IRQ_VECTOR(KINETIS_SPI_SPI1_DMA_CHANNEL)) {
+  OSAL_IRQ_PROLOGUE();
+
+  spi_handle_dma_isr(&SPID2);
+
+  OSAL_IRQ_EPILOGUE();
+}
+#endif
+
 #if KINETIS_SPI_USE_SPI0
 OSAL_IRQ_HANDLER(KINETIS_SPI0_IRQ_VECTOR) {
   OSAL_IRQ_PROLOGUE();
@@ -173,9 +248,19 @@ OSAL_IRQ_HANDLER(KINETIS_SPI1_IRQ_VECTOR) {
 void spi_lld_init(void) {
 #if KINETIS_SPI_USE_SPI0
   spiObjectInit(&SPID1);
+#if KINETIS_SPI0_DMA
+  SPID1.dma = KINETIS_SPI_SPI0_DMA_CHANNEL;
+#else
+  SPID1.dma = KINETIS_SPI_NO_DMA;
+#endif
 #endif
 #if KINETIS_SPI_USE_SPI1
   spiObjectInit(&SPID2);
+#if KINETIS_SPI1_DMA
+  SPID2.dma = KINETIS_SPI_SPI1_DMA_CHANNEL;
+#else
+  SPID2.dma = KINETIS_SPI_NO_DMA;
+#endif
 #endif
 }
 
@@ -214,6 +299,23 @@ void spi_lld_start(SPIDriver *spip) {
       nvicEnableVector(SPI1_IRQn, KINETIS_SPI_SPI1_IRQ_PRIORITY);
     }
 #endif
+
+#if KINETIS_SPI_DMA
+    if (spip->dma != KINETIS_SPI_NO_DMA) {
+
+      /* The DMA clocks stay on once enabled, other drivers use channels.*/
+      SIM->SCGC6 |= SIM_SCGC6_DMAMUX;
+      SIM->SCGC7 |= SIM_SCGC7_DMA;
+
+      DMAMUX->CHCFG[spip->dma] = 0;
+      DMAMUX->CHCFG[spip->dma] = DMAMUX_CHCFGn_ENBL |
+        DMAMUX_CHCFGn_SOURCE(spip->spi == SPI0 ? DMAMUX_SPI0_TX_SOURCE
+                                               : DMAMUX_SPI1_TX_SOURCE);
+      nvicEnableVector(DMA0_IRQn + spip->dma,
+                       spip->spi == SPI0 ? KINETIS_SPI_SPI0_IRQ_PRIORITY
+                                         : KINETIS_SPI_SPI1_IRQ_PRIORITY);
+    }
+#endif
   }
 
   /* Initialize the SPI peripheral default values.*/
@@ -259,6 +361,13 @@ void spi_lld_stop(SPIDriver *spip) {
       SIM->SCGC4 &= ~SIM_SCGC4_SPI1;
     }
 #endif
+
+#if KINETIS_SPI_DMA
+    if (spip->dma != KINETIS_SPI_NO_DMA) {
+      nvicDisableVector(DMA0_IRQn + spip->dma);
+      DMAMUX->CHCFG[spip->dma] = 0;
+    }
+#endif
   }
 }
 
@@ -334,7 +443,9 @@ void spi_lld_exchange(SPIDriver *spip, size_t n,
 
 /**
  * @brief   Sends data over the SPI bus.
- * @details This asynchronous function starts a transmit operation.
+ * @details This asynchronous function starts a transmit operation. Sends of
+ *          @p KINETIS_SPI_DMA_THRESHOLD words or more are moved by DMA on
+ *          a driver that has a channel.
  * @post    At the end of the operation the configured callback is invoked.
  * @note    The buffers are organized as uint8_t arrays for data sizes below or
  *          equal to 8 bits else it is organized as uint16_t arrays.
@@ -351,6 +462,13 @@ void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf) {
   spip->rxbuf = NULL;
   spip->txbuf = (void *)txbuf;
 
+#if KINETIS_SPI_DMA
+  if ((spip->dma != KINETIS_SPI_NO_DMA) && (n >= KINETIS_SPI_DMA_THRESHOLD)) {
+    spi_start_dma(spip);
+    return;
+  }
+#endif
+
   spi_start_xfer(spip);
 }
 
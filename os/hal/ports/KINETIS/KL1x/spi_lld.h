@@ -70,6 +70,51 @@
 #define KINETIS_SPI_SPI1_IRQ_PRIORITY         2
 #endif
 
+/**
+ * @brief   SPI0 transmit DMA enable switch.
+ * @details If set to @p TRUE, sends of @p KINETIS_SPI_DMA_THRESHOLD words
+ *          or more on SPI0 are moved by a DMA channel instead of the
+ *          interrupt handler.
+ * @note    The default is @p FALSE.
+ */
+#if !defined(KINETIS_SPI_USE_SPI0_DMA) || defined(__DOXYGEN__)
+#define KINETIS_SPI_USE_SPI0_DMA              FALSE
+#endif
+
+/**
+ * @brief   SPI1 transmit DMA enable switch.
+ * @details If set to @p TRUE, sends of @p KINETIS_SPI_DMA_THRESHOLD words
+ *          or more on SPI1 are moved by a DMA channel instead of the
+ *          interrupt handler.
+ * @note    The default is @p FALSE.
+ */
+#if !defined(KINETIS_SPI_USE_SPI1_DMA) || defined(__DOXYGEN__)
+#define KINETIS_SPI_USE_SPI1_DMA              FALSE
+#endif
+
+/**
+ * @brief   DMA channel used by SPI0.
+ */
+#if !defined(KINETIS_SPI_SPI0_DMA_CHANNEL) || defined(__DOXYGEN__)
+#define KINETIS_SPI_SPI0_DMA_CHANNEL          3
+#endif
+
+/**
+ * @brief   DMA channel used by SPI1.
+ */
+#if !defined(KINETIS_SPI_SPI1_DMA_CHANNEL) || defined(__DOXYGEN__)
+#define KINETIS_SPI_SPI1_DMA_CHANNEL          3
+#endif
+
+/**
+ * @brief   Shortest send moved by DMA.
+ * @details Setting up the channel costs about as much as a few words
+ *          moved by the interrupt handler.
+ */
+#if !defined(KINETIS_SPI_DMA_THRESHOLD) || defined(__DOXYGEN__)
+#define KINETIS_SPI_DMA_THRESHOLD             8
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -89,6 +134,32 @@
 #error "SPI driver activated but no SPI peripheral assigned"
 #endif
 
+#define KINETIS_SPI0_DMA    (KINETIS_SPI_USE_SPI0 && KINETIS_SPI_USE_SPI0_DMA)
+#define KINETIS_SPI1_DMA    (KINETIS_SPI_USE_SPI1 && KINETIS_SPI_USE_SPI1_DMA)
+#define KINETIS_SPI_DMA     (KINETIS_SPI0_DMA || KINETIS_SPI1_DMA)
+
+#if KINETIS_SPI0_DMA && (KINETIS_SPI_SPI0_DMA_CHANNEL > 3)
+#error "invalid DMA channel assigned to SPI0"
+#endif
+
+#if KINETIS_SPI1_DMA && (KINETIS_SPI_SPI1_DMA_CHANNEL > 3)
+#error "invalid DMA channel assigned to SPI1"
+#endif
+
+#if KINETIS_SPI_DMA && (KINETIS_SPI_DMA_THRESHOLD < 2)
+#error "KINETIS_SPI_DMA_THRESHOLD must be 2 or more, the last word is not moved by DMA"
+#endif
+
+#if KINETIS_SPI0_DMA && KINETIS_SPI1_DMA &&                                 \
+    (KINETIS_SPI_SPI0_DMA_CHANNEL == KINETIS_SPI_SPI1_DMA_CHANNEL)
+#error "SPI0 and SPI1 are assigned the same DMA channel"
+#endif
+
+/**
+ * @brief   Value of the @p dma field of a driver sending without DMA.
+ */
+#define KINETIS_SPI_NO_DMA  0xFF
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -181,6 +252,10 @@ struct SPIDriver {
    * @brief   Offset for current rx operation.
    */
   uint32_t                  rxoffset;
+  /**
+   * @brief   DMA channel moving long sends, or @p KINETIS_SPI_NO_DMA.
+   */
+  uint8_t                   dma;
 };
 
 /*===========================================================================*/
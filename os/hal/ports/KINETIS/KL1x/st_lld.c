@@ -30,10 +30,24 @@
 /* Driver local definitions.                                                 */
 /*===========================================================================*/
 
+#if (OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING) && HAL_USE_PWM
+#if ((KINETIS_ST_USE_TIMER == 1) && KINETIS_PWM_USE_TPM1) ||                \
+    ((KINETIS_ST_USE_TIMER == 2) && KINETIS_PWM_USE_TPM2)
+#error "the TPM of KINETIS_ST_USE_TIMER is already used by the PWM driver"
+#endif
+#endif
+
 /*===========================================================================*/
 /* Driver exported variables.                                                */
 /*===========================================================================*/
 
+#if (OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING) || defined(__DOXYGEN__)
+/**
+ * @brief   Alarm time, the TPM only compares its low 16 bits.
+ */
+systime_t st_lld_alarm;
+#endif
+
 /*===========================================================================*/
 /* Driver local types.                                                       */
 /*===========================================================================*/
@@ -42,6 +56,14 @@
 /* Driver local variables and types.                                         */
 /*===========================================================================*/
 
+#if ((OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING) &&                          \
+     (OSAL_ST_RESOLUTION == 32)) || defined(__DOXYGEN__)
+/**
+ * @brief   Upper half of the counter, counts the TPM overflows.
+ */
+static volatile uint32_t st_high;
+#endif
+
 /*===========================================================================*/
 /* Driver local functions.                                                   */
 /*===========================================================================*/
@@ -69,6 +91,43 @@ OSAL_IRQ_HANDLER(SysTick_Handler) {
 }
 #endif /* OSAL_ST_MODE == OSAL_ST_MODE_PERIODIC */
 
+#if (OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING) || defined(__DOXYGEN__)
+/**
+ * @brief   System Timer vector.
+ * @details This interrupt is used for the alarm in free running mode, and
+ *          for the counter overflows when it is extended to 32 bits.
+ *
+ * @isr
+ */
+OSAL_IRQ_HANDLER(KINETIS_ST_HANDLER) {
+  uint32_t sc;
+
+  OSAL_IRQ_PROLOGUE();
+
+#if OSAL_ST_RESOLUTION == 32
+  if ((KINETIS_ST_TPM->SC & TPM_SC_TOF) != 0U) {
+    KINETIS_ST_TPM->SC |= TPM_SC_TOF;
+    st_high += 0x10000U;
+  }
+#endif
+
+  /* The compare matched, or the alarm was set in the past and the
+     interrupt pended by hand.*/
+  sc = KINETIS_ST_TPM->C[0].SC;
+  if ((sc & TPM_CnSC_CHIE) != 0U) {
+    KINETIS_ST_TPM->C[0].SC = sc;
+    if (((sc & TPM_CnSC_CHF) != 0U) ||
+        ((systime_t)(st_lld_get_counter() - st_lld_alarm) < (systime_t)0x8000U)) {
+      osalSysLockFromISR();
+      osalOsTimerHandlerI();
+      osalSysUnlockFromISR();
+    }
+  }
+
+  OSAL_IRQ_EPILOGUE();
+}
+#endif /* OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING */
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -91,7 +150,58 @@ void st_lld_init(void) {
   /* IRQ enabled.*/
   nvicSetSystemHandlerPriority(HANDLER_SYSTICK, KINETIS_ST_IRQ_PRIORITY);
 #endif /* OSAL_ST_MODE == OSAL_ST_MODE_PERIODIC */
+
+#if OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING
+  /* Free running mode, a TPM counts up at OSAL_ST_FREQUENCY and its
+     channel 0 is a software compare for the alarm.*/
+  SIM->SCGC6 |= KINETIS_ST_SCGC;
+  KINETIS_ST_TPM->SC = TPM_SC_CMOD_DISABLE;
+  KINETIS_ST_TPM->CNT = 0;
+  KINETIS_ST_TPM->MOD = TPM_MOD_MASK;
+  KINETIS_ST_TPM->C[0].SC = TPM_CnSC_MSA | TPM_CnSC_CHF;
+  KINETIS_ST_TPM->C[0].V = 0;
+  KINETIS_ST_TPM->CONF = TPM_CONF_DBGMODE_PAUSE;
+#if OSAL_ST_RESOLUTION == 32
+  KINETIS_ST_TPM->SC = TPM_SC_CMOD_LPTPM_CLK | TPM_SC_TOF | TPM_SC_TOIE |
+                       KINETIS_ST_PS;
+#else
+  KINETIS_ST_TPM->SC = TPM_SC_CMOD_LPTPM_CLK | TPM_SC_TOF | KINETIS_ST_PS;
+#endif
+
+  /* IRQ enabled.*/
+  nvicEnableVector(KINETIS_ST_NUMBER, KINETIS_ST_IRQ_PRIORITY);
+#endif /* OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING */
+}
+
+#if ((OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING) &&                          \
+     (OSAL_ST_RESOLUTION == 32)) || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the time counter extended to 32 bits.
+ * @details An overflow the interrupt did not count yet is added here, the
+ *          counter is read again after it.
+ *
+ * @return              The counter value.
+ *
+ * @notapi
+ */
+systime_t st_lld_get_counter32(void) {
+  uint32_t high, cnt, tof;
+
+  do {
+    high = st_high;
+    cnt = KINETIS_ST_TPM->CNT;
+    tof = KINETIS_ST_TPM->SC & TPM_SC_TOF;
+    if (tof != 0U) {
+      cnt = KINETIS_ST_TPM->CNT;
+    }
+  } while (high != st_high);
+  if (tof != 0U) {
+    high += 0x10000U;
+  }
+
+  return (systime_t)(high | cnt);
 }
+#endif
 
 #endif /* OSAL_ST_MODE != OSAL_ST_MODE_NONE */
 
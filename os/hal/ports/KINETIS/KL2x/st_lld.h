@@ -28,6 +28,7 @@
 #define _ST_LLD_H_
 
 #include "mcuconf.h"
+#include "kinetis_tpm.h"
 
 /*===========================================================================*/
 /* Driver constants.                                                         */
@@ -48,12 +49,68 @@
 #define KINETIS_ST_IRQ_PRIORITY               8
 #endif
 
+/**
+ * @brief   TPM used as free running counter in tick-less mode.
+ * @note    Timers 1 and 2 are supported, timer 0 has the DMA requests the
+ *          other drivers want.
+ */
+#if !defined(KINETIS_ST_USE_TIMER) || defined(__DOXYGEN__)
+#define KINETIS_ST_USE_TIMER                  1
+#endif
+
+/**
+ * @brief   Input clock of the TPMs.
+ * @note    Selected by @p SIM_SOPT2_TPMSRC in @p hal_lld.c.
+ */
+#if !defined(KINETIS_ST_TPM_CLOCK) || defined(__DOXYGEN__)
+#define KINETIS_ST_TPM_CLOCK                  KINETIS_SYSCLK_FREQUENCY
+#endif
+
 /** @} */
 
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if (OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING) || defined(__DOXYGEN__)
+#if (KINETIS_ST_USE_TIMER == 1) || defined(__DOXYGEN__)
+#define KINETIS_ST_TPM                        TPM1
+#define KINETIS_ST_HANDLER                    Vector88
+#define KINETIS_ST_NUMBER                     TPM1_IRQn
+#define KINETIS_ST_SCGC                       SIM_SCGC6_TPM1
+#elif KINETIS_ST_USE_TIMER == 2
+#define KINETIS_ST_TPM                        TPM2
+#define KINETIS_ST_HANDLER                    Vector8C
+#define KINETIS_ST_NUMBER                     TPM2_IRQn
+#define KINETIS_ST_SCGC                       SIM_SCGC6_TPM2
+#else
+#error "KINETIS_ST_USE_TIMER specifies an unsupported timer"
+#endif
+
+/**
+ * @brief   TPM prescaler field, the counter runs at @p OSAL_ST_FREQUENCY.
+ */
+#if (KINETIS_ST_TPM_CLOCK == OSAL_ST_FREQUENCY) || defined(__DOXYGEN__)
+#define KINETIS_ST_PS                         0
+#elif KINETIS_ST_TPM_CLOCK == (OSAL_ST_FREQUENCY * 2)
+#define KINETIS_ST_PS                         1
+#elif KINETIS_ST_TPM_CLOCK == (OSAL_ST_FREQUENCY * 4)
+#define KINETIS_ST_PS                         2
+#elif KINETIS_ST_TPM_CLOCK == (OSAL_ST_FREQUENCY * 8)
+#define KINETIS_ST_PS                         3
+#elif KINETIS_ST_TPM_CLOCK == (OSAL_ST_FREQUENCY * 16)
+#define KINETIS_ST_PS                         4
+#elif KINETIS_ST_TPM_CLOCK == (OSAL_ST_FREQUENCY * 32)
+#define KINETIS_ST_PS                         5
+#elif KINETIS_ST_TPM_CLOCK == (OSAL_ST_FREQUENCY * 64)
+#define KINETIS_ST_PS                         6
+#elif KINETIS_ST_TPM_CLOCK == (OSAL_ST_FREQUENCY * 128)
+#define KINETIS_ST_PS                         7
+#else
+#error "OSAL_ST_FREQUENCY must be KINETIS_ST_TPM_CLOCK divided by 1, 2, 4, ... 128"
+#endif
+#endif /* OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING */
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -70,14 +127,113 @@
 extern "C" {
 #endif
   void st_lld_init(void);
+#if OSAL_ST_RESOLUTION == 32
+  systime_t st_lld_get_counter32(void);
+#endif
 #ifdef __cplusplus
 }
 #endif
 
+#if OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING
+extern systime_t st_lld_alarm;
+#endif
+
 /*===========================================================================*/
 /* Driver inline functions.                                                  */
 /*===========================================================================*/
 
+#if (OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING) || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the time counter value.
+ * @note    The TPM counts 16 bits, a 32 bits counter is extended in
+ *          software by the overflow interrupt.
+ *
+ * @return              The counter value.
+ *
+ * @notapi
+ */
+static inline systime_t st_lld_get_counter(void) {
+
+#if OSAL_ST_RESOLUTION == 32
+  return st_lld_get_counter32();
+#else
+  return (systime_t)KINETIS_ST_TPM->CNT;
+#endif
+}
+
+/**
+ * @brief   Sets the alarm time.
+ * @note    The compare only sees the low 16 bits, an alarm further away
+ *          fires early and the kernel sets it again. An alarm the counter
+ *          passed before the compare was written fires right away.
+ *
+ * @param[in] time      the time to be set for the next alarm
+ *
+ * @notapi
+ */
+static inline void st_lld_set_alarm(systime_t time) {
+
+  st_lld_alarm = time;
+  KINETIS_ST_TPM->C[0].V = (uint32_t)time & TPM_CnV_VAL_MASK;
+  if ((systime_t)(st_lld_get_counter() - time) < (systime_t)0x8000U) {
+    NVIC->ISPR[0] = 1U << KINETIS_ST_NUMBER;
+  }
+}
+
+/**
+ * @brief   Starts the alarm.
+ * @note    Makes sure that no spurious alarms are triggered after
+ *          this call.
+ *
+ * @param[in] time      the time to be set for the first alarm
+ *
+ * @notapi
+ */
+static inline void st_lld_start_alarm(systime_t time) {
+
+  KINETIS_ST_TPM->C[0].SC = TPM_CnSC_MSA | TPM_CnSC_CHF;
+  KINETIS_ST_TPM->C[0].SC = TPM_CnSC_MSA | TPM_CnSC_CHIE;
+  st_lld_set_alarm(time);
+}
+
+/**
+ * @brief   Stops the alarm interrupt.
+ *
+ * @notapi
+ */
+static inline void st_lld_stop_alarm(void) {
+
+  KINETIS_ST_TPM->C[0].SC = TPM_CnSC_MSA | TPM_CnSC_CHF;
+}
+
+/**
+ * @brief   Returns the current alarm time.
+ *
+ * @return              The currently set alarm time.
+ *
+ * @notapi
+ */
+static inline systime_t st_lld_get_alarm(void) {
+
+  return st_lld_alarm;
+}
+
+/**
+ * @brief   Determines if the alarm is active.
+ *
+ * @return              The alarm status.
+ * @retval false        if the alarm is not active.
+ * @retval true         is the alarm is active
+ *
+ * @notapi
+ */
+static inline bool st_lld_is_alarm_active(void) {
+
+  return (bool)((KINETIS_ST_TPM->C[0].SC & TPM_CnSC_CHIE) != 0U);
+}
+
+#else /* OSAL_ST_MODE != OSAL_ST_MODE_FREERUNNING */
+
 /**
  * @brief   Returns the time counter value.
  *
@@ -150,6 +306,7 @@ static inline bool st_lld_is_alarm_active(void) {
 
   return false;
 }
+#endif /* OSAL_ST_MODE != OSAL_ST_MODE_FREERUNNING */
 
 #endif /* _ST_LLD_H_ */
 
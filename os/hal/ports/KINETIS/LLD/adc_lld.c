@@ -245,6 +245,10 @@ void adc_lld_start_conversion(ADCDriver *adcp) {
 void adc_lld_stop_conversion(ADCDriver *adcp) {
   const ADCConversionGroup *grpp = adcp->grpp;
 
+  /* Disable Interrupt, Disable Channel. This also aborts a conversion in
+     progress, a circular conversion is otherwise never stopped.*/
+  adcp->adc->SC1A = ADCx_SC1n_ADCH(ADCx_SC1n_ADCH_DISABLED);
+
   /* Disable the Bandgap buffer if channel mask includes BANDGAP */
   if (grpp->channel_mask & ADC_BANDGAP) {
     /* Clear BGBE, ACKISO is w1c, avoid setting */
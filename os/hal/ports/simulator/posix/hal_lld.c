@@ -0,0 +1,117 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    hal_lld.c
+ * @brief   Posix simulator HAL subsystem low level driver code.
+ *
+ * @addtogroup POSIX_HAL
+ * @{
+ */
+
+#include <time.h>
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static uint64_t nextcnt;
+static uint64_t slice;
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Reads the host monotonic clock.
+ *
+ * @return              The clock value in nanoseconds.
+ */
+static uint64_t host_clock_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief Low level HAL driver initialization.
+ */
+void hal_lld_init(void) {
+
+  printf("ChibiOS/RT simulator (Posix)\n");
+  slice = 1000000000ULL / CH_CFG_ST_FREQUENCY;
+  nextcnt = host_clock_ns() + slice;
+
+  fflush(stdout);
+}
+
+/**
+ * @brief   Interrupts simulation.
+ * @details The system tick is derived from the host monotonic clock, one
+ *          tick is raised each time a @p CH_CFG_ST_FREQUENCY slice elapses.
+ *          In tick-less mode the system timer interrupt is raised when the
+ *          ST alarm is due instead.
+ */
+void _sim_check_for_interrupts(void) {
+
+#if HAL_USE_SERIAL
+  if (sd_lld_interrupt_pending()) {
+    _dbg_check_lock();
+    if (chSchIsPreemptionRequired())
+      chSchDoReschedule();
+    _dbg_check_unlock();
+    return;
+  }
+#endif
+
+  /* Interrupt Timer simulation.*/
+#if OSAL_ST_MODE == OSAL_ST_MODE_FREERUNNING
+  if (st_lld_is_alarm_due()) {
+#else
+  if (host_clock_ns() > nextcnt) {
+    nextcnt += slice;
+#endif
+
+    CH_IRQ_PROLOGUE();
+
+    chSysLockFromISR();
+    chSysTimerHandlerI();
+    chSysUnlockFromISR();
+
+    CH_IRQ_EPILOGUE();
+
+    _dbg_check_lock();
+    if (chSchIsPreemptionRequired())
+      chSchDoReschedule();
+    _dbg_check_unlock();
+  }
+}
+
+/** @} */
@@ -0,0 +1,272 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    serial_lld.c
+ * @brief   Posix simulator low level serial driver code.
+ * @details Each serial port is exposed as a pseudo-terminal, the slave
+ *          device name is printed on startup and can be opened with any
+ *          terminal program (screen, picocom, minicom).
+ *
+ * @addtogroup POSIX_SERIAL
+ * @{
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "hal.h"
+
+#if HAL_USE_SERIAL || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief Serial driver 1 identifier.*/
+#if USE_POSIX_SERIAL1 || defined(__DOXYGEN__)
+SerialDriver SD1;
+#endif
+/** @brief Serial driver 2 identifier.*/
+#if USE_POSIX_SERIAL2 || defined(__DOXYGEN__)
+SerialDriver SD2;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/** @brief Driver default configuration.*/
+static const SerialConfig default_config = {
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void init(SerialDriver *sdp) {
+  struct termios tio;
+  int slave;
+
+  sdp->com_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (sdp->com_fd < 0) {
+    printf("%s: Error opening pseudo-terminal\n", sdp->com_name);
+    goto abort;
+  }
+
+  if ((grantpt(sdp->com_fd) != 0) || (unlockpt(sdp->com_fd) != 0)) {
+    printf("%s: Error unlocking pseudo-terminal\n", sdp->com_name);
+    goto abort;
+  }
+
+  /* Raw mode, the shell does its own echo and line editing.*/
+  if (tcgetattr(sdp->com_fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    (void)tcsetattr(sdp->com_fd, TCSANOW, &tio);
+  }
+
+  /* A fresh pseudo-terminal does not report hang-up until a terminal has
+     been attached and detached at least once, the slave is opened and closed
+     here so that the port starts in the disconnected state.*/
+  slave = open(ptsname(sdp->com_fd), O_RDWR | O_NOCTTY);
+  if (slave < 0) {
+    printf("%s: Error opening pseudo-terminal slave\n", sdp->com_name);
+    goto abort;
+  }
+  close(slave);
+  sdp->com_connected = false;
+  printf("Full Duplex Channel %s on %s\n", sdp->com_name, ptsname(sdp->com_fd));
+  return;
+
+abort:
+  if (sdp->com_fd >= 0)
+    close(sdp->com_fd);
+  exit(1);
+}
+
+static bool connint(SerialDriver *sdp) {
+  struct pollfd pfd;
+
+  if ((sdp->com_fd < 0) || sdp->com_connected)
+    return false;
+
+  /* The hang-up condition clears as soon as a terminal reopens the slave.*/
+  pfd.fd = sdp->com_fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  if ((poll(&pfd, 1, 0) < 0) || ((pfd.revents & POLLHUP) != 0))
+    return false;
+
+  sdp->com_connected = true;
+  chSysLockFromISR();
+  chnAddFlagsI(sdp, CHN_CONNECTED);
+  chSysUnlockFromISR();
+  return true;
+}
+
+static void disconnected(SerialDriver *sdp) {
+
+  sdp->com_connected = false;
+  chSysLockFromISR();
+  chnAddFlagsI(sdp, CHN_DISCONNECTED);
+  chSysUnlockFromISR();
+}
+
+static bool inint(SerialDriver *sdp) {
+
+  if ((sdp->com_fd >= 0) && sdp->com_connected) {
+    ssize_t i, n;
+    uint8_t data[32];
+
+    /*
+     * Input.
+     */
+    n = read(sdp->com_fd, data, sizeof(data));
+    if (n < 0) {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+        disconnected(sdp);
+      return false;
+    }
+    if (n == 0)
+      return false;
+    for (i = 0; i < n; i++) {
+      chSysLockFromISR();
+      sdIncomingDataI(sdp, data[i]);
+      chSysUnlockFromISR();
+    }
+    return true;
+  }
+  return false;
+}
+
+static bool outint(SerialDriver *sdp) {
+
+  if ((sdp->com_fd >= 0) && sdp->com_connected) {
+    struct pollfd pfd;
+    msg_t n;
+    uint8_t data[1];
+
+    /* Bytes are only fetched from the queue when the host side can accept
+       them, so nothing is lost when the terminal is slow.*/
+    pfd.fd = sdp->com_fd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    if ((poll(&pfd, 1, 0) <= 0) || ((pfd.revents & POLLOUT) == 0))
+      return false;
+
+    /*
+     * Output.
+     */
+    chSysLockFromISR();
+    n = sdRequestDataI(sdp);
+    chSysUnlockFromISR();
+    if (n < 0)
+      return false;
+    data[0] = (uint8_t)n;
+    if (write(sdp->com_fd, data, sizeof(data)) < 0) {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+        disconnected(sdp);
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * Low level serial driver initialization.
+ */
+void sd_lld_init(void) {
+
+#if USE_POSIX_SERIAL1
+  sdObjectInit(&SD1, NULL, NULL);
+  SD1.com_fd = -1;
+  SD1.com_connected = false;
+  SD1.com_name = "SD1";
+#endif
+
+#if USE_POSIX_SERIAL2
+  sdObjectInit(&SD2, NULL, NULL);
+  SD2.com_fd = -1;
+  SD2.com_connected = false;
+  SD2.com_name = "SD2";
+#endif
+}
+
+/**
+ * @brief   Low level serial driver configuration and (re)start.
+ *
+ * @param[in] sdp       pointer to a @p SerialDriver object
+ * @param[in] config    the architecture-dependent serial driver configuration.
+ *                      If this parameter is set to @p NULL then a default
+ *                      configuration is used.
+ */
+void sd_lld_start(SerialDriver *sdp, const SerialConfig *config) {
+
+  if (config == NULL)
+    config = &default_config;
+
+  if (sdp->com_fd < 0)
+    init(sdp);
+}
+
+/**
+ * @brief Low level serial driver stop.
+ * @details Closes the pseudo-terminal associated to the port.
+ *
+ * @param[in] sdp pointer to a @p SerialDriver object
+ */
+void sd_lld_stop(SerialDriver *sdp) {
+
+  if (sdp->com_fd >= 0) {
+    close(sdp->com_fd);
+    sdp->com_fd = -1;
+    sdp->com_connected = false;
+  }
+}
+
+bool sd_lld_interrupt_pending(void) {
+  bool b = false;
+
+  CH_IRQ_PROLOGUE();
+
+#if USE_POSIX_SERIAL1
+  b = b || connint(&SD1) || inint(&SD1) || outint(&SD1);
+#endif
+#if USE_POSIX_SERIAL2
+  b = b || connint(&SD2) || inint(&SD2) || outint(&SD2);
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+#endif /* HAL_USE_SERIAL */
+
+/** @} */
@@ -42,11 +42,33 @@
  */
 /**
  * @brief   Trace buffer entries.
+ * @note    Must be a power of two.
  */
 #ifndef CH_DBG_TRACE_BUFFER_SIZE
 #define CH_DBG_TRACE_BUFFER_SIZE            64
 #endif
 
+/**
+ * @brief   Trace timestamp.
+ * @details Time stamp stored in each trace record, by default the realtime
+ *          counter if the port has one, else the system time.
+ */
+#ifndef CH_DBG_TRACE_TIMESTAMP
+#if (PORT_SUPPORTS_RT == TRUE) || defined(__DOXYGEN__)
+#define CH_DBG_TRACE_TIMESTAMP()            ((uint32_t)chSysGetRealtimeCounterX())
+#else
+#define CH_DBG_TRACE_TIMESTAMP()            ((uint32_t)chVTGetSystemTimeX())
+#endif
+#endif
+
+/**
+ * @brief   Number of the interrupt being served.
+ * @details Stored in the ISR trace records, zero if the port can't tell.
+ */
+#ifndef CH_DBG_TRACE_IRQ_NUMBER
+#define CH_DBG_TRACE_IRQ_NUMBER()           0U
+#endif
+
 /**
  * @brief   Fill value for thread stack area in debug mode.
  */
@@ -70,6 +92,34 @@
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if (CH_DBG_TRACE_BUFFER_SIZE & (CH_DBG_TRACE_BUFFER_SIZE - 1)) != 0
+#error "CH_DBG_TRACE_BUFFER_SIZE must be a power of two"
+#endif
+
+/**
+ * @name    Trace record types
+ * @{
+ */
+#define CH_TRACE_TYPE_SWITCH                1U
+#define CH_TRACE_TYPE_ISR_ENTER             2U
+#define CH_TRACE_TYPE_ISR_LEAVE             3U
+#define CH_TRACE_TYPE_VT_ENTER              4U
+#define CH_TRACE_TYPE_VT_LEAVE              5U
+#define CH_TRACE_TYPE_EVT_BROADCAST         6U
+#define CH_TRACE_TYPE_MTX_CONTENDED         7U
+#define CH_TRACE_TYPE_MARK                  8U
+/** @} */
+
+/**
+ * @brief   Mask of a trace record type, see @p chDbgTraceSetMask().
+ */
+#define CH_TRACE_MASK(type)                 (1U << (type))
+
+/**
+ * @brief   All the trace record types.
+ */
+#define CH_TRACE_MASK_ALL                   0x1FEU
+
 /*===========================================================================*/
 /* Module data structures and types.                                         */
 /*===========================================================================*/
@@ -80,22 +130,27 @@
  */
 typedef struct {
   /**
-   * @brief   Time of the switch event.
+   * @brief   Record type, one of the @p CH_TRACE_TYPE_ values.
    */
-  systime_t             se_time;
+  uint8_t               te_type;
   /**
-   * @brief   Switched in thread.
+   * @brief   Switched out thread state, interrupt number or marker id.
    */
-  thread_t              *se_tp;
+  uint8_t               te_state;
   /**
-   * @brief   Object where going to sleep.
+   * @brief   Time stamp, see @p CH_DBG_TRACE_TIMESTAMP.
    */
-  void                  *se_wtobjp;
+  uint32_t              te_time;
   /**
-   * @brief   Switched out thread state.
+   * @brief   Switched in thread, timer callback, event source or mutex.
    */
-  uint8_t               se_state;
-} ch_swc_event_t;
+  void                  *te_objp;
+  /**
+   * @brief   Object the switched out thread sleeps on, timer callback
+   *          parameter, broadcast flags, mutex owner or marker value.
+   */
+  uintptr_t             te_arg;
+} ch_trace_event_t;
 
 /**
  * @brief   Trace buffer header.
@@ -106,13 +161,25 @@ typedef struct {
    */
   unsigned              tb_size;
   /**
-   * @brief   Pointer to the buffer front.
+   * @brief   Record types being recorded, see @p CH_TRACE_MASK.
+   */
+  uint32_t              tb_mask;
+  /**
+   * @brief   Records written since start, the next one goes at this index.
+   */
+  uint32_t              tb_head;
+  /**
+   * @brief   Index of the oldest record not yet read.
+   */
+  uint32_t              tb_tail;
+  /**
+   * @brief   Records overwritten before being read.
    */
-  ch_swc_event_t        *tb_ptr;
+  uint32_t              tb_lost;
   /**
    * @brief   Ring buffer.
    */
-  ch_swc_event_t        tb_buffer[CH_DBG_TRACE_BUFFER_SIZE];
+  ch_trace_event_t      tb_buffer[CH_DBG_TRACE_BUFFER_SIZE];
 } ch_trace_buffer_t;
 #endif /* CH_DBG_ENABLE_TRACE */
 
@@ -147,6 +214,14 @@ typedef struct {
    macro.*/
 #if CH_DBG_ENABLE_TRACE == FALSE
 #define _dbg_trace(otp)
+#define _dbg_trace_isr_enter()
+#define _dbg_trace_isr_leave()
+#define _dbg_trace_vt_enter(fn, par)
+#define _dbg_trace_vt_leave(fn)
+#define _dbg_trace_evt_broadcast(esp, flags)
+#define _dbg_trace_mtx_contended(mp, otp)
+#define chDbgTraceMarkI(id, value)
+#define chDbgTraceMark(id, value)
 #endif
 
 /**
@@ -225,6 +300,16 @@ extern "C" {
 #if (CH_DBG_ENABLE_TRACE == TRUE) || defined(__DOXYGEN__)
   void _dbg_trace_init(void);
   void _dbg_trace(thread_t *otp);
+  void _dbg_trace_isr_enter(void);
+  void _dbg_trace_isr_leave(void);
+  void _dbg_trace_vt_enter(void *fn, void *par);
+  void _dbg_trace_vt_leave(void *fn);
+  void _dbg_trace_evt_broadcast(void *esp, uint32_t flags);
+  void _dbg_trace_mtx_contended(void *mp, thread_t *otp);
+  void chDbgTraceMarkI(uint8_t id, uint32_t value);
+  void chDbgTraceMark(uint8_t id, uint32_t value);
+  void chDbgTraceSetMask(uint32_t mask);
+  bool chDbgTraceReadI(ch_trace_event_t *tep);
 #endif
 #ifdef __cplusplus
 }
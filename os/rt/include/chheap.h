@@ -38,6 +38,39 @@
 /* Module pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   Segregated fit heap allocator.
+ * @details If enabled the free blocks of a heap are kept in size classes,
+ *          two level segregated fit (TLSF) style, instead of a single
+ *          address ordered list. Allocation and release take a bounded time
+ *          whatever the number of free blocks, and a request is served from
+ *          the smallest class that fits instead of the first block that
+ *          fits, which keeps the big blocks whole.
+ * @note    The default is @p FALSE.
+ * @note    Requires a @p stkalign_t of at least 4 bytes.
+ */
+#if !defined(CH_CFG_USE_HEAP_TLSF) || defined(__DOXYGEN__)
+#define CH_CFG_USE_HEAP_TLSF                FALSE
+#endif
+
+/**
+ * @brief   Second level size classes, as a power of two.
+ * @details Each power of two range of sizes is split in
+ *          2^CH_CFG_HEAP_TLSF_SL_BITS classes.
+ */
+#if !defined(CH_CFG_HEAP_TLSF_SL_BITS) || defined(__DOXYGEN__)
+#define CH_CFG_HEAP_TLSF_SL_BITS            2
+#endif
+
+/**
+ * @brief   First level size classes.
+ * @details Blocks bigger than the last class covers all go in the last
+ *          class, which is then searched linearly.
+ */
+#if !defined(CH_CFG_HEAP_TLSF_FL_COUNT) || defined(__DOXYGEN__)
+#define CH_CFG_HEAP_TLSF_FL_COUNT           14
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -50,6 +83,19 @@
 #error "CH_CFG_USE_HEAP requires CH_CFG_USE_MUTEXES and/or CH_CFG_USE_SEMAPHORES"
 #endif
 
+#if (CH_CFG_HEAP_TLSF_SL_BITS < 1) || (CH_CFG_HEAP_TLSF_SL_BITS > 5)
+#error "CH_CFG_HEAP_TLSF_SL_BITS must be between 1 and 5"
+#endif
+
+#if (CH_CFG_HEAP_TLSF_FL_COUNT < 1) || (CH_CFG_HEAP_TLSF_FL_COUNT > 31)
+#error "CH_CFG_HEAP_TLSF_FL_COUNT must be between 1 and 31"
+#endif
+
+/**
+ * @brief   Number of second level size classes.
+ */
+#define CH_HEAP_TLSF_SL_COUNT   (1U << CH_CFG_HEAP_TLSF_SL_BITS)
+
 /*===========================================================================*/
 /* Module data structures and types.                                         */
 /*===========================================================================*/
@@ -73,13 +119,45 @@ union heap_header {
   } h;
 };
 
+/**
+ * @brief   Heap statistics.
+ * @note    The fragmentation of the free space can be told from
+ *          @p largest against @p free.
+ */
+typedef struct {
+  size_t                fragments;  /**< @brief Number of free blocks.      */
+  size_t                free;       /**< @brief Total free space.           */
+  size_t                largest;    /**< @brief Largest free block.         */
+  size_t                used;       /**< @brief Space in allocated blocks.  */
+  size_t                peak;       /**< @brief Highest @p used seen.       */
+  uint32_t              allocs;     /**< @brief Successful allocations.     */
+  uint32_t              frees;      /**< @brief Releases.                   */
+  uint32_t              failures;   /**< @brief Failed allocations.         */
+} heap_stats_t;
+
 /**
  * @brief   Structure describing a memory heap.
  */
 struct memory_heap {
   memgetfunc_t          h_provider; /**< @brief Memory blocks provider for
                                                 this heap.                  */
+#if (CH_CFG_USE_HEAP_TLSF == TRUE) || defined(__DOXYGEN__)
+  uint32_t              h_fl_map;   /**< @brief Non empty first levels.     */
+  uint32_t              h_sl_map[CH_CFG_HEAP_TLSF_FL_COUNT];
+                                    /**< @brief Non empty second levels.    */
+  union heap_header     *h_lists[CH_CFG_HEAP_TLSF_FL_COUNT][CH_HEAP_TLSF_SL_COUNT];
+                                    /**< @brief Free blocks lists, one per
+                                                size class.                 */
+  union heap_header     *h_end;     /**< @brief End header of the last
+                                                provider chunk.             */
+#else
   union heap_header     h_free;     /**< @brief Free blocks list header.    */
+#endif
+  size_t                h_used;     /**< @brief Space in allocated blocks.  */
+  size_t                h_peak;     /**< @brief Highest @p h_used seen.     */
+  uint32_t              h_allocs;   /**< @brief Successful allocations.     */
+  uint32_t              h_frees;    /**< @brief Releases.                   */
+  uint32_t              h_failures; /**< @brief Failed allocations.         */
 #if CH_CFG_USE_MUTEXES == TRUE
   mutex_t               h_mtx;      /**< @brief Heap access mutex.          */
 #else
@@ -103,6 +181,7 @@ extern "C" {
   void *chHeapAlloc(memory_heap_t *heapp, size_t size);
   void chHeapFree(void *p);
   size_t chHeapStatus(memory_heap_t *heapp, size_t *sizep);
+  void chHeapStats(memory_heap_t *heapp, heap_stats_t *statsp);
 #ifdef __cplusplus
 }
 #endif
@@ -109,7 +109,8 @@
 #define CH_IRQ_PROLOGUE()                                                   \
   PORT_IRQ_PROLOGUE();                                                      \
   _stats_increase_irq();                                                    \
-  _dbg_check_enter_isr()
+  _dbg_check_enter_isr();                                                   \
+  _dbg_trace_isr_enter()
 
 /**
  * @brief   IRQ handler exit code.
@@ -120,6 +121,7 @@
  * @special
  */
 #define CH_IRQ_EPILOGUE()                                                   \
+  _dbg_trace_isr_leave();                                                   \
   _dbg_check_leave_isr();                                                   \
   PORT_IRQ_EPILOGUE()
 
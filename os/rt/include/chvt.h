@@ -481,9 +481,11 @@ static inline void chVTDoTickI(void) {
       vtp->vt_func = NULL;
       vtp->vt_next->vt_prev = (virtual_timer_t *)&ch.vtlist;
       ch.vtlist.vt_next = vtp->vt_next;
+      _dbg_trace_vt_enter((void *)fn, vtp->vt_par);
       chSysUnlockFromISR();
       fn(vtp->vt_par);
       chSysLockFromISR();
+      _dbg_trace_vt_leave((void *)fn);
     }
   }
 #else /* CH_CFG_ST_TIMEDELTA > 0 */
@@ -517,6 +519,7 @@ static inline void chVTDoTickI(void) {
     /* Leaving the system critical zone in order to execute the callback
        and in order to give a preemption chance to higher priority
        interrupts.*/
+    _dbg_trace_vt_enter((void *)fn, vtp->vt_par);
     chSysUnlockFromISR();
 
     /* The callback is invoked outside the kernel critical zone.*/
@@ -525,6 +528,7 @@ static inline void chVTDoTickI(void) {
     /* Re-entering the critical zone in order to continue the exploration
        of the list.*/
     chSysLockFromISR();
+    _dbg_trace_vt_leave((void *)fn);
 
     /* Next element in the list, the current time could have advanced so
        recalculating the time window.*/
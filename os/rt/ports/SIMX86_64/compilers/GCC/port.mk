@@ -0,0 +1,7 @@
+# List of the ChibiOS/RT SIMX86_64 port files.
+PORTSRC = ${CHIBIOS}/os/rt/ports/SIMX86_64/chcore.c
+
+PORTASM = 
+
+PORTINC = ${CHIBIOS}/os/rt/ports/SIMX86_64/compilers/GCC \
+          ${CHIBIOS}/os/rt/ports/SIMX86_64
@@ -69,7 +69,9 @@
  *              - S-class function not called from within a critical zone.
  *              - Called from an ISR.
  *            .
- *          - Trace buffer.
+ *          - Trace buffer, recording context switches, ISRs, virtual timer
+ *            callbacks, event broadcasts, contended mutexes and markers
+ *            put in by the application.
  *          - Parameters check.
  *          - Kernel assertions.
  *          - Kernel panics.
@@ -264,7 +266,44 @@ void chDbgCheckClassS(void) {
 void _dbg_trace_init(void) {
 
   ch.dbg.trace_buffer.tb_size = CH_DBG_TRACE_BUFFER_SIZE;
-  ch.dbg.trace_buffer.tb_ptr = &ch.dbg.trace_buffer.tb_buffer[0];
+  ch.dbg.trace_buffer.tb_mask = CH_TRACE_MASK_ALL;
+  ch.dbg.trace_buffer.tb_head = 0U;
+  ch.dbg.trace_buffer.tb_tail = 0U;
+  ch.dbg.trace_buffer.tb_lost = 0U;
+}
+
+/**
+ * @brief   Inserts a record in the circular debug trace buffer.
+ * @details When the buffer is full the oldest record is overwritten and
+ *          counted as lost.
+ *
+ * @param[in] type      the record type
+ * @param[in] state     the record state byte
+ * @param[in] objp      the record object
+ * @param[in] arg       the record argument
+ *
+ * @notapi
+ */
+static void _dbg_trace_put(uint8_t type, uint8_t state,
+                           void *objp, uintptr_t arg) {
+  ch_trace_buffer_t *tbp = &ch.dbg.trace_buffer;
+  ch_trace_event_t *tep;
+
+  if ((tbp->tb_mask & CH_TRACE_MASK(type)) == 0U) {
+    return;
+  }
+
+  if ((tbp->tb_head - tbp->tb_tail) >= (uint32_t)CH_DBG_TRACE_BUFFER_SIZE) {
+    tbp->tb_tail++;
+    tbp->tb_lost++;
+  }
+  tep = &tbp->tb_buffer[tbp->tb_head & (CH_DBG_TRACE_BUFFER_SIZE - 1U)];
+  tep->te_type  = type;
+  tep->te_state = state;
+  tep->te_time  = CH_DBG_TRACE_TIMESTAMP();
+  tep->te_objp  = objp;
+  tep->te_arg   = arg;
+  tbp->tb_head++;
 }
 
 /**
@@ -276,14 +315,161 @@ void _dbg_trace_init(void) {
  */
 void _dbg_trace(thread_t *otp) {
 
-  ch.dbg.trace_buffer.tb_ptr->se_time   = chVTGetSystemTimeX();
-  ch.dbg.trace_buffer.tb_ptr->se_tp     = currp;
-  ch.dbg.trace_buffer.tb_ptr->se_wtobjp = otp->p_u.wtobjp;
-  ch.dbg.trace_buffer.tb_ptr->se_state  = (uint8_t)otp->p_state;
-  if (++ch.dbg.trace_buffer.tb_ptr >=
-      &ch.dbg.trace_buffer.tb_buffer[CH_DBG_TRACE_BUFFER_SIZE]) {
-    ch.dbg.trace_buffer.tb_ptr = &ch.dbg.trace_buffer.tb_buffer[0];
+  _dbg_trace_put(CH_TRACE_TYPE_SWITCH, (uint8_t)otp->p_state,
+                 currp, (uintptr_t)otp->p_u.wtobjp);
+}
+
+/**
+ * @brief   Inserts in the circular debug trace buffer an ISR enter record.
+ * @note    Invoked by @p CH_IRQ_PROLOGUE(), outside the critical zone.
+ *
+ * @notapi
+ */
+void _dbg_trace_isr_enter(void) {
+
+  port_lock_from_isr();
+  _dbg_trace_put(CH_TRACE_TYPE_ISR_ENTER, (uint8_t)CH_DBG_TRACE_IRQ_NUMBER(),
+                 NULL, 0U);
+  port_unlock_from_isr();
+}
+
+/**
+ * @brief   Inserts in the circular debug trace buffer an ISR leave record.
+ * @note    Invoked by @p CH_IRQ_EPILOGUE(), outside the critical zone.
+ *
+ * @notapi
+ */
+void _dbg_trace_isr_leave(void) {
+
+  port_lock_from_isr();
+  _dbg_trace_put(CH_TRACE_TYPE_ISR_LEAVE, (uint8_t)CH_DBG_TRACE_IRQ_NUMBER(),
+                 NULL, 0U);
+  port_unlock_from_isr();
+}
+
+/**
+ * @brief   Inserts in the circular debug trace buffer a record of a virtual
+ *          timer callback being invoked.
+ *
+ * @param[in] fn        the callback
+ * @param[in] par       the callback parameter
+ *
+ * @notapi
+ */
+void _dbg_trace_vt_enter(void *fn, void *par) {
+
+  _dbg_trace_put(CH_TRACE_TYPE_VT_ENTER, 0U, fn, (uintptr_t)par);
+}
+
+/**
+ * @brief   Inserts in the circular debug trace buffer a record of a virtual
+ *          timer callback having returned.
+ *
+ * @param[in] fn        the callback
+ *
+ * @notapi
+ */
+void _dbg_trace_vt_leave(void *fn) {
+
+  _dbg_trace_put(CH_TRACE_TYPE_VT_LEAVE, 0U, fn, 0U);
+}
+
+/**
+ * @brief   Inserts in the circular debug trace buffer an event broadcast
+ *          record.
+ *
+ * @param[in] esp       the event source
+ * @param[in] flags     the flags being broadcast
+ *
+ * @notapi
+ */
+void _dbg_trace_evt_broadcast(void *esp, uint32_t flags) {
+
+  _dbg_trace_put(CH_TRACE_TYPE_EVT_BROADCAST, 0U, esp, (uintptr_t)flags);
+}
+
+/**
+ * @brief   Inserts in the circular debug trace buffer a record of the
+ *          current thread having to wait for a mutex.
+ *
+ * @param[in] mp        the mutex
+ * @param[in] otp       the thread owning the mutex
+ *
+ * @notapi
+ */
+void _dbg_trace_mtx_contended(void *mp, thread_t *otp) {
+
+  _dbg_trace_put(CH_TRACE_TYPE_MTX_CONTENDED, 0U, mp, (uintptr_t)otp);
+}
+
+/**
+ * @brief   Inserts in the circular debug trace buffer an application
+ *          marker.
+ *
+ * @param[in] id        the marker id
+ * @param[in] value     a value stored with the marker
+ *
+ * @iclass
+ */
+void chDbgTraceMarkI(uint8_t id, uint32_t value) {
+
+  chDbgCheckClassI();
+
+  _dbg_trace_put(CH_TRACE_TYPE_MARK, id, currp, (uintptr_t)value);
+}
+
+/**
+ * @brief   Inserts in the circular debug trace buffer an application
+ *          marker.
+ *
+ * @param[in] id        the marker id
+ * @param[in] value     a value stored with the marker
+ *
+ * @api
+ */
+void chDbgTraceMark(uint8_t id, uint32_t value) {
+
+  chSysLock();
+  chDbgTraceMarkI(id, value);
+  chSysUnlock();
+}
+
+/**
+ * @brief   Selects the record types that are stored in the trace buffer.
+ *
+ * @param[in] mask      the record types, see @p CH_TRACE_MASK
+ *
+ * @api
+ */
+void chDbgTraceSetMask(uint32_t mask) {
+
+  chSysLock();
+  ch.dbg.trace_buffer.tb_mask = mask;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Takes the oldest record out of the trace buffer.
+ *
+ * @param[out] tep      the record
+ * @return              The operation status.
+ * @retval false        if the trace buffer is empty.
+ * @retval true         if a record was returned.
+ *
+ * @iclass
+ */
+bool chDbgTraceReadI(ch_trace_event_t *tep) {
+  ch_trace_buffer_t *tbp = &ch.dbg.trace_buffer;
+
+  chDbgCheckClassI();
+
+  if (tbp->tb_tail == tbp->tb_head) {
+    return false;
   }
+  *tep = tbp->tb_buffer[tbp->tb_tail & (CH_DBG_TRACE_BUFFER_SIZE - 1U)];
+  tbp->tb_tail++;
+
+  return true;
 }
 #endif /* CH_DBG_ENABLE_TRACE */
 
@@ -28,11 +28,15 @@
  *          are functionally equivalent to the usual @p malloc() and @p free()
  *          library functions. The main difference is that the OS heap APIs
  *          are guaranteed to be thread safe.<br>
+ *          With @p CH_CFG_USE_HEAP_TLSF the free blocks are kept in size
+ *          classes instead, see @p CH_CFG_USE_HEAP_TLSF.<br>
  * @pre     In order to use the heap APIs the @p CH_CFG_USE_HEAP option must
  *          be enabled in @p chconf.h.
  * @{
  */
 
+#include <string.h>
+
 #include "ch.h"
 
 #if (CH_CFG_USE_HEAP == TRUE) || defined(__DOXYGEN__)
@@ -52,11 +56,49 @@
 #define H_UNLOCK(h)     chSemSignal(&(h)->h_sem)
 #endif
 
+#if (CH_CFG_USE_HEAP_TLSF == FALSE) || defined(__DOXYGEN__)
 #define LIMIT(p)                                                            \
   /*lint -save -e9087 [11.3] Safe cast.*/                                   \
   (union heap_header *)((uint8_t *)(p) +                                    \
                         sizeof(union heap_header) + (p)->h.size)            \
   /*lint -restore*/
+#endif
+
+#if (CH_CFG_USE_HEAP_TLSF == TRUE) || defined(__DOXYGEN__)
+/*
+ * The two low bits of the size of a block, always a multiple of
+ * MEM_ALIGN_SIZE, flag the block and the one physically before it as
+ * free. A free block keeps the previous block of its list in its first
+ * word and a pointer to its own header in its last word, so the block
+ * after it can find it to merge.
+ */
+#define TLSF_FREE           ((size_t)1)
+#define TLSF_PREV_FREE      ((size_t)2)
+#define TLSF_FLAGS          (TLSF_FREE | TLSF_PREV_FREE)
+
+#define B_SIZE(p)           ((p)->h.size & ~TLSF_FLAGS)
+#define B_NEXT(p)                                                           \
+  /*lint -save -e9087 [11.3] Safe cast.*/                                   \
+  ((union heap_header *)((uint8_t *)((p) + 1) + B_SIZE(p)))                 \
+  /*lint -restore*/
+#define B_PREV_FREE(p)      (((union heap_header **)(void *)((p) + 1))[0])
+#define B_FOOTER(next)      (((union heap_header **)(void *)(next))[-1])
+
+/* Smallest block, room for the list link and the footer.*/
+#define TLSF_MIN_SIZE       MEM_ALIGN_NEXT(2U * sizeof(void *))
+
+#define TLSF_ALIGN_SHIFT    ((MEM_ALIGN_SIZE >= 32U) ? 5U :                 \
+                             (MEM_ALIGN_SIZE == 16U) ? 4U :                 \
+                             (MEM_ALIGN_SIZE == 8U) ? 3U : 2U)
+
+/* Sizes below TLSF_SMALL are spread linearly over the first level 0.*/
+#define TLSF_SMALL_SHIFT    (CH_CFG_HEAP_TLSF_SL_BITS + TLSF_ALIGN_SHIFT)
+#define TLSF_SMALL          ((size_t)1 << TLSF_SMALL_SHIFT)
+
+/* Sizes from TLSF_BIG up all go in the last class.*/
+#define TLSF_BIG            ((size_t)1 << (TLSF_SMALL_SHIFT +               \
+                                           CH_CFG_HEAP_TLSF_FL_COUNT - 1U))
+#endif
 
 /*===========================================================================*/
 /* Module exported variables.                                                */
@@ -79,6 +121,206 @@ static memory_heap_t default_heap;
 /* Module local functions.                                                   */
 /*===========================================================================*/
 
+/**
+ * @brief   Accounts an allocation.
+ * @note    Called with the heap locked.
+ */
+static void heap_count_alloc(memory_heap_t *heapp, size_t size) {
+
+  heapp->h_allocs++;
+  heapp->h_used += size;
+  if (heapp->h_used > heapp->h_peak) {
+    heapp->h_peak = heapp->h_used;
+  }
+}
+
+#if (CH_CFG_USE_HEAP_TLSF == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Index of the most significant bit set, @p x must not be zero.
+ * @note    Portable, a fixed number of steps.
+ */
+static unsigned tlsf_fls(size_t x) {
+  unsigned n = 0U;
+
+#if SIZE_MAX > 0xFFFFFFFFU
+  if ((x >> 32) != 0U) { x >>= 32; n += 32U; }
+#endif
+  if ((x >> 16) != 0U) { x >>= 16; n += 16U; }
+  if ((x >> 8) != 0U)  { x >>= 8;  n += 8U; }
+  if ((x >> 4) != 0U)  { x >>= 4;  n += 4U; }
+  if ((x >> 2) != 0U)  { x >>= 2;  n += 2U; }
+  if ((x >> 1) != 0U)  { n += 1U; }
+
+  return n;
+}
+
+/**
+ * @brief   Index of the least significant bit set, @p x must not be zero.
+ */
+static unsigned tlsf_ffs(uint32_t x) {
+
+  return tlsf_fls((size_t)(x & (~x + 1U)));
+}
+
+/**
+ * @brief   Size class of a block.
+ */
+static void tlsf_mapping(size_t size, unsigned *flp, unsigned *slp) {
+  unsigned f;
+
+  if (size < TLSF_SMALL) {
+    *flp = 0U;
+    *slp = (unsigned)(size >> TLSF_ALIGN_SHIFT);
+  }
+  else if (size >= TLSF_BIG) {
+    *flp = CH_CFG_HEAP_TLSF_FL_COUNT - 1U;
+    *slp = CH_HEAP_TLSF_SL_COUNT - 1U;
+  }
+  else {
+    f = tlsf_fls(size);
+    *flp = (f - TLSF_SMALL_SHIFT) + 1U;
+    *slp = (unsigned)(size >> (f - CH_CFG_HEAP_TLSF_SL_BITS)) -
+           CH_HEAP_TLSF_SL_COUNT;
+  }
+}
+
+/**
+ * @brief   Links a free block into the list of its class.
+ * @note    Called with the heap locked.
+ */
+static void tlsf_insert(memory_heap_t *heapp, union heap_header *hp) {
+  unsigned fl, sl;
+
+  tlsf_mapping(B_SIZE(hp), &fl, &sl);
+  hp->h.size |= TLSF_FREE;
+  hp->h.u.next = heapp->h_lists[fl][sl];
+  B_PREV_FREE(hp) = NULL;
+  if (hp->h.u.next != NULL) {
+    B_PREV_FREE(hp->h.u.next) = hp;
+  }
+  heapp->h_lists[fl][sl] = hp;
+  heapp->h_fl_map |= (uint32_t)1 << fl;
+  heapp->h_sl_map[fl] |= (uint32_t)1 << sl;
+
+  B_FOOTER(B_NEXT(hp)) = hp;
+  B_NEXT(hp)->h.size |= TLSF_PREV_FREE;
+}
+
+/**
+ * @brief   Unlinks a free block from the list of its class.
+ * @note    Called with the heap locked.
+ */
+static void tlsf_remove(memory_heap_t *heapp, union heap_header *hp) {
+  union heap_header *prev = B_PREV_FREE(hp), *next = hp->h.u.next;
+  unsigned fl, sl;
+
+  tlsf_mapping(B_SIZE(hp), &fl, &sl);
+  if (next != NULL) {
+    B_PREV_FREE(next) = prev;
+  }
+  if (prev != NULL) {
+    prev->h.u.next = next;
+  }
+  else {
+    heapp->h_lists[fl][sl] = next;
+    if (next == NULL) {
+      heapp->h_sl_map[fl] &= ~((uint32_t)1 << sl);
+      if (heapp->h_sl_map[fl] == 0U) {
+        heapp->h_fl_map &= ~((uint32_t)1 << fl);
+      }
+    }
+  }
+
+  hp->h.size &= ~TLSF_FREE;
+  B_NEXT(hp)->h.size &= ~TLSF_PREV_FREE;
+}
+
+/**
+ * @brief   Finds a free block of at least @p size bytes.
+ * @details The request is rounded up to the next class boundary so that
+ *          any block of the first non empty class from there fits, which is
+ *          found in two bitmap lookups. Failing that the class of the
+ *          request itself is searched, it may hold a block just big enough.
+ * @note    Called with the heap locked.
+ */
+static union heap_header *tlsf_find(memory_heap_t *heapp, size_t size) {
+  union heap_header *hp;
+  unsigned fl, sl;
+  uint32_t map;
+  size_t rounded = size;
+
+  if ((size >= TLSF_SMALL) && (size < TLSF_BIG)) {
+    rounded += ((size_t)1 << (tlsf_fls(size) - CH_CFG_HEAP_TLSF_SL_BITS)) - 1U;
+  }
+  tlsf_mapping(rounded, &fl, &sl);
+
+  map = heapp->h_sl_map[fl] & (~(uint32_t)0 << sl);
+  if (map == 0U) {
+    map = heapp->h_fl_map & (~(uint32_t)0 << fl) & ~((uint32_t)1 << fl);
+    if (map != 0U) {
+      fl = tlsf_ffs(map);
+      map = heapp->h_sl_map[fl];
+    }
+  }
+  if (map != 0U) {
+    /* Only the last class can hold blocks smaller than the request.*/
+    for (hp = heapp->h_lists[fl][tlsf_ffs(map)]; hp != NULL; hp = hp->h.u.next) {
+      if (B_SIZE(hp) >= size) {
+        return hp;
+      }
+    }
+  }
+
+  tlsf_mapping(size, &fl, &sl);
+  for (hp = heapp->h_lists[fl][sl]; hp != NULL; hp = hp->h.u.next) {
+    if (B_SIZE(hp) >= size) {
+      return hp;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief   Adds a chunk from the provider to the free blocks.
+ * @details A chunk directly following the previous one takes over its end
+ *          header and merges with a free block before it, so memory from
+ *          the core allocator keeps growing as a single region.
+ * @note    Called with the heap locked.
+ */
+static bool tlsf_grow(memory_heap_t *heapp, size_t size) {
+  union heap_header *hp, *np;
+
+  hp = heapp->h_provider(size + (2U * sizeof(union heap_header)));
+  if (hp == NULL) {
+    return false;
+  }
+  if ((heapp->h_end != NULL) && (hp == (heapp->h_end + 1))) {
+    np = heapp->h_end;
+    np->h.size = (size + sizeof(union heap_header)) |
+                 (np->h.size & TLSF_PREV_FREE);
+  }
+  else {
+    np = hp;
+    np->h.size = size;
+  }
+  hp = B_NEXT(np);
+  hp->h.u.heap = heapp;
+  hp->h.size = 0U;
+  heapp->h_end = hp;
+
+  if ((np->h.size & TLSF_PREV_FREE) != 0U) {
+    hp = B_FOOTER(np);
+    tlsf_remove(heapp, hp);
+    hp->h.size += B_SIZE(np) + sizeof(union heap_header);
+    np = hp;
+  }
+  tlsf_insert(heapp, np);
+
+  return true;
+}
+#endif /* CH_CFG_USE_HEAP_TLSF == TRUE */
+
 /*===========================================================================*/
 /* Module exported functions.                                                */
 /*===========================================================================*/
@@ -91,8 +333,21 @@ static memory_heap_t default_heap;
 void _heap_init(void) {
 
   default_heap.h_provider = chCoreAlloc;
+#if (CH_CFG_USE_HEAP_TLSF == TRUE) || defined(__DOXYGEN__)
+  chDbgAssert(MEM_ALIGN_SIZE >= 4U, "alignment too small for TLSF");
+  memset(default_heap.h_sl_map, 0, sizeof(default_heap.h_sl_map));
+  memset(default_heap.h_lists, 0, sizeof(default_heap.h_lists));
+  default_heap.h_fl_map = 0U;
+  default_heap.h_end = NULL;
+#else
   default_heap.h_free.h.u.next = NULL;
   default_heap.h_free.h.size = 0;
+#endif
+  default_heap.h_used = 0U;
+  default_heap.h_peak = 0U;
+  default_heap.h_allocs = 0U;
+  default_heap.h_frees = 0U;
+  default_heap.h_failures = 0U;
 #if (CH_CFG_USE_MUTEXES == TRUE) || defined(__DOXYGEN__)
   chMtxObjectInit(&default_heap.h_mtx);
 #else
@@ -117,10 +372,28 @@ void chHeapObjectInit(memory_heap_t *heapp, void *buf, size_t size) {
   chDbgCheck(MEM_IS_ALIGNED(buf) && MEM_IS_ALIGNED(size));
 
   heapp->h_provider = NULL;
+#if (CH_CFG_USE_HEAP_TLSF == TRUE) || defined(__DOXYGEN__)
+  memset(heapp->h_sl_map, 0, sizeof(heapp->h_sl_map));
+  memset(heapp->h_lists, 0, sizeof(heapp->h_lists));
+  heapp->h_fl_map = 0U;
+  heapp->h_end = NULL;
+  /* One free block, and a header at the end that is never free so that
+     nothing merges past the buffer.*/
+  hp->h.size = size - (2U * sizeof(union heap_header));
+  B_NEXT(hp)->h.u.heap = heapp;
+  B_NEXT(hp)->h.size = 0U;
+  tlsf_insert(heapp, hp);
+#else
   heapp->h_free.h.u.next = hp;
   heapp->h_free.h.size = 0;
   hp->h.u.next = NULL;
   hp->h.size = size - sizeof(union heap_header);
+#endif
+  heapp->h_used = 0U;
+  heapp->h_peak = 0U;
+  heapp->h_allocs = 0U;
+  heapp->h_frees = 0U;
+  heapp->h_failures = 0U;
 #if (CH_CFG_USE_MUTEXES == TRUE) || defined(__DOXYGEN__)
   chMtxObjectInit(&heapp->h_mtx);
 #else
@@ -128,6 +401,138 @@ void chHeapObjectInit(memory_heap_t *heapp, void *buf, size_t size) {
 #endif
 }
 
+#if (CH_CFG_USE_HEAP_TLSF == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Allocates a block of memory from the heap by using the
+ *          segregated fit algorithm.
+ * @details The allocated block is guaranteed to be properly aligned for a
+ *          pointer data type (@p stkalign_t).
+ *
+ * @param[in] heapp     pointer to a heap descriptor or @p NULL in order to
+ *                      access the default heap.
+ * @param[in] size      the size of the block to be allocated. Note that the
+ *                      allocated block may be a bit bigger than the requested
+ *                      size for alignment and fragmentation reasons.
+ * @return              A pointer to the allocated block.
+ * @retval NULL         if the block cannot be allocated.
+ *
+ * @api
+ */
+void *chHeapAlloc(memory_heap_t *heapp, size_t size) {
+  union heap_header *hp, *fp;
+
+  if (heapp == NULL) {
+    heapp = &default_heap;
+  }
+
+  size = MEM_ALIGN_NEXT(size);
+  if (size < TLSF_MIN_SIZE) {
+    size = TLSF_MIN_SIZE;
+  }
+
+  H_LOCK(heapp);
+  hp = tlsf_find(heapp, size);
+  if ((hp == NULL) && (heapp->h_provider != NULL) && (size < TLSF_BIG) &&
+      tlsf_grow(heapp, size)) {
+    /* More memory was required, it came from the associated provider.*/
+    hp = tlsf_find(heapp, size);
+  }
+  if (hp != NULL) {
+    tlsf_remove(heapp, hp);
+    if (B_SIZE(hp) >= (size + sizeof(union heap_header) + TLSF_MIN_SIZE)) {
+      /* Block bigger enough, must split it, the rest goes back free.*/
+      /*lint -save -e9087 [11.3] Safe cast.*/
+      fp = (void *)((uint8_t *)(hp) + sizeof(union heap_header) + size);
+      /*lint -restore*/
+      fp->h.size = (B_SIZE(hp) - sizeof(union heap_header)) - size;
+      hp->h.size = size | (hp->h.size & TLSF_PREV_FREE);
+      tlsf_insert(heapp, fp);
+    }
+    hp->h.u.heap = heapp;
+    heap_count_alloc(heapp, B_SIZE(hp));
+    H_UNLOCK(heapp);
+
+    /*lint -save -e9087 [11.3] Safe cast.*/
+    return (void *)(hp + 1);
+    /*lint -restore*/
+  }
+
+  heapp->h_failures++;
+  H_UNLOCK(heapp);
+
+  return NULL;
+}
+
+/**
+ * @brief   Frees a previously allocated memory block.
+ * @details The block is merged with its free neighbours, found through
+ *          the block headers, so no list is walked.
+ *
+ * @param[in] p         pointer to the memory block to be freed
+ *
+ * @api
+ */
+void chHeapFree(void *p) {
+  union heap_header *hp, *np;
+  memory_heap_t *heapp;
+
+  chDbgCheck(p != NULL);
+
+  /*lint -save -e9087 [11.3] Safe cast.*/
+  hp = (union heap_header *)p - 1;
+  /*lint -restore*/
+  heapp = hp->h.u.heap;
+
+  H_LOCK(heapp);
+  chDbgAssert((hp->h.size & TLSF_FREE) == 0U, "already free");
+
+  heapp->h_frees++;
+  heapp->h_used -= B_SIZE(hp);
+
+  np = B_NEXT(hp);
+  if ((np->h.size & TLSF_FREE) != 0U) {
+    /* Merge with the next block.*/
+    tlsf_remove(heapp, np);
+    hp->h.size += B_SIZE(np) + sizeof(union heap_header);
+  }
+  if ((hp->h.size & TLSF_PREV_FREE) != 0U) {
+    /* Merge with the previous block.*/
+    np = B_FOOTER(hp);
+    tlsf_remove(heapp, np);
+    np->h.size += B_SIZE(hp) + sizeof(union heap_header);
+    hp = np;
+  }
+  tlsf_insert(heapp, hp);
+  H_UNLOCK(heapp);
+}
+
+/**
+ * @brief   Walks the free blocks.
+ * @note    Called with the heap locked.
+ */
+static size_t heap_walk(memory_heap_t *heapp, size_t *sizep, size_t *largestp) {
+  union heap_header *hp;
+  unsigned fl, sl;
+  size_t n = 0U, sz = 0U, largest = 0U;
+
+  for (fl = 0U; fl < CH_CFG_HEAP_TLSF_FL_COUNT; fl++) {
+    for (sl = 0U; sl < CH_HEAP_TLSF_SL_COUNT; sl++) {
+      for (hp = heapp->h_lists[fl][sl]; hp != NULL; hp = hp->h.u.next) {
+        sz += B_SIZE(hp);
+        if (B_SIZE(hp) > largest) {
+          largest = B_SIZE(hp);
+        }
+        n++;
+      }
+    }
+  }
+  *sizep = sz;
+  *largestp = largest;
+
+  return n;
+}
+
+#else /* CH_CFG_USE_HEAP_TLSF == FALSE */
 /**
  * @brief   Allocates a block of memory from the heap by using the first-fit
  *          algorithm.
@@ -175,6 +580,7 @@ void *chHeapAlloc(memory_heap_t *heapp, size_t size) {
         hp->h.size = size;
       }
       hp->h.u.heap = heapp;
+      heap_count_alloc(heapp, hp->h.size);
       H_UNLOCK(heapp);
 
       /*lint -save -e9087 [11.3] Safe cast.*/
@@ -192,6 +598,9 @@ void *chHeapAlloc(memory_heap_t *heapp, size_t size) {
     if (hp != NULL) {
       hp->h.u.heap = heapp;
       hp->h.size = size;
+      H_LOCK(heapp);
+      heap_count_alloc(heapp, size);
+      H_UNLOCK(heapp);
       hp++;
 
       /*lint -save -e9087 [11.3] Safe cast.*/
@@ -200,6 +609,10 @@ void *chHeapAlloc(memory_heap_t *heapp, size_t size) {
     }
   }
 
+  H_LOCK(heapp);
+  heapp->h_failures++;
+  H_UNLOCK(heapp);
+
   return NULL;
 }
 
@@ -223,6 +636,8 @@ void chHeapFree(void *p) {
   qp = &heapp->h_free;
 
   H_LOCK(heapp);
+  heapp->h_frees++;
+  heapp->h_used -= hp->h.size;
   while (true) {
     chDbgAssert((hp < qp) || (hp >= LIMIT(qp)), "within free block");
 
@@ -251,6 +666,30 @@ void chHeapFree(void *p) {
   return;
 }
 
+/**
+ * @brief   Walks the free blocks.
+ * @note    Called with the heap locked.
+ */
+static size_t heap_walk(memory_heap_t *heapp, size_t *sizep, size_t *largestp) {
+  union heap_header *qp;
+  size_t n = 0U, sz = 0U, largest = 0U;
+
+  qp = &heapp->h_free;
+  while (qp->h.u.next != NULL) {
+    sz += qp->h.u.next->h.size;
+    if (qp->h.u.next->h.size > largest) {
+      largest = qp->h.u.next->h.size;
+    }
+    n++;
+    qp = qp->h.u.next;
+  }
+  *sizep = sz;
+  *largestp = largest;
+
+  return n;
+}
+#endif /* CH_CFG_USE_HEAP_TLSF == FALSE */
+
 /**
  * @brief   Reports the heap status.
  * @note    This function is meant to be used in the test suite, it should
@@ -265,22 +704,14 @@ void chHeapFree(void *p) {
  * @api
  */
 size_t chHeapStatus(memory_heap_t *heapp, size_t *sizep) {
-  union heap_header *qp;
-  size_t n, sz;
+  size_t n, sz, largest;
 
   if (heapp == NULL) {
     heapp = &default_heap;
   }
 
   H_LOCK(heapp);
-  sz = 0;
-  n = 0;
-  qp = &heapp->h_free;
-  while (qp->h.u.next != NULL) {
-    sz += qp->h.u.next->h.size;
-    n++;
-    qp = qp->h.u.next;
-  }
+  n = heap_walk(heapp, &sz, &largest);
   if (sizep != NULL) {
     *sizep = sz;
   }
@@ -289,6 +720,36 @@ size_t chHeapStatus(memory_heap_t *heapp, size_t *sizep) {
   return n;
 }
 
+/**
+ * @brief   Reports the heap statistics.
+ * @details Besides the free space and the number of fragments returned by
+ *          @p chHeapStatus(), reports the largest free block, the space in
+ *          use and its peak, and the allocation counters.
+ *
+ * @param[in] heapp     pointer to a heap descriptor or @p NULL in order to
+ *                      access the default heap.
+ * @param[out] statsp   pointer to the structure receiving the statistics
+ *
+ * @api
+ */
+void chHeapStats(memory_heap_t *heapp, heap_stats_t *statsp) {
+
+  chDbgCheck(statsp != NULL);
+
+  if (heapp == NULL) {
+    heapp = &default_heap;
+  }
+
+  H_LOCK(heapp);
+  statsp->fragments = heap_walk(heapp, &statsp->free, &statsp->largest);
+  statsp->used = heapp->h_used;
+  statsp->peak = heapp->h_peak;
+  statsp->allocs = heapp->h_allocs;
+  statsp->frees = heapp->h_frees;
+  statsp->failures = heapp->h_failures;
+  H_UNLOCK(heapp);
+}
+
 #endif /* CH_CFG_USE_HEAP == TRUE */
 
 /** @} */
@@ -160,6 +160,8 @@ void chMtxLockS(mutex_t *mp) {
          priority of the running thread requesting the mutex.*/
       thread_t *tp = mp->m_owner;
 
+      _dbg_trace_mtx_contended(mp, tp);
+
       /* Does the running thread have higher priority than the mutex
          owning thread? */
       while (tp->p_prio < ctp->p_prio) {
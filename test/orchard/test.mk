@@ -0,0 +1,25 @@
+# List of all the Orchard host test files.
+TESTSRC = ${CHIBIOS}/test/lib/ch_test.c \
+          ${CHIBIOS}/test/orchard/test_root.c \
+          ${CHIBIOS}/test/orchard/test_sequence_001.c \
+          ${CHIBIOS}/test/orchard/test_sequence_002.c \
+          ${CHIBIOS}/test/orchard/test_sequence_003.c \
+          ${CHIBIOS}/test/orchard/test_sequence_004.c \
+          ${CHIBIOS}/test/orchard/test_sequence_005.c \
+          ${CHIBIOS}/test/orchard/test_sequence_006.c \
+          ${CHIBIOS}/test/orchard/test_sequence_007.c \
+          ${CHIBIOS}/test/orchard/test_sequence_008.c \
+          ${CHIBIOS}/test/orchard/test_sequence_009.c \
+          ${CHIBIOS}/test/orchard/test_sequence_010.c \
+          ${CHIBIOS}/test/orchard/test_sequence_011.c \
+          ${CHIBIOS}/test/orchard/test_sequence_012.c \
+          ${CHIBIOS}/test/orchard/test_sequence_013.c \
+          ${CHIBIOS}/test/orchard/test_sequence_014.c \
+          ${CHIBIOS}/test/orchard/test_sequence_015.c \
+          ${CHIBIOS}/test/orchard/test_sequence_016.c \
+          ${CHIBIOS}/test/orchard/test_sequence_017.c \
+          ${CHIBIOS}/test/orchard/test_sequence_018.c
+
+# Required include directories
+TESTINC = ${CHIBIOS}/test/lib \
+          ${CHIBIOS}/test/orchard
@@ -0,0 +1,58 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    test_root.c
+ * @brief   Test Suite root structures code.
+ *
+ * @addtogroup CH_TEST_ROOT
+ * @{
+ */
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+/*===========================================================================*/
+/* Module exported variables.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Array of all the test sequences.
+ */
+const testcase_t * const *test_suite[] = {
+  test_sequence_001,
+  test_sequence_002,
+  test_sequence_003,
+  test_sequence_004,
+  test_sequence_005,
+  test_sequence_006,
+  test_sequence_007,
+  test_sequence_008,
+  test_sequence_009,
+  test_sequence_010,
+  test_sequence_011,
+  test_sequence_012,
+  test_sequence_013,
+  test_sequence_014,
+  test_sequence_015,
+  test_sequence_016,
+  test_sequence_017,
+  test_sequence_018,
+  NULL
+};
+
+/** @} */
@@ -0,0 +1,69 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    test_root.h
+ * @brief   Test Suite root structures header.
+ *
+ * @addtogroup CH_TEST_ROOT
+ * @{
+ */
+
+#ifndef _TEST_ROOT_H_
+#define _TEST_ROOT_H_
+
+#include "ch.h"
+
+#include "test_sequence_001.h"
+#include "test_sequence_002.h"
+#include "test_sequence_003.h"
+#include "test_sequence_004.h"
+#include "test_sequence_005.h"
+#include "test_sequence_006.h"
+#include "test_sequence_007.h"
+#include "test_sequence_008.h"
+#include "test_sequence_009.h"
+#include "test_sequence_010.h"
+#include "test_sequence_011.h"
+#include "test_sequence_012.h"
+#include "test_sequence_013.h"
+#include "test_sequence_014.h"
+#include "test_sequence_015.h"
+#include "test_sequence_016.h"
+#include "test_sequence_017.h"
+#include "test_sequence_018.h"
+
+/*===========================================================================*/
+/* Default definitions.                                                      */
+/*===========================================================================*/
+
+/* Global test suite name, it is printed on top of the test
+   report header.*/
+#define TEST_SUITE_NAME                     "Orchard Host Test Suite"
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+extern const testcase_t * const *test_suite[];
+
+/*===========================================================================*/
+/* Shared definitions.                                                       */
+/*===========================================================================*/
+
+#endif /* _TEST_ROOT_H_ */
+
+/** @} */
@@ -0,0 +1,301 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "flash.h"
+#include "storage.h"
+#include "sim-flash.h"
+
+/**
+ * @page test_sequence_001 ORFS storage
+ *
+ * File: @ref test_sequence_001.c
+ *
+ * <h2>Description</h2>
+ * This sequence tests the ORFS block storage in orchard/storage.c on top
+ * of the RAM-backed flash stand-in.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_001_001
+ * - @subpage test_001_002
+ * - @subpage test_001_003
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define LOOKUPS 1000
+#define SAVES   200
+
+/* Same shape as the badge settings in orchard/userconfig.h.*/
+typedef struct {
+  uint32_t signature;
+  uint32_t version;
+  uint32_t sex_initiations;
+  uint32_t sex_responses;
+  uint32_t cfg_autosex;
+} test_config_t;
+
+static void storage_setup(void) {
+
+  simFlashReset();
+  storageStart();
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_001_001 Store, patch and relocate
+ *
+ * <h2>Description</h2>
+ * Blocks are allocated, patched in place over blank words and patched
+ * over programmed words, which forces a copy into a new sector.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A block is fetched from an empty file system, it must read blank.
+ * - The block is patched over blank words, data must be in place.
+ * - The same words are patched again, the block must move to a new
+ *   sector and keep the untouched words.
+ * - Every block is written and the index is rebuilt from flash, the
+ *   newest copies must be found again.
+ * .
+ */
+
+static void test_001_001_execute(void) {
+  static uint32_t testDataA[4] = {0xfeedface, 0xdeadbeef, 0x340dbabe, 0x696955aa};
+  static uint32_t testDataB[4] = {0x12345678, 0xaaaa5555, 0x3333cccc, 0x66660000};
+  const uint32_t *data, *old;
+  uint32_t block, i;
+
+  test_set_step(1);
+  {
+    data = storageGetData(0);
+    test_assert(data != NULL, "no block");
+    for (i = 0; i < 4; i++)
+      test_assert(data[i] == 0xFFFFFFFF, "not blank");
+  }
+
+  test_set_step(2);
+  {
+    test_assert(storagePatchData(0, testDataA, 0, sizeof(testDataA)) == F_ERR_OK,
+                "patch failed");
+    data = storageGetData(0);
+    for (i = 0; i < 4; i++)
+      test_assert(data[i] == testDataA[i], "wrong data");
+  }
+
+  test_set_step(3);
+  {
+    old = data;
+    test_assert(storagePatchData(0, testDataB, 4, sizeof(testDataB)) == F_ERR_OK,
+                "patch failed");
+    data = storageGetData(0);
+    test_assert(data != old, "block not relocated");
+    test_assert(data[0] == testDataA[0], "leading word lost");
+    for (i = 0; i < 4; i++)
+      test_assert(data[i + 1] == testDataB[i], "wrong data");
+  }
+
+  test_set_step(4);
+  {
+    for (block = 0; block < BLOCK_TOTAL; block++) {
+      for (i = 0; i < 3; i++) {
+        uint32_t v = (block << 8) | i;
+        test_assert(storagePatchData(block, &v, 64, sizeof(v)) == F_ERR_OK,
+                    "patch failed");
+      }
+    }
+    storageStart();
+    for (block = 0; block < BLOCK_TOTAL; block++) {
+      data = storageGetData(block);
+      test_assert(data[16] == ((block << 8) | 2), "stale copy found");
+    }
+  }
+}
+
+static const testcase_t test_001_001 = {
+  "store, patch and relocate",
+  storage_setup,
+  NULL,
+  test_001_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_001_002 Lookup cost
+ *
+ * <h2>Description</h2>
+ * The flash sector headers read by storageGetData() are counted. A linear
+ * scan reads SECTOR_COUNT headers per lookup, the block index must serve
+ * lookups without touching flash.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - All the blocks are allocated and the index is rebuilt.
+ * - LOOKUPS lookups are performed and the header reads counted.
+ * .
+ */
+
+static void test_001_002_execute(void) {
+  const orfs_stats *stats = storageGetStats();
+  uint32_t block, i, reads;
+
+  test_set_step(1);
+  {
+    for (block = 0; block < BLOCK_TOTAL; block++)
+      (void)storageGetData(block);
+    storageStart();
+  }
+
+  test_set_step(2);
+  {
+    reads = stats->headerReads;
+    for (i = 0; i < LOOKUPS; i++)
+      (void)storageGetData(i % BLOCK_TOTAL);
+    reads = stats->headerReads - reads;
+
+    test_print("--- Linear scan: ");
+    test_printn(LOOKUPS * SECTOR_COUNT);
+    test_println(" header reads");
+    test_print("--- Indexed    : ");
+    test_printn(reads);
+    test_println(" header reads");
+    test_assert(reads == 0, "lookups read flash");
+  }
+}
+
+static const testcase_t test_001_002 = {
+  "lookup cost",
+  storage_setup,
+  NULL,
+  test_001_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_001_003 Settings save wear
+ *
+ * <h2>Description</h2>
+ * A settings record is saved SAVES times with a changing counter, the way
+ * the apps save the user configuration. Rewriting the block into a fresh
+ * sector costs one erase per save, appending records to the sector tail
+ * must cut that by an order of magnitude and spread the erases over the
+ * free sectors.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The settings are stored into a fresh block.
+ * - The settings are saved SAVES times, the erases are counted and the
+ *   stored data checked after every save.
+ * - The index is rebuilt from flash, the last save must be found.
+ * .
+ */
+
+static void test_001_003_execute(void) {
+  const orfs_stats *stats = storageGetStats();
+  static test_config_t config = {0x55434647, 1, 0, 0, 1};
+  const test_config_t *stored;
+  uint32_t i, erases, appends, worst;
+
+  test_set_step(1);
+  {
+    test_assert(storagePatchData(1, (uint32_t *)&config, 0, sizeof(config)) == F_ERR_OK,
+                "patch failed");
+  }
+
+  test_set_step(2);
+  {
+    erases = sim_flash_stats.erases;
+    appends = stats->appends;
+    for (i = 0; i < SAVES; i++) {
+      config.sex_initiations = i + 1;
+      test_assert(storagePatchData(1, (uint32_t *)&config, 0, sizeof(config)) == F_ERR_OK,
+                  "patch failed");
+      stored = storageGetData(1);
+      test_assert(stored->sex_initiations == i + 1, "wrong data");
+      test_assert(stored->cfg_autosex == 1, "untouched word lost");
+    }
+    erases = sim_flash_stats.erases - erases;
+    appends = stats->appends - appends;
+    worst = 0;
+    for (i = 0; i < SECTOR_COUNT; i++) {
+      if (sim_flash_stats.sectorErases[i] > worst)
+        worst = sim_flash_stats.sectorErases[i];
+    }
+
+    test_print("--- Record append: ");
+    test_printn(erases);
+    test_print(" erases, ");
+    test_printn(appends);
+    test_print(" appends, worst sector ");
+    test_printn(worst);
+    test_println(" erases");
+    test_assert(erases * 10 <= SAVES, "too many erases");
+    test_assert(worst * (SECTOR_COUNT - 1) <= erases + SECTOR_COUNT, "erases not spread");
+  }
+
+  test_set_step(3);
+  {
+    storageStart();
+    stored = storageGetData(1);
+    test_assert(stored->sex_initiations == SAVES, "stale copy found");
+  }
+}
+
+static const testcase_t test_001_003 = {
+  "settings save wear",
+  storage_setup,
+  NULL,
+  test_001_003_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   ORFS storage.
+ */
+const testcase_t * const test_sequence_001[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_001_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_001_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_001_003,
+#endif
+  NULL
+};
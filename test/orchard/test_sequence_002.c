@@ -0,0 +1,286 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "led.h"
+#include "genes.h"
+#include "lightgene.h"
+#include "orchard-math.h"
+#include "fixmath.h"
+#include <math.h>
+
+/**
+ * @page test_sequence_002 Lightgene effect
+ *
+ * File: @ref test_sequence_002.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the table driven lightgene renderer in
+ * orchard/lightgene.c against the per-pixel fixed point computation it
+ * replaces, and benchmarks both.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_002_001
+ * - @subpage test_002_002
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define PIXELS      16
+#define GENOMES     32
+#define FRAMES      4000
+#define TOLERANCE   3
+
+static uint8_t fb_ref[PIXELS * 3];
+static uint8_t fb_lg[PIXELS * 3];
+static genome test_genome;
+
+/* Deterministic genomes, including the rare variants.*/
+static void make_genome(genome *g, uint32_t seed) {
+  uint32_t x = seed * 2654435761U + 12345;
+  uint8_t *p = (uint8_t *)g;
+  unsigned i;
+
+  for (i = 0; i < 11; i++) {
+    x = x * 1103515245U + 12345;
+    p[i] = (uint8_t)(x >> 16);
+  }
+  if (seed & 1)
+    g->lin = 10;
+}
+
+/* The per-pixel computation done by do_lightgene() before the effect was
+   compiled into tables, with elapsed = curtime - reftime_lg. If exact is
+   set the value wave is computed in double precision instead.*/
+static void reference_render(const genome *g, uint8_t *fb, uint32_t count,
+                             uint32_t loop, uint32_t elapsed,
+                             uint8_t sat_offset, uint8_t shift, bool exact) {
+  HsvColor hsvC;
+  RgbColor rgbC;
+  uint32_t i, tau, indextime, hue_rate, hue_temp;
+  uint8_t hue_dir, overshift, overrideHSV;
+  fix16_t time, space, twopi, spacetime;
+
+  tau = (uint32_t)map(g->cd_rate, 0, 255, 700, 8000);
+  indextime = -elapsed;
+  for (i = 0; i < count; i++) {
+    overrideHSV = 0;
+    hue_rate = (uint32_t)g->hue_ratedir & 0xF;
+    hue_dir = (((g->hue_ratedir >> 4) & 0xF) > 10) ? 1 : 0;
+    if (!hue_dir)
+      hue_temp = ((128L / (count / 2)) * i + (loop * hue_rate)) - 0L;
+    else
+      hue_temp = ((128L / (count / 2)) * i - (loop * hue_rate)) - 0L;
+    hue_temp &= 0x1FF;
+    if (hue_temp <= 0xFF)
+      hsvC.h = (uint8_t)hue_temp;
+    else
+      hsvC.h = (uint8_t)(511 - hue_temp);
+    hsvC.h = map_16((int16_t)hsvC.h, 0, 255,
+                    (int16_t)g->hue_base, (int16_t)g->hue_bound);
+    hsvC.s = satadd_8(g->sat, sat_offset);
+
+    twopi = fix16_mul(fix16_from_int(2), fix16_pi);
+    space = fix16_mul(twopi, fix16_mul(fix16_from_int(g->cd_period),
+                                       fix16_div(fix16_from_int(i), fix16_from_int(count - 1))));
+    time = fix16_mul(twopi, fix16_div(fix16_from_int(indextime), fix16_from_int(tau)));
+    if (g->cd_dir > 128)
+      spacetime = fix16_add(space, time);
+    else
+      spacetime = fix16_sub(space, time);
+    hsvC.v = (uint8_t)fix16_to_int(fix16_mul(fix16_from_int(127),
+                                             fix16_add(fix16_from_int(1),
+                                                       fix16_cos(spacetime))));
+    if (exact) {
+      double phase = (double)g->cd_period * i / (count - 1) +
+                     (g->cd_dir > 128 ? -1.0 : 1.0) * elapsed / tau;
+      hsvC.v = (uint8_t)lround(127.0 * (1.0 + cos(2.0 * M_PI * phase)));
+    }
+    if (g->nonlin > 127)
+      hsvC.v = (uint8_t)(((uint16_t)hsvC.v * (uint16_t)hsvC.v) >> 8 & 0xFF);
+
+    if (g->lin < 90) {
+      if ((loop % count) == i)
+        overrideHSV = 1;
+    }
+
+    if (!overrideHSV) {
+      rgbC = HsvToRgb(hsvC);
+      fb[i * 3] = rgbC.g >> shift;
+      fb[i * 3 + 1] = rgbC.r >> shift;
+      fb[i * 3 + 2] = rgbC.b >> shift;
+    }
+    else {
+      overshift = shift - 2;
+      if (overshift > 4)
+        overshift = 4;
+      fb[i * 3] = 255 >> overshift;
+      fb[i * 3 + 1] = 255 >> overshift;
+      fb[i * 3 + 2] = 255 >> overshift;
+    }
+  }
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_002_001 Compiled effect accuracy
+ *
+ * <h2>Description</h2>
+ * GENOMES genomes are compiled and rendered over a whole hue cycle and
+ * a whole wave period, every channel must be within TOLERANCE of the
+ * per-pixel computation done with an exact cosine. The error of the
+ * per-pixel fix16 computation, whose fast cosine loses precision on the
+ * unreduced angles, is printed for comparison.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Every genome is compiled and its frames compared.
+ * .
+ */
+
+static void test_002_001_execute(void) {
+  uint32_t seed, loop, elapsed, tau, i;
+  int diff, worst = 0, worst_fix16 = 0;
+
+  test_set_step(1);
+  {
+    for (seed = 0; seed < GENOMES; seed++) {
+      make_genome(&test_genome, seed);
+      test_assert(lightgeneCompile(&test_genome, PIXELS), "compile failed");
+      tau = lightgeneTau();
+      for (loop = 0; loop < 512; loop += 7) {
+        elapsed = (loop * 37) % (tau + 1);
+        reference_render(&test_genome, fb_ref, PIXELS, loop, elapsed, loop & 0x3F, 2, true);
+        lightgeneRender(fb_lg, PIXELS, loop, elapsed, loop & 0x3F, 2);
+        for (i = 0; i < sizeof(fb_ref); i++) {
+          diff = abs((int)fb_ref[i] - (int)fb_lg[i]);
+          if (diff > worst)
+            worst = diff;
+        }
+        reference_render(&test_genome, fb_lg, PIXELS, loop, elapsed, loop & 0x3F, 2, false);
+        for (i = 0; i < sizeof(fb_ref); i++) {
+          diff = abs((int)fb_ref[i] - (int)fb_lg[i]);
+          if (diff > worst_fix16)
+            worst_fix16 = diff;
+        }
+      }
+    }
+    test_print("--- Worst channel error, per-pixel fix16   : ");
+    test_printn(worst_fix16);
+    test_println("");
+    test_print("--- Worst channel error, compiled tables: ");
+    test_printn(worst);
+    test_println("");
+    test_assert(worst <= TOLERANCE, "compiled effect differs");
+  }
+}
+
+static const testcase_t test_002_001 = {
+  "compiled effect accuracy",
+  NULL,
+  NULL,
+  test_002_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_002_002 Frame cost
+ *
+ * <h2>Description</h2>
+ * FRAMES frames of a PIXELS pixels strip are rendered with the per-pixel
+ * computation and with the compiled effect, the time per frame is
+ * printed. The compiled effect must be faster.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Frames are rendered with the per-pixel computation.
+ * - Frames are rendered with the compiled effect.
+ * .
+ */
+
+static rtcnt_t frames_ref, frames_lg;
+
+static void test_002_002_execute(void) {
+  uint32_t i;
+  rtcnt_t start;
+
+  make_genome(&test_genome, 7);
+  (void)lightgeneCompile(&test_genome, PIXELS);
+
+  test_set_step(1);
+  {
+    start = chSysGetRealtimeCounterX();
+    for (i = 0; i < FRAMES; i++)
+      reference_render(&test_genome, fb_ref, PIXELS, i & 0x1FF, i % 700, 0, 2, false);
+    frames_ref = chSysGetRealtimeCounterX() - start;
+  }
+
+  test_set_step(2);
+  {
+    start = chSysGetRealtimeCounterX();
+    for (i = 0; i < FRAMES; i++)
+      lightgeneRender(fb_lg, PIXELS, i & 0x1FF, i % 700, 0, 2);
+    frames_lg = chSysGetRealtimeCounterX() - start;
+
+    test_print("--- Per-pixel fix16: ");
+    test_printn((uint32_t)(frames_ref * 1000 / FRAMES));
+    test_println(" ns/frame");
+    test_print("--- Compiled tables: ");
+    test_printn((uint32_t)(frames_lg * 1000 / FRAMES));
+    test_println(" ns/frame");
+    test_assert(frames_lg < frames_ref, "compiled effect is not faster");
+  }
+}
+
+static const testcase_t test_002_002 = {
+  "frame cost",
+  NULL,
+  NULL,
+  test_002_002_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Lightgene effect.
+ */
+const testcase_t * const test_sequence_002[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_002_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_002_002,
+#endif
+  NULL
+};
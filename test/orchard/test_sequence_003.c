@@ -0,0 +1,211 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "orchard-math.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_003 LED compositor
+ *
+ * File: @ref test_sequence_003.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the word at a time saturating add used by the LED
+ * compositor in orchard/led.c against the per-byte satadd_8(), and
+ * benchmarks both on a strip longer than the old 85 pixel limit.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_003_001
+ * - @subpage test_003_002
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define PIXELS      300
+#define FRAMES      4000
+
+static uint32_t fb_a[PIXELS * 3 / 4 + 1];
+static uint32_t fb_b[PIXELS * 3 / 4 + 1];
+static uint32_t fb_out[PIXELS * 3 / 4 + 1];
+static uint8_t fb_ref[PIXELS * 3 + 4];
+
+static void fill(uint8_t *a, uint8_t *b, uint32_t len, uint32_t seed) {
+  uint32_t x = seed * 2654435761U + 12345;
+  uint32_t i;
+
+  for (i = 0; i < len; i++) {
+    x = x * 1103515245U + 12345;
+    a[i] = (uint8_t)(x >> 16);
+    b[i] = (uint8_t)(x >> 24);
+  }
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_003_001 Saturating add
+ *
+ * <h2>Description</h2>
+ * Every pair of byte values is added, then random buffers of every
+ * length up to 16 and every alignment, the result must match satadd_8()
+ * byte for byte and nothing past the end may be written.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - All the 65536 byte pairs are added on aligned buffers.
+ * - Random buffers are added at every length and alignment.
+ * .
+ */
+
+static void test_003_001_execute(void) {
+  uint8_t *a = (uint8_t *)fb_a;
+  uint8_t *b = (uint8_t *)fb_b;
+  uint8_t *out = (uint8_t *)fb_out;
+  uint32_t x, y, i, len, align;
+
+  test_set_step(1);
+  {
+    for (x = 0; x < 256; x++) {
+      for (y = 0; y < 256; y++) {
+        a[y] = (uint8_t)x;
+        b[y] = (uint8_t)y;
+      }
+      satadd_8_buf(out, a, b, 256);
+      for (y = 0; y < 256; y++)
+        test_assert(out[y] == satadd_8((uint8_t)x, (uint8_t)y), "wrong sum");
+    }
+  }
+
+  test_set_step(2);
+  {
+    for (len = 0; len <= 16; len++) {
+      for (align = 0; align < 4; align++) {
+        fill(a, b, sizeof(fb_a), len * 4 + align);
+        for (i = 0; i < len + 4; i++)
+          out[i] = 0x5A;
+        satadd_8_buf(out + align, a + align, b + (align & 1), len);
+        for (i = 0; i < len; i++)
+          test_assert(out[align + i] == satadd_8(a[align + i], b[(align & 1) + i]),
+                      "wrong sum");
+        test_assert(out[align + len] == 0x5A, "overrun");
+      }
+    }
+  }
+}
+
+static const testcase_t test_003_001 = {
+  "saturating add",
+  NULL,
+  NULL,
+  test_003_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_003_002 Blend cost
+ *
+ * <h2>Description</h2>
+ * FRAMES frames of a PIXELS pixels strip are blended one byte at a time
+ * and a word at a time, the time per frame is printed. The word at a
+ * time blend must be faster.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Frames are blended with satadd_8().
+ * - Frames are blended with satadd_8_buf().
+ * .
+ */
+
+static void test_003_002_execute(void) {
+  uint8_t *a = (uint8_t *)fb_a;
+  uint8_t *b = (uint8_t *)fb_b;
+  uint8_t *out = (uint8_t *)fb_out;
+  rtcnt_t start, bytes, words;
+  uint32_t n, i;
+
+  fill(a, b, PIXELS * 3, 3);
+
+  test_set_step(1);
+  {
+    start = chSysGetRealtimeCounterX();
+    for (n = 0; n < FRAMES; n++) {
+      for (i = 0; i < PIXELS * 3; i++)
+        fb_ref[i] = satadd_8(a[i], b[i]);
+      a[n % (PIXELS * 3)] ^= fb_ref[0];
+    }
+    bytes = chSysGetRealtimeCounterX() - start;
+  }
+
+  test_set_step(2);
+  {
+    fill(a, b, PIXELS * 3, 3);
+    start = chSysGetRealtimeCounterX();
+    for (n = 0; n < FRAMES; n++) {
+      satadd_8_buf(out, a, b, PIXELS * 3);
+      a[n % (PIXELS * 3)] ^= out[0];
+    }
+    words = chSysGetRealtimeCounterX() - start;
+
+    test_assert(memcmp(out, fb_ref, PIXELS * 3) == 0, "results differ");
+    test_print("--- Byte at a time: ");
+    test_printn((uint32_t)(bytes * 1000 / FRAMES));
+    test_println(" ns/frame");
+    test_print("--- Word at a time: ");
+    test_printn((uint32_t)(words * 1000 / FRAMES));
+    test_println(" ns/frame");
+    test_assert(words < bytes, "word at a time blend is not faster");
+  }
+}
+
+static const testcase_t test_003_002 = {
+  "blend cost",
+  NULL,
+  NULL,
+  test_003_002_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   LED compositor.
+ */
+const testcase_t * const test_sequence_003[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_003_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_003_002,
+#endif
+  NULL
+};
@@ -0,0 +1,229 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "chprintf.h"
+#include "memstreams.h"
+#include "orchard-effects.h"
+#include "fxprof.h"
+#include "genes.h"
+#include "lightgene.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_004 Effect profiler
+ *
+ * File: @ref test_sequence_004.c
+ *
+ * <h2>Description</h2>
+ * This sequence runs a table of effects through the frame-time profiler
+ * in orchard/fxprof.c, prints the ranked cost report the fxprof shell
+ * command shows, and checks the frame budget enforcement.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_004_001
+ * - @subpage test_004_002
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define PIXELS      300
+#define FRAMES      200
+#define SLOW_US     300
+#define BUDGET_US   100
+
+static uint8_t fb[PIXELS * 3];
+static char report[1024];
+
+/* Busy waits, standing in for an effect too slow for the frame rate.*/
+static void fx_slow(struct effects_config *config) {
+  uint32_t start = fxprofNow();
+
+  (void)config;
+  while (fxprofNow() - start < US2FXPROF(SLOW_US))
+    ;
+}
+
+static void fx_lightgene(struct effects_config *config) {
+  lightgeneRender(fb, config->count, config->loop, (config->loop * 35) % lightgeneTau(), 0, 2);
+}
+
+static void fx_clear(struct effects_config *config) {
+  memset(fb, 0, config->count * 3);
+}
+
+/* The orchard_effects() registry is a linker section of the firmware, the
+   host builds the same NULL-terminated table by hand.*/
+static const OrchardEffects effects[] = {
+  {"Clear", fx_clear},
+  {"Lightgene", fx_lightgene},
+  {"Slow", fx_slow},
+  {NULL, NULL}
+};
+
+static void run_frames(uint32_t index, uint32_t frames) {
+  effects_config config;
+
+  config.hwconfig = NULL;
+  config.count = PIXELS;
+  for (config.loop = 0; config.loop < frames; config.loop++)
+    (void)fxprofRun(effects, index, &config);
+}
+
+static void print_report(void) {
+  MemoryStream ms;
+
+  msObjectInit(&ms, (uint8_t *)report, sizeof(report) - 1, 0);
+  fxprofReport((BaseSequentialStream *)&ms, effects);
+  report[ms.eos] = '\0';
+  test_print(report);
+}
+
+static void test_004_setup(void) {
+  genome g;
+
+  memset(&g, 0x5A, sizeof(g));
+  (void)lightgeneCompile(&g, PIXELS);
+  fxprofReset();
+  fxprofSetBudget(0);
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_004_001 Ranked cost report
+ *
+ * <h2>Description</h2>
+ * Every effect of the table is run for FRAMES frames of a PIXELS pixels
+ * strip without a budget. Every frame must be timed, and the report must
+ * rank the effects by their average cost.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Every effect is run for FRAMES frames.
+ * - The report is printed and the ranking checked.
+ * .
+ */
+
+static void test_004_001_execute(void) {
+  const fxprof_entry *e;
+  uint32_t i;
+
+  test_set_step(1);
+  {
+    for (i = 0; effects[i].name != NULL; i++) {
+      run_frames(i, FRAMES);
+      e = fxprofGet(i);
+      test_assert(e->calls == FRAMES, "frames not timed");
+      test_assert(e->skipped == 0, "frames held without a budget");
+      test_assert(e->min <= e->max, "min above max");
+    }
+  }
+
+  test_set_step(2);
+  {
+    print_report();
+    test_assert(strstr(report, "Slow") < strstr(report, "Lightgene"), "wrong ranking");
+    test_assert(strstr(report, "Lightgene") < strstr(report, "Clear"), "wrong ranking");
+  }
+}
+
+static const testcase_t test_004_001 = {
+  "ranked cost report",
+  test_004_setup,
+  NULL,
+  test_004_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_004_002 Frame budget
+ *
+ * <h2>Description</h2>
+ * With a BUDGET_US budget an effect taking SLOW_US per frame must be
+ * decimated down to one frame in FXPROF_MAX_DECIMATE, while effects within
+ * the budget keep running on every frame.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The slow effect is run with the budget set.
+ * - The fast effect is run with the budget set.
+ * .
+ */
+
+static void test_004_002_execute(void) {
+  const fxprof_entry *e;
+
+  fxprofSetBudget(US2FXPROF(BUDGET_US));
+
+  test_set_step(1);
+  {
+    run_frames(2, FRAMES);
+    e = fxprofGet(2);
+    test_assert(e->decimate == FXPROF_MAX_DECIMATE, "not decimated");
+    test_assert(e->calls + e->skipped == FRAMES, "frames lost");
+    test_assert(e->calls <= FRAMES / FXPROF_MAX_DECIMATE + 3, "not held");
+    test_assert(e->overruns == e->calls, "overruns not counted");
+  }
+
+  test_set_step(2);
+  {
+    run_frames(0, FRAMES);
+    e = fxprofGet(0);
+    test_assert(e->calls == FRAMES, "effect in budget held");
+    test_assert(e->decimate == 1, "effect in budget decimated");
+    print_report();
+  }
+}
+
+static const testcase_t test_004_002 = {
+  "frame budget",
+  test_004_setup,
+  NULL,
+  test_004_002_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Effect profiler.
+ */
+const testcase_t * const test_sequence_004[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_004_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_004_002,
+#endif
+  NULL
+};
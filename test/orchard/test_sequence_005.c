@@ -0,0 +1,258 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "radio.h"
+#include "radio-queue.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_005 Radio receive queue
+ *
+ * File: @ref test_sequence_005.c
+ *
+ * <h2>Description</h2>
+ * This sequence stresses the radio receive pool and dispatch queue in
+ * orchard/radio-queue.c. An injector thread stands in for the radio RX
+ * thread and queues packets at a configurable rate, a dispatcher thread
+ * stands in for the event thread and runs handlers that block for a
+ * system tick per packet.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_005_001
+ * - @subpage test_005_002
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+/* Injection rates in packets per second, handlers take a tick per packet.*/
+#if !defined(RADIO_STRESS_RATE_LOW)
+#define RADIO_STRESS_RATE_LOW       (CH_CFG_ST_FREQUENCY / 4)
+#endif
+#if !defined(RADIO_STRESS_RATE_HIGH)
+#define RADIO_STRESS_RATE_HIGH      (CH_CFG_ST_FREQUENCY * 4)
+#endif
+#define RADIO_STRESS_MS             200
+
+#define PROT_TEST                   radio_prot_ping
+#define PROT_UNKNOWN                (RADIO_PROT_MAX + 1)
+
+static radio_queue rxq;
+static binary_semaphore_t rx_ready;
+static thread_t *dispatcher;
+static uint32_t injected;
+static uint32_t handled;
+static uint32_t last_seq;
+static bool in_order;
+
+static void test_handler(uint8_t prot, uint8_t src, uint8_t dst,
+                         uint8_t length, const void *data) {
+  uint32_t seq;
+
+  (void)prot;
+  (void)src;
+  (void)dst;
+
+  memcpy(&seq, data, sizeof(seq));
+  if ((length != sizeof(seq)) || (seq <= last_seq))
+    in_order = false;
+  last_seq = seq;
+  handled++;
+
+  /* The handler redraws the screen or talks over I2C.*/
+  chThdSleep(1);
+}
+
+static THD_WORKING_AREA(waDispatcher, 1024);
+static THD_FUNCTION(dispatcher_thread, p) {
+
+  (void)p;
+  while (!chThdShouldTerminateX()) {
+    if (chBSemWaitTimeout(&rx_ready, MS2ST(10)) == MSG_OK)
+      (void)radioQueueDispatch(&rxq);
+  }
+  (void)radioQueueDispatch(&rxq);
+}
+
+/* Receives packets at rate packets per second for ms milliseconds,
+   one in eight of them for a protocol without a handler.*/
+static void inject(uint32_t rate, uint32_t ms) {
+  radio_rx_packet *rx;
+  systime_t start = chVTGetSystemTime();
+  uint32_t due, seq;
+
+  while (chVTTimeElapsedSinceX(start) < MS2ST(ms)) {
+    due = (uint32_t)(((uint64_t)chVTTimeElapsedSinceX(start) + 1) * rate / CH_CFG_ST_FREQUENCY);
+    while (injected < due) {
+      rx = radioQueueAlloc(&rxq);
+      seq = ++injected;
+      if (rx != NULL) {
+        rx->pkt.length = sizeof(RadioPacket) + sizeof(seq);
+        rx->pkt.src = 2;
+        rx->pkt.dst = RADIO_BROADCAST_ADDRESS;
+        rx->pkt.prot = (seq & 7) ? PROT_TEST : PROT_UNKNOWN;
+        memcpy(rx->pkt.payload, &seq, sizeof(seq));
+        radioQueuePost(&rxq, rx);
+        chBSemSignal(&rx_ready);
+      }
+    }
+    chThdSleep(1);
+  }
+}
+
+static void stress_setup(void) {
+
+  radioQueueInit(&rxq);
+  radioQueueSetHandler(&rxq, PROT_TEST, test_handler);
+  chBSemObjectInit(&rx_ready, true);
+  injected = 0;
+  handled = 0;
+  last_seq = 0;
+  in_order = true;
+  dispatcher = chThdCreateStatic(waDispatcher, sizeof(waDispatcher),
+                                 chThdGetPriorityX() - 1, dispatcher_thread, NULL);
+}
+
+static void stress_teardown(void) {
+
+  chThdTerminate(dispatcher);
+  chThdWait(dispatcher);
+}
+
+static void stress_run(uint32_t rate) {
+  const radio_rx_stats *stats = &rxq.stats;
+
+  inject(rate, RADIO_STRESS_MS);
+  /* Lets the dispatcher drain the queue.*/
+  chThdSleepMilliseconds(RADIO_RX_POOL_SIZE * 2 + 10);
+
+  test_print("--- Rate ");
+  test_printn(rate);
+  test_print(" pkt/s: ");
+  test_printn(injected);
+  test_print(" injected, ");
+  test_printn(stats->dropped);
+  test_print(" dropped, ");
+  test_printn(stats->dispatched);
+  test_print(" dispatched, ");
+  test_printn(stats->unhandled);
+  test_print(" unhandled, ");
+  test_printn(stats->high_water);
+  test_println(" most in use");
+
+  test_assert(stats->received + stats->dropped == injected, "packets lost");
+  test_assert(stats->dispatched + stats->unhandled == stats->received, "packets not dispatched");
+  test_assert(handled == stats->dispatched, "wrong handler called");
+  test_assert(in_order, "packets out of order");
+  test_assert(stats->high_water <= RADIO_RX_POOL_SIZE, "pool overcommitted");
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_005_001 Sustainable rate
+ *
+ * <h2>Description</h2>
+ * Packets are injected at RADIO_STRESS_RATE_LOW, below what the handlers
+ * can keep up with. No packet may be dropped, and every packet must be
+ * dispatched once, in order, to its handler or counted as unhandled.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Packets are injected for RADIO_STRESS_MS and the counters checked.
+ * .
+ */
+
+static void test_005_001_execute(void) {
+
+  test_set_step(1);
+  {
+    stress_run(RADIO_STRESS_RATE_LOW);
+    test_assert(rxq.stats.dropped == 0, "packets dropped");
+  }
+}
+
+static const testcase_t test_005_001 = {
+  "sustainable rate",
+  stress_setup,
+  stress_teardown,
+  test_005_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_005_002 Ping storm
+ *
+ * <h2>Description</h2>
+ * Packets are injected at RADIO_STRESS_RATE_HIGH, well above what the
+ * handlers can keep up with. The pool must run dry and the excess be
+ * counted as drops, while every packet that was queued is still
+ * dispatched once and in order.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Packets are injected for RADIO_STRESS_MS and the counters checked.
+ * .
+ */
+
+static void test_005_002_execute(void) {
+
+  test_set_step(1);
+  {
+    stress_run(RADIO_STRESS_RATE_HIGH);
+    test_assert(rxq.stats.dropped > 0, "storm not dropped");
+    test_assert(rxq.stats.high_water == RADIO_RX_POOL_SIZE, "pool not used");
+  }
+}
+
+static const testcase_t test_005_002 = {
+  "ping storm",
+  stress_setup,
+  stress_teardown,
+  test_005_002_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Radio receive queue.
+ */
+const testcase_t * const test_sequence_005[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_005_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_005_002,
+#endif
+  NULL
+};
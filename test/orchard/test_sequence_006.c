@@ -0,0 +1,254 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "radio.h"
+#include "radio-queue.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_006 Radio transmit queue
+ *
+ * File: @ref test_sequence_006.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the radio transmit queue in orchard/radio-queue.c.
+ * A thread stands in for the radio thread and spends AIRTIME_TICKS on
+ * every packet it takes from the queue.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_006_001
+ * - @subpage test_006_002
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define AIRTIME_TICKS   2
+#define PACKETS         (RADIO_TX_QUEUE_SIZE * 4)
+
+static radio_tx_queue txq;
+static thread_t *radio_tp;
+static uint32_t completed[PACKETS];
+static uint32_t ncompleted;
+static msg_t last_result;
+
+static void tx_done(void *arg, msg_t result) {
+
+  if (ncompleted < PACKETS)
+    completed[ncompleted] = (uint32_t)(uintptr_t)arg;
+  ncompleted++;
+  last_result = result;
+}
+
+static THD_WORKING_AREA(waRadio, 1024);
+static THD_FUNCTION(radio_thread, p) {
+  radio_tx_packet *tx;
+
+  (void)p;
+  while (!chThdShouldTerminateX()) {
+    (void)chEvtWaitAnyTimeout(ALL_EVENTS, MS2ST(10));
+    while ((tx = radioTxQueueGet(&txq)) != NULL) {
+      chThdSleep(AIRTIME_TICKS);
+      radioTxQueueDone(&txq, tx, MSG_OK);
+    }
+  }
+}
+
+static void txq_setup(void) {
+
+  radioTxQueueInit(&txq);
+  memset(completed, 0, sizeof(completed));
+  ncompleted = 0;
+  last_result = MSG_RESET;
+  radio_tp = NULL;
+}
+
+static void txq_teardown(void) {
+
+  if (radio_tp != NULL) {
+    chThdTerminate(radio_tp);
+    chThdWait(radio_tp);
+  }
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_006_001 Queued sends
+ *
+ * <h2>Description</h2>
+ * PACKETS packets are sent while the radio is busy with the previous
+ * ones. Puts must return without waiting for the air while there is room,
+ * and every packet must complete once, in order, with its latency
+ * accounted.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A full queue worth of packets is put while the radio is busy.
+ * - The remaining packets are put, waiting for room.
+ * - Completions and statistics are checked.
+ * .
+ */
+
+static void test_006_001_execute(void) {
+  uint32_t i, payload = 0x5A5A5A5A;
+  systime_t start, blocked;
+
+  radio_tp = chThdCreateStatic(waRadio, sizeof(waRadio),
+                               chThdGetPriorityX() + 1, radio_thread, NULL);
+
+  test_set_step(1);
+  {
+    start = chVTGetSystemTime();
+    for (i = 0; i < RADIO_TX_QUEUE_SIZE; i++) {
+      test_assert(radioTxQueuePut(&txq, 1, RADIO_BROADCAST_ADDRESS, radio_prot_ping,
+                                  sizeof(payload), &payload, tx_done,
+                                  (void *)(uintptr_t)(i + 1), TIME_INFINITE) == MSG_OK,
+                  "put failed");
+      chEvtSignal(radio_tp, EVENT_MASK(0));
+    }
+    blocked = chVTTimeElapsedSinceX(start);
+    test_assert(blocked < AIRTIME_TICKS * RADIO_TX_QUEUE_SIZE / 2, "put waited for the air");
+  }
+
+  test_set_step(2);
+  {
+    for (; i < PACKETS; i++) {
+      test_assert(radioTxQueuePut(&txq, 1, RADIO_BROADCAST_ADDRESS, radio_prot_ping,
+                                  sizeof(payload), &payload, tx_done,
+                                  (void *)(uintptr_t)(i + 1), TIME_INFINITE) == MSG_OK,
+                  "put failed");
+      chEvtSignal(radio_tp, EVENT_MASK(0));
+    }
+    chThdSleep(AIRTIME_TICKS * (RADIO_TX_QUEUE_SIZE + 2));
+  }
+
+  test_set_step(3);
+  {
+    test_print("--- Put time ");
+    test_printn(ST2MS(blocked));
+    test_print(" ms for ");
+    test_printn(RADIO_TX_QUEUE_SIZE);
+    test_print(" packets, latency ");
+    test_printn(ST2MS(txq.stats.latency_min));
+    test_print("/");
+    test_printn(ST2MS(txq.stats.latency_total / txq.stats.sent));
+    test_print("/");
+    test_printn(ST2MS(txq.stats.latency_max));
+    test_println(" ms min/avg/max");
+
+    test_assert(ncompleted == PACKETS, "packets not completed");
+    for (i = 0; i < PACKETS; i++)
+      test_assert(completed[i] == i + 1, "packets out of order");
+    test_assert(last_result == MSG_OK, "wrong result");
+    test_assert(txq.stats.queued == PACKETS, "wrong queued count");
+    test_assert(txq.stats.sent == PACKETS, "wrong sent count");
+    test_assert(txq.stats.high_water == RADIO_TX_QUEUE_SIZE, "queue depth not tracked");
+    test_assert(txq.stats.latency_min >= AIRTIME_TICKS, "latency too short");
+    test_assert(txq.stats.latency_max >= AIRTIME_TICKS * RADIO_TX_QUEUE_SIZE,
+                "latency too short");
+  }
+}
+
+static const testcase_t test_006_001 = {
+  "queued sends",
+  txq_setup,
+  txq_teardown,
+  test_006_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_006_002 Full queue
+ *
+ * <h2>Description</h2>
+ * With the radio stalled, a put on a full queue must time out and be
+ * counted, and a packet given up on by the radio must complete with
+ * MSG_TIMEOUT and free its buffer.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The queue is filled and one more packet put.
+ * - A packet is failed and the freed buffer reused.
+ * .
+ */
+
+static void test_006_002_execute(void) {
+  radio_tx_packet *tx;
+  uint32_t i;
+  uint8_t payload = 0;
+
+  test_set_step(1);
+  {
+    for (i = 0; i < RADIO_TX_QUEUE_SIZE; i++)
+      test_assert(radioTxQueuePut(&txq, 1, 2, radio_prot_paging, sizeof(payload), &payload,
+                                  tx_done, NULL, TIME_IMMEDIATE) == MSG_OK, "put failed");
+    test_assert(radioTxQueuePut(&txq, 1, 2, radio_prot_paging, sizeof(payload), &payload,
+                                tx_done, NULL, MS2ST(2)) == MSG_TIMEOUT, "put on a full queue");
+    test_assert(txq.stats.full == 1, "full queue not counted");
+  }
+
+  test_set_step(2);
+  {
+    tx = radioTxQueueGet(&txq);
+    test_assert(tx != NULL, "queue empty");
+    test_assert(tx->pkt.length == sizeof(RadioPacket) + sizeof(payload), "wrong length");
+    radioTxQueueDone(&txq, tx, MSG_TIMEOUT);
+    test_assert(last_result == MSG_TIMEOUT, "wrong result");
+    test_assert(txq.stats.failed == 1, "failure not counted");
+    test_assert(radioTxQueuePut(&txq, 1, 2, radio_prot_paging, sizeof(payload), &payload,
+                                tx_done, NULL, TIME_IMMEDIATE) == MSG_OK, "buffer not freed");
+  }
+}
+
+static const testcase_t test_006_002 = {
+  "full queue",
+  txq_setup,
+  txq_teardown,
+  test_006_002_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Radio transmit queue.
+ */
+const testcase_t * const test_sequence_006[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_006_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_006_002,
+#endif
+  NULL
+};
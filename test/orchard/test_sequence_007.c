@@ -0,0 +1,461 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "friends.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @page test_sequence_007 Friends table
+ *
+ * File: @ref test_sequence_007.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the hashed friends table of orchard/friends.c, and
+ * benchmarks it against the previous heap allocated list with a linear
+ * lookup and a full qsort(), with hundreds of badges pinging around.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_007_001
+ * - @subpage test_007_002
+ * - @subpage test_007_003
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define BADGES          400
+#define PINGS           20000
+#define PINGS_PER_SORT  16    // the UI sorts between redraws
+#define PINGS_PER_CLEANUP (BADGES / 2)
+
+static char names[BADGES][GENE_NAMELENGTH];
+static uint32_t seed;
+
+static uint32_t next_rand(void) {
+  seed = seed * 1103515245U + 12345;
+  return seed >> 8;
+}
+
+static void make_names(void) {
+  uint32_t i, n;
+  char *p;
+
+  for (i = 0; i < BADGES; i++) {
+    p = names[i];
+    memcpy(p, "badge ", 6);
+    p += 6;
+    n = i * 7919;
+    do {
+      *p++ = (char)('a' + n % 26);
+      n /= 26;
+    } while (n != 0);
+    *p = '\0';
+  }
+}
+
+static int ref_key_comp(const char *a, const char *b) {
+  if ((a[0] != b[0]) &&
+      ((a[0] < (FRIENDS_MAX_CREDIT - FRIENDS_SORT_HYSTERESIS)) ||
+       (b[0] < (FRIENDS_MAX_CREDIT - FRIENDS_SORT_HYSTERESIS))))
+    return a[0] > b[0] ? -1 : 1;
+  return strncmp(&a[1], &b[1], GENE_NAMELENGTH + 1);
+}
+
+/* The friends list as it was before the slab: heap allocated records, a
+   linear lookup and a qsort() of the whole pointer array.*/
+static char *ref_friends[MAX_FRIENDS];
+static mutex_t ref_mutex;
+
+static void ref_init(void) {
+  memset(ref_friends, 0, sizeof(ref_friends));
+  osalMutexObjectInit(&ref_mutex);
+}
+
+static char *ref_lookup(const char *name) {
+  int i;
+
+  osalMutexLock(&ref_mutex);
+  for (i = 0; i < MAX_FRIENDS; i++) {
+    if ((ref_friends[i] != NULL) &&
+        (strncmp(&ref_friends[i][1], name, GENE_NAMELENGTH) == 0)) {
+      osalMutexUnlock(&ref_mutex);
+      return ref_friends[i];
+    }
+  }
+  osalMutexUnlock(&ref_mutex);
+  return NULL;
+}
+
+static char *ref_add(const char *name) {
+  char *record;
+  int i;
+
+  record = ref_lookup(name);
+  if (record != NULL)
+    return record;
+
+  osalMutexLock(&ref_mutex);
+  for (i = 0; i < MAX_FRIENDS; i++) {
+    if (ref_friends[i] == NULL) {
+      ref_friends[i] = chHeapAlloc(NULL, GENE_NAMELENGTH + 2);
+      ref_friends[i][0] = FRIENDS_INIT_CREDIT;
+      strncpy(&ref_friends[i][1], name, GENE_NAMELENGTH);
+      osalMutexUnlock(&ref_mutex);
+      return ref_friends[i];
+    }
+  }
+  osalMutexUnlock(&ref_mutex);
+  return NULL;
+}
+
+static void ref_seen(const char *name) {
+  char *record;
+
+  record = ref_lookup(name);
+  if (record == NULL)
+    record = ref_add(name);
+  if ((record != NULL) && (record[0] < FRIENDS_MAX_CREDIT))
+    record[0]++;
+}
+
+static void ref_cleanup(void) {
+  int i;
+
+  osalMutexLock(&ref_mutex);
+  for (i = 0; i < MAX_FRIENDS; i++) {
+    if (ref_friends[i] == NULL)
+      continue;
+    ref_friends[i][0]--;
+    if (ref_friends[i][0] == 0) {
+      chHeapFree(ref_friends[i]);
+      ref_friends[i] = NULL;
+    }
+  }
+  osalMutexUnlock(&ref_mutex);
+}
+
+static int ref_comp(const void *a, const void *b) {
+  const char *mya = *(const char * const *)a;
+  const char *myb = *(const char * const *)b;
+
+  if ((mya == NULL) && (myb == NULL))
+    return 0;
+  if (mya == NULL)
+    return 1;
+  if (myb == NULL)
+    return -1;
+  return ref_key_comp(mya, myb);
+}
+
+static void ref_sort(void) {
+  osalMutexLock(&ref_mutex);
+  qsort(ref_friends, MAX_FRIENDS, sizeof(char *), ref_comp);
+  osalMutexUnlock(&ref_mutex);
+}
+
+static void ref_free(void) {
+  int i;
+
+  for (i = 0; i < MAX_FRIENDS; i++) {
+    if (ref_friends[i] != NULL)
+      chHeapFree(ref_friends[i]);
+    ref_friends[i] = NULL;
+  }
+}
+
+/* Every record in the display order can be looked up, and nothing else.*/
+static bool table_consistent(void) {
+  const char **friends = friendsGet();
+  uint32_t i;
+
+  for (i = 0; i < MAX_FRIENDS; i++) {
+    if ((i < friendCount()) != (friends[i] != NULL))
+      return false;
+    if ((friends[i] != NULL) && (friend_lookup(&friends[i][1]) != friends[i]))
+      return false;
+  }
+  return true;
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_007_001 Add, lookup and expire
+ *
+ * <h2>Description</h2>
+ * The table is filled up to MAX_FRIENDS, one more friend must be refused.
+ * Friends are then pinged and cleaned up at random, every friend must stay
+ * reachable through the hash while others are deleted around it.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The table is filled, looked up and overfilled.
+ * - Everybody expires after FRIENDS_INIT_CREDIT cleanups.
+ * - Random pings and cleanups, checking the table after each.
+ * .
+ */
+
+static void test_007_001_setup(void) {
+  friendsInit();
+  make_names();
+  seed = 7;
+}
+
+static void test_007_001_execute(void) {
+  uint32_t i, n;
+  char *record;
+
+  test_set_step(1);
+  {
+    for (i = 0; i < MAX_FRIENDS; i++) {
+      record = friend_add(names[i]);
+      test_assert(record != NULL, "add failed");
+      test_assert(record[0] == FRIENDS_INIT_CREDIT, "wrong initial credit");
+      test_assert(friend_add(names[i]) == record, "added twice");
+    }
+    test_assert(friendCount() == MAX_FRIENDS, "wrong count");
+    test_assert(friend_add(names[MAX_FRIENDS]) == NULL, "overfilled");
+    test_assert(friend_lookup(names[MAX_FRIENDS]) == NULL, "found a stranger");
+    for (i = 0; i < MAX_FRIENDS; i++)
+      test_assert(strcmp(&friend_lookup(names[i])[1], names[i]) == 0, "wrong record");
+    test_assert(table_consistent(), "inconsistent table");
+  }
+
+  test_set_step(2);
+  {
+    for (i = 0; i < FRIENDS_INIT_CREDIT; i++) {
+      test_assert(friendCount() == MAX_FRIENDS, "expired early");
+      friend_cleanup();
+    }
+    test_assert(friendCount() == 0, "not expired");
+    for (i = 0; i < MAX_FRIENDS; i++)
+      test_assert(friend_lookup(names[i]) == NULL, "expired friend found");
+  }
+
+  test_set_step(3);
+  {
+    for (n = 0; n < 5000; n++) {
+      if ((n % 32) == 31)
+        friend_cleanup();
+      else
+        friend_seen(names[next_rand() % (MAX_FRIENDS * 2)]);
+      test_assert(table_consistent(), "inconsistent table");
+    }
+  }
+}
+
+static const testcase_t test_007_001 = {
+  "add, lookup and expire",
+  test_007_001_setup,
+  NULL,
+  test_007_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_007_002 Display order
+ *
+ * <h2>Description</h2>
+ * The same pings and cleanups are applied to the table and to the old
+ * list, after every sort both must hold the same friends with the same
+ * credits, in the same order.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Random pings, cleanups and sorts, comparing after each sort.
+ * .
+ */
+
+static void test_007_002_setup(void) {
+  friendsInit();
+  ref_init();
+  make_names();
+  seed = 11;
+}
+
+static void test_007_002_teardown(void) {
+  ref_free();
+}
+
+static void test_007_002_execute(void) {
+  const char **friends;
+  const char *name;
+  uint32_t n, i;
+
+  test_set_step(1);
+  {
+    for (n = 1; n <= PINGS / 4; n++) {
+      name = names[next_rand() % (MAX_FRIENDS + MAX_FRIENDS / 2)];
+      friend_seen(name);
+      ref_seen(name);
+      if ((n % PINGS_PER_CLEANUP) == 0) {
+        friend_cleanup();
+        ref_cleanup();
+      }
+      if ((n % PINGS_PER_SORT) == 0) {
+        friendsSort();
+        ref_sort();
+        friends = friendsGet();
+        for (i = 0; i < MAX_FRIENDS; i++) {
+          test_assert((friends[i] == NULL) == (ref_friends[i] == NULL),
+                      "different friends");
+          if (friends[i] == NULL)
+            break;
+          test_assert(memcmp(friends[i], ref_friends[i],
+                             strlen(ref_friends[i] + 1) + 2) == 0,
+                      "different order");
+        }
+      }
+    }
+  }
+}
+
+static const testcase_t test_007_002 = {
+  "display order",
+  test_007_002_setup,
+  test_007_002_teardown,
+  test_007_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_007_003 Crowd benchmark
+ *
+ * <h2>Description</h2>
+ * BADGES badges ping at random, so that the table is full most of the time
+ * and most pings come from strangers that don't fit. The table is sorted
+ * every PINGS_PER_SORT pings and cleaned up every PINGS_PER_CLEANUP pings.
+ * The time per ping is printed for the old list and the table, the table
+ * must be faster and end up with the same friends in the same order.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The old list is run.
+ * - The table is run.
+ * .
+ */
+
+static void test_007_003_setup(void) {
+  friendsInit();
+  ref_init();
+  make_names();
+}
+
+static void test_007_003_teardown(void) {
+  ref_free();
+}
+
+static void test_007_003_execute(void) {
+  const char **friends;
+  rtcnt_t start, list, table;
+  uint32_t n, i;
+
+  test_set_step(1);
+  {
+    seed = 13;
+    start = chSysGetRealtimeCounterX();
+    for (n = 1; n <= PINGS; n++) {
+      ref_seen(names[next_rand() % BADGES]);
+      if ((n % PINGS_PER_CLEANUP) == 0)
+        ref_cleanup();
+      if ((n % PINGS_PER_SORT) == 0)
+        ref_sort();
+    }
+    list = chSysGetRealtimeCounterX() - start;
+  }
+
+  test_set_step(2);
+  {
+    seed = 13;
+    start = chSysGetRealtimeCounterX();
+    for (n = 1; n <= PINGS; n++) {
+      friend_seen(names[next_rand() % BADGES]);
+      if ((n % PINGS_PER_CLEANUP) == 0)
+        friend_cleanup();
+      if ((n % PINGS_PER_SORT) == 0)
+        friendsSort();
+    }
+    table = chSysGetRealtimeCounterX() - start;
+
+    test_print("--- Friends at the end: ");
+    test_printn(friendCount());
+    test_println("");
+    test_print("--- Linear list: ");
+    test_printn((uint32_t)(list * 1000 / PINGS));
+    test_println(" ns/ping");
+    test_print("--- Hash table:  ");
+    test_printn((uint32_t)(table * 1000 / PINGS));
+    test_println(" ns/ping");
+    test_assert(table < list, "hash table is not faster");
+
+    friends = friendsGet();
+    for (i = 0; i < MAX_FRIENDS; i++) {
+      test_assert((friends[i] == NULL) == (ref_friends[i] == NULL),
+                  "different friends");
+      if (friends[i] == NULL)
+        break;
+      test_assert(strcmp(&friends[i][1], &ref_friends[i][1]) == 0,
+                  "different order");
+    }
+  }
+}
+
+static const testcase_t test_007_003 = {
+  "crowd benchmark",
+  test_007_003_setup,
+  test_007_003_teardown,
+  test_007_003_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Friends table.
+ */
+const testcase_t * const test_sequence_007[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_007_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_007_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_007_003,
+#endif
+  NULL
+};
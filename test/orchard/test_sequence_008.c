@@ -0,0 +1,278 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "mic-features.h"
+#include <math.h>
+
+/**
+ * @page test_sequence_008 Microphone features
+ *
+ * File: @ref test_sequence_008.c
+ *
+ * <h2>Description</h2>
+ * This sequence feeds synthetic microphone blocks through the streaming
+ * feature pipeline of orchard/mic-features.c, block after block as the mic
+ * thread of orchard/analog.c does, and checks the levels, the band split
+ * and the beat onsets it publishes.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_008_001
+ * - @subpage test_008_002
+ * - @subpage test_008_003
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define BLOCK       128
+#define BASS_HZ     80
+#define TREBLE_HZ   2000
+
+static mic_pipeline pipe;
+static mic_features features;
+static uint8_t block[BLOCK];
+static uint32_t sample_clock;
+
+/* Next block of a tone, continuous from the previous block, plus a quiet
+   treble tone standing in for background noise.*/
+static void tone_block(uint32_t hz, uint32_t amplitude, uint32_t noise) {
+  double t, v;
+  uint32_t i;
+
+  for (i = 0; i < BLOCK; i++) {
+    t = (double)sample_clock++ / MIC_SAMPLE_RATE;
+    v = 128.0 + amplitude * sin(2 * M_PI * hz * t) +
+        noise * sin(2 * M_PI * TREBLE_HZ * 1.1 * t);
+    block[i] = (uint8_t)lround(v);
+  }
+  micPipelineRun(&pipe, block, BLOCK, &features);
+}
+
+static void pipeline_setup(void) {
+  micPipelineInit(&pipe);
+  sample_clock = 0;
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_008_001 Levels
+ *
+ * <h2>Description</h2>
+ * Silence and a full scale tone are fed, the DC level, peak and RMS must
+ * match the signal.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Silence.
+ * - A tone of amplitude 100.
+ * .
+ */
+
+static void test_008_001_execute(void) {
+  uint32_t n;
+
+  test_set_step(1);
+  {
+    for (n = 0; n < 4; n++)
+      tone_block(0, 0, 0);
+    test_assert(features.seq == 3, "wrong block number");
+    test_assert(features.dc == 128, "wrong dc");
+    test_assert(features.peak == 0, "peak in silence");
+    test_assert(features.rms == 0, "rms in silence");
+    test_assert(features.bands[MIC_BAND_LOW] + features.bands[MIC_BAND_MID] +
+                features.bands[MIC_BAND_HIGH] == 0, "energy in silence");
+    test_assert(features.beat == 0, "beat in silence");
+  }
+
+  test_set_step(2);
+  {
+    for (n = 0; n < 8; n++)
+      tone_block(1000, 100, 0);
+    test_assert((features.dc >= 127) && (features.dc <= 129), "wrong dc");
+    test_assert((features.peak >= 97) && (features.peak <= 101), "wrong peak");
+    test_assert((features.rms >= 68) && (features.rms <= 72), "wrong rms");
+  }
+}
+
+static const testcase_t test_008_001 = {
+  "levels",
+  pipeline_setup,
+  NULL,
+  test_008_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_008_002 Bands
+ *
+ * <h2>Description</h2>
+ * A bass tone and a treble tone are fed in turn, each must put most of
+ * its energy into its own band.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A bass tone.
+ * - A treble tone.
+ * .
+ */
+
+static void test_008_002_execute(void) {
+  uint32_t n;
+
+  test_set_step(1);
+  {
+    for (n = 0; n < 8; n++)
+      tone_block(BASS_HZ, 100, 0);
+    test_assert(features.bands[MIC_BAND_LOW] > 3 * features.bands[MIC_BAND_MID],
+                "bass not in the low band");
+    test_assert(features.bands[MIC_BAND_LOW] > 4 * features.bands[MIC_BAND_HIGH],
+                "bass not in the low band");
+  }
+
+  test_set_step(2);
+  {
+    for (n = 0; n < 8; n++)
+      tone_block(TREBLE_HZ, 100, 0);
+    test_assert(features.bands[MIC_BAND_HIGH] > 4 * features.bands[MIC_BAND_LOW],
+                "treble not in the high band");
+    test_assert(features.bands[MIC_BAND_HIGH] > features.bands[MIC_BAND_MID],
+                "treble not in the high band");
+  }
+}
+
+static const testcase_t test_008_002 = {
+  "bands",
+  pipeline_setup,
+  NULL,
+  test_008_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_008_003 Beat onsets
+ *
+ * <h2>Description</h2>
+ * Bass bursts a few blocks long are fed at a steady tempo over quiet
+ * background noise, every burst and nothing else must be reported as a
+ * beat. A steady bass tone must not keep beating. The pipeline cost per
+ * block is printed.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Bass bursts, 25 blocks apart (120bpm).
+ * - A steady bass tone.
+ * - The pipeline is timed.
+ * .
+ */
+
+#define BURSTS        12
+#define BURST_BLOCKS  4
+#define BURST_PERIOD  25
+#define COST_BLOCKS   10000
+
+static void test_008_003_execute(void) {
+  uint32_t n, beats, missed;
+  rtcnt_t start, elapsed;
+
+  test_set_step(1);
+  {
+    beats = 0;
+    missed = 0;
+    for (n = 0; n < BURSTS * BURST_PERIOD; n++) {
+      if ((n % BURST_PERIOD) < BURST_BLOCKS)
+        tone_block(BASS_HZ, 100, 5);
+      else
+        tone_block(BASS_HZ, 0, 5);
+      if (features.beat) {
+        beats++;
+        test_assert((n % BURST_PERIOD) <= 1, "beat outside a burst onset");
+      }
+      else if ((n % BURST_PERIOD) == 1) {
+        missed += (beats < n / BURST_PERIOD + 1);
+      }
+    }
+    test_assert(beats == BURSTS, "wrong beat count");
+    test_assert(missed == 0, "missed a burst");
+  }
+
+  test_set_step(2);
+  {
+    beats = 0;
+    for (n = 0; n < 5 * BURST_PERIOD; n++) {
+      tone_block(BASS_HZ, 100, 5);
+      beats += features.beat;
+    }
+    test_assert(beats == 1, "steady tone keeps beating");
+  }
+
+  test_set_step(3);
+  {
+    start = chSysGetRealtimeCounterX();
+    for (n = 0; n < COST_BLOCKS; n++)
+      micPipelineRun(&pipe, block, BLOCK, &features);
+    elapsed = chSysGetRealtimeCounterX() - start;
+    test_print("--- Pipeline: ");
+    test_printn((uint32_t)(elapsed * 1000 / COST_BLOCKS));
+    test_println(" ns/block");
+  }
+}
+
+static const testcase_t test_008_003 = {
+  "beat onsets",
+  pipeline_setup,
+  NULL,
+  test_008_003_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Microphone features.
+ */
+const testcase_t * const test_sequence_008[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_008_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_008_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_008_003,
+#endif
+  NULL
+};
@@ -0,0 +1,313 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "motion.h"
+#include <math.h>
+
+/**
+ * @page test_sequence_009 Motion engine
+ *
+ * File: @ref test_sequence_009.c
+ *
+ * <h2>Description</h2>
+ * This sequence feeds synthetic accelerometer samples through the motion
+ * engine of orchard/motion.c, sample after sample as the accel thread of
+ * orchard/accel.c does, and checks the tilt, orientation, tap and shake
+ * events it reports.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_009_001
+ * - @subpage test_009_002
+ * - @subpage test_009_003
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define MAX_EVENTS  8
+
+static motion_engine engine;
+static motion_event events[MAX_EVENTS];
+static uint32_t counts[motionOrient + 1];
+static uint8_t last_orient;
+static uint32_t noise_seed;
+
+/* A little sensor noise, +/-4 counts.*/
+static int16_t noise(void) {
+  noise_seed = noise_seed * 1103515245 + 12345;
+  return (int16_t)((noise_seed >> 16) % 9) - 4;
+}
+
+/* Runs one sample and tallies the events it produced.*/
+static void feed(int32_t x, int32_t y, int32_t z) {
+  motion_sample s;
+  unsigned n, i;
+
+  s.x = (int16_t)(x + noise());
+  s.y = (int16_t)(y + noise());
+  s.z = (int16_t)(z + noise());
+  n = motionRun(&engine, &s, 1, events, MAX_EVENTS);
+  for (i = 0; i < n; i++) {
+    counts[events[i].type]++;
+    if (events[i].type == motionOrient)
+      last_orient = events[i].orient;
+  }
+}
+
+static void feed_still(unsigned samples) {
+  while (samples--)
+    feed(0, 0, MOTION_1G);
+}
+
+static void clear_counts(void) {
+  unsigned i;
+
+  for (i = 0; i <= motionOrient; i++)
+    counts[i] = 0;
+}
+
+static void engine_setup(void) {
+  motionInit(&engine);
+  clear_counts();
+  last_orient = motionOrientUnknown;
+  noise_seed = 1;
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_009_001 Tilt and orientation
+ *
+ * <h2>Description</h2>
+ * A badge lying still must not report anything. Turned slowly from face
+ * up to portrait, it must report a series of tilts and one orientation
+ * change, and no taps or shakes.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Lying face up.
+ * - Turned to portrait over two seconds.
+ * .
+ */
+
+#define TURN_SAMPLES  100
+
+static void test_009_001_execute(void) {
+  unsigned n;
+  double a;
+
+  test_set_step(1);
+  {
+    feed_still(5 * MOTION_SAMPLE_RATE);
+    test_assert(counts[motionTilt] + counts[motionShake] +
+                counts[motionTap] + counts[motionOrient] == 0,
+                "events while still");
+    test_assert(engine.orient == motionOrientFaceUp, "not face up");
+  }
+
+  test_set_step(2);
+  {
+    for (n = 1; n <= TURN_SAMPLES; n++) {
+      a = M_PI / 2 * n / TURN_SAMPLES;
+      feed(0, -lround(MOTION_1G * sin(a)), lround(MOTION_1G * cos(a)));
+    }
+    for (n = 0; n < MOTION_SAMPLE_RATE; n++)
+      feed(0, -MOTION_1G, 0);
+    test_assert(counts[motionTilt] >= 10, "too few tilts");
+    test_assert(counts[motionTilt] <= MOTION_1G / MOTION_TILT_STEP + 2,
+                "too many tilts");
+    test_assert(counts[motionOrient] == 1, "wrong orientation changes");
+    test_assert(last_orient == motionOrientPortraitUp, "wrong orientation");
+    test_assert(counts[motionShake] + counts[motionTap] == 0,
+                "turning taken for a tap or shake");
+  }
+}
+
+static const testcase_t test_009_001 = {
+  "tilt and orientation",
+  engine_setup,
+  NULL,
+  test_009_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_009_002 Taps
+ *
+ * <h2>Description</h2>
+ * Short spikes on a still badge must each report one tap, a longer push
+ * must not.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Three one sample taps, half a second apart.
+ * - A two sample tap.
+ * - A push over five samples.
+ * .
+ */
+
+static void test_009_002_execute(void) {
+  unsigned n, i;
+
+  feed_still(MOTION_SAMPLE_RATE);
+
+  test_set_step(1);
+  {
+    for (n = 0; n < 3; n++) {
+      feed(0, 0, MOTION_1G + 700);
+      feed_still(MOTION_SAMPLE_RATE / 2);
+    }
+    test_assert(counts[motionTap] == 3, "wrong tap count");
+    test_assert(counts[motionShake] == 0, "tap taken for a shake");
+  }
+
+  test_set_step(2);
+  {
+    clear_counts();
+    feed(300, 0, MOTION_1G + 600);
+    feed(-200, 0, MOTION_1G - 500);
+    feed_still(MOTION_SAMPLE_RATE / 2);
+    test_assert(counts[motionTap] == 1, "two sample tap missed");
+  }
+
+  test_set_step(3);
+  {
+    clear_counts();
+    for (i = 0; i < 5; i++)
+      feed(0, 0, MOTION_1G + 800);
+    feed_still(MOTION_SAMPLE_RATE);
+    test_assert(counts[motionTap] == 0, "push taken for a tap");
+  }
+}
+
+static const testcase_t test_009_002 = {
+  "taps",
+  engine_setup,
+  NULL,
+  test_009_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_009_003 Shakes
+ *
+ * <h2>Description</h2>
+ * A badge shaken side to side must report shakes at most once per holdoff
+ * and no taps, and go quiet as soon as the shaking stops. The engine cost
+ * per sample is printed.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Shaken at 4Hz, 1.5g, for two seconds.
+ * - Lying still again.
+ * - The engine is timed.
+ * .
+ */
+
+#define SHAKE_HZ      4
+#define COST_SAMPLES  100000
+
+static void test_009_003_execute(void) {
+  unsigned n;
+  motion_sample s[MOTION_SAMPLE_RATE];
+  rtcnt_t start, elapsed;
+
+  feed_still(MOTION_SAMPLE_RATE);
+
+  test_set_step(1);
+  {
+    for (n = 0; n < 2 * MOTION_SAMPLE_RATE; n++)
+      feed(lround(1.5 * MOTION_1G *
+                  sin(2 * M_PI * SHAKE_HZ * n / MOTION_SAMPLE_RATE)),
+           0, MOTION_1G);
+    test_assert(counts[motionShake] >= 2, "shake missed");
+    test_assert(counts[motionShake] <=
+                2 * MOTION_SAMPLE_RATE / MOTION_SHAKE_HOLDOFF + 1,
+                "shakes within the holdoff");
+    test_assert(counts[motionTap] == 0, "shake taken for taps");
+  }
+
+  test_set_step(2);
+  {
+    clear_counts();
+    feed_still(2 * MOTION_SAMPLE_RATE);
+    test_assert(counts[motionShake] + counts[motionTap] == 0,
+                "events after the shaking stopped");
+  }
+
+  test_set_step(3);
+  {
+    for (n = 0; n < MOTION_SAMPLE_RATE; n++) {
+      s[n].x = (int16_t)(n * 37 % 512);
+      s[n].y = (int16_t)(n * 91 % 512);
+      s[n].z = MOTION_1G;
+    }
+    start = chSysGetRealtimeCounterX();
+    for (n = 0; n < COST_SAMPLES / MOTION_SAMPLE_RATE; n++)
+      (void)motionRun(&engine, s, MOTION_SAMPLE_RATE, events, MAX_EVENTS);
+    elapsed = chSysGetRealtimeCounterX() - start;
+    test_print("--- Engine: ");
+    test_printn((uint32_t)(elapsed * 1000 / COST_SAMPLES));
+    test_println(" ns/sample");
+  }
+}
+
+static const testcase_t test_009_003 = {
+  "shakes",
+  engine_setup,
+  NULL,
+  test_009_003_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Motion engine.
+ */
+const testcase_t * const test_sequence_009[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_009_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_009_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_009_003,
+#endif
+  NULL
+};
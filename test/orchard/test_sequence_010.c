@@ -0,0 +1,339 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "i2c-queue.h"
+#include "fxprof.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_010 I2C queue
+ *
+ * File: @ref test_sequence_010.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the prioritized I2C queue in orchard/i2c-queue.c.
+ * The bus is simulated: every transfer sleeps XFER_TICKS, is logged, and a
+ * read returns the register address plus the number of transfers so far.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_010_001
+ * - @subpage test_010_002
+ * - @subpage test_010_003
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define XFER_TICKS  2
+#define LOG_SIZE    32
+
+static i2cq_device touch, gauge;
+static uint8_t xfer_log[LOG_SIZE];
+static uint32_t xfers;
+
+static msg_t fake_xfer(uint8_t addr, const uint8_t *tx, size_t txn,
+                       uint8_t *rx, size_t rxn) {
+
+  (void)txn;
+  if (xfers < LOG_SIZE)
+    xfer_log[xfers] = (uint8_t)(addr + tx[0]);
+  xfers++;
+  chThdSleep(XFER_TICKS);
+  if (rxn != 0)
+    memset(rx, tx[0] + xfers, rxn);
+  return MSG_OK;
+}
+
+static uint8_t done_log[LOG_SIZE];
+static uint32_t ndone;
+
+static void log_done(i2cq_request *req) {
+
+  if (ndone < LOG_SIZE)
+    done_log[ndone] = (uint8_t)(uintptr_t)req->arg;
+  ndone++;
+}
+
+static void prepare(i2cq_request *req, i2cq_device *dev, const uint8_t *tx,
+                    uint8_t *rx, size_t rxn, uint8_t coalesce, uint8_t tag) {
+
+  req->dev = dev;
+  req->tx = tx;
+  req->txn = 1;
+  req->rx = rx;
+  req->rxn = rxn;
+  req->coalesce = coalesce;
+  req->done = log_done;
+  req->arg = (void *)(uintptr_t)tag;
+}
+
+static void wait_done(uint32_t n) {
+
+  while (ndone < n)
+    chThdSleep(1);
+}
+
+static void queue_setup(void) {
+
+  i2cqInit(fake_xfer);
+  i2cqDeviceInit(&touch, "touch", 0x10, i2cqPrioInput);
+  i2cqDeviceInit(&gauge, "gauge", 0x20, i2cqPrioTelemetry);
+  memset(xfer_log, 0, sizeof(xfer_log));
+  xfers = 0;
+  ndone = 0;
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_010_001 Priority
+ *
+ * <h2>Description</h2>
+ * Telemetry reads are queued behind one on the bus, then a touch read.
+ * The touch read must go on the bus right after the transfer in flight,
+ * the telemetry reads after it in the order they came.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Four telemetry reads and one touch read are queued.
+ * - The bus order is checked.
+ * .
+ */
+
+static void test_010_001_execute(void) {
+  static const uint8_t regs[5] = {1, 2, 3, 4, 5};
+  static const uint8_t expected[5] = {0x21, 0x15, 0x22, 0x23, 0x24};
+  i2cq_request req[5];
+  uint8_t rx[5][2];
+  unsigned i;
+
+  test_set_step(1);
+  {
+    for (i = 0; i < 4; i++) {
+      prepare(&req[i], &gauge, &regs[i], rx[i], 2, 0, i);
+      i2cqSubmit(&req[i]);
+    }
+    prepare(&req[4], &touch, &regs[4], rx[4], 2, 0, 4);
+    i2cqSubmit(&req[4]);
+    wait_done(5);
+  }
+
+  test_set_step(2);
+  {
+    test_assert(xfers == 5, "wrong transfer count");
+    test_assert(memcmp(xfer_log, expected, sizeof(expected)) == 0,
+                "touch read did not go first");
+    test_assert(done_log[1] == 4, "touch read not completed second");
+    for (i = 0; i < 5; i++)
+      test_assert(req[i].result == MSG_OK, "transfer failed");
+  }
+}
+
+static const testcase_t test_010_001 = {
+  "priority",
+  queue_setup,
+  NULL,
+  test_010_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_010_002 Coalescing
+ *
+ * <h2>Description</h2>
+ * Identical register reads that meet in the queue must share one
+ * transfer and all get its data. Reads that did not ask for it, and reads
+ * of another register, must go on the bus on their own.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A read keeps the bus busy while three identical reads, a read that
+ *   may not be coalesced and a read of another register are queued.
+ * - Transfers, data and statistics are checked.
+ * .
+ */
+
+static void test_010_002_execute(void) {
+  static const uint8_t busy = 9, reg = 7, other = 8;
+  i2cq_request req[6];
+  uint8_t rx[6][2];
+  unsigned i;
+
+  test_set_step(1);
+  {
+    memset(rx, 0, sizeof(rx));
+    prepare(&req[0], &gauge, &busy, rx[0], 2, 1, 0);
+    i2cqSubmit(&req[0]);
+    for (i = 1; i <= 3; i++) {
+      prepare(&req[i], &gauge, &reg, rx[i], 2, 1, i);
+      i2cqSubmit(&req[i]);
+    }
+    prepare(&req[4], &gauge, &reg, rx[4], 2, 0, 4);
+    i2cqSubmit(&req[4]);
+    prepare(&req[5], &gauge, &other, rx[5], 2, 1, 5);
+    i2cqSubmit(&req[5]);
+    wait_done(6);
+  }
+
+  test_set_step(2);
+  {
+    test_assert(xfers == 4, "identical reads not coalesced");
+    test_assert(gauge.stats.coalesced == 2, "wrong coalesced count");
+    test_assert(gauge.stats.transfers == 4, "wrong transfer count");
+    test_assert(gauge.stats.bytes == 4 * 3, "wrong byte count");
+    test_assert((rx[1][0] == rx[2][0]) && (rx[2][0] == rx[3][0]) &&
+                (rx[3][1] == rx[1][1]), "coalesced reads got different data");
+    test_assert(rx[1][0] == reg + 2, "coalesced read got the wrong data");
+    test_assert(rx[4][0] == reg + 3, "uncoalesced read got the wrong data");
+    test_assert(rx[5][0] == other + 4, "other read got the wrong data");
+  }
+}
+
+static const testcase_t test_010_002 = {
+  "coalescing",
+  queue_setup,
+  NULL,
+  test_010_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_010_003 Touch latency under telemetry load
+ *
+ * <h2>Description</h2>
+ * Two threads keep the bus busy with back to back telemetry transfers
+ * while touch reads are made. Every touch read must wait for at most the
+ * transfer in flight, and the statistics must account for all the bus
+ * time. The worst touch wait is printed.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Telemetry threads are started.
+ * - Touch reads are made and timed.
+ * - The statistics are checked.
+ * .
+ */
+
+#define TOUCH_READS   10
+
+static THD_WORKING_AREA(waGauge1, 512);
+static THD_WORKING_AREA(waGauge2, 512);
+static THD_FUNCTION(gauge_thread, p) {
+  uint8_t reg = (uint8_t)(uintptr_t)p;
+  uint8_t rx[2];
+
+  while (!chThdShouldTerminateX())
+    (void)i2cqTransfer(&gauge, &reg, 1, rx, sizeof(rx));
+}
+
+static void test_010_003_execute(void) {
+  static const uint8_t reg = 0;
+  thread_t *tp1, *tp2;
+  systime_t start, elapsed, worst = 0;
+  uint8_t rx[2];
+  unsigned i;
+
+  test_set_step(1);
+  {
+    tp1 = chThdCreateStatic(waGauge1, sizeof(waGauge1), chThdGetPriorityX(),
+                            gauge_thread, (void *)1);
+    tp2 = chThdCreateStatic(waGauge2, sizeof(waGauge2), chThdGetPriorityX(),
+                            gauge_thread, (void *)2);
+    chThdSleep(5 * XFER_TICKS);
+  }
+
+  test_set_step(2);
+  {
+    for (i = 0; i < TOUCH_READS; i++) {
+      start = chVTGetSystemTime();
+      test_assert(i2cqTransfer(&touch, &reg, 1, rx, sizeof(rx)) == MSG_OK,
+                  "touch read failed");
+      elapsed = chVTTimeElapsedSinceX(start);
+      if (elapsed > worst)
+        worst = elapsed;
+      chThdSleep(XFER_TICKS + 1);
+    }
+    chThdTerminate(tp1);
+    chThdTerminate(tp2);
+    chThdWait(tp1);
+    chThdWait(tp2);
+    test_assert(worst <= 2 * XFER_TICKS + 1, "touch read waited behind telemetry");
+  }
+
+  test_set_step(3);
+  {
+    test_assert(touch.stats.transfers == TOUCH_READS, "wrong touch transfers");
+    test_assert(gauge.stats.transfers > TOUCH_READS, "telemetry did not run");
+    test_assert(touch.stats.transfers + gauge.stats.transfers == xfers,
+                "transfers not accounted");
+    test_assert(FXPROF2US(touch.stats.wait_max) <= ST2US(XFER_TICKS + 1),
+                "touch wait over one transfer");
+    test_assert(touch.stats.bus_time >= US2FXPROF(ST2US(XFER_TICKS - 1)) * TOUCH_READS,
+                "bus time not accounted");
+    test_print("--- Touch wait max ");
+    test_printn(FXPROF2US(touch.stats.wait_max));
+    test_print(" us, telemetry wait max ");
+    test_printn(FXPROF2US(gauge.stats.wait_max));
+    test_println(" us");
+  }
+}
+
+static const testcase_t test_010_003 = {
+  "touch latency under telemetry load",
+  queue_setup,
+  NULL,
+  test_010_003_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   I2C queue.
+ */
+const testcase_t * const test_sequence_010[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_010_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_010_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_010_003,
+#endif
+  NULL
+};
@@ -0,0 +1,514 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "ble-aci.h"
+#include "fxprof.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_011 BLE ACI transport
+ *
+ * File: @ref test_sequence_011.c
+ *
+ * <h2>Description</h2>
+ * This sequence runs the nRF8001 ACI transport in orchard/ble-aci.c against
+ * a stand-in for the chip. The stand-in pulls RDYN low from a virtual timer
+ * SIM_RDY_TICKS after REQN went low or after it got an event to send, and
+ * raises the RDYN event like the EXT interrupt does. It answers echo,
+ * acknowledges other commands, takes pipe data against its credits and
+ * gives the credits back once they are all used.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_011_001
+ * - @subpage test_011_002
+ * - @subpage test_011_003
+ * - @subpage test_011_004
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define SIM_RDY_TICKS   1
+#define SIM_CREDITS     2
+#define SIM_EVENTS      8
+#define SIM_PIPE        3
+
+static struct {
+  int             reqn;         // REQN is low
+  int             rdyn;         // RDYN is low
+  uint8_t         out[SIM_EVENTS][BLE_ACI_PACKET_SIZE + 1];
+  unsigned        out_head, out_count;
+  uint8_t         cur[BLE_ACI_PACKET_SIZE + 1];   // event being sent
+  uint8_t         in[BLE_ACI_PACKET_SIZE + 1];    // command being received
+  unsigned        pos;
+  int             credits;      // the host's credits, as the chip sees them
+  int             hold;         // keep the credits once used
+  unsigned        violations;   // data sent without a credit
+  unsigned        commands;
+  unsigned        packets;      // pipe data packets
+  uint8_t         pipe[256];    // pipe data received
+  unsigned        pipe_n;
+  virtual_timer_t vt;
+} nrf;
+
+static event_source_t sim_rdy;
+static ble_aci aci;
+
+static void sim_rdy_cb(void *arg) {
+
+  (void)arg;
+  chSysLockFromISR();
+  if( nrf.reqn || (nrf.out_count != 0) ) {
+    nrf.rdyn = 1;
+    chEvtBroadcastI(&sim_rdy);
+  }
+  chSysUnlockFromISR();
+}
+
+// call locked
+static void sim_arm_s(void) {
+
+  if( !nrf.rdyn && !chVTIsArmedI(&nrf.vt) )
+    chVTSetI(&nrf.vt, SIM_RDY_TICKS, sim_rdy_cb, NULL);
+}
+
+// call locked
+static void sim_event_s(const uint8_t *event, unsigned len) {
+  uint8_t *e;
+
+  if( nrf.out_count == SIM_EVENTS )
+    return;
+  e = nrf.out[(nrf.out_head + nrf.out_count++) % SIM_EVENTS];
+  memset(e, 0, BLE_ACI_PACKET_SIZE + 1);
+  e[1] = len;
+  memcpy(e + 2, event, len);
+  sim_arm_s();
+}
+
+static void sim_give_credits(uint8_t credits) {
+  uint8_t ev[2] = {NRF_DATACREDITEVENT, credits};
+
+  chSysLock();
+  nrf.credits += credits;
+  sim_event_s(ev, sizeof(ev));
+  chSysUnlock();
+}
+
+// call locked
+static void sim_command_s(void) {
+  uint8_t ev[BLE_ACI_PACKET_SIZE];
+  unsigned len = nrf.in[0];
+
+  if( len == 0 )
+    return;
+
+  switch( nrf.in[1] ) {
+  case NRF_ECHO_OP:
+    ev[0] = NRF_ECHOEVENT;
+    memcpy(ev + 1, nrf.in + 2, len - 1);
+    sim_event_s(ev, len);
+    break;
+
+  case NRF_SENDDATA_OP:
+    if( nrf.credits <= 0 )
+      nrf.violations++;
+    nrf.credits--;
+    nrf.packets++;
+    if( nrf.pipe_n + len - 2 <= sizeof(nrf.pipe) ) {
+      memcpy(nrf.pipe + nrf.pipe_n, nrf.in + 3, len - 2);
+      nrf.pipe_n += len - 2;
+    }
+    if( (nrf.credits == 0) && !nrf.hold ) {
+      ev[0] = NRF_DATACREDITEVENT;
+      ev[1] = SIM_CREDITS;
+      nrf.credits = SIM_CREDITS;
+      sim_event_s(ev, 2);
+    }
+    break;
+
+  default:
+    nrf.commands++;
+    ev[0] = NRF_COMMANDRESPONSEEVENT;
+    ev[1] = nrf.in[1];
+    ev[2] = NRF_STATUS_SUCCESS;
+    sim_event_s(ev, 3);
+    break;
+  }
+}
+
+static void sim_request(void *ctx, int on) {
+
+  (void)ctx;
+  chSysLock();
+  nrf.reqn = on;
+  if( on ) {
+    sim_arm_s();
+  }
+  else {
+    nrf.rdyn = 0;
+    sim_command_s();
+    nrf.pos = 0;
+    if( nrf.out_count != 0 )
+      sim_arm_s();
+  }
+  chSysUnlock();
+}
+
+static int sim_ready(void *ctx) {
+
+  (void)ctx;
+  return nrf.rdyn;
+}
+
+static void sim_exchange(void *ctx, size_t n, const uint8_t *tx, uint8_t *rx) {
+  size_t i;
+
+  (void)ctx;
+  chSysLock();
+  if( nrf.pos == 0 ) {
+    memset(nrf.in, 0, sizeof(nrf.in));
+    memset(nrf.cur, 0, sizeof(nrf.cur));
+    if( nrf.out_count != 0 ) {
+      memcpy(nrf.cur, nrf.out[nrf.out_head], sizeof(nrf.cur));
+      nrf.out_head = (nrf.out_head + 1) % SIM_EVENTS;
+      nrf.out_count--;
+    }
+  }
+  for( i = 0; (i < n) && (nrf.pos < sizeof(nrf.in)); i++, nrf.pos++ ) {
+    nrf.in[nrf.pos] = tx[i];
+    rx[i] = nrf.cur[nrf.pos];
+  }
+  chSysUnlock();
+}
+
+static const ble_aci_port sim_port = {
+  sim_request,
+  sim_ready,
+  sim_exchange,
+};
+
+static uint8_t last_event[BLE_ACI_PACKET_SIZE + 1];
+static unsigned events;
+
+static void sim_handler(void *ctx, uint8_t *event) {
+
+  (void)ctx;
+  memcpy(last_event, event, sizeof(last_event));
+  events++;
+}
+
+static void sim_start(uint8_t credits, int hold) {
+  uint8_t started[4] = {NRF_DEVICESTARTEDEVENT, 0x03, 0x00, credits};
+
+  memset(&nrf, 0, sizeof(nrf));
+  chVTObjectInit(&nrf.vt);
+  chEvtObjectInit(&sim_rdy);
+  nrf.hold = hold;
+  events = 0;
+
+  memset(&aci, 0, sizeof(aci));
+  bleAciStart(&aci, &sim_port, NULL, &sim_rdy, sim_handler);
+
+  // coming out of reset
+  chSysLock();
+  nrf.credits = credits;
+  sim_event_s(started, sizeof(started));
+  chSysUnlock();
+  bleAciWait(&aci, 0, MS2ST(100));
+}
+
+static void sim_stop(void) {
+
+  bleAciStop(&aci);
+  chVTReset(&nrf.vt);
+}
+
+static void sim_setup(void) {
+
+  sim_start(SIM_CREDITS, FALSE);
+}
+
+static void sim_setup_no_credits(void) {
+
+  sim_start(0, TRUE);
+}
+
+static msg_t send_echo(const char *msg) {
+  uint8_t cmd[BLE_ACI_PACKET_SIZE];
+  size_t len = strlen(msg);
+
+  cmd[0] = len + 1;
+  cmd[1] = NRF_ECHO_OP;
+  memcpy(cmd + 2, msg, len);
+  return bleAciSend(&aci, cmd, MS2ST(100));
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_011_001 Start and commands
+ *
+ * <h2>Description</h2>
+ * The device started event must be picked up without anything to send, and
+ * give the transport its credits. Commands must go out and their answers
+ * come back through the handler.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The credits of the device started event are checked.
+ * - An echo is sent and its answer checked.
+ * - A command is sent and its response checked.
+ * .
+ */
+
+static void test_011_001_execute(void) {
+  static const uint8_t wakeup[2] = {1, NRF_WAKEUP_OP};
+  uint32_t seen;
+
+  test_set_step(1);
+  {
+    test_assert(events == 1, "device started event missing");
+    test_assert(bleAciCredits(&aci) == SIM_CREDITS, "credits not taken");
+  }
+
+  test_set_step(2);
+  {
+    seen = bleAciReceived(&aci);
+    test_assert(send_echo("orchard") == MSG_OK, "echo not queued");
+    test_assert(bleAciWait(&aci, seen, MS2ST(100)) == MSG_OK, "no echo");
+    test_assert((last_event[1] == 8) && (last_event[2] == NRF_ECHOEVENT) &&
+                !memcmp(last_event + 3, "orchard", 7), "wrong echo");
+  }
+
+  test_set_step(3);
+  {
+    seen = bleAciReceived(&aci);
+    test_assert(bleAciSend(&aci, wakeup, MS2ST(100)) == MSG_OK, "command not queued");
+    test_assert(bleAciWait(&aci, seen, MS2ST(100)) == MSG_OK, "no response");
+    test_assert((last_event[2] == NRF_COMMANDRESPONSEEVENT) &&
+                (last_event[3] == NRF_WAKEUP_OP), "wrong response");
+    test_assert(aci.stats.commands == 2, "wrong command count");
+    test_assert(aci.stats.events == 3, "wrong event count");
+  }
+}
+
+static const testcase_t test_011_001 = {
+  "start and commands",
+  sim_setup,
+  sim_stop,
+  test_011_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_011_002 Credit flow control
+ *
+ * <h2>Description</h2>
+ * More pipe data packets are queued than the device has credits for. They
+ * must only go out with a credit, wait for the credits to come back, and
+ * arrive complete and in order.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Seven data packets are queued and flushed.
+ * - The data and the credit accounting are checked.
+ * .
+ */
+
+static void test_011_002_execute(void) {
+  uint8_t cmd[BLE_ACI_PACKET_SIZE];
+  unsigned i, j;
+
+  test_set_step(1);
+  {
+    for( i = 0; i < 7; i++ ) {
+      cmd[0] = 2 + 5;
+      cmd[1] = NRF_SENDDATA_OP;
+      cmd[2] = SIM_PIPE;
+      for( j = 0; j < 5; j++ )
+        cmd[3 + j] = i * 5 + j;
+      test_assert(bleAciSend(&aci, cmd, MS2ST(100)) == MSG_OK, "data not queued");
+    }
+    test_assert(bleAciFlush(&aci, MS2ST(500)) == MSG_OK, "data not sent");
+  }
+
+  test_set_step(2);
+  {
+    test_assert(nrf.violations == 0, "data sent without a credit");
+    test_assert(nrf.packets == 7, "wrong packet count");
+    test_assert(nrf.pipe_n == 35, "wrong data length");
+    for( i = 0; i < 35; i++ )
+      test_assert(nrf.pipe[i] == i, "data corrupted or out of order");
+    test_assert(aci.stats.data == 7, "wrong data count");
+    test_assert(aci.stats.data_bytes == 35, "wrong data bytes");
+    test_assert(aci.stats.credit_stalls >= 3, "data did not wait for credits");
+  }
+}
+
+static const testcase_t test_011_002 = {
+  "credit flow control",
+  sim_setup,
+  sim_stop,
+  test_011_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_011_003 Stream batching
+ *
+ * <h2>Description</h2>
+ * Short stream writes made while there are no credits must be packed into
+ * full send data packets, and go out as such once credits come.
+ *
+ * <h2>Conditions</h2>
+ * The device starts without credits.
+ *
+ * <h2>Test Steps</h2>
+ * - Ten writes of three bytes are made.
+ * - Credits are given and the packets checked.
+ * .
+ */
+
+static void test_011_003_execute(void) {
+  uint8_t buf[3];
+  unsigned i;
+
+  test_set_step(1);
+  {
+    for( i = 0; i < 10; i++ ) {
+      buf[0] = i * 3;
+      buf[1] = i * 3 + 1;
+      buf[2] = i * 3 + 2;
+      test_assert(bleAciStream(&aci, SIM_PIPE, buf, 3, MS2ST(100)) == MSG_OK,
+                  "stream not queued");
+    }
+    test_assert(aci.data_count == 2, "writes not packed");
+    test_assert(aci.stats.streamed == 9, "wrong streamed count");
+  }
+
+  test_set_step(2);
+  {
+    sim_give_credits(2);
+    test_assert(bleAciFlush(&aci, MS2ST(500)) == MSG_OK, "data not sent");
+    test_assert(nrf.packets == 2, "wrong packet count");
+    test_assert(nrf.violations == 0, "data sent without a credit");
+    test_assert(nrf.pipe_n == 30, "wrong data length");
+    for( i = 0; i < 30; i++ )
+      test_assert(nrf.pipe[i] == i, "data corrupted or out of order");
+  }
+}
+
+static const testcase_t test_011_003 = {
+  "stream batching",
+  sim_setup_no_credits,
+  sim_stop,
+  test_011_003_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_011_004 Event latency
+ *
+ * <h2>Description</h2>
+ * Echo round trips are timed. The transport sleeps on the RDYN event, so
+ * a round trip must take the two RDYN delays of the stand-in and not much
+ * more. The average round trip is printed.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Echoes are sent and timed.
+ * .
+ */
+
+#define ECHOES  16
+
+static void test_011_004_execute(void) {
+  systime_t start, elapsed, worst = 0, total = 0;
+  uint32_t seen;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    for( i = 0; i < ECHOES; i++ ) {
+      seen = bleAciReceived(&aci);
+      start = chVTGetSystemTime();
+      test_assert(send_echo("ping") == MSG_OK, "echo not queued");
+      test_assert(bleAciWait(&aci, seen, MS2ST(100)) == MSG_OK, "no echo");
+      elapsed = chVTTimeElapsedSinceX(start);
+      total += elapsed;
+      if( elapsed > worst )
+        worst = elapsed;
+    }
+    test_assert(worst <= 2 * SIM_RDY_TICKS + 2, "echo too slow");
+    test_assert(aci.stats.timeouts == 0, "RDYN timed out");
+    test_print("--- Echo round trip ");
+    test_printn(ST2US(total) / ECHOES);
+    test_print(" us avg, queue to wire ");
+    test_printn(FXPROF2US(aci.stats.latency_total / aci.stats.commands));
+    test_println(" us avg");
+  }
+}
+
+static const testcase_t test_011_004 = {
+  "event latency",
+  sim_setup,
+  sim_stop,
+  test_011_004_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   BLE ACI transport.
+ */
+const testcase_t * const test_sequence_011[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_011_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_011_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_011_003,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_011_004,
+#endif
+  NULL
+};
@@ -0,0 +1,22 @@
+/*
+    ChibiOS - Copyright (C) 2011..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _TEST_SEQUENCE_011_H_
+#define _TEST_SEQUENCE_011_H_
+
+extern const testcase_t * const test_sequence_011[];
+
+#endif /* _TEST_SEQUENCE_011_H_ */
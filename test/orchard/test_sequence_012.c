@@ -0,0 +1,365 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "oled-frame.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_012 OLED frame segments
+ *
+ * File: @ref test_sequence_012.c
+ *
+ * <h2>Description</h2>
+ * This sequence flushes frames through the OLED shadow of
+ * orchard/oled-frame.c the way the SSD1306 driver does, one page of
+ * 128 bytes after the other, and applies the segments it sends to a
+ * stand-in for the panel memory. The panel must always end up showing
+ * what was meant to be sent, with as few bytes as the frame options allow.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_012_001
+ * - @subpage test_012_002
+ * - @subpage test_012_003
+ * - @subpage test_012_004
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+static oled_frame frame;
+static uint8_t fb[OLED_FRAME_SIZE];       // what the app drew
+static uint8_t panel[OLED_FRAME_SIZE];    // what the panel shows
+static unsigned segments, sent, bad_windows;
+
+static void panel_segment(void *ctx, unsigned page, unsigned col,
+                          const uint8_t *data, size_t n) {
+  (void)ctx;
+
+  if( (page >= OLED_PAGES) || (n == 0) || (col + n > OLED_WIDTH) ) {
+    bad_windows++;
+    return;
+  }
+  memcpy(&panel[page * OLED_WIDTH + col], data, n);
+  segments++;
+  sent += n;
+}
+
+static void pixel(int x, int y) {
+  fb[(y / 8) * OLED_WIDTH + x] |= 1 << (y % 8);
+}
+
+/* One gdispFlush(), then the end of the drawing.*/
+static void flush(void) {
+  unsigned page;
+
+  segments = sent = 0;
+  for( page = 0; page < OLED_PAGES; page++ )
+    oledFrameWrite(&frame, &fb[page * OLED_WIDTH], OLED_WIDTH);
+  oledFrameSend(&frame, panel_segment, NULL);
+  oledFrameEndDraw(&frame);
+}
+
+static void frame_setup(void) {
+  oledFrameInit(&frame);
+  memset(fb, 0, sizeof(fb));
+  memset(panel, 0x5A, sizeof(panel));   // whatever it showed at power up
+  bad_windows = 0;
+}
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_012_001 Whole frames
+ *
+ * <h2>Description</h2>
+ * The first flush must send the whole frame, the panel memory being
+ * unknown. Without frame options every flush is sent whole, as before.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A frame is flushed after start, and the panel checked.
+ * - The same frame is flushed again without options.
+ * - The panel loses its memory and the frame is flushed with frame diff.
+ * .
+ */
+
+static void test_012_001_execute(void) {
+
+  test_set_step(1);
+  {
+    oledFrameSetDiff(&frame, 1);
+    flush();
+    test_assert(sent == OLED_FRAME_SIZE, "first frame not sent whole");
+    test_assert(segments == OLED_PAGES, "not a segment per page");
+    test_assert(!memcmp(panel, fb, sizeof(fb)), "panel differs");
+  }
+
+  test_set_step(2);
+  {
+    flush();
+    test_assert(sent == OLED_FRAME_SIZE, "frame not sent whole");
+    test_assert(frame.stats.bytes_skipped == 0, "bytes skipped");
+  }
+
+  test_set_step(3);
+  {
+    oledFrameLost(&frame);
+    memset(panel, 0xA5, sizeof(panel));
+    oledFrameSetDiff(&frame, 1);
+    flush();
+    test_assert(sent == OLED_FRAME_SIZE, "lost frame not sent whole");
+    test_assert(!memcmp(panel, fb, sizeof(fb)), "panel differs");
+    test_assert(bad_windows == 0, "segment out of the panel");
+  }
+}
+
+static const testcase_t test_012_001 = {
+  "whole frames",
+  frame_setup,
+  NULL,
+  test_012_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_012_002 Frame diff
+ *
+ * <h2>Description</h2>
+ * With frame diff on, only the columns that changed may be sent. Changes
+ * close to each other share a segment, changes far apart do not.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - An identical frame is flushed.
+ * - Two pixels a few columns apart are set, and two far apart on another
+ *   page.
+ * - The whole frame is cleared and redrawn the same but for one pixel.
+ * .
+ */
+
+static void test_012_002_execute(void) {
+
+  flush();
+
+  test_set_step(1);
+  {
+    oledFrameSetDiff(&frame, 1);
+    flush();
+    test_assert(sent == 0, "identical frame sent");
+    test_assert(frame.stats.bytes_skipped == OLED_FRAME_SIZE, "wrong skipped count");
+  }
+
+  test_set_step(2);
+  {
+    pixel(10, 3);
+    pixel(10 + OLED_SEGMENT_GAP + 1, 5);
+    pixel(5, 40);
+    pixel(100, 41);
+    oledFrameSetDiff(&frame, 1);
+    flush();
+    test_assert(segments == 3, "wrong segment count");
+    test_assert(sent == OLED_SEGMENT_GAP + 2 + 1 + 1, "wrong byte count");
+    test_assert(!memcmp(panel, fb, sizeof(fb)), "panel differs");
+  }
+
+  test_set_step(3);
+  {
+    memset(fb, 0, sizeof(fb));
+    pixel(10, 3);
+    pixel(10 + OLED_SEGMENT_GAP + 1, 5);
+    pixel(5, 40);
+    pixel(100, 41);
+    pixel(127, 63);
+    oledFrameSetDiff(&frame, 1);
+    flush();
+    test_assert((segments == 1) && (sent == 1), "more than the change sent");
+    test_assert(!memcmp(panel, fb, sizeof(fb)), "panel differs");
+    test_assert(bad_windows == 0, "segment out of the panel");
+  }
+}
+
+static const testcase_t test_012_002 = {
+  "frame diff",
+  frame_setup,
+  NULL,
+  test_012_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_012_003 Invalidated rectangles
+ *
+ * <h2>Description</h2>
+ * Once rectangles are invalidated, only the pages and columns they cover
+ * may be sent, whatever else changed in the frame. Rectangles are clipped
+ * to the panel, and the options go with the end of the drawing.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Pixels are set inside and outside of an invalidated rectangle.
+ * - A rectangle partly off the panel is invalidated.
+ * - The next flush without options sends everything again.
+ * .
+ */
+
+static void test_012_003_execute(void) {
+  static uint8_t before[OLED_FRAME_SIZE];
+
+  flush();
+
+  test_set_step(1);
+  {
+    memcpy(before, panel, sizeof(panel));
+    pixel(20, 20);
+    pixel(70, 20);
+    oledFrameInvalidate(&frame, 16, 16, 8, 8);
+    flush();
+    test_assert((segments == 1) && (sent == 8), "not the rectangle sent");
+    test_assert(panel[2 * OLED_WIDTH + 20] == fb[2 * OLED_WIDTH + 20],
+                "change inside not shown");
+    test_assert(panel[2 * OLED_WIDTH + 70] == before[2 * OLED_WIDTH + 70],
+                "change outside shown");
+  }
+
+  test_set_step(2);
+  {
+    oledFrameInvalidate(&frame, 120, -4, 20, 10);
+    flush();
+    test_assert((segments == 1) && (sent == 8), "not clipped");
+    oledFrameInvalidate(&frame, OLED_WIDTH, 0, 8, 8);
+    oledFrameInvalidate(&frame, 0, 0, 0, 8);
+    flush();
+    test_assert(sent == OLED_FRAME_SIZE, "empty rectangles limited the flush");
+  }
+
+  test_set_step(3);
+  {
+    flush();
+    test_assert(sent == OLED_FRAME_SIZE, "options kept");
+    test_assert(!memcmp(panel, fb, sizeof(fb)), "panel differs");
+    test_assert(bad_windows == 0, "segment out of the panel");
+  }
+}
+
+static const testcase_t test_012_003 = {
+  "invalidated rectangles",
+  frame_setup,
+  NULL,
+  test_012_003_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_012_004 Scope traffic
+ *
+ * <h2>Description</h2>
+ * A scope trace like the one of app-oscope.c is cleared and redrawn every
+ * frame, with frame diff on. The panel must follow it, for far less than
+ * whole frames. The bytes sent per flush are printed.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Frames of a moving trace are flushed and checked.
+ * .
+ */
+
+#define SCOPE_FRAMES  32
+
+static void test_012_004_execute(void) {
+  uint32_t seed = 1, total = 0;
+  int y[OLED_WIDTH];
+  unsigned f, x;
+  int ok = 1;
+
+  test_set_step(1);
+  {
+    for( f = 0; f < SCOPE_FRAMES; f++ ) {
+      // a quiet trace with a little noise, and a burst moving through it
+      for( x = 0; x < OLED_WIDTH; x++ ) {
+        seed = seed * 1103515245 + 12345;
+        y[x] = ((seed >> 16) % 8) ? 32 : 33;
+        if( (x >= f * 4) && (x < f * 4 + 12) )
+          y[x] = 8 + (int)((seed >> 16) % 48);
+      }
+      memset(fb, 0, sizeof(fb));
+      for( x = 0; x < OLED_WIDTH; x++ )
+        pixel(x, y[x]);
+      oledFrameSetDiff(&frame, 1);
+      flush();
+      if( f != 0 )
+        total += sent;
+      ok = ok && !memcmp(panel, fb, sizeof(fb));
+    }
+    test_assert(ok, "panel differs");
+    test_assert(bad_windows == 0, "segment out of the panel");
+    test_assert(total / (SCOPE_FRAMES - 1) < OLED_FRAME_SIZE / 4,
+                "too much sent");
+    test_print("--- ");
+    test_printn(total / (SCOPE_FRAMES - 1));
+    test_print(" of ");
+    test_printn(OLED_FRAME_SIZE);
+    test_println(" bytes per flush");
+  }
+}
+
+static const testcase_t test_012_004 = {
+  "scope traffic",
+  frame_setup,
+  NULL,
+  test_012_004_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   OLED frame segments.
+ */
+const testcase_t * const test_sequence_012[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_012_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_012_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_012_003,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_012_004,
+#endif
+  NULL
+};
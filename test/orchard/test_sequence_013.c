@@ -0,0 +1,374 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "spi-arbiter.h"
+#include "fxprof.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_013 SPI bus arbiter
+ *
+ * File: @ref test_sequence_013.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the SPI bus arbiter in orchard/spi-arbiter.c. The
+ * bus is simulated: holding it for a transfer is a sleep, and every device
+ * logs the first letter of its name when it gets the bus.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_013_001
+ * - @subpage test_013_002
+ * - @subpage test_013_003
+ * - @subpage test_013_004
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define HOLD_TICKS    2
+#define CHUNK_TICKS   3
+#define CHUNKS        8
+#define LOG_SIZE      16
+
+static const char fake_spi = 0;
+static spiarb_device oled, flash, ble, radio;
+static char bus_log[LOG_SIZE];
+static unsigned nlog;
+
+static void log_owner(spiarb_device *dev) {
+
+  if (nlog < LOG_SIZE - 1)
+    bus_log[nlog++] = dev->name[0];
+}
+
+static void arb_setup(void) {
+  spiarb_bus *bus = spiarbBus(&fake_spi);
+
+  spiarbDeviceInit(&oled, bus, "oled", spiarbPrioDisplay);
+  spiarbDeviceInit(&flash, bus, "flash", spiarbPrioDisplay);
+  spiarbDeviceInit(&ble, bus, "ble", spiarbPrioNormal);
+  spiarbDeviceInit(&radio, bus, "radio", spiarbPrioRadio);
+  memset(bus_log, 0, sizeof(bus_log));
+  nlog = 0;
+}
+
+static THD_WORKING_AREA(waUser1, 256);
+static THD_WORKING_AREA(waUser2, 256);
+static THD_WORKING_AREA(waUser3, 256);
+
+// takes the bus once, after sleeping for the ticks in delay
+static systime_t delay;
+static THD_FUNCTION(user_thread, p) {
+  spiarb_device *dev = p;
+
+  if (delay != 0)
+    chThdSleep(delay);
+  spiarbAcquire(dev);
+  log_owner(dev);
+  chThdSleep(HOLD_TICKS);
+  spiarbRelease(dev);
+}
+
+static thread_t *start_user(stkalign_t *wa, size_t size,
+                            spiarb_device *dev) {
+
+  return chThdCreateStatic(wa, size, chThdGetPriorityX() + 1,
+                           user_thread, dev);
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_013_001 Priority
+ *
+ * <h2>Description</h2>
+ * While the OLED holds the bus, a display device, the BLE and the radio
+ * ask for it in that order. When the OLED lets go, the bus must go to the
+ * radio, then the BLE, then the display device.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The bus is taken, the other devices queue up for it.
+ * - The bus is released and the order checked.
+ * .
+ */
+
+static void test_013_001_execute(void) {
+  thread_t *tp1, *tp2, *tp3;
+
+  test_set_step(1);
+  {
+    delay = 0;
+    spiarbAcquire(&oled);
+    log_owner(&oled);
+    tp1 = start_user(waUser1, sizeof(waUser1), &flash);
+    tp2 = start_user(waUser2, sizeof(waUser2), &ble);
+    tp3 = start_user(waUser3, sizeof(waUser3), &radio);
+    test_assert(nlog == 1, "bus taken while held");
+  }
+
+  test_set_step(2);
+  {
+    spiarbRelease(&oled);
+    chThdWait(tp1);
+    chThdWait(tp2);
+    chThdWait(tp3);
+    test_assert(strcmp(bus_log, "orbf") == 0, "wrong bus order");
+    test_assert((flash.stats.contended == 1) && (ble.stats.contended == 1) &&
+                (radio.stats.contended == 1), "waits not counted");
+    test_assert(oled.stats.contended == 0, "free bus counted as a wait");
+    test_assert(radio.stats.wait_max < flash.stats.wait_max,
+                "radio waited longer than the display");
+  }
+}
+
+static const testcase_t test_013_001 = {
+  "priority",
+  arb_setup,
+  NULL,
+  test_013_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_013_002 Radio during an OLED frame
+ *
+ * <h2>Description</h2>
+ * The OLED sends a frame in chunks and yields between them. The radio
+ * asks for the bus in the middle of the frame, and must get it at the
+ * end of the chunk in flight, not of the frame. A display device asking
+ * for the bus must wait for the whole frame. The worst radio wait is
+ * printed.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The frame is sent while the radio and a display device ask for the bus.
+ * - The order, the waits and the statistics are checked.
+ * .
+ */
+
+static void test_013_002_execute(void) {
+  thread_t *tp1, *tp2;
+  unsigned i, yields = 0;
+
+  test_set_step(1);
+  {
+    delay = CHUNK_TICKS + 1;
+    tp1 = start_user(waUser1, sizeof(waUser1), &flash);
+    tp2 = start_user(waUser2, sizeof(waUser2), &radio);
+
+    spiarbAcquire(&oled);
+    for (i = 0; i < CHUNKS; i++) {
+      if (spiarbWaiting(&oled))
+        yields += spiarbYield(&oled);
+      log_owner(&oled);
+      chThdSleep(CHUNK_TICKS);
+    }
+    spiarbRelease(&oled);
+    chThdWait(tp1);
+    chThdWait(tp2);
+  }
+
+  test_set_step(2);
+  {
+    test_assert(strcmp(bus_log, "ooroooooof") == 0, "wrong bus order");
+    test_assert(yields == 1, "wrong yield count");
+    test_assert(oled.stats.yielded == 1, "yield not counted");
+    test_assert(oled.stats.acquired == 2, "yield did not get the bus back");
+    test_assert(FXPROF2US(radio.stats.wait_max) <= ST2US(CHUNK_TICKS + 1),
+                "radio waited over one chunk");
+    test_assert(FXPROF2US(flash.stats.wait_max) >=
+                ST2US((CHUNKS - 2) * CHUNK_TICKS),
+                "display device got into the frame");
+    test_print("--- Radio wait max ");
+    test_printn(FXPROF2US(radio.stats.wait_max));
+    test_print(" us, frame ");
+    test_printn(ST2US(CHUNKS * CHUNK_TICKS));
+    test_println(" us");
+  }
+}
+
+static const testcase_t test_013_002 = {
+  "radio during an OLED frame",
+  arb_setup,
+  NULL,
+  test_013_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_013_003 Histograms
+ *
+ * <h2>Description</h2>
+ * Times must land in the power of two bucket they belong to, every time
+ * the bus is held must be counted once in each histogram, and a reset must
+ * clear them.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The bucket of a few times is checked.
+ * - The bus is taken a few times and the histograms checked.
+ * - The statistics are reset.
+ * .
+ */
+
+static void test_013_003_execute(void) {
+  uint32_t waits, holds;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    test_assert((spiarbBucket(0) == 0) && (spiarbBucket(1) == 0),
+                "wrong bucket under 2us");
+    test_assert((spiarbBucket(2) == 1) && (spiarbBucket(3) == 1) &&
+                (spiarbBucket(4) == 2) && (spiarbBucket(1000) == 9),
+                "wrong bucket");
+    test_assert((spiarbBucket(2048) == SPIARB_HIST_BUCKETS - 1) &&
+                (spiarbBucket(0xFFFFFFFF) == SPIARB_HIST_BUCKETS - 1),
+                "long times not in the last bucket");
+  }
+
+  test_set_step(2);
+  {
+    spiarbResetStats();
+    for (i = 0; i < 4; i++) {
+      spiarbAcquire(&ble);
+      test_assert(spiarbYield(&ble) == 0, "yielded to nobody");
+      chThdSleep(HOLD_TICKS);
+      spiarbRelease(&ble);
+    }
+    waits = holds = 0;
+    for (i = 0; i < SPIARB_HIST_BUCKETS; i++) {
+      waits += ble.stats.wait_hist[i];
+      holds += ble.stats.hold_hist[i];
+    }
+    test_assert((waits == 4) && (holds == 4), "wrong histogram counts");
+    test_assert(ble.stats.hold_hist[spiarbBucket(FXPROF2US(ble.stats.hold_max))] != 0,
+                "longest hold not in its bucket");
+    test_assert(ble.stats.hold_time >= US2FXPROF(ST2US(HOLD_TICKS - 1)) * 4,
+                "hold time not accounted");
+  }
+
+  test_set_step(3);
+  {
+    spiarbResetStats();
+    test_assert((ble.stats.acquired == 0) && (ble.stats.hold_hist[0] == 0) &&
+                (ble.stats.hold_time == 0), "stats not cleared");
+  }
+}
+
+static const testcase_t test_013_003 = {
+  "histograms",
+  arb_setup,
+  NULL,
+  test_013_003_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_013_004 Priority inheritance
+ *
+ * <h2>Description</h2>
+ * While a thread of higher priority waits for the bus, the thread holding
+ * it must run at the waiter's priority, and drop back to its own when it
+ * lets go of the bus, whether by releasing it or by yielding.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The bus is taken and a thread of higher priority asks for it.
+ * - The bus is yielded, then taken back and released.
+ * .
+ */
+
+static void test_013_004_execute(void) {
+  tprio_t prio = chThdGetPriorityX();
+  thread_t *tp1, *tp2;
+
+  test_set_step(1);
+  {
+    delay = 0;
+    spiarbAcquire(&oled);
+    test_assert(chThdGetPriorityX() == prio, "raised with nobody waiting");
+    tp1 = start_user(waUser1, sizeof(waUser1), &radio);
+    test_assert(chThdGetPriorityX() == prio + 1, "holder not raised");
+  }
+
+  test_set_step(2);
+  {
+    test_assert(spiarbYield(&oled) == 1, "did not yield");
+    test_assert(chThdGetPriorityX() == prio, "raised after the yield");
+    chThdWait(tp1);
+    tp2 = start_user(waUser2, sizeof(waUser2), &flash);
+    test_assert(chThdGetPriorityX() == prio + 1, "holder not raised again");
+    spiarbRelease(&oled);
+    test_assert(chThdGetPriorityX() == prio, "priority not restored");
+    chThdWait(tp2);
+    test_assert(strcmp(bus_log, "rf") == 0, "wrong bus order");
+  }
+}
+
+static const testcase_t test_013_004 = {
+  "priority inheritance",
+  arb_setup,
+  NULL,
+  test_013_004_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   SPI bus arbiter.
+ */
+const testcase_t * const test_sequence_013[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_013_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_013_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_013_003,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_013_004,
+#endif
+  NULL
+};
@@ -0,0 +1,313 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "orchard-evq.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_014 App event queue
+ *
+ * File: @ref test_sequence_014.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the app event queue in orchard/orchard-evq.c, with
+ * the test thread as the reader.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_014_001
+ * - @subpage test_014_002
+ * - @subpage test_014_003
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define EVQ_TEST_EVENT  EVENT_MASK(3)
+#define TIMER_POSTS     10
+
+static orchard_evq q;
+static OrchardAppEvent got[EVQ_SIZE * 2];
+static unsigned ngot;
+
+static void evq_setup(void) {
+  evqInit(&q);
+  evqSetReader(&q, chThdGetSelfX(), EVQ_TEST_EVENT);
+  chEvtGetAndClearEvents(ALL_EVENTS);
+  memset(got, 0, sizeof(got));
+  ngot = 0;
+}
+
+static void evq_teardown(void) {
+  evqSetReader(&q, NULL, 0);
+  chEvtGetAndClearEvents(ALL_EVENTS);
+}
+
+static void collect(void *ctx, const OrchardAppEvent *evt) {
+
+  (void)ctx;
+  if (ngot < EVQ_SIZE * 2)
+    got[ngot++] = *evt;
+}
+
+static void adc(OrchardAppEvent *evt, uint8_t code, int32_t value) {
+
+  memset(evt, 0, sizeof(*evt));
+  evt->type = adcEvent;
+  evt->adc.code = code;
+  evt->adc.value = value;
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_014_001 Order and payloads
+ *
+ * <h2>Description</h2>
+ * Events of several types are posted from one record that is changed
+ * between posts. They must come out in order, each with the data it had
+ * when it was posted, after a single wakeup.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The events are posted and the reader flag checked.
+ * - The queue is drained and the records checked.
+ * .
+ */
+
+static void test_014_001_execute(void) {
+  OrchardAppEvent evt;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    memset(&evt, 0, sizeof(evt));
+    evt.type = touchEvent;
+    for (i = 0; i < 3; i++) {
+      evt.touch.mask = 1 << i;
+      test_assert(evqPost(&q, &evt), "post failed");
+    }
+    adc(&evt, adcCodeTemp, 25123);
+    evqPost(&q, &evt);
+    memset(&evt, 0, sizeof(evt));
+    evt.type = radioEvent;
+    evt.radio.prot = 2;
+    evt.radio.src = 0x42;
+    evt.radio.length = 7;
+    evqPost(&q, &evt);
+    test_assert(evqPending(&q) == 5, "wrong depth");
+    test_assert(chEvtGetAndClearEvents(ALL_EVENTS) == EVQ_TEST_EVENT,
+                "reader not signalled");
+  }
+
+  test_set_step(2);
+  {
+    test_assert(evqDrain(&q, collect, NULL) == 5, "wrong drain count");
+    for (i = 0; i < 3; i++)
+      test_assert((got[i].type == touchEvent) && (got[i].touch.mask == 1 << i),
+                  "touch state lost");
+    test_assert((got[3].type == adcEvent) && (got[3].adc.code == adcCodeTemp) &&
+                (got[3].adc.value == 25123), "adc payload lost");
+    test_assert((got[4].type == radioEvent) && (got[4].radio.src == 0x42) &&
+                (got[4].radio.length == 7), "radio payload lost");
+    test_assert(evqPending(&q) == 0, "queue not empty");
+    test_assert((q.stats.batches == 1) && (q.stats.batch_max == 5),
+                "wrong batch stats");
+  }
+}
+
+static const testcase_t test_014_001 = {
+  "order and payloads",
+  evq_setup,
+  evq_teardown,
+  test_014_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_014_002 Overflow
+ *
+ * <h2>Description</h2>
+ * More events than the queue holds are posted. The ones past the end must
+ * be refused and counted by type, the ones in the queue must be intact.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The queue is filled up and then some.
+ * - The counters and the delivered events are checked.
+ * .
+ */
+
+static void test_014_002_execute(void) {
+  OrchardAppEvent evt;
+  unsigned i, refused = 0;
+
+  test_set_step(1);
+  {
+    for (i = 0; i < EVQ_SIZE + 3; i++) {
+      adc(&evt, adcCodeMic, i);
+      if (!evqPost(&q, &evt))
+        refused++;
+    }
+    memset(&evt, 0, sizeof(evt));
+    evt.type = touchEvent;
+    if (!evqPost(&q, &evt))
+      refused++;
+  }
+
+  test_set_step(2);
+  {
+    test_assert(refused == 4, "full queue took events");
+    test_assert((q.stats.dropped == 4) && (q.stats.dropped_type[adcEvent] == 3) &&
+                (q.stats.dropped_type[touchEvent] == 1), "drops not counted");
+    test_assert(q.stats.depth_max == EVQ_SIZE, "wrong depth max");
+    test_assert(evqDrain(&q, collect, NULL) == EVQ_SIZE, "wrong drain count");
+    for (i = 0; i < EVQ_SIZE; i++)
+      test_assert(got[i].adc.value == (int32_t)i, "queued event damaged");
+    test_assert((q.stats.posted == EVQ_SIZE) && (q.stats.delivered == EVQ_SIZE),
+                "wrong counts");
+    evqResetStats(&q);
+    test_assert((q.stats.dropped == 0) && (q.stats.dropped_type[adcEvent] == 0),
+                "stats not cleared");
+  }
+}
+
+static const testcase_t test_014_002 = {
+  "overflow",
+  evq_setup,
+  evq_teardown,
+  test_014_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_014_003 Posting from a timer callback
+ *
+ * <h2>Description</h2>
+ * A virtual timer posts an event on each of several ticks while the reader
+ * sleeps, as an ISR would. Every event must be delivered, in one batch.
+ * Events posted by the handler during a drain must wait for the next one.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The timer posts while the reader sleeps, then the reader drains.
+ * - A handler posts from inside the drain.
+ * .
+ */
+
+static virtual_timer_t post_timer;
+static unsigned timer_posts;
+
+static void post_from_timer(void *arg) {
+  OrchardAppEvent evt;
+
+  (void)arg;
+  adc(&evt, adcCodeMic, timer_posts);
+  chSysLockFromISR();
+  evqPostI(&q, &evt);
+  if (++timer_posts < TIMER_POSTS)
+    chVTSetI(&post_timer, 1, post_from_timer, NULL);
+  chSysUnlockFromISR();
+}
+
+static void post_again(void *ctx, const OrchardAppEvent *evt) {
+
+  collect(ctx, evt);
+  if (evt->adc.value == 0) {
+    OrchardAppEvent next;
+    adc(&next, adcCodeMic, 1);
+    evqPost(&q, &next);
+  }
+}
+
+static void test_014_003_execute(void) {
+  eventmask_t mask;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    timer_posts = 0;
+    chVTSet(&post_timer, 1, post_from_timer, NULL);
+    chThdSleep(TIMER_POSTS + 5);
+    mask = chEvtWaitAnyTimeout(EVQ_TEST_EVENT, TIME_IMMEDIATE);
+    test_assert(mask == EVQ_TEST_EVENT, "reader not signalled");
+    test_assert(evqDrain(&q, collect, NULL) == TIMER_POSTS, "events lost");
+    for (i = 0; i < TIMER_POSTS; i++)
+      test_assert(got[i].adc.value == (int32_t)i, "wrong order");
+    test_assert(q.stats.batches == 1, "not one batch");
+  }
+
+  test_set_step(2);
+  {
+    OrchardAppEvent evt;
+
+    ngot = 0;
+    adc(&evt, adcCodeMic, 0);
+    evqPost(&q, &evt);
+    chEvtGetAndClearEvents(ALL_EVENTS);
+    test_assert(evqDrain(&q, post_again, NULL) == 1, "drain not bounded");
+    test_assert(chEvtGetAndClearEvents(ALL_EVENTS) == EVQ_TEST_EVENT,
+                "reader not signalled again");
+    test_assert(evqDrain(&q, collect, NULL) == 1, "second event lost");
+    test_assert((ngot == 2) && (got[1].adc.value == 1), "wrong event");
+  }
+}
+
+static const testcase_t test_014_003 = {
+  "posting from a timer callback",
+  evq_setup,
+  evq_teardown,
+  test_014_003_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   App event queue.
+ */
+const testcase_t * const test_sequence_014[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_014_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_014_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_014_003,
+#endif
+  NULL
+};
@@ -0,0 +1,349 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "deadline-timer.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_015 Deadline timers
+ *
+ * File: @ref test_sequence_015.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the app timers in orchard/deadline-timer.c. The
+ * test thread is the app: it drains the event queue the timers post to,
+ * and sleeps in the handler to stand for the time a frame takes to draw.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_015_001
+ * - @subpage test_015_002
+ * - @subpage test_015_003
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define TIMER_EVENT     EVENT_MASK(3)
+#define FRAME_TICKS     10
+#define DRAW_TICKS      6
+#define FRAMES          20
+#define MAX_LOG         64
+
+static orchard_evq q;
+static dtimer timers[2];
+
+static struct {
+  systime_t   time;
+  uint8_t     id;
+  uint16_t    overruns;
+} frames[MAX_LOG];
+static unsigned nframes;
+static systime_t draw_ticks;
+static bool rearm;          // re-arm timer 0 after the handler, as a one-shot
+
+static void dtimer_setup(void) {
+  evqInit(&q);
+  evqSetReader(&q, chThdGetSelfX(), TIMER_EVENT);
+  chEvtGetAndClearEvents(ALL_EVENTS);
+  dtimerInit(&timers[0], &q, 0);
+  dtimerInit(&timers[1], &q, 1);
+  nframes = 0;
+  draw_ticks = 0;
+  rearm = false;
+}
+
+static void dtimer_teardown(void) {
+  dtimerStop(&timers[0]);
+  dtimerStop(&timers[1]);
+  evqSetReader(&q, NULL, 0);
+  chEvtGetAndClearEvents(ALL_EVENTS);
+}
+
+static void on_timer(void *ctx, const OrchardAppEvent *evt) {
+  dtimer *t = &timers[evt->timer.id];
+
+  (void)ctx;
+  if (!dtimerRunning(t))
+    return;
+  if (nframes < MAX_LOG) {
+    frames[nframes].time = chVTGetSystemTime();
+    frames[nframes].id = evt->timer.id;
+    frames[nframes].overruns = evt->timer.overruns;
+    nframes++;
+  }
+  if (draw_ticks != 0)
+    chThdSleep(draw_ticks);
+  dtimerDone(t);
+  if (rearm)
+    dtimerStart(t, evt->timer.usecs, false);
+}
+
+// handles timer events until count of them came or span ticks went by
+static void run_app(unsigned count, systime_t span) {
+  systime_t start = chVTGetSystemTime();
+  systime_t elapsed;
+
+  while (nframes < count) {
+    elapsed = chVTTimeElapsedSinceX(start);
+    if (elapsed >= span)
+      break;
+    if (chEvtWaitAnyTimeout(TIMER_EVENT, span - elapsed) != 0)
+      evqDrain(&q, on_timer, NULL);
+  }
+}
+
+// frame period stats from the handler start times
+static void periods(systime_t *min, systime_t *max, systime_t *total) {
+  systime_t p;
+  unsigned i;
+
+  *min = (systime_t)-1;
+  *max = 0;
+  for (i = 1; i < nframes; i++) {
+    p = frames[i].time - frames[i - 1].time;
+    if (p < *min)
+      *min = p;
+    if (p > *max)
+      *max = p;
+  }
+  *total = frames[nframes - 1].time - frames[0].time;
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_015_001 Frame period jitter
+ *
+ * <h2>Description</h2>
+ * A repeating timer drives frames that take most of a period to draw. The
+ * frames must come one period apart on average, with little jitter. The
+ * same frames driven by a one-shot armed again after each frame, as apps
+ * used to get, are printed for comparison and must run slower.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Frames are run off a repeating timer and their periods checked.
+ * - Frames are run off a re-armed one-shot.
+ * .
+ */
+
+static void test_015_001_execute(void) {
+  systime_t min, max, total, rearm_total;
+
+  test_set_step(1);
+  {
+    draw_ticks = DRAW_TICKS;
+    dtimerStart(&timers[0], ST2US(FRAME_TICKS), true);
+    run_app(FRAMES, FRAMES * FRAME_TICKS * 2);
+    dtimerStop(&timers[0]);
+    test_assert(nframes == FRAMES, "frames missing");
+    periods(&min, &max, &total);
+    test_assert(total <= (FRAMES - 1) * FRAME_TICKS + 2, "frames drifted");
+    test_assert(total + 2 >= (FRAMES - 1) * FRAME_TICKS, "frames too fast");
+    test_assert(max - min <= 3, "frame period jitter");
+    test_assert(timers[0].stats.overruns == 0, "overruns counted");
+    test_print("--- Frame period ");
+    test_printn(ST2US(total) / (FRAMES - 1));
+    test_print(" us avg, jitter ");
+    test_printn(ST2US(max - min));
+    test_println(" us");
+  }
+
+  test_set_step(2);
+  {
+    nframes = 0;
+    rearm = true;
+    chEvtGetAndClearEvents(ALL_EVENTS);
+    dtimerStart(&timers[0], ST2US(FRAME_TICKS), false);
+    run_app(FRAMES, FRAMES * (FRAME_TICKS + DRAW_TICKS) * 2);
+    test_assert(nframes == FRAMES, "frames missing");
+    periods(&min, &max, &rearm_total);
+    test_assert(rearm_total > total + (FRAMES - 1) * (DRAW_TICKS - 1),
+                "re-armed timer did not drift");
+    test_print("--- Re-armed one-shot ");
+    test_printn(ST2US(rearm_total) / (FRAMES - 1));
+    test_println(" us avg");
+  }
+}
+
+static const testcase_t test_015_001 = {
+  "frame period jitter",
+  dtimer_setup,
+  dtimer_teardown,
+  test_015_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_015_002 Overruns
+ *
+ * <h2>Description</h2>
+ * The frames take longer than two periods. The deadlines that pass while
+ * a frame is drawn must not queue up; they must be counted, and reported
+ * with the next frame, and the timer must keep to its schedule.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Slow frames are run off a repeating timer.
+ * - The overrun counts are checked against the elapsed time.
+ * .
+ */
+
+static void test_015_002_execute(void) {
+  systime_t start, elapsed;
+  uint32_t reported = 0, deadlines;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    draw_ticks = 10;
+    start = chVTGetSystemTime();
+    dtimerStart(&timers[0], ST2US(4), true);
+    run_app(6, 200);
+    elapsed = chVTTimeElapsedSinceX(start);
+    dtimerStop(&timers[0]);
+  }
+
+  test_set_step(2);
+  {
+    test_assert(nframes == 6, "frames missing");
+    for (i = 1; i < nframes; i++) {
+      test_assert(frames[i].overruns >= 2, "overruns not reported");
+      reported += frames[i].overruns;
+    }
+    test_assert(frames[0].overruns == 0, "first frame reported overruns");
+    test_assert(reported + timers[0].missed == timers[0].stats.overruns,
+                "reported and counted overruns differ");
+    deadlines = timers[0].stats.fired + timers[0].stats.overruns;
+    test_assert((deadlines + 1 >= elapsed / 4) && (deadlines <= elapsed / 4 + 1),
+                "timer lost its schedule");
+    test_assert(evqPending(&q) == 0, "deadlines queued up");
+  }
+}
+
+static const testcase_t test_015_002 = {
+  "overruns",
+  dtimer_setup,
+  dtimer_teardown,
+  test_015_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_015_003 Several timers
+ *
+ * <h2>Description</h2>
+ * Two timers with different periods run side by side, and their events
+ * must carry their ids. A stopped timer must not deliver again, and a
+ * one-shot must fire once.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Both timers run for a while and their events are counted.
+ * - Timer 1 is stopped and timer 0 keeps going.
+ * - Timer 1 is started as a one-shot.
+ * .
+ */
+
+static unsigned count_id(uint8_t id, unsigned from) {
+  unsigned i, n = 0;
+
+  for (i = from; i < nframes; i++)
+    if (frames[i].id == id)
+      n++;
+  return n;
+}
+
+static void test_015_003_execute(void) {
+  unsigned n0, n1, mark;
+
+  test_set_step(1);
+  {
+    dtimerStart(&timers[0], ST2US(3), true);
+    dtimerStart(&timers[1], ST2US(5), true);
+    run_app(MAX_LOG, 30);
+    n0 = count_id(0, 0);
+    n1 = count_id(1, 0);
+    test_assert((n0 >= 9) && (n0 <= 10), "wrong timer 0 count");
+    test_assert((n1 >= 5) && (n1 <= 6), "wrong timer 1 count");
+  }
+
+  test_set_step(2);
+  {
+    dtimerStop(&timers[1]);
+    mark = nframes;
+    run_app(MAX_LOG, 15);
+    test_assert(count_id(1, mark) == 0, "stopped timer fired");
+    test_assert(count_id(0, mark) >= 4, "running timer stopped");
+  }
+
+  test_set_step(3);
+  {
+    dtimerStop(&timers[0]);
+    dtimerStart(&timers[1], ST2US(2), false);
+    mark = nframes;
+    run_app(MAX_LOG, 10);
+    test_assert(count_id(1, mark) == 1, "one-shot did not fire once");
+    test_assert(count_id(0, mark) == 0, "stopped timer fired");
+  }
+}
+
+static const testcase_t test_015_003 = {
+  "several timers",
+  dtimer_setup,
+  dtimer_teardown,
+  test_015_003_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Deadline timers.
+ */
+const testcase_t * const test_sequence_015[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_015_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_015_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_015_003,
+#endif
+  NULL
+};
@@ -0,0 +1,219 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "arena.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_016 App state arena
+ *
+ * File: @ref test_sequence_016.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the bump allocator in orchard/arena.c that holds
+ * the state of the running app.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_016_001
+ * - @subpage test_016_002
+ * - @subpage test_016_003
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define ARENA_BYTES   100
+
+static uint64_t mem[(ARENA_BYTES + 7) / 8];
+static arena a;
+
+static void arena_setup(void) {
+  memset(mem, 0xA5, sizeof(mem));
+  arenaInit(&a, mem, ARENA_BYTES);
+}
+
+static bool zeroed(const void *p, size_t size) {
+  const uint8_t *b = p;
+
+  while (size--)
+    if (*b++ != 0)
+      return false;
+  return true;
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_016_001 Alignment
+ *
+ * <h2>Description</h2>
+ * The arena size must be rounded down to the alignment, and allocations
+ * of any size must come back aligned, zeroed and one after the other.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A few odd sized blocks are allocated.
+ * .
+ */
+
+static void test_016_001_execute(void) {
+  uint8_t *p1, *p2, *p3;
+
+  test_set_step(1);
+  {
+    test_assert(a.size == ARENA_BYTES / ARENA_ALIGN * ARENA_ALIGN,
+                "size not rounded to the alignment");
+    p1 = arenaAlloc(&a, 1);
+    p2 = arenaAlloc(&a, 13);
+    p3 = arenaAlloc(&a, 8);
+    test_assert((p1 != NULL) && (p2 != NULL) && (p3 != NULL), "allocation failed");
+    test_assert((((uintptr_t)p1 | (uintptr_t)p2 | (uintptr_t)p3) & (ARENA_ALIGN - 1)) == 0,
+                "block not aligned");
+    test_assert((p1 == (uint8_t *)mem) && (p2 == p1 + ARENA_ALIGN) &&
+                (p3 == p2 + 2 * ARENA_ALIGN), "blocks not packed");
+    test_assert(zeroed(p1, 1) && zeroed(p2, 13) && zeroed(p3, 8), "block not zeroed");
+    test_assert(a.used == 4 * ARENA_ALIGN, "wrong use");
+  }
+}
+
+static const testcase_t test_016_001 = {
+  "alignment",
+  arena_setup,
+  NULL,
+  test_016_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_016_002 Exhaustion
+ *
+ * <h2>Description</h2>
+ * Allocations that don't fit must fail and be counted without using up
+ * the room that is left, including sizes that would wrap when rounded.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The arena is filled up.
+ * - Allocations too large for it are made.
+ * .
+ */
+
+static void test_016_002_execute(void) {
+
+  test_set_step(1);
+  {
+    test_assert(arenaAlloc(&a, a.size - ARENA_ALIGN) != NULL, "allocation failed");
+    test_assert(arenaAvailable(&a) == ARENA_ALIGN, "wrong room left");
+  }
+
+  test_set_step(2);
+  {
+    test_assert(arenaAlloc(&a, ARENA_ALIGN + 1) == NULL, "allocation past the end");
+    test_assert(arenaAlloc(&a, (size_t)-1) == NULL, "huge allocation wrapped");
+    test_assert(a.failed == 2, "failures not counted");
+    test_assert(arenaAlloc(&a, ARENA_ALIGN) != NULL, "last block not given");
+    test_assert(arenaAvailable(&a) == 0, "room left in a full arena");
+    test_assert(a.peak == a.size, "wrong peak");
+  }
+}
+
+static const testcase_t test_016_002 = {
+  "exhaustion",
+  arena_setup,
+  NULL,
+  test_016_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_016_003 App switches
+ *
+ * <h2>Description</h2>
+ * The app host resets the arena on every switch. Each app must get the
+ * whole arena back, with none of the previous app's state in it, and the
+ * peak must be kept across switches.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Apps of different sizes are switched through, each dirtying its state.
+ * .
+ */
+
+static void test_016_003_execute(void) {
+  static const size_t sizes[] = {40, 96, 8, 64};
+  uint8_t *priv;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      arenaReset(&a);
+      priv = arenaAlloc(&a, sizes[i]);
+      test_assert(priv == (uint8_t *)mem, "arena not given back");
+      test_assert(zeroed(priv, sizes[i]), "previous app state leaked");
+      memset(priv, 0xFF, sizes[i]);
+    }
+    test_assert(a.peak == 96, "peak lost across switches");
+    test_assert(a.used == 64, "wrong use");
+  }
+}
+
+static const testcase_t test_016_003 = {
+  "app switches",
+  arena_setup,
+  NULL,
+  test_016_003_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   App state arena.
+ */
+const testcase_t * const test_sequence_016[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_016_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_016_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_016_003,
+#endif
+  NULL
+};
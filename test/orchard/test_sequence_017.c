@@ -0,0 +1,362 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "chprintf.h"
+#include "dlog.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_017 Log output
+ *
+ * File: @ref test_sequence_017.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the buffered output of chprintf() and the deferred
+ * log in orchard/dlog.c, and compares what a trace point costs with each.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_017_001
+ * - @subpage test_017_002
+ * - @subpage test_017_003
+ * - @subpage test_017_004
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define CALLS         2000
+
+static const char trace_fmt[] = " init_sector: sector %d, block %d, journal %x\n\r";
+
+/*
+ * A stream standing in for a serial driver: every call takes the lock, like
+ * a put or write on the output queue does. It can also be made to take
+ * writes one byte at a time, the way chprintf() used to hand them over.
+ */
+static struct {
+  const struct BaseSequentialStreamVMT *vmt;
+  uint8_t   buf[256];
+  size_t    len;
+  unsigned  puts;
+  unsigned  writes;
+  bool      bytewise;
+} sink;
+
+static msg_t sink_put(void *ip, uint8_t b) {
+
+  (void)ip;
+  chSysLock();
+  sink.buf[sink.len++ % sizeof(sink.buf)] = b;
+  sink.puts++;
+  chSysUnlock();
+  return MSG_OK;
+}
+
+static size_t sink_write(void *ip, const uint8_t *bp, size_t n) {
+  size_t i;
+
+  if (sink.bytewise) {
+    for (i = 0; i < n; i++)
+      sink_put(ip, bp[i]);
+    return n;
+  }
+  chSysLock();
+  for (i = 0; i < n; i++)
+    sink.buf[sink.len++ % sizeof(sink.buf)] = bp[i];
+  sink.writes++;
+  chSysUnlock();
+  return n;
+}
+
+static size_t sink_read(void *ip, uint8_t *bp, size_t n) {
+
+  (void)ip;
+  (void)bp;
+  (void)n;
+  return 0;
+}
+
+static msg_t sink_get(void *ip) {
+
+  (void)ip;
+  return MSG_RESET;
+}
+
+static const struct BaseSequentialStreamVMT sink_vmt = {
+  sink_write, sink_read, sink_put, sink_get
+};
+
+static void log_setup(void) {
+  memset(&sink, 0, sizeof(sink));
+  sink.vmt = &sink_vmt;
+  dlogClear();
+  dlogResetStats();
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_017_001 Bulk output
+ *
+ * <h2>Description</h2>
+ * chprintf() must hand its output to the stream in writes of up to
+ * CHPRINTF_BUFFER_SIZE characters, with no single character puts, and the
+ * text must come out the same.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A short line is printed.
+ * - A line longer than the buffer is printed.
+ * .
+ */
+
+static void test_017_001_execute(void) {
+  int n;
+
+  test_set_step(1);
+  {
+    n = chprintf((BaseSequentialStream *)&sink, "%5d|%-3s|%02x", -42, "ab", 10);
+    test_assert((n == 12) && (sink.len == 12), "wrong length");
+    test_assert(memcmp(sink.buf, "  -42|ab |0A", 12) == 0, "wrong text");
+    test_assert((sink.puts == 0) && (sink.writes == 1), "not written in one go");
+  }
+
+  test_set_step(2);
+  {
+    sink.len = 0;
+    sink.writes = 0;
+    n = chprintf((BaseSequentialStream *)&sink, trace_fmt, 12, 3, 0xBEEF);
+    test_assert((n == 48) && (sink.len == 48), "wrong length");
+    test_assert(memcmp(sink.buf, " init_sector: sector 12, block 3, journal BEEF\n", 47) == 0,
+                "wrong text");
+    test_assert((sink.puts == 0) &&
+                (sink.writes == (48 + CHPRINTF_BUFFER_SIZE - 1) / CHPRINTF_BUFFER_SIZE),
+                "not written a buffer at a time");
+  }
+}
+
+static const testcase_t test_017_001 = {
+  "bulk output",
+  log_setup,
+  NULL,
+  test_017_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_017_002 Deferred records
+ *
+ * <h2>Description</h2>
+ * dlog() records must come back in order with their format, argument
+ * count and arguments, negative and pointer arguments included.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Records with no, some and the most arguments are written and read.
+ * .
+ */
+
+static void test_017_002_execute(void) {
+  static const char fmt0[] = "none";
+  static const char fmt2[] = "%d %s";
+  static const char fmt6[] = "%d %d %d %d %d %d";
+  dlog_record r;
+
+  test_set_step(1);
+  {
+    dlog(fmt0);
+    dlog(fmt2, -5, fmt0);
+    dlog(fmt6, 1, 2, 3, 4, 5, 6);
+
+    test_assert(dlogRead(&r) && (r.fmt == fmt0) && (r.nargs == 0), "wrong first record");
+    test_assert(dlogRead(&r) && (r.fmt == fmt2) && (r.nargs == 2), "wrong second record");
+    test_assert(((int)r.args[0] == -5) && ((const char *)r.args[1] == fmt0),
+                "wrong arguments");
+    test_assert(dlogRead(&r) && (r.fmt == fmt6) && (r.nargs == 6), "wrong third record");
+    test_assert((r.args[0] == 1) && (r.args[5] == 6), "wrong arguments");
+    test_assert(!dlogRead(&r), "record out of nothing");
+    test_assert((dlogStats()->written == 3) && (dlogStats()->read == 3), "wrong counts");
+  }
+}
+
+static const testcase_t test_017_002 = {
+  "deferred records",
+  log_setup,
+  NULL,
+  test_017_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_017_003 Full ring
+ *
+ * <h2>Description</h2>
+ * Records that don't fit must be dropped whole and counted, the ones in
+ * the ring kept intact, and the ring must work across its wrap.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The ring is overfilled.
+ * - Records are read and written again past the end of the ring.
+ * .
+ */
+
+static void test_017_003_execute(void) {
+  dlog_record r;
+  unsigned i, fit = DLOG_WORDS / 5;
+
+  test_set_step(1);
+  {
+    for (i = 0; i < fit + 3; i++)
+      dlog(trace_fmt, i, i, i);
+    test_assert(dlogStats()->written == fit, "wrong records kept");
+    test_assert(dlogStats()->dropped == 3, "drops not counted");
+  }
+
+  test_set_step(2);
+  {
+    for (i = 0; i < fit * 3; i++) {
+      test_assert(dlogRead(&r) && (r.nargs == 3) && (r.args[2] == i),
+                  "record lost");
+      dlog(trace_fmt, fit + i, fit + i, fit + i);
+    }
+    test_assert(dlogStats()->dropped == 3, "drop after the wrap");
+  }
+}
+
+static const testcase_t test_017_003 = {
+  "full ring",
+  log_setup,
+  NULL,
+  test_017_003_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_017_004 Trace point cost
+ *
+ * <h2>Description</h2>
+ * The storage trace line is logged with chprintf() handing every byte to
+ * the stream, as before, with chprintf() writing a buffer at a time, and
+ * with dlog(). Deferring the formatting must be the cheapest.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The line is printed a byte at a time.
+ * - The line is printed a buffer at a time.
+ * - The line is logged with dlog().
+ * .
+ */
+
+static void test_017_004_execute(void) {
+  dlog_record r;
+  rtcnt_t start, bytes, buffered, deferred;
+  unsigned n;
+
+  test_set_step(1);
+  {
+    sink.bytewise = true;
+    start = chSysGetRealtimeCounterX();
+    for (n = 0; n < CALLS; n++)
+      chprintf((BaseSequentialStream *)&sink, trace_fmt, n, n & 63, n * 7);
+    bytes = chSysGetRealtimeCounterX() - start;
+    test_assert(sink.puts > 40 * CALLS, "not written a byte at a time");
+  }
+
+  test_set_step(2);
+  {
+    sink.bytewise = false;
+    start = chSysGetRealtimeCounterX();
+    for (n = 0; n < CALLS; n++)
+      chprintf((BaseSequentialStream *)&sink, trace_fmt, n, n & 63, n * 7);
+    buffered = chSysGetRealtimeCounterX() - start;
+  }
+
+  test_set_step(3);
+  {
+    start = chSysGetRealtimeCounterX();
+    for (n = 0; n < CALLS; n++) {
+      dlog(trace_fmt, n, n & 63, n * 7);
+      dlogRead(&r);
+    }
+    deferred = chSysGetRealtimeCounterX() - start;
+    test_assert(dlogStats()->dropped == 0, "records dropped");
+
+    test_print("--- Byte at a time: ");
+    test_printn((uint32_t)(bytes * 1000 / CALLS));
+    test_println(" ns/call");
+    test_print("--- Bulk write:     ");
+    test_printn((uint32_t)(buffered * 1000 / CALLS));
+    test_println(" ns/call");
+    test_print("--- Deferred:       ");
+    test_printn((uint32_t)(deferred * 1000 / CALLS));
+    test_println(" ns/call");
+    test_assert((deferred < buffered) && (deferred < bytes), "dlog() is not cheaper");
+  }
+}
+
+static const testcase_t test_017_004 = {
+  "trace point cost",
+  log_setup,
+  NULL,
+  test_017_004_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Log output.
+ */
+const testcase_t * const test_sequence_017[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_017_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_017_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_017_003,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_017_004,
+#endif
+  NULL
+};
@@ -0,0 +1,399 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "test_root.h"
+
+#include "trace.h"
+#include <string.h>
+
+/**
+ * @page test_sequence_018 Kernel trace
+ *
+ * File: @ref test_sequence_018.c
+ *
+ * <h2>Description</h2>
+ * This sequence checks the records the kernel puts in its trace buffer,
+ * how the buffer overflows, and their encoding by orchard/trace.c for the
+ * "trace" shell command.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_018_001
+ * - @subpage test_018_002
+ * - @subpage test_018_003
+ * - @subpage test_018_004
+ * - @subpage test_018_005
+ * .
+ */
+
+/****************************************************************************
+ * Shared code.
+ ****************************************************************************/
+
+#define MAX_RECORDS   CH_DBG_TRACE_BUFFER_SIZE
+
+static ch_trace_event_t recs[MAX_RECORDS];
+static unsigned nrecs;
+
+static void trace_setup(void) {
+  ch_trace_event_t e;
+
+  chDbgTraceSetMask(CH_TRACE_MASK_ALL &
+                    ~(CH_TRACE_MASK(CH_TRACE_TYPE_ISR_ENTER) |
+                      CH_TRACE_MASK(CH_TRACE_TYPE_ISR_LEAVE)));
+  chSysLock();
+  while (chDbgTraceReadI(&e))
+    ;
+  chSysUnlock();
+}
+
+static void trace_teardown(void) {
+  chDbgTraceSetMask(CH_TRACE_MASK_ALL);
+}
+
+static void trace_collect(void) {
+  chSysLock();
+  for (nrecs = 0; (nrecs < MAX_RECORDS) && chDbgTraceReadI(&recs[nrecs]); nrecs++)
+    ;
+  chSysUnlock();
+}
+
+/* Index of the first record of a type from start on, nrecs if none.*/
+static unsigned trace_find(unsigned start, uint8_t type) {
+  while ((start < nrecs) && (recs[start].te_type != type))
+    start++;
+  return start;
+}
+
+static event_source_t es_unmasked;
+static unsigned fired;
+
+static void vt_callback(void *par) {
+  (void)par;
+  fired++;
+}
+
+static mutex_t mtx;
+static THD_WORKING_AREA(waLocker, 512);
+
+static THD_FUNCTION(locker, arg) {
+  (void)arg;
+  chMtxLock(&mtx);
+  chMtxUnlock(&mtx);
+}
+
+/****************************************************************************
+ * Test cases.
+ ****************************************************************************/
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_018_001 Kernel records
+ *
+ * <h2>Description</h2>
+ * Broadcasts, markers, virtual timer callbacks and context switches must
+ * each leave a record with their object and argument.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - Flags are broadcast and a marker is put in.
+ * - A virtual timer fires while the thread sleeps.
+ * .
+ */
+
+static void test_018_001_execute(void) {
+  static event_source_t es;
+  static virtual_timer_t vt;
+  static int par;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    chEvtObjectInit(&es);
+    chEvtBroadcastFlags(&es, 5);
+    chDbgTraceMark(TRACE_MARK_RADIO_RX, 42);
+    trace_collect();
+
+    i = trace_find(0, CH_TRACE_TYPE_EVT_BROADCAST);
+    test_assert((i < nrecs) && (recs[i].te_objp == &es) && (recs[i].te_arg == 5),
+                "no broadcast record");
+    i = trace_find(i, CH_TRACE_TYPE_MARK);
+    test_assert((i < nrecs) && (recs[i].te_state == TRACE_MARK_RADIO_RX) &&
+                (recs[i].te_objp == chThdGetSelfX()) && (recs[i].te_arg == 42),
+                "no marker after the broadcast");
+  }
+
+  test_set_step(2);
+  {
+    fired = 0;
+    chVTObjectInit(&vt);
+    chVTSet(&vt, MS2ST(1), vt_callback, &par);
+    chThdSleepMilliseconds(5);
+    trace_collect();
+
+    test_assert(fired == 1, "timer didn't fire");
+    i = trace_find(0, CH_TRACE_TYPE_SWITCH);
+    test_assert((i < nrecs) && (recs[i].te_state == CH_STATE_SLEEPING),
+                "no switch away from the sleeping thread");
+    i = trace_find(0, CH_TRACE_TYPE_VT_ENTER);
+    test_assert((i < nrecs) && (recs[i].te_objp == (void *)vt_callback) &&
+                (recs[i].te_arg == (uintptr_t)&par), "no callback record");
+    test_assert(recs[i + 1].te_type == CH_TRACE_TYPE_VT_LEAVE,
+                "no record of the callback returning");
+    test_assert((int32_t)(recs[i + 1].te_time - recs[i].te_time) >= 0,
+                "time went backwards");
+  }
+}
+
+static const testcase_t test_018_001 = {
+  "kernel records",
+  trace_setup,
+  trace_teardown,
+  test_018_001_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_018_002 Mutex contention
+ *
+ * <h2>Description</h2>
+ * A thread having to wait for a mutex must leave a record naming the
+ * mutex and its owner.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A higher priority thread tries to lock a mutex this thread holds.
+ * .
+ */
+
+static void test_018_002_execute(void) {
+  thread_t *tp;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    chMtxObjectInit(&mtx);
+    chMtxLock(&mtx);
+    tp = chThdCreateStatic(waLocker, sizeof(waLocker), chThdGetPriorityX() + 1,
+                           locker, NULL);
+    chMtxUnlock(&mtx);
+    chThdWait(tp);
+    trace_collect();
+
+    i = trace_find(0, CH_TRACE_TYPE_MTX_CONTENDED);
+    test_assert((i < nrecs) && (recs[i].te_objp == &mtx) &&
+                (recs[i].te_arg == (uintptr_t)chThdGetSelfX()),
+                "no contention record");
+    i = trace_find(i, CH_TRACE_TYPE_SWITCH);
+    test_assert((i < nrecs) && (recs[i].te_state == CH_STATE_WTMTX) &&
+                (recs[i].te_arg == (uintptr_t)&mtx), "no switch to the owner");
+  }
+}
+
+static const testcase_t test_018_002 = {
+  "mutex contention",
+  trace_setup,
+  trace_teardown,
+  test_018_002_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_018_003 Overflow
+ *
+ * <h2>Description</h2>
+ * When nothing reads the buffer the oldest records must be overwritten
+ * and counted as lost, and the rest read back in order. Record types
+ * left out of the mask must not be stored at all.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - More markers than the buffer holds are put in.
+ * .
+ */
+
+static void test_018_003_execute(void) {
+  uint32_t lost;
+  unsigned i;
+
+  test_set_step(1);
+  {
+    chDbgTraceSetMask(CH_TRACE_MASK(CH_TRACE_TYPE_MARK));
+    chEvtObjectInit(&es_unmasked);
+    lost = ch.dbg.trace_buffer.tb_lost;
+    for (i = 0; i < MAX_RECORDS + 5; i++)
+      chDbgTraceMark(TRACE_MARK_FX_BEGIN, i);
+    chEvtBroadcastFlags(&es_unmasked, 0);
+    trace_collect();
+
+    test_assert(ch.dbg.trace_buffer.tb_lost - lost == 5, "lost records not counted");
+    test_assert(nrecs == MAX_RECORDS, "wrong record count");
+    for (i = 0; i < nrecs; i++)
+      test_assert((recs[i].te_type == CH_TRACE_TYPE_MARK) && (recs[i].te_arg == i + 5),
+                  "records out of order");
+  }
+}
+
+static const testcase_t test_018_003 = {
+  "overflow",
+  trace_setup,
+  trace_teardown,
+  test_018_003_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_018_004 Encoding
+ *
+ * <h2>Description</h2>
+ * Records must be encoded with the time since the previous one and only
+ * the fields of their type, in the layout trace-json.py reads.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - A switch record and an ISR record are encoded.
+ * .
+ */
+
+static void test_018_004_execute(void) {
+  static const uint8_t expect_switch[] = {
+    CH_TRACE_TYPE_SWITCH, 0xAC, 0x02, CH_STATE_WTSEM,
+    0x78, 0x56, 0x34, 0x12, 0xEF, 0xBE, 0x00, 0x00
+  };
+  static const uint8_t expect_isr[] = {CH_TRACE_TYPE_ISR_ENTER, 0x05, 31};
+  uint8_t out[TRACE_RECORD_MAX];
+  ch_trace_event_t e;
+  trace_encoder enc;
+  size_t n;
+
+  test_set_step(1);
+  {
+    traceEncoderInit(&enc);
+    memset(&e, 0, sizeof(e));
+    e.te_type = CH_TRACE_TYPE_SWITCH;
+    e.te_state = CH_STATE_WTSEM;
+    e.te_time = 300;
+    e.te_objp = (void *)(uintptr_t)0x12345678;
+    e.te_arg = 0xBEEF;
+    n = traceEncode(&enc, &e, out);
+    test_assert((n == sizeof(expect_switch)) &&
+                (memcmp(out, expect_switch, n) == 0), "wrong switch record");
+
+    e.te_type = CH_TRACE_TYPE_ISR_ENTER;
+    e.te_state = 31;
+    e.te_time = 305;
+    n = traceEncode(&enc, &e, out);
+    test_assert((n == sizeof(expect_isr)) &&
+                (memcmp(out, expect_isr, n) == 0), "wrong ISR record");
+  }
+}
+
+static const testcase_t test_018_004 = {
+  "encoding",
+  NULL,
+  NULL,
+  test_018_004_execute
+};
+#endif /* TRUE */
+
+#if TRUE || defined(__DOXYGEN__)
+/**
+ * @page test_018_005 Timestamps
+ *
+ * <h2>Description</h2>
+ * Records must come out with timestamps that never decrease, including
+ * the ones written from the tick interrupt and from timer callbacks. The
+ * encoder stores unsigned deltas, so a step back would be read as a jump
+ * of a whole timestamp period.
+ *
+ * <h2>Conditions</h2>
+ * None.
+ *
+ * <h2>Test Steps</h2>
+ * - The thread sleeps across several ticks with a timer armed and every
+ *   record type enabled.
+ * .
+ */
+
+static void test_018_005_execute(void) {
+  static virtual_timer_t vt;
+  unsigned i, isr;
+
+  test_set_step(1);
+  {
+    chDbgTraceSetMask(CH_TRACE_MASK_ALL);
+    fired = 0;
+    chVTObjectInit(&vt);
+    chVTSet(&vt, MS2ST(1), vt_callback, NULL);
+    chThdSleepMilliseconds(3);
+    trace_collect();
+
+    test_assert(fired == 1, "timer didn't fire");
+    isr = trace_find(0, CH_TRACE_TYPE_ISR_ENTER);
+    test_assert(isr < nrecs, "no ISR record");
+    for (i = 1; i < nrecs; i++)
+      test_assert((int32_t)(recs[i].te_time - recs[i - 1].te_time) >= 0,
+                  "time went backwards");
+  }
+}
+
+static const testcase_t test_018_005 = {
+  "timestamps",
+  trace_setup,
+  trace_teardown,
+  test_018_005_execute
+};
+#endif /* TRUE */
+
+/****************************************************************************
+ * Exported data.
+ ****************************************************************************/
+
+/**
+ * @brief   Kernel trace.
+ */
+const testcase_t * const test_sequence_018[] = {
+#if TRUE || defined(__DOXYGEN__)
+  &test_018_001,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_018_002,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_018_003,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_018_004,
+#endif
+#if TRUE || defined(__DOXYGEN__)
+  &test_018_005,
+#endif
+  NULL
+};
@@ -0,0 +1,31 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host stand-in for the C90TFS SSD_FTFx.h header, only the geometry used by
+ * orchard/flash.h and orchard/storage.h is provided.
+ */
+
+#ifndef _SSD_FTFX_H_
+#define _SSD_FTFX_H_
+
+#define FTFx_PSECTOR_SIZE                       0x00000400
+
+#define FSL_FEATURE_FLASH_PFLASH_BLOCK_SIZE     0x00020000
+#define FSL_FEATURE_FLASH_PFLASH_BLOCK_COUNT    1
+#define FSL_FEATURE_FLASH_PFLASH_BLOCK_SECTOR_SIZE FTFx_PSECTOR_SIZE
+
+#endif /* _SSD_FTFX_H_ */
@@ -0,0 +1,63 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "ch_test.h"
+#include "console.h"
+#include "nullstreams.h"
+
+#include "flash.h"
+#include "storage.h"
+
+/*
+ * The Orchard modules print their traces on this stream, they are not
+ * interesting during the tests.
+ */
+static NullStream null_stream;
+void *stream = &null_stream;
+
+/*
+ * Simulator main.
+ */
+int main(int argc, char *argv[]) {
+
+  (void)argc;
+  (void)argv;
+
+  /*
+   * System initializations.
+   * - HAL initialization, this also initializes the configured device drivers
+   *   and performs the board-specific initializations.
+   * - Kernel initialization, the main() function becomes a thread and the
+   *   RTOS is active.
+   */
+  halInit();
+  conInit();
+  chSysInit();
+  nullObjectInit(&null_stream);
+
+  flashStart();
+  storageStart();
+
+  if (test_execute((BaseSequentialStream *)&CD1))
+    exit(1);
+  else
+    exit(0);
+}
@@ -0,0 +1,103 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * RAM-backed stand-in for the Orchard flash driver. The storage area is
+ * mapped at the same address the KW01 linker script assigns to it, so the
+ * ORFS code can keep using absolute sector addresses.
+ */
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "flash.h"
+#include "sim-flash.h"
+
+sim_flash_stats_t sim_flash_stats;
+
+void flashStart(void) {
+  void *p;
+
+  p = mmap(__storage_start__, (size_t)__storage_size__,
+           PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if (p != (void *)__storage_start__) {
+    printf("Unable to map the simulated flash at %p\n", (void *)__storage_start__);
+    exit(1);
+  }
+  simFlashReset();
+}
+
+uint32_t flashGetSecurity(void) {
+
+  return 0;
+}
+
+/*
+ * Wipes the whole storage area and the counters.
+ */
+void simFlashReset(void) {
+
+  memset(__storage_start__, 0xFF, (size_t)__storage_size__);
+  memset(&sim_flash_stats, 0, sizeof(sim_flash_stats));
+}
+
+int8_t flashErase(uint32_t offset, uint16_t sectorCount) {
+  uint32_t end = offset + (uint32_t)sectorCount;
+
+  if ((offset < F_USER_SECTOR_START) ||
+      (end > ((uintptr_t)__storage_end__ + 1) / FTFx_PSECTOR_SIZE))
+    return F_ERR_RANGE;
+
+  while (offset < end) {
+    memset((uint8_t *)((uintptr_t)offset * FTFx_PSECTOR_SIZE), 0xFF,
+           FTFx_PSECTOR_SIZE);
+    sim_flash_stats.erases++;
+    sim_flash_stats.sectorErases[offset - F_USER_SECTOR_START]++;
+    offset++;
+  }
+  return F_ERR_OK;
+}
+
+int8_t flashProgram(uint8_t *src, uint8_t *dest, uint32_t count) {
+  uint32_t i;
+
+  if (count == 0)
+    return F_ERR_OK;
+
+  if (((uintptr_t)dest < (uintptr_t)__storage_start__) ||
+      (((uintptr_t)dest + count) > ((uintptr_t)__storage_end__ + 1)))
+    return F_ERR_RANGE;
+
+  if (((count % 4) != 0) || (((uintptr_t)dest % 4) != 0))
+    return F_ERR_NOTALIGN;
+
+  /* Same policy as the real driver, no re-programming over 0's.*/
+  for (i = 0; i < count; i++) {
+    if (dest[i] != 0xFF)
+      return F_ERR_NOTBLANK;
+  }
+
+  memcpy(dest, src, count);
+  sim_flash_stats.programs++;
+  sim_flash_stats.programBytes += count;
+  return F_ERR_OK;
+}
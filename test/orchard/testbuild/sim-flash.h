@@ -0,0 +1,44 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * RAM-backed stand-in for the Orchard flash driver.
+ */
+
+#ifndef _SIM_FLASH_H_
+#define _SIM_FLASH_H_
+
+/**
+ * @brief   Flash operation counters.
+ */
+typedef struct {
+  uint32_t      erases;             /**< @brief Sectors erased.             */
+  uint32_t      programs;           /**< @brief Program operations.         */
+  uint32_t      programBytes;       /**< @brief Bytes programmed.           */
+  uint32_t      sectorErases[32];   /**< @brief Per-sector erase counts.    */
+} sim_flash_stats_t;
+
+extern sim_flash_stats_t sim_flash_stats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void simFlashReset(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SIM_FLASH_H_ */
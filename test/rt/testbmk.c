@@ -49,6 +49,8 @@
  * - @subpage test_benchmarks_011
  * - @subpage test_benchmarks_012
  * - @subpage test_benchmarks_013
+ * - @subpage test_benchmarks_014
+ * - @subpage test_benchmarks_015
  * .
  * @file testbmk.c Kernel Benchmarks
  * @brief Kernel Benchmarks source file
@@ -690,6 +692,210 @@ ROMCONST struct testcase testbmk13 = {
   bmk13_execute
 };
 
+#if CH_CFG_USE_HEAP || defined(__DOXYGEN__)
+/**
+ * @page test_benchmarks_014 Heap allocator under a random workload
+ *
+ * <h2>Description</h2>
+ * A set of slots is filled and emptied at random, each allocation of a
+ * random size between 8 and 263 bytes, from a local heap in the test
+ * buffer.<br>
+ * The performance is calculated by measuring the number of allocations
+ * and releases after a second of continuous operations, then the state of
+ * the heap with all the slots still allocated shows how fragmented the
+ * allocator left it.
+ */
+
+#define BMK14_SLOTS 24
+
+static memory_heap_t bmk14_heap;
+
+static void bmk14_setup(void) {
+
+  chHeapObjectInit(&bmk14_heap, test.buffer, sizeof(union test_buffers));
+}
+
+static void bmk14_execute(void) {
+  void *slots[BMK14_SLOTS];
+  heap_stats_t stats;
+  uint32_t n = 0, seed = 1;
+  unsigned i;
+
+  for (i = 0; i < BMK14_SLOTS; i++) {
+    slots[i] = NULL;
+  }
+
+  test_wait_tick();
+  test_start_timer(1000);
+  do {
+    /* Same sequence on every run.*/
+    seed = seed * 1103515245U + 12345U;
+    i = (unsigned)(seed >> 16) % BMK14_SLOTS;
+    if (slots[i] != NULL) {
+      chHeapFree(slots[i]);
+      slots[i] = NULL;
+    }
+    else {
+      slots[i] = chHeapAlloc(&bmk14_heap, 8U + ((seed >> 8) & 0xFFU));
+    }
+    n++;
+#if defined(SIMULATOR)
+    _sim_check_for_interrupts();
+#endif
+  } while (!test_timer_done);
+
+  chHeapStats(&bmk14_heap, &stats);
+  for (i = 0; i < BMK14_SLOTS; i++) {
+    if (slots[i] != NULL) {
+      chHeapFree(slots[i]);
+    }
+  }
+
+#if CH_CFG_USE_HEAP_TLSF
+  test_println("--- Heap  : segregated fit");
+#else
+  test_println("--- Heap  : first fit");
+#endif
+  test_print("--- Score : ");
+  test_printn(n);
+  test_println(" alloc|free/S");
+  test_print("--- Frags : ");
+  test_printn(stats.fragments);
+  test_print(", largest ");
+  test_printn(stats.largest);
+  test_print("/");
+  test_printn(stats.free);
+  test_println(" bytes");
+  test_print("--- Failed: ");
+  test_printn(stats.failures);
+  test_println(" allocs");
+}
+
+ROMCONST struct testcase testbmk14 = {
+  "Benchmark, heap random workload",
+  bmk14_setup,
+  NULL,
+  bmk14_execute
+};
+#endif
+
+/**
+ * @page test_benchmarks_015 Virtual timers dispatch jitter
+ *
+ * <h2>Description</h2>
+ * A virtual timer sets itself again from its callback every few
+ * milliseconds for one second, while the test thread sleeps.<br>
+ * The time between two callbacks is measured with the realtime counter,
+ * or the system time where there is none, and its spread is the dispatch
+ * jitter. The system timer interrupts taken in that second are the
+ * wakeups, one per tick in periodic mode and about one per callback in
+ * tick-less mode. They are counted by a @p CH_CFG_SYSTEM_TICK_HOOK()
+ * that increments @p test_timer_irqs, or else by the kernel statistics.
+ */
+
+#define BMK15_PERIOD MS2ST(3)
+
+/* Incremented by the system tick hook of the test configuration, if any.*/
+volatile unsigned test_timer_irqs;
+
+static virtual_timer_t bmk15_vt;
+static uint32_t bmk15_n, bmk15_min, bmk15_max, bmk15_last, bmk15_first;
+
+static uint32_t bmk15_now(void) {
+
+#if PORT_SUPPORTS_RT
+  return (uint32_t)chSysGetRealtimeCounterX();
+#else
+  return (uint32_t)chVTGetSystemTimeX();
+#endif
+}
+
+static void bmk15_cb(void *p) {
+  uint32_t now = bmk15_now();
+
+  (void)p;
+  if (bmk15_n == 0U) {
+    bmk15_first = now;
+  }
+  else {
+    if (now - bmk15_last < bmk15_min) {
+      bmk15_min = now - bmk15_last;
+    }
+    if (now - bmk15_last > bmk15_max) {
+      bmk15_max = now - bmk15_last;
+    }
+  }
+  bmk15_last = now;
+  bmk15_n++;
+
+  chSysLockFromISR();
+  chVTSetI(&bmk15_vt, BMK15_PERIOD, bmk15_cb, NULL);
+  chSysUnlockFromISR();
+}
+
+static void bmk15_execute(void) {
+  unsigned irqs;
+#if CH_DBG_STATISTICS
+  ucnt_t stats_irqs;
+#endif
+
+  bmk15_n = 0;
+  bmk15_min = (uint32_t)-1;
+  bmk15_max = 0;
+  chVTObjectInit(&bmk15_vt);
+
+  test_wait_tick();
+  irqs = test_timer_irqs;
+#if CH_DBG_STATISTICS
+  stats_irqs = ch.kernel_stats.n_irq;
+#endif
+  chVTSet(&bmk15_vt, BMK15_PERIOD, bmk15_cb, NULL);
+  chThdSleepSeconds(1);
+  chVTReset(&bmk15_vt);
+  irqs = test_timer_irqs - irqs;
+#if CH_DBG_STATISTICS
+  if (irqs == 0U) {
+    irqs = (unsigned)(ch.kernel_stats.n_irq - stats_irqs);
+  }
+#endif
+
+  test_assert(1, bmk15_n > 1U, "timer not dispatched");
+
+#if CH_CFG_ST_TIMEDELTA > 0
+  test_println("--- Mode  : tick-less");
+#else
+  test_println("--- Mode  : periodic");
+#endif
+#if PORT_SUPPORTS_RT
+  test_print("--- Period: realtime counts, mean ");
+#else
+  test_print("--- Period: ticks, mean ");
+#endif
+  test_printn((bmk15_last - bmk15_first) / (bmk15_n - 1U));
+  test_print(", min ");
+  test_printn(bmk15_min);
+  test_print(", max ");
+  test_printn(bmk15_max);
+  test_println("");
+  test_print("--- Jitter: ");
+  test_printn(bmk15_max - bmk15_min);
+  test_println("");
+  if (irqs > 0U) {
+    test_print("--- Wakeup: ");
+    test_printn(irqs);
+    test_print(" IRQs/S for ");
+    test_printn(bmk15_n);
+    test_println(" callbacks");
+  }
+}
+
+ROMCONST struct testcase testbmk15 = {
+  "Benchmark, virtual timers dispatch jitter",
+  NULL,
+  NULL,
+  bmk15_execute
+};
+
 /**
  * @brief   Test sequence for benchmarks.
  */
@@ -718,6 +924,10 @@ ROMCONST struct testcase * ROMCONST patternbmk[] = {
   &testbmk12,
 #endif
   &testbmk13,
+#if CH_CFG_USE_HEAP || defined(__DOXYGEN__)
+  &testbmk14,
+#endif
+  &testbmk15,
 #endif
   NULL
 };
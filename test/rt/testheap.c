@@ -37,6 +37,7 @@
  *
  * <h2>Test Cases</h2>
  * - @subpage test_heap_001
+ * - @subpage test_heap_002
  * .
  * @file testheap.c
  * @brief Heap test source file
@@ -146,6 +147,40 @@ ROMCONST struct testcase testheap1 = {
   heap1_execute
 };
 
+/**
+ * @page test_heap_002 Provider merge test
+ *
+ * <h2>Description</h2>
+ * Two blocks too big for the free space of the default heap are taken from
+ * the core allocator, one right after the other. Once both are released
+ * they must form a single free block, the heap can't fragment for good by
+ * growing a chunk at a time.
+ */
+
+static void heap2_execute(void) {
+  void *p1, *p2;
+  heap_stats_t st;
+  size_t size;
+
+  chHeapStats(NULL, &st);
+  size = MEM_ALIGN_NEXT(st.largest + SIZE);
+  p1 = chHeapAlloc(NULL, size);
+  p2 = chHeapAlloc(NULL, size);
+  test_assert(1, (p1 != NULL) && (p2 != NULL), "allocation failed");
+  chHeapFree(p1);
+  chHeapFree(p2);
+
+  chHeapStats(NULL, &st);
+  test_assert(2, st.largest >= 2 * size, "provider chunks not merged");
+}
+
+ROMCONST struct testcase testheap2 = {
+  "Heap, provider merge test",
+  NULL,
+  NULL,
+  heap2_execute
+};
+
 #endif /* CH_CFG_USE_HEAP.*/
 
 /**
@@ -154,6 +189,7 @@ ROMCONST struct testcase testheap1 = {
 ROMCONST struct testcase * ROMCONST patternheap[] = {
 #if (CH_CFG_USE_HEAP && !CH_CFG_USE_MALLOC_HEAP) || defined(__DOXYGEN__)
   &testheap1,
+  &testheap2,
 #endif
   NULL
 };